@@ -0,0 +1,148 @@
+#!/bin/bash
+# Writes a GP 2 host graph of a scalable family to stdout.
+#
+# Usage: generate.sh <family> <size> [<seed>]
+#
+# Families:
+#   grid <n>            n x n grid, edges pointing right and down.
+#   weighted-grid <n>   As grid, with integer edge weights and the first node
+#                       grey (the input of shortpathprog).
+#   tree <n>            Random recursive tree with n nodes, edges pointing away
+#                       from the root.
+#   cycle <n>           Directed cycle with n nodes.
+#   atom-cycle <n>      As cycle, with the nodes and edges labelled with their
+#                       numbers (the input of eulercycleprog).
+#   sierpinski <k>      Sierpinski triangle of generation k.
+#   sierpinski-seed <k> The single root node with label k from which
+#                       triangleprog grows the Sierpinski triangle.
+#   gnp <n>             Random graph G(n, p) with p = 4/n: each pair of nodes
+#                       i < j is joined by an edge i -> j with probability p.
+#   powerlaw <n>        Preferential attachment (Barabasi-Albert) graph: each new
+#                       node is joined to 2 earlier nodes chosen with probability
+#                       proportional to their degree.
+#
+# A family prefixed with shuffled- (e.g. shuffled-grid) gives the same graph with
+# its nodes and edges listed in random order. The loader numbers the items in
+# file order, so these graphs measure the locality of badly ordered inputs
+# (see gp2run -r).
+#
+# Random families are seeded with <seed> (default 1), so a family, size and
+# seed always give the same graph. The grid, tree, gnp and powerlaw graphs are
+# acyclic.
+
+if [ $# -lt 2 ]; then
+   sed -n '2,/^$/s/^# \{0,1\}//p' "$0" >&2
+   exit 1
+fi
+
+family=${1#shuffled-}
+size=$2
+seed=${3:-1}
+[ "$family" != "$1" ] && shuffled=1 || shuffled=0
+
+exec awk -v family="$family" -v n="$size" -v seed="$seed" -v shuffled="$shuffled" '
+function node(id, label) { emit(sprintf("    (%d, %s)", id, label)) }
+function edge(source, target, label) { emit(sprintf("    (%d, %d, %d, %s)", edges++, source, target, label)) }
+function separator() { emit("|") }
+function emit(line) { if(shuffled) lines[line_count++] = line; else print line }
+
+# Prints the lines from first to last - 1 in random order. The order is drawn
+# after the graph is generated, so that the graph does not depend on it.
+function shuffle(first, last,     i, j, line) {
+   for(i = last - 1; i > first; i--) {
+      j = first + int(rand() * (i - first + 1))
+      line = lines[i]; lines[i] = lines[j]; lines[j] = line
+   }
+   for(i = first; i < last; i++) print lines[i]
+}
+
+# The unit triangles of the Sierpinski triangle of side s with corner (x, y),
+# in the coordinates of the triangular lattice.
+function triangles(x, y, s,     h) {
+   if(s == 1) {
+      tx[triangle_count] = x; ty[triangle_count] = y; triangle_count++
+      return
+   }
+   h = s / 2
+   triangles(x, y, h); triangles(x + h, y, h); triangles(x, y + h, h)
+}
+function corner(x, y) {
+   if(!((x, y) in ids)) ids[x, y] = corner_count++
+   return ids[x, y]
+}
+
+BEGIN {
+   srand(seed)
+   edges = 0
+   print "["
+   if(family == "grid" || family == "weighted-grid") {
+      for(i = 0; i < n * n; i++) node(i, family == "grid" || i > 0 ? "empty" : "empty # grey")
+      separator()
+      for(i = 0; i < n * n; i++) {
+         weight = family == "grid" ? "empty" : (i * 7 + 3) % 10
+         if(i % n < n - 1) edge(i, i + 1, weight)
+         if(i + n < n * n) edge(i, i + n, weight)
+      }
+   }
+   else if(family == "tree") {
+      for(i = 0; i < n; i++) node(i, "empty")
+      separator()
+      for(i = 1; i < n; i++) edge(int(rand() * i), i, "empty")
+   }
+   else if(family == "cycle" || family == "atom-cycle") {
+      for(i = 0; i < n; i++) node(i, family == "cycle" ? "empty" : i)
+      separator()
+      for(i = 0; i < n; i++) edge(i, (i + 1) % n, family == "cycle" ? "empty" : i)
+   }
+   else if(family == "sierpinski") {
+      triangles(0, 0, 2 ^ n)
+      for(t = 0; t < triangle_count; t++) {
+         a[t] = corner(tx[t], ty[t]); b[t] = corner(tx[t] + 1, ty[t]); c[t] = corner(tx[t], ty[t] + 1)
+      }
+      for(i = 0; i < corner_count; i++) node(i, "empty")
+      separator()
+      for(t = 0; t < triangle_count; t++) {
+         edge(a[t], b[t], "empty"); edge(b[t], c[t], "empty"); edge(c[t], a[t], "empty")
+      }
+   }
+   else if(family == "sierpinski-seed") {
+      emit("    (0(R), " n ")")
+      separator()
+   }
+   else if(family == "gnp") {
+      for(i = 0; i < n; i++) node(i, "empty")
+      separator()
+      # Skip over the absent pairs with geometric jumps (Batagelj and Brandes),
+      # so that the generator runs in time linear in the size of the graph.
+      p = n > 4 ? 4 / n : 0.5
+      i = 1; j = -1
+      while(i < n) {
+         j += 1 + int(log(1 - rand()) / log(1 - p))
+         while(j >= i && i < n) { j -= i; i++ }
+         if(i < n) edge(j, i, "empty")
+      }
+   }
+   else if(family == "powerlaw") {
+      for(i = 0; i < n; i++) node(i, "empty")
+      separator()
+      # Every edge adds both its nodes to the list of ends, so a node is chosen
+      # from the list with probability proportional to its degree.
+      ends = 0
+      if(n > 1) { edge(1, 0, "empty"); end[ends++] = 0; end[ends++] = 1 }
+      for(i = 2; i < n; i++) {
+         first = end[int(rand() * ends)]
+         do second = end[int(rand() * ends)]; while(second == first && i > 2)
+         edge(i, first, "empty"); end[ends++] = i; end[ends++] = first
+         if(second != first) { edge(i, second, "empty"); end[ends++] = i; end[ends++] = second }
+      }
+   }
+   else {
+      print "generate.sh: unknown family " family > "/dev/stderr"
+      exit 1
+   }
+   if(shuffled) {
+      for(bar = 0; lines[bar] != "|"; bar++);
+      shuffle(0, bar); print "|"; shuffle(bar + 1, line_count)
+   }
+   print "]"
+}'
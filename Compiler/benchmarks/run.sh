@@ -0,0 +1,193 @@
+#!/bin/bash
+# Benchmarks the sample programs on scaled host graphs.
+#
+# Usage: run.sh [-g <gp2>] [-l <rootdir>] [-o <outdir>] [-s <suite>]
+#               [-b <baseline>] [-u] [-t <tolerance>] [-T <timeout>]
+#               [-R <gp2run flags>] [-- <gp2 flags>]
+#
+# Each line of the suite file (default benchmarks/suite) names a program of
+# programs/, a graph family of generate.sh and the sizes to run it on. The
+# program is compiled once by gp2 -P with the given gp2 flags and built with
+# the Makefile gp2 generates. Its gp2run is then run on the graph of each size,
+# and the wall time, the peak resident set size and the totals of the profiler
+# counters of the run are written to <outdir>/results.csv, one row per run:
+#
+#   program,family,size,status,wall_ms,peak_rss_kb,match_calls,matches,candidates,changes
+#
+# The status is ok, failed or timeout (after <timeout> seconds, default 300).
+# The gp2run flags of -R, separated by spaces, are passed to each run.
+#
+# The compiler is src/gp2 and the runtime library is taken from lib/ unless
+# -g and -l (a root directory as for gp2 -l) are given. <outdir> defaults to
+# /tmp/gp2-bench.
+#
+# With -b, the results are compared against the baseline file, the results.csv
+# of an earlier run. A run that no longer succeeds, or whose wall time, peak
+# resident set size or candidate count exceeds the baseline by more than the
+# tolerance (default 25 percent) is a regression, and run.sh exits with status 1.
+# Wall times under 50 ms are not compared. With -u, the results are copied to
+# the baseline file instead. Wall times and memory depend on the machine, so a
+# baseline is only comparable with runs on the machine that recorded it; the
+# counters depend only on the compiler and the library.
+#
+# For example, the effect of gp2run -r (locality reordering) on the shuffled
+# grid and power-law graphs of the suite shows in
+#
+#   run.sh -o /tmp/gp2-plain -u -b /tmp/plain.csv
+#   run.sh -o /tmp/gp2-reordered -R -r -b /tmp/plain.csv -t 0
+
+bench_dir=$(cd "$(dirname "$0")" && pwd)
+top_dir=$(dirname "$bench_dir")
+
+gp2=$top_dir/src/gp2
+root_dir=
+out_dir=/tmp/gp2-bench
+suite=$bench_dir/suite
+baseline=
+update=false
+tolerance=25
+time_limit=300
+run_flags=()
+
+usage() {
+   sed -n '2,/^$/s/^# \{0,1\}//p' "$0" >&2
+   exit 1
+}
+
+while getopts "g:l:o:s:b:ut:T:R:h" option; do
+   case $option in
+      g) gp2=$(cd "$(dirname "$OPTARG")" && pwd)/$(basename "$OPTARG") ;;
+      l) root_dir=$(cd "$OPTARG" && pwd) ;;
+      o) out_dir=$OPTARG ;;
+      s) suite=$OPTARG ;;
+      b) baseline=$OPTARG ;;
+      u) update=true ;;
+      t) tolerance=$OPTARG ;;
+      T) time_limit=$OPTARG ;;
+      R) read -r -a run_flags <<< "$OPTARG" ;;
+      *) usage ;;
+   esac
+done
+shift $((OPTIND - 1))
+gp2_flags=("$@")
+
+if [ ! -x "$gp2" ]; then
+   echo "run.sh: no compiler at $gp2." >&2
+   exit 1
+fi
+if $update && [ -z "$baseline" ]; then
+   echo "run.sh: -u needs a baseline file (-b)." >&2
+   exit 1
+fi
+
+mkdir -p "$out_dir"/graphs "$out_dir"/build
+out_dir=$(cd "$out_dir" && pwd)
+results=$out_dir/results.csv
+
+# Stage the headers, the library and its sources (for gp2 -B unity or lto) of
+# the build tree as an installed root.
+if [ -z "$root_dir" ]; then
+   root_dir=$out_dir/root
+   mkdir -p "$root_dir"/include "$root_dir"/lib "$root_dir"/share/gp2/lib
+   cp "$top_dir"/lib/*.h "$root_dir"/include/
+   cp "$top_dir"/lib/*.c "$root_dir"/share/gp2/lib/
+   if ! cp "$top_dir"/lib/libgp2.a "$root_dir"/lib/; then
+      echo "run.sh: build the runtime library first, or pass -l." >&2
+      exit 1
+   fi
+fi
+
+# Prints the peak resident set size and the totals of the counters of the
+# profile written by gp2run, separated by commas.
+profile_counters() {
+   awk '
+   {
+      text = $0
+      while(match(text, /"[a-z_]+": [0-9]+/)) {
+         field = substr(text, RSTART + 1, RLENGTH - 1)
+         text = substr(text, RSTART + RLENGTH)
+         split(field, parts, "\": ")
+         total[parts[1]] += parts[2]
+      }
+      text = $0
+      if(match(text, /"candidates": \[[0-9, ]*\]/)) {
+         count = split(substr(text, RSTART + 15, RLENGTH - 16), numbers, ", ")
+         for(i = 1; i <= count; i++) total["candidates"] += numbers[i]
+      }
+   }
+   END {
+      printf "%d,%d,%d,%d,%d\n", total["peak_rss_kb"], total["match_calls"],
+             total["matches"], total["candidates"], total["changes"]
+   }' "$1"
+}
+
+echo "program,family,size,status,wall_ms,peak_rss_kb,match_calls,matches,candidates,changes" \
+     > "$results"
+
+while read -r program family sizes; do
+   case $program in ''|\#*) continue ;; esac
+   build=$out_dir/build/$program
+   rm -rf "$build"
+   mkdir -p "$build"
+   if ! "$gp2" -P "${gp2_flags[@]}" -l "$root_dir" -o "$build" "$top_dir/programs/$program" \
+        > "$build/compile.txt" 2>&1 || ! make -s -C "$build" > "$build/make.txt" 2>&1; then
+      echo "FAIL: $program does not compile (see $build)."
+      for size in $sizes; do echo "$program,$family,$size,failed,,,,,," >> "$results"; done
+      continue
+   fi
+   for size in $sizes; do
+      graph=$out_dir/graphs/$family-$size
+      [ -f "$graph" ] || "$bench_dir/generate.sh" "$family" "$size" > "$graph"
+      run=$program-$family-$size
+      start=$(date +%s%N)
+      ( cd "$build" && timeout "$time_limit" ./gp2run "${run_flags[@]}" -p "$run.json" \
+        -o "$run.output" "$graph" > "$run.txt" 2>&1 )
+      status=$?
+      end=$(date +%s%N)
+      wall_ms=$(( (end - start) / 1000000 ))
+      if [ $status -eq 0 ] && [ -f "$build/$run.json" ]; then
+         echo "$program,$family,$size,ok,$wall_ms,$(profile_counters "$build/$run.json")" >> "$results"
+         printf "%-16s %-16s %8s %10d ms\n" "$program" "$family" "$size" "$wall_ms"
+      else
+         [ $status -eq 124 ] && outcome=timeout || outcome=failed
+         echo "$program,$family,$size,$outcome,$wall_ms,,,,," >> "$results"
+         printf "%-16s %-16s %8s %13s\n" "$program" "$family" "$size" "$outcome"
+      fi
+   done
+done < "$suite"
+
+echo "Results written to $results."
+
+if $update; then
+   cp "$results" "$baseline"
+   echo "Baseline $baseline updated."
+   exit 0
+fi
+[ -n "$baseline" ] || exit 0
+if [ ! -f "$baseline" ]; then
+   echo "run.sh: no baseline file $baseline." >&2
+   exit 1
+fi
+
+awk -F, -v tolerance="$tolerance" '
+function worse(new, old) { return old != "" && new > old * (1 + tolerance / 100) }
+function report(what, new, old) {
+   printf "REGRESSION: %s on %s %s: %s %s (baseline %s)\n", $1, $2, $3, what, new, old
+   regressions++
+}
+FNR == 1 { next }
+FNR == NR { key = $1 "," $2 "," $3; status[key] = $4; wall[key] = $5; rss[key] = $6
+            candidates[key] = $9; next }
+{
+   key = $1 "," $2 "," $3
+   if(!(key in status)) next
+   if($4 != "ok") { if(status[key] == "ok") report("status", $4, "ok"); next }
+   if(status[key] != "ok") next
+   if(wall[key] >= 50 && worse($5, wall[key])) report("wall time (ms)", $5, wall[key])
+   if(worse($6, rss[key])) report("peak RSS (kB)", $6, rss[key])
+   if(worse($9, candidates[key])) report("candidates", $9, candidates[key])
+}
+END {
+   if(regressions > 0) { printf "%d regressions against the baseline.\n", regressions; exit 1 }
+   print "No regressions against the baseline."
+}' "$baseline" "$results"
@@ -43,6 +43,13 @@
 
 typedef char* string;
 
-extern FILE *log_file;
+/* The state of the runtime is thread-local: the list store and symbol table,
+ * the graph change stack, the graph stack and the log and trace files, as well
+ * as the host graph, morphisms and other globals of the generated program. The
+ * state of a thread is the context in which it runs a GP 2 program, so several
+ * threads of a process can rewrite unrelated host graphs at the same time. A
+ * host graph and its lists belong to the thread that built them, and are used
+ * and freed by that thread. */
+extern __thread FILE *log_file;
 
 #endif /* INC_COMMON_H */
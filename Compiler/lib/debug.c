@@ -14,8 +14,14 @@
   along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
 
 #include "debug.h"
+#include "graphStacks.h"
 
-FILE *log_file = NULL;
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <time.h>
+
+__thread FILE *log_file = NULL;
 
 void openLogFile(string log_file_name)
 {
@@ -32,7 +38,7 @@ void closeLogFile(void)
    fclose(log_file);
 }
 
-FILE *trace_file = NULL;
+__thread FILE *trace_file = NULL;
 
 void openTraceFile(string trace_file_name)
 {
@@ -61,7 +67,8 @@ void closeTraceFile(void)
  * (6) The number of non-dummy edges in the edge array is equal to 
  *     graph->number_of_edges.
  * (7) Source and target consistency: For all edges E, if S is E's source and
- *     T is E's target, then E is in S's outedge list and E is in T's inedge list. 
+ *     T is E's target, then E is in S's outedge list at E's source position and
+ *     E is in T's inedge list at E's target position.
  */
 
 bool validGraph(Graph *graph)
@@ -105,11 +112,10 @@ bool validGraph(Graph *graph)
          /* Keep a count of the number of nodes in the array. */
          node_count++;
          int n;
-         for(n = 0; n < node->out_edges.size + 2; n++)
+         for(n = 0; n < node->out_edges.size; n++)
          {
-            Edge *node_edge = getNthOutEdge(graph, node, n);
             /* Keep a count of the number of outedges in the array. */
-            if(node_edge != NULL) edge_count++;           
+            if(getEdge(graph, node->out_edges.items[n]) != NULL) edge_count++;
          }
          /* Invariant (3) */
          if(node->outdegree != edge_count)
@@ -121,11 +127,10 @@ bool validGraph(Graph *graph)
          }
          edge_count = 0;
 
-         for(n = 0; n < node->in_edges.size + 2; n++)
+         for(n = 0; n < node->in_edges.size; n++)
          {
-            Edge *node_edge = getNthInEdge(graph, node, n);
             /* Keep a count of the number of inedges in the array. */
-            if(node_edge != NULL) edge_count++;
+            if(getEdge(graph, node->in_edges.items[n]) != NULL) edge_count++;
          }
          /* Invariant (4) */
          if(node->indegree != edge_count)
@@ -177,48 +182,26 @@ bool validGraph(Graph *graph)
          Node *source = getNode(graph, edge->source); 
          Node *target = getNode(graph, edge->target);
 
-         bool source_found = false;
-         if(source->first_out_edge == edge->index || source->second_out_edge == edge->index)
-            source_found = true;
-         if(!source_found)
-         {
-            int counter;
-            for(counter = 0; counter < source->out_edges.size; counter++)
-            {
-               if(source->out_edges.items[counter] == edge->index)
-               {
-                  source_found = true;
-                  break;
-               }
-            }
-         }
          /* Invariant (7) */
+         bool source_found = edge->source_position >= 0 &&
+                             edge->source_position < source->out_edges.size &&
+                             source->out_edges.items[edge->source_position] == edge->index;
          if(!source_found)
          {
-            fprintf(stderr, "(7) Edge %d does not occur in node %d's outedge "
-                    "array.\n", edge_index, source->index);   
+            fprintf(stderr, "(7) Edge %d does not occur at position %d of node %d's "
+                    "outedge array.\n", edge_index, edge->source_position,
+                    source->index);   
             valid_graph = false;
          }   
 
-         bool target_found = false;
-         if(target->first_in_edge == edge->index || target->second_in_edge == edge->index)
-            target_found = true;
-         if(!target_found)
-         {
-            int counter;
-            for(counter = 0; counter < target->in_edges.size; counter++)
-            {
-               if(target->in_edges.items[counter] == edge->index)
-               {
-                  target_found = true;
-                  break;
-               }
-            }
-         }
+         bool target_found = edge->target_position >= 0 &&
+                             edge->target_position < target->in_edges.size &&
+                             target->in_edges.items[edge->target_position] == edge->index;
          if(!target_found)
          {
-            fprintf(stderr, "(7) Edge %d does not occur in node %d's inedge "
-                    "array.\n", edge_index, target->index);   
+            fprintf(stderr, "(7) Edge %d does not occur at position %d of node %d's "
+                    "inedge array.\n", edge_index, edge->target_position,
+                    target->index);   
             valid_graph = false;
          }   
 
@@ -248,14 +231,13 @@ void printVerboseGraph(Graph *graph, FILE *file)
        if(node->index >= 0) printVerboseNode(node, file);
     }   
     PTF("Root Node List: ");
-    RootNodes *iterator = graph->root_nodes;
-    while(iterator != NULL)
+    int mark, root;
+    for(mark = 0; mark < NUMBER_OF_MARKS; mark++)
     {
-       if(iterator->next == NULL) PTF("%d\n", iterator->index);
-       else PTF("%d, ", iterator->index);
-       iterator = iterator->next;
+       IntArray *roots = getRootNodes(graph, mark);
+       for(root = 0; root < roots->size; root++) PTF("%d ", roots->items[root]);
     }
-    PTF("\n");
+    PTF("\n\n");
     PTF("Edges\n=====\n");
     for(index = 0; index < graph->edges.size; index++)
     {
@@ -276,23 +258,13 @@ void printVerboseNode(Node *node, FILE *file)
     PTF("Outdegree: %d. Indegree: %d\n", node->outdegree, node->indegree);
 
     PTF("Outedges: ");
-    if(node->first_out_edge >= 0) PTF("%d ", node->first_out_edge);
-    if(node->second_out_edge >= 0) PTF("%d ", node->second_out_edge);
     int index;
     for(index = 0; index < node->out_edges.size; index++)
-    {
-       int out_edge = node->out_edges.items[index];
-       if(out_edge >= 0) PTF("%d ", out_edge);
-    }
+       PTF("%d ", node->out_edges.items[index]);
 
     PTF("\nInedges: ");
-    if(node->first_in_edge >= 0) PTF("%d ", node->first_in_edge);
-    if(node->second_in_edge >= 0) PTF("%d ", node->second_in_edge);
     for(index = 0; index < node->in_edges.size; index++)
-    {
-       int in_edge = node->in_edges.items[index];
-       if(in_edge >= 0) PTF("%d ", in_edge);
-    }
+       PTF("%d ", node->in_edges.items[index]);
     PTF("\n\n");
 }
 
@@ -306,3 +278,184 @@ void printVerboseEdge(Edge *edge, FILE *file)
     PTF("Source: %d. Target: %d\n\n", edge->source, edge->target);
 }
 
+
+__thread UndoProfile undo_profile = {0, 0};
+
+uint64_t profileClock(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+void profileUndoChanges(Graph *graph, int restore_point)
+{
+   uint64_t start = profileClock();
+   undoChanges(graph, restore_point);
+   undo_profile.time += profileClock() - start;
+   undo_profile.calls++;
+}
+
+Graph *profileRevertGraph(Graph *graph, int restore_point)
+{
+   uint64_t start = profileClock();
+   graph = revertGraph(graph, restore_point);
+   undo_profile.time += profileClock() - start;
+   undo_profile.calls++;
+   return graph;
+}
+
+static void printCandidates(RuleProfile *profile, string separator, FILE *file)
+{
+   int index;
+   for(index = 0; index < profile->operations; index++)
+      fprintf(file, "%s%lu", index == 0 ? "" : separator, profile->candidates[index]);
+}
+
+static void printProfilesCSV(RuleProfile **profiles, FILE *file)
+{
+   fprintf(file, "rule,searchplan,match_calls,matches,match_time_ns,applications,"
+                 "apply_time_ns,changes,candidates\n");
+   for(; *profiles != NULL; profiles++)
+   {
+      RuleProfile *profile = *profiles;
+      fprintf(file, "%s,%s,%lu,%lu,%llu,%lu,%llu,%lu,", profile->name, profile->searchplan,
+              profile->match_calls, profile->matches, (unsigned long long)profile->match_time,
+              profile->applications, (unsigned long long)profile->apply_time,
+              profile->changes);
+      printCandidates(profile, " ", file);
+      fprintf(file, "\n");
+   }
+   fprintf(file, "undo,,0,0,0,%lu,%llu,0,\n", undo_profile.calls,
+           (unsigned long long)undo_profile.time);
+}
+
+/* Rule names are GP 2 identifiers, so no string needs escaping. */
+static void printProfilesJSON(RuleProfile **profiles, uint64_t run_time, FILE *file)
+{
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   fprintf(file, "{\n  \"run_time_ns\": %llu,\n  \"peak_rss_kb\": %ld,\n  \"rules\": [", 
+           (unsigned long long)run_time, usage.ru_maxrss);
+   bool first = true;
+   for(; *profiles != NULL; profiles++)
+   {
+      RuleProfile *profile = *profiles;
+      fprintf(file, "%s\n    {\"name\": \"%s\", \"searchplan\": \"%s\", "
+                    "\"match_calls\": %lu, \"matches\": %lu, \"match_time_ns\": %llu,\n"
+                    "     \"applications\": %lu, \"apply_time_ns\": %llu, "
+                    "\"changes\": %lu, \"candidates\": [",
+              first ? "" : ",", profile->name, profile->searchplan, profile->match_calls,
+              profile->matches, (unsigned long long)profile->match_time,
+              profile->applications, (unsigned long long)profile->apply_time,
+              profile->changes);
+      printCandidates(profile, ", ", file);
+      fprintf(file, "]}");
+      first = false;
+   }
+   fprintf(file, "\n  ],\n  \"undo\": {\"calls\": %lu, \"time_ns\": %llu}\n}\n",
+           undo_profile.calls, (unsigned long long)undo_profile.time);
+}
+
+void printRuleProfiles(RuleProfile **profiles, uint64_t run_time, string file_name)
+{
+   FILE *file = fopen(file_name, "w");
+   if(file == NULL)
+   {
+      perror(file_name);
+      return;
+   }
+   int length = strlen(file_name);
+   if(length >= 4 && strcmp(file_name + length - 4, ".csv") == 0)
+      printProfilesCSV(profiles, file);
+   else printProfilesJSON(profiles, run_time, file);
+   fclose(file);
+}
+
+volatile sig_atomic_t runtime_stats_requested = 0;
+
+static string stats_name = NULL;
+static RuleCounter **stats_counters = NULL;
+static Graph **stats_graph = NULL;
+static uint64_t stats_start = 0;
+static unsigned long stats_writes = 0;
+
+static void requestRuntimeStats(int signal_number)
+{
+   (void)signal_number;
+   runtime_stats_requested = 1;
+}
+
+bool enableRuntimeStats(string file_name, int interval, RuleCounter **counters,
+                        Graph **graph)
+{
+   stats_name = file_name;
+   stats_counters = counters;
+   stats_graph = graph;
+   stats_start = profileClock();
+   /* SA_RESTART, so that a request does not interrupt the reading of a stream. */
+   struct sigaction action;
+   memset(&action, 0, sizeof(action));
+   action.sa_handler = requestRuntimeStats;
+   action.sa_flags = SA_RESTART;
+   sigemptyset(&action.sa_mask);
+   if(sigaction(SIGUSR1, &action, NULL) != 0)
+   {
+      perror("sigaction");
+      return false;
+   }
+   if(interval <= 0) return true;
+   if(sigaction(SIGALRM, &action, NULL) != 0)
+   {
+      perror("sigaction");
+      return false;
+   }
+   struct itimerval timer;
+   timer.it_interval.tv_sec = interval;
+   timer.it_interval.tv_usec = 0;
+   timer.it_value = timer.it_interval;
+   if(setitimer(ITIMER_REAL, &timer, NULL) != 0)
+   {
+      perror("setitimer");
+      return false;
+   }
+   return true;
+}
+
+/* The statistics are written to a temporary file that is renamed over the
+ * stats file. Rule names are GP 2 identifiers, so no string needs escaping. */
+void writeRuntimeStats(void)
+{
+   runtime_stats_requested = 0;
+   if(stats_name == NULL) return;
+   char temporary_name[strlen(stats_name) + 5];
+   sprintf(temporary_name, "%s.tmp", stats_name);
+   FILE *file = fopen(temporary_name, "w");
+   if(file == NULL)
+   {
+      perror(temporary_name);
+      return;
+   }
+   Graph *graph = *stats_graph;
+   int lists = 0;
+   #ifdef LIST_HASHING
+      lists = hostListStoreCount();
+   #endif
+   fprintf(file, "{\n  \"run_time_ns\": %llu,\n  \"writes\": %lu,\n",
+           (unsigned long long)(profileClock() - stats_start), ++stats_writes);
+   fprintf(file, "  \"nodes\": %d,\n  \"edges\": %d,\n  \"lists\": %d,\n",
+           graph == NULL ? 0 : graph->number_of_nodes,
+           graph == NULL ? 0 : graph->number_of_edges, lists);
+   fprintf(file, "  \"change_stack_bytes\": %d,\n  \"graph_stack_depth\": %d,\n"
+                 "  \"graph_changes\": %d,\n  \"graph_copies\": %d,\n",
+           graphChangeStackSize(), graph_stack_index, graph_change_count,
+           graph_copy_count);
+   fprintf(file, "  \"rule_applications\": {");
+   RuleCounter **counters = stats_counters;
+   for(; *counters != NULL; counters++)
+      fprintf(file, "%s\n    \"%s\": %lu", counters == stats_counters ? "" : ",",
+              (*counters)->name, (*counters)->applications);
+   fprintf(file, "\n  }\n}\n");
+   if(fclose(file) != 0 || rename(temporary_name, stats_name) != 0)
+      perror(stats_name);
+}
@@ -33,14 +33,16 @@
 #include "common.h"
 #include "graph.h"
 
+#include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h> 
 #include <stdio.h> 
 
 void openLogFile(string log_file_name);
 void closeLogFile(void);
 
-extern FILE *trace_file;
+extern __thread FILE *trace_file;
 void openTraceFile(string trace_file_name);
 void closeTraceFile(void);
 
@@ -52,4 +54,82 @@ void printVerboseGraph(Graph *graph, FILE *file);
 void printVerboseNode(Node *node, FILE *file);
 void printVerboseEdge(Edge *edge, FILE *file);
 
+/* Counters kept for each rule by a runtime compiled with the -P flag. The
+ * generated matching and application functions of the rule update them, and
+ * the runtime writes them to its profile file when the program exits.
+ * Times are in nanoseconds. */
+typedef struct RuleProfile {
+   string name;
+   /* The searchplan operations, as in the comment at the top of the rule's
+    * matching code. */
+   string searchplan;
+   int operations;
+   /* The number of host items examined by each searchplan operation. */
+   unsigned long *candidates;
+   unsigned long match_calls;
+   unsigned long matches;
+   uint64_t match_time;
+   unsigned long applications;
+   uint64_t apply_time;
+   /* The number of graph changes pushed by the applications. */
+   unsigned long changes;
+} RuleProfile;
+
+/* The calls of the profiled runtime to undoChanges or revertGraph. */
+typedef struct UndoProfile {
+   unsigned long calls;
+   uint64_t time;
+} UndoProfile;
+
+extern __thread UndoProfile undo_profile;
+
+/* A monotonic clock in nanoseconds. */
+uint64_t profileClock(void);
+/* undoChanges and revertGraph, timed in undo_profile. */
+void profileUndoChanges(Graph *graph, int restore_point);
+Graph *profileRevertGraph(Graph *graph, int restore_point);
+
+/* Writes the profiles of the NULL-terminated array and the undo profile to the
+ * named file. The profile is written as CSV if the file name ends in ".csv"
+ * and as JSON, with the running time and the peak resident set size of the
+ * program, otherwise. The CSV file has one row per rule, with the candidate
+ * counts of the searchplan operations separated by spaces, and a final row for
+ * undo whose applications and apply_time_ns columns hold the undo calls and
+ * their time. */
+void printRuleProfiles(RuleProfile **profiles, uint64_t run_time, string file_name);
+
+/* The number of applications of a rule, counted by every runtime, profiled or
+ * not, for the live statistics below. */
+typedef struct RuleCounter {
+   string name;
+   unsigned long applications;
+} RuleCounter;
+
+/* Live statistics of a running program (gp2run -t), for telling a long run
+ * that makes progress from one that is stuck. They are written on request: the
+ * signal SIGUSR1 or a timer only sets runtime_stats_requested, and the
+ * statistics are written by the next rule application, at which the host graph
+ * is consistent, or when the program ends. The file holds the running time, the
+ * size of the host graph, the number of lists in the list store, the sizes of
+ * the graph change stack (in bytes) and the graph stack, the numbers of graph
+ * changes and graph copies made, and the applications of each rule. It is
+ * replaced atomically, so that a reader never sees a partial file. A run whose
+ * statistics are requested but whose file is no longer replaced is in a single
+ * search for a match. */
+extern volatile sig_atomic_t runtime_stats_requested;
+
+#define pollRuntimeStats()                                    \
+  do { if(runtime_stats_requested) writeRuntimeStats(); }     \
+  while(0)
+
+/* Writes the statistics to file_name on SIGUSR1 and, if interval is positive,
+ * every interval seconds. counters is the NULL-terminated array of the rule
+ * counters and graph points to the host graph pointer of the runtime, which
+ * may be NULL between the graphs of a stream. Returns false if the signal
+ * handler or the timer cannot be installed. */
+bool enableRuntimeStats(string file_name, int interval, RuleCounter **counters,
+                        Graph **graph);
+/* Writes the statistics if they are enabled and clears the request. */
+void writeRuntimeStats(void);
+
 #endif /* INC_DEBUG_H */
@@ -0,0 +1,70 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software: 
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but 
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY 
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ========================
+  Program Interface Module
+  ========================
+
+  The C interface of a GP 2 program compiled by gp2 --shared into the shared
+  library gp2run.so. The library contains the program and its own copy of the
+  runtime library, whose functions (loadHostGraph, newGraph, addNode, printGraph,
+  freeGraph, ...) build and read the host graphs passed to gp2_run. Its symbols
+  are bound within the library, so several programs can be loaded into one
+  process with dlopen(RTLD_LOCAL) and looked up with dlsym.
+
+  The runtime state is thread-local (see common.h), so threads can call
+  gp2_run at the same time, each on its own host graph. A thread's morphisms,
+  list store and change stack persist between its runs until it calls
+  gp2_close. A graph must be built, passed to gp2_run and freed by one thread,
+  because its lists belong to that thread's list store.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_GP2_H
+#define INC_GP2_H
+
+#include "graph.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* output - The file to which the output graph is written after a successful
+ *          run, or the reason of the failure of the program, as gp2run writes
+ *          them to gp2.output. NULL writes nothing.
+ * binary_output - Writes the output graph in the binary host graph format.
+ * log - The file of the runtime log. NULL logs to stderr.
+ * seed - The seed of the random choices of the program. 0 seeds from the time. */
+typedef struct GP2Options {
+   FILE *output;
+   bool binary_output;
+   FILE *log;
+   unsigned seed;
+} GP2Options;
+
+/* Runs the program on the host graph *graph, which is rewritten in place.
+ * *graph is updated if the run replaces the graph, which a program compiled
+ * with graph copying (-c) does when it backtracks. Returns true if the program
+ * succeeds. If it fails, *graph is the graph as it was when the program failed.
+ * NULL options are all zero. The graph remains owned by the caller. */
+bool gp2_run(Graph **graph, const GP2Options *options);
+
+/* Frees the calling thread's runtime state of the program: its morphisms, change
+ * stack and list store. Call it after freeing every graph the thread passed to
+ * gp2_run. A profiled program writes its rule profiles to gp2.profile.json. */
+void gp2_close(void);
+
+#endif /* INC_GP2_H */
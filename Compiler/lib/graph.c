@@ -15,9 +15,177 @@
 
 #include "graph.h"
 
-Node dummy_node = {-1, false, {NONE, 0, NULL}, 0, 0, -1, -1, -1, -1, 
-                   {0, 0, NULL}, {0, 0, NULL}, false};
-Edge dummy_edge = {-1, {NONE, 0, NULL}, -1, -1, false};
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+Node dummy_node = {-1, false, {NONE, 0, NULL}, 0, 0, {0, 0, NULL}, {0, 0, NULL},
+                   -1, -1, 0};
+Edge dummy_edge = {-1, -1, {NONE, 0, NULL}, -1, -1, -1, -1, 0};
+
+/* The last match epoch given to a graph by this thread. */
+static __thread uint64_t last_match_epoch = 0;
+
+/* ==============
+ * Storage Policy
+ * ============== */
+GraphStoragePolicy graph_storage = {0, 0, 100, NO_HUGE_PAGES, NULL};
+
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+/* Chunks are pooled, rather than allocated with malloc, if they are backed by
+ * huge pages or by the backing file. */
+static inline bool pooledChunks(void)
+{
+   return graph_storage.huge_pages != NO_HUGE_PAGES || graph_storage.backing_file != NULL;
+}
+
+/* Returns the capacity of a full array of the given capacity after it grows by
+ * the policy's percentage, which is at least one more item. */
+static int grownCapacity(int capacity)
+{
+   long long grown = capacity + (long long)capacity * graph_storage.growth_percent / 100;
+   if(grown <= capacity) grown = capacity + 1;
+   return grown > INT_MAX ? INT_MAX : (int)grown;
+}
+
+/* Advises the kernel to back the huge pages inside the allocation with
+ * transparent huge pages. Smaller allocations are left alone. */
+static void adviseHugePages(void *memory, size_t size)
+{
+   #ifdef MADV_HUGEPAGE
+      if(graph_storage.huge_pages == NO_HUGE_PAGES || size < 2 * HUGE_PAGE_SIZE) return;
+      uintptr_t start = ((uintptr_t)memory + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+      uintptr_t end = ((uintptr_t)memory + size) & ~(HUGE_PAGE_SIZE - 1);
+      if(end > start) madvise((void *)start, end - start, MADV_HUGEPAGE);
+   #else
+      (void)memory;
+      (void)size;
+   #endif
+}
+
+/* The descriptor of the open backing file and the size the threads have taken
+ * from it so far. */
+static int backing_descriptor = -1;
+static off_t backing_size = 0;
+static pthread_mutex_t backing_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Returns a slab of HUGE_PAGE_SIZE bytes at the end of the backing file, which
+ * is opened and unlinked on the first call. The slab's blocks are allocated
+ * in the file before it is mapped, so that a full disk is reported here and
+ * not by a SIGBUS when the slab is first written. */
+static char *mapBackingSlab(void)
+{
+   pthread_mutex_lock(&backing_lock);
+   if(backing_descriptor < 0)
+   {
+      backing_descriptor = open(graph_storage.backing_file, O_RDWR | O_CREAT | O_TRUNC, 0600);
+      if(backing_descriptor < 0)
+      {
+         print_to_log("Error (mapBackingSlab): cannot open %s.\n", graph_storage.backing_file);
+         exit(1);
+      }
+      unlink(graph_storage.backing_file);
+   }
+   off_t offset = backing_size;
+   int status = posix_fallocate(backing_descriptor, offset, HUGE_PAGE_SIZE);
+   if(status == 0) backing_size += HUGE_PAGE_SIZE;
+   pthread_mutex_unlock(&backing_lock);
+   void *slab = status == 0 ? mmap(NULL, HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                   backing_descriptor, offset) : MAP_FAILED;
+   if(slab == MAP_FAILED)
+   {
+      print_to_log("Error (mapBackingSlab): cannot extend %s.\n", graph_storage.backing_file);
+      exit(1);
+   }
+   return slab;
+}
+
+/* Returns a slab of HUGE_PAGE_SIZE bytes for a chunk pool, aligned to its size
+ * unless it is in the backing file. A slab of transparent huge pages is cut
+ * from a mapping of twice the size. */
+static char *mapSlab(void)
+{
+   if(graph_storage.backing_file != NULL) return mapBackingSlab();
+   void *slab = MAP_FAILED;
+   #ifdef MAP_HUGETLB
+      if(graph_storage.huge_pages == EXPLICIT_HUGE_PAGES)
+         slab = mmap(NULL, HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+   #endif
+   if(slab != MAP_FAILED) return slab;
+   char *region = mmap(NULL, 2 * HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if(region == MAP_FAILED)
+   {
+      print_to_log("Error (mapSlab): mmap failure.\n");
+      exit(1);
+   }
+   char *aligned = (char *)(((uintptr_t)region + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+   if(aligned > region) munmap(region, aligned - region);
+   munmap(aligned + HUGE_PAGE_SIZE, region + HUGE_PAGE_SIZE - aligned);
+   #ifdef MADV_HUGEPAGE
+      madvise(aligned, HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+   #endif
+   return aligned;
+}
+
+/* The chunks of one kind carved from slabs. Freed chunks are linked through
+ * their first bytes. Slabs are not unmapped: their chunks are reused by the
+ * thread's later graphs. */
+typedef struct ChunkPool {
+   size_t chunk_size;
+   void *free_chunks;
+   char *slab_next, *slab_end;
+} ChunkPool;
+
+#define POOL_CHUNK_SIZE(type) ((sizeof(type) + 63) & ~(size_t)63)
+static __thread ChunkPool node_chunk_pool = {POOL_CHUNK_SIZE(NodeChunk), NULL, NULL, NULL};
+static __thread ChunkPool edge_chunk_pool = {POOL_CHUNK_SIZE(EdgeChunk), NULL, NULL, NULL};
+
+static void *allocateChunk(ChunkPool *pool)
+{
+   void *chunk;
+   if(!pooledChunks()) chunk = malloc(pool->chunk_size);
+   else if(pool->free_chunks != NULL)
+   {
+      chunk = pool->free_chunks;
+      pool->free_chunks = *(void **)chunk;
+   }
+   else
+   {
+      if(pool->slab_next == NULL || (size_t)(pool->slab_end - pool->slab_next) < pool->chunk_size)
+      {
+         pool->slab_next = mapSlab();
+         pool->slab_end = pool->slab_next + HUGE_PAGE_SIZE;
+      }
+      chunk = pool->slab_next;
+      pool->slab_next += pool->chunk_size;
+   }
+   if(chunk == NULL)
+   {
+      print_to_log("Error (allocateChunk): malloc failure.\n");
+      exit(1);
+   }
+   return chunk;
+}
+
+static void freeChunk(ChunkPool *pool, void *chunk)
+{
+   if(!pooledChunks())
+   {
+      free(chunk);
+      return;
+   }
+   *(void **)chunk = pool->free_chunks;
+   pool->free_chunks = chunk;
+}
 
 IntArray makeIntArray(int initial_capacity)
 {
@@ -44,14 +212,15 @@ static void growIntArray(IntArray *array)
    int old_capacity = array->capacity;
    /* Node's incident edge arrays have initial capacity of 0. On the first
     * allocation, they are allocated space for 4 integers. In all other cases,
-    * the old capacity is doubled. */
-   array->capacity = old_capacity == 0 ? 4 : 2*old_capacity;
+    * the old capacity grows by the storage policy's percentage. */
+   array->capacity = old_capacity == 0 ? 4 : grownCapacity(old_capacity);
    array->items = realloc(array->items, array->capacity * sizeof(int));
    if(array->items == NULL)
    {
       print_to_log("Error (doubleCapacity): malloc failure.\n");
       exit(1);
    }
+   adviseHugePages(array->items, array->capacity * sizeof(int));
    int i;
    for(i = old_capacity; i < array->capacity; i++) array->items[i] = -1;
 }
@@ -86,14 +255,191 @@ void removeFromIntArray(IntArray *array, int index)
       }
    }
 }
+
+void copyIntArray(IntArray *target, IntArray *source)
+{
+   if(target->items != NULL) free(target->items);
+   target->capacity = source->capacity;
+   target->size = source->size;
+   if(source->capacity == 0)
+   {
+      target->items = NULL;
+      return;
+   }
+   target->items = malloc(source->capacity * sizeof(int));
+   if(target->items == NULL)
+   {
+      print_to_log("Error (copyIntArray): malloc failure.\n");
+      exit(1);
+   }
+   memcpy(target->items, source->items, source->capacity * sizeof(int));
+}
    
+/* ======================
+ * Node and Edge Chunks
+ * ====================== */
+#define CHUNK_OFFSET(index) ((index) & (GRAPH_CHUNK_SIZE - 1))
+
+/* The number of chunk table entries needed for an array of the given capacity. */
+static int chunkCount(int capacity)
+{
+   if(capacity <= 0) return 1;
+   return (capacity + GRAPH_CHUNK_SIZE - 1) >> GRAPH_CHUNK_BITS;
+}
+
+static NodeChunk *makeNodeChunk(void)
+{
+   NodeChunk *chunk = allocateChunk(&node_chunk_pool);
+   chunk->references = 1;
+   int offset;
+   for(offset = 0; offset < GRAPH_CHUNK_SIZE; offset++)
+   {
+      chunk->items[offset] = dummy_node;
+      chunk->keys[offset] = -1;
+   }
+   return chunk;
+}
+
+/* Makes a private copy of a shared chunk for the graph that is about to modify
+ * it. The copy holds its own references to the labels and its own incidence
+ * arrays. Matched stamps in the shared chunk were set by the copying graph, as
+ * snapshots are never matched against, and they keep their meaning in the
+ * copy. The other graphs holding the chunk have epochs of their own, for which
+ * the stamps are stale. */
+static NodeChunk *copyNodeChunk(NodeChunk *chunk)
+{
+   NodeChunk *copy = allocateChunk(&node_chunk_pool);
+   memcpy(copy, chunk, sizeof(NodeChunk));
+   copy->references = 1;
+   chunk->references--;
+   int offset;
+   for(offset = 0; offset < GRAPH_CHUNK_SIZE; offset++)
+   {
+      Node *node = &(copy->items[offset]);
+      if(node->index < 0) continue;
+      node->out_edges.items = NULL;
+      node->in_edges.items = NULL;
+      copyIntArray(&(node->out_edges), &(chunk->items[offset].out_edges));
+      copyIntArray(&(node->in_edges), &(chunk->items[offset].in_edges));
+      #ifdef LIST_HASHING
+         addHostList(node->label.list);
+      #else
+         node->label.list = copyHostList(node->label.list);
+      #endif
+   }
+   return copy;
+}
+
+/* Drops a graph's reference to the chunk, freeing the chunk and the data owned
+ * by its nodes when no graph holds it any more. */
+static void releaseNodeChunk(NodeChunk *chunk)
+{
+   if(chunk == NULL || --chunk->references > 0) return;
+   int offset;
+   for(offset = 0; offset < GRAPH_CHUNK_SIZE; offset++)
+   {
+      Node *node = &(chunk->items[offset]);
+      if(node->index < 0) continue;
+      if(node->out_edges.items != NULL) free(node->out_edges.items);
+      if(node->in_edges.items != NULL) free(node->in_edges.items);
+      removeHostList(node->label.list);
+   }
+   freeChunk(&node_chunk_pool, chunk);
+}
+
+static EdgeChunk *makeEdgeChunk(void)
+{
+   EdgeChunk *chunk = allocateChunk(&edge_chunk_pool);
+   chunk->references = 1;
+   int offset;
+   for(offset = 0; offset < GRAPH_CHUNK_SIZE; offset++)
+   {
+      chunk->items[offset] = dummy_edge;
+      chunk->keys[offset] = -1;
+   }
+   return chunk;
+}
+
+static EdgeChunk *copyEdgeChunk(EdgeChunk *chunk)
+{
+   EdgeChunk *copy = allocateChunk(&edge_chunk_pool);
+   memcpy(copy, chunk, sizeof(EdgeChunk));
+   copy->references = 1;
+   chunk->references--;
+   int offset;
+   for(offset = 0; offset < GRAPH_CHUNK_SIZE; offset++)
+   {
+      Edge *edge = &(copy->items[offset]);
+      if(edge->index < 0) continue;
+      #ifdef LIST_HASHING
+         addHostList(edge->label.list);
+      #else
+         edge->label.list = copyHostList(edge->label.list);
+      #endif
+   }
+   return copy;
+}
+
+static void releaseEdgeChunk(EdgeChunk *chunk)
+{
+   if(chunk == NULL || --chunk->references > 0) return;
+   int offset;
+   for(offset = 0; offset < GRAPH_CHUNK_SIZE; offset++)
+      if(chunk->items[offset].index >= 0) removeHostList(chunk->items[offset].label.list);
+   freeChunk(&edge_chunk_pool, chunk);
+}
+
+/* Return the slot of the item at the given index for reading, without the
+ * bounds check of getNode and getEdge. The chunk must exist. */
+static inline Node *nodeSlot(NodeArray *array, int index)
+{
+   return &(array->chunks[index >> GRAPH_CHUNK_BITS]->items[CHUNK_OFFSET(index)]);
+}
+
+static inline Edge *edgeSlot(EdgeArray *array, int index)
+{
+   return &(array->chunks[index >> GRAPH_CHUNK_BITS]->items[CHUNK_OFFSET(index)]);
+}
+
+/* Return the print key of the item at the given index. The key is written
+ * only after the item's slot has been written, so the chunk is private. */
+static inline int *nodeKey(NodeArray *array, int index)
+{
+   return &(array->chunks[index >> GRAPH_CHUNK_BITS]->keys[CHUNK_OFFSET(index)]);
+}
+
+static inline int *edgeKey(EdgeArray *array, int index)
+{
+   return &(array->chunks[index >> GRAPH_CHUNK_BITS]->keys[CHUNK_OFFSET(index)]);
+}
+
+/* Return the slot of the item at the given index for writing. The chunk is
+ * allocated if the array has not reached it before, and copied if it is
+ * shared. */
+static Node *writableNodeSlot(NodeArray *array, int index)
+{
+   NodeChunk **chunk = &(array->chunks[index >> GRAPH_CHUNK_BITS]);
+   if(*chunk == NULL) *chunk = makeNodeChunk();
+   else if((*chunk)->references > 1) *chunk = copyNodeChunk(*chunk);
+   return &((*chunk)->items[CHUNK_OFFSET(index)]);
+}
+
+static Edge *writableEdgeSlot(EdgeArray *array, int index)
+{
+   EdgeChunk **chunk = &(array->chunks[index >> GRAPH_CHUNK_BITS]);
+   if(*chunk == NULL) *chunk = makeEdgeChunk();
+   else if((*chunk)->references > 1) *chunk = copyEdgeChunk(*chunk);
+   return &((*chunk)->items[CHUNK_OFFSET(index)]);
+}
+
 static NodeArray makeNodeArray(int initial_capacity)
 {
    NodeArray array;
-   array.capacity = initial_capacity;
+   int chunks = chunkCount(initial_capacity);
+   array.capacity = chunks << GRAPH_CHUNK_BITS;
    array.size = 0;
-   array.items = calloc(initial_capacity, sizeof(Node));
-   if(array.items == NULL)
+   array.chunks = calloc(chunks, sizeof(NodeChunk *));
+   if(array.chunks == NULL)
    {
       print_to_log("Error (makeNodeArray): malloc failure.\n");
       exit(1);
@@ -102,15 +448,20 @@ static NodeArray makeNodeArray(int initial_capacity)
    return array;
 }
 
-static void doubleNodeArray(NodeArray *array)
+/* Only the chunk table is reallocated, so pointers to nodes remain valid when
+ * the array grows. */
+static void growNodeArray(NodeArray *array)
 {
-   array->capacity *= 2;
-   array->items = realloc(array->items, array->capacity * sizeof(Node));
-   if(array->items == NULL)
+   int chunks = array->capacity >> GRAPH_CHUNK_BITS;
+   int new_chunks = grownCapacity(chunks);
+   array->chunks = realloc(array->chunks, new_chunks * sizeof(NodeChunk *));
+   if(array->chunks == NULL)
    {
-      print_to_log("Error (doubleCapacity): malloc failure.\n");
+      print_to_log("Error (growNodeArray): malloc failure.\n");
       exit(1);
    }
+   memset(array->chunks + chunks, 0, (new_chunks - chunks) * sizeof(NodeChunk *));
+   array->capacity = new_chunks << GRAPH_CHUNK_BITS;
 }
 
 static int addToNodeArray(NodeArray *array, Node node)
@@ -120,8 +471,8 @@ static int addToNodeArray(NodeArray *array, Node node)
    if(array->holes.size == 0)
    {
       node.index = array->size;
-      if(array->size >= array->capacity) doubleNodeArray(array);
-      array->items[array->size++] = node;
+      if(array->size >= array->capacity) growNodeArray(array);
+      *writableNodeSlot(array, array->size++) = node;
    }
    /* If the holes array is non-empty, the node is placed in the hole marked by 
     * the rightmost element of the holes array. */
@@ -130,15 +481,16 @@ static int addToNodeArray(NodeArray *array, Node node)
       array->holes.size--;
       assert(array->holes.items[array->holes.size] >= 0);
       node.index = array->holes.items[array->holes.size];
-      array->items[node.index] = node;
+      *writableNodeSlot(array, node.index) = node;
       array->holes.items[array->holes.size] = -1;
    }
+   *nodeKey(array, node.index) = -1;
    return node.index;
 }
 
 static void removeFromNodeArray(NodeArray *array, int index)
 {
-   array->items[index] = dummy_node;
+   *writableNodeSlot(array, index) = dummy_node;
    /* If the index is the last index in the array, no hole is created. */
    if(index == array->size - 1) array->size--;
    else addToIntArray(&(array->holes), index);
@@ -147,10 +499,11 @@ static void removeFromNodeArray(NodeArray *array, int index)
 static EdgeArray makeEdgeArray(int initial_capacity)
 {
    EdgeArray array;
-   array.capacity = initial_capacity;
+   int chunks = chunkCount(initial_capacity);
+   array.capacity = chunks << GRAPH_CHUNK_BITS;
    array.size = 0;
-   array.items = calloc(initial_capacity, sizeof(Edge));
-   if(array.items == NULL)
+   array.chunks = calloc(chunks, sizeof(EdgeChunk *));
+   if(array.chunks == NULL)
    {
       print_to_log("Error (makeEdgeArray): malloc failure.\n");
       exit(1);
@@ -160,15 +513,18 @@ static EdgeArray makeEdgeArray(int initial_capacity)
 }
 
 
-static void doubleEdgeArray(EdgeArray *array)
+static void growEdgeArray(EdgeArray *array)
 {
-   array->capacity *= 2;
-   array->items = realloc(array->items, array->capacity * sizeof(Edge));
-   if(array->items == NULL)
+   int chunks = array->capacity >> GRAPH_CHUNK_BITS;
+   int new_chunks = grownCapacity(chunks);
+   array->chunks = realloc(array->chunks, new_chunks * sizeof(EdgeChunk *));
+   if(array->chunks == NULL)
    {
-      print_to_log("Error (doubleCapacity): malloc failure.\n");
+      print_to_log("Error (growEdgeArray): malloc failure.\n");
       exit(1);
    }
+   memset(array->chunks + chunks, 0, (new_chunks - chunks) * sizeof(EdgeChunk *));
+   array->capacity = new_chunks << GRAPH_CHUNK_BITS;
 }
 
 static int addToEdgeArray(EdgeArray *array, Edge edge)
@@ -180,8 +536,8 @@ static int addToEdgeArray(EdgeArray *array, Edge edge)
       /* There are no holes in the node array, so the node's index is the current
        * size of the node array. */
       edge.index  = array->size;
-      if(array->size >= array->capacity) doubleEdgeArray(array);
-      array->items[array->size++] = edge;
+      if(array->size >= array->capacity) growEdgeArray(array);
+      *writableEdgeSlot(array, array->size++) = edge;
    }
    /* If the holes array is non-empty, the edge is placed in the hole marked by 
     * the rightmost element of the holes array. */
@@ -190,20 +546,56 @@ static int addToEdgeArray(EdgeArray *array, Edge edge)
       array->holes.size--;
       assert(array->holes.items[array->holes.size] >= 0);
       edge.index = array->holes.items[array->holes.size];
-      array->items[edge.index] = edge;
+      *writableEdgeSlot(array, edge.index) = edge;
       array->holes.items[array->holes.size] = -1;
    }
+   *edgeKey(array, edge.index) = -1;
    return edge.index;
 }
 
 static void removeFromEdgeArray(EdgeArray *array, int index)
 {
-   array->items[index] = dummy_edge;
+   *writableEdgeSlot(array, index) = dummy_edge;
    /* If the index is the last index in the array, no hole is created. */
    if(index == array->size - 1) array->size--;
    else addToIntArray(&(array->holes), index);
 }
 
+/* ==================
+ * Label Class Tables
+ * ================== */
+static ClassTable *makeClassTable(void)
+{
+   ClassTable *table = malloc(sizeof(ClassTable));
+   if(table == NULL)
+   {
+      print_to_log("Error (makeClassTable): malloc failure.\n");
+      exit(1);
+   }
+   table->references = 1;
+   table->items = makeIntArray(0);
+   return table;
+}
+
+static IntArray *writableClassTable(ClassTable **table)
+{
+   if((*table)->references > 1)
+   {
+      ClassTable *copy = makeClassTable();
+      copyIntArray(&(copy->items), &((*table)->items));
+      (*table)->references--;
+      *table = copy;
+   }
+   return &((*table)->items);
+}
+
+static void releaseClassTable(ClassTable *table)
+{
+   if(--table->references > 0) return;
+   if(table->items.items != NULL) free(table->items.items);
+   free(table);
+}
+
 
 /* ===============
  * Graph Functions
@@ -216,31 +608,103 @@ Graph *newGraph(int nodes, int edges)
       print_to_log("Error (newGraph): malloc failure.\n");
       exit(1);
    }
-   graph->nodes = makeNodeArray(nodes);
-   graph->edges = makeEdgeArray(edges);
+   graph->nodes = makeNodeArray(nodes > graph_storage.node_hint ? nodes : graph_storage.node_hint);
+   graph->edges = makeEdgeArray(edges > graph_storage.edge_hint ? edges : graph_storage.edge_hint);
 
    graph->number_of_nodes = 0;
    graph->number_of_edges = 0;
-   graph->root_nodes = NULL;
+   graph->adjacency = NULL;
+   graph->node_columns = NULL;
+   graph->match_epoch = ++last_match_epoch;
+   graph->reordered = false;
+
+   int mark, label_class;
+   for(mark = 0; mark < NUMBER_OF_MARKS; mark++)
+   {
+      graph->root_nodes[mark] = makeIntArray(0);
+      for(label_class = 0; label_class < NUMBER_OF_CLASSES; label_class++)
+      {
+         graph->node_classes[mark][label_class] = makeClassTable();
+         graph->edge_classes[mark][label_class] = makeClassTable();
+      }
+   }
    return graph;
 }
 
+static NodeColumns *copyNodeColumns(NodeColumns *columns);
+
+Graph *snapshotGraph(Graph *graph)
+{
+   Graph *snapshot = malloc(sizeof(Graph));
+   if(snapshot == NULL)
+   {
+      print_to_log("Error (snapshotGraph): malloc failure.\n");
+      exit(1);
+   }
+   *snapshot = *graph;
+   snapshot->match_epoch = ++last_match_epoch;
+
+   int chunks = graph->nodes.capacity >> GRAPH_CHUNK_BITS, chunk;
+   snapshot->nodes.chunks = malloc(chunks * sizeof(NodeChunk *));
+   if(snapshot->nodes.chunks == NULL)
+   {
+      print_to_log("Error (snapshotGraph): malloc failure.\n");
+      exit(1);
+   }
+   for(chunk = 0; chunk < chunks; chunk++)
+   {
+      snapshot->nodes.chunks[chunk] = graph->nodes.chunks[chunk];
+      if(graph->nodes.chunks[chunk] != NULL) graph->nodes.chunks[chunk]->references++;
+   }
+   chunks = graph->edges.capacity >> GRAPH_CHUNK_BITS;
+   snapshot->edges.chunks = malloc(chunks * sizeof(EdgeChunk *));
+   if(snapshot->edges.chunks == NULL)
+   {
+      print_to_log("Error (snapshotGraph): malloc failure.\n");
+      exit(1);
+   }
+   for(chunk = 0; chunk < chunks; chunk++)
+   {
+      snapshot->edges.chunks[chunk] = graph->edges.chunks[chunk];
+      if(graph->edges.chunks[chunk] != NULL) graph->edges.chunks[chunk]->references++;
+   }
+   snapshot->nodes.holes.items = NULL;
+   copyIntArray(&(snapshot->nodes.holes), &(graph->nodes.holes));
+   snapshot->edges.holes.items = NULL;
+   copyIntArray(&(snapshot->edges.holes), &(graph->edges.holes));
+
+   int mark, label_class;
+   for(mark = 0; mark < NUMBER_OF_MARKS; mark++)
+   {
+      snapshot->root_nodes[mark].items = NULL;
+      copyIntArray(&(snapshot->root_nodes[mark]), &(graph->root_nodes[mark]));
+      for(label_class = 0; label_class < NUMBER_OF_CLASSES; label_class++)
+      {
+         graph->node_classes[mark][label_class]->references++;
+         graph->edge_classes[mark][label_class]->references++;
+      }
+   }
+   if(graph->adjacency != NULL) graph->adjacency->references++;
+   snapshot->node_columns = copyNodeColumns(graph->node_columns);
+   return snapshot;
+}
+
 int addNode(Graph *graph, bool root, HostLabel label) 
 {
    Node node;
    node.root = root;
    node.label = label;
-   node.first_out_edge = -1;
-   node.second_out_edge = -1;
-   node.first_in_edge = -1;
-   node.second_in_edge = -1;
    node.out_edges = makeIntArray(0);
    node.in_edges = makeIntArray(0);
    node.outdegree = 0;
    node.indegree = 0;
-   node.matched = false;
+   node.class_position = -1;
+   node.root_position = -1;
+   node.matched_epoch = 0;
 
    int index = addToNodeArray(&(graph->nodes), node);
+   addToNodeClassTable(graph, index);
+   updateNodeColumns(graph, index);
    if(root) addRootNode(graph, index);
    graph->number_of_nodes++;
    return index; 
@@ -248,15 +712,10 @@ int addNode(Graph *graph, bool root, HostLabel label)
 
 void addRootNode(Graph *graph, int index)
 {
-   RootNodes *root_node = malloc(sizeof(RootNodes));
-   if(root_node == NULL)
-   {
-      print_to_log("Error (addRootNode): malloc failure.\n");
-      exit(1);
-   }
-   root_node->index = index;
-   root_node->next = graph->root_nodes;
-   graph->root_nodes = root_node;
+   Node *node = getWritableNode(graph, index);
+   IntArray *roots = &(graph->root_nodes[node->label.mark]);
+   node->root_position = roots->size;
+   addToIntArray(roots, index);
 }
 
 int addEdge(Graph *graph, HostLabel label, int source_index, int target_index) 
@@ -265,284 +724,1696 @@ int addEdge(Graph *graph, HostLabel label, int source_index, int target_index)
    edge.label = label;
    edge.source = source_index;
    edge.target = target_index;
-   edge.matched = false;
+   edge.source_position = -1;
+   edge.target_position = -1;
+   edge.class_position = -1;
+   edge.matched_epoch = 0;
 
    int index = addToEdgeArray(&(graph->edges), edge);
-
-   Node *source = getNode(graph, source_index);
-   assert(source != NULL);
-   if(source->first_out_edge == -1) source->first_out_edge = index;
-   else if(source->second_out_edge == -1) source->second_out_edge = index;
-   else addToIntArray(&(source->out_edges), index);
-   source->outdegree++;
-
-   Node *target = getNode(graph, target_index);
-   assert(target != NULL);
-   if(target->first_in_edge == -1) target->first_in_edge = index;
-   else if(target->second_in_edge == -1) target->second_in_edge = index;
-   else addToIntArray(&(target->in_edges), index);
-   target->indegree++;
-
+   addToEdgeClassTable(graph, index);
+   addToAdjacencyIndex(graph, index);
+   addIncidentEdge(graph, index);
    graph->number_of_edges++;
    return index; 
 }
 
 void removeNode(Graph *graph, int index)
 {   
-   Node *node = getNode(graph, index);  
+   Node *node = getWritableNode(graph, index);  
    assert(node->indegree == 0 && node->outdegree == 0);
    if(node->out_edges.items != NULL) free(node->out_edges.items);
    if(node->in_edges.items != NULL) free(node->in_edges.items); 
    if(node->root) removeRootNode(graph, index);
+   removeFromNodeClassTable(graph, index);
 
    removeHostList(node->label.list);
    
    removeFromNodeArray(&(graph->nodes), index);
+   updateNodeColumns(graph, index);
    graph->number_of_nodes--;
 }
 
+/* The last node of the root node array is moved into the removed node's slot,
+ * in the same way as in removeFromNodeClassTable. */
 void removeRootNode(Graph *graph, int index)
 {
-   RootNodes *current = graph->root_nodes, *previous = NULL;
-   while(current != NULL)
-   {
-      if(current->index == index) 
-      {
-         if(previous == NULL) graph->root_nodes = current->next;
-         else previous->next = current->next;
-         free(current);
-         break;
-      }
-      previous = current;
-      current = current->next;
-   }
+   Node *node = getWritableNode(graph, index);
+   IntArray *roots = &(graph->root_nodes[node->label.mark]);
+   assert(roots->items[node->root_position] == index);
+   int last = roots->items[--roots->size];
+   roots->items[node->root_position] = last;
+   getWritableNode(graph, last)->root_position = node->root_position;
+   roots->items[roots->size] = -1;
+   node->root_position = -1;
 }
 
 void removeEdge(Graph *graph, int index) 
 {
-   Node *source = getNode(graph, graph->edges.items[index].source);
-   if(source->first_out_edge == index) source->first_out_edge = -1;
-   else if(source->second_out_edge == index) source->second_out_edge = -1;
-   else removeFromIntArray(&(source->out_edges), index);
-   source->outdegree--;
-
-   Node *target = getNode(graph, graph->edges.items[index].target);
-   if(target->first_in_edge == index) target->first_in_edge = -1;
-   else if(target->second_in_edge == index) target->second_in_edge = -1;
-   else removeFromIntArray(&(target->in_edges), index);
-   target->indegree--;
-
-   removeHostList(graph->edges.items[index].label.list);
+   removeIncidentEdge(graph, index);
+   removeFromEdgeClassTable(graph, index);
+   removeFromAdjacencyIndex(graph, index);
+   removeHostList(getEdge(graph, index)->label.list);
 
    removeFromEdgeArray(&(graph->edges), index);
    graph->number_of_edges--;
 }
 
+/* A root node whose mark changes is moved to the root node array of its new
+ * mark. */
 void relabelNode(Graph *graph, int index, HostLabel new_label) 
 {
-   removeHostList(graph->nodes.items[index].label.list);
-   graph->nodes.items[index].label = new_label;
+   removeFromNodeClassTable(graph, index);
+   Node *node = getWritableNode(graph, index);
+   bool move_root = node->root && node->label.mark != new_label.mark;
+   if(move_root) removeRootNode(graph, index);
+   removeHostList(node->label.list);
+   node->label = new_label;
+   addToNodeClassTable(graph, index);
+   if(move_root) addRootNode(graph, index);
+   updateNodeColumns(graph, index);
 }
 
 void changeNodeMark(Graph *graph, int index, MarkType new_mark)
 {
-   graph->nodes.items[index].label.mark = new_mark;
+   removeFromNodeClassTable(graph, index);
+   Node *node = getWritableNode(graph, index);
+   if(node->root) removeRootNode(graph, index);
+   node->label.mark = new_mark;
+   addToNodeClassTable(graph, index);
+   if(node->root) addRootNode(graph, index);
+   updateNodeColumns(graph, index);
 }
 
 void changeRoot(Graph *graph, int index)
 {
-   bool is_root = graph->nodes.items[index].root;
+   Node *node = getWritableNode(graph, index);
+   bool is_root = node->root;
    if(is_root) removeRootNode(graph, index);
    else addRootNode(graph, index);
-   graph->nodes.items[index].root = !is_root;
+   node->root = !is_root;
+}
+
+/* Matched flags are changed in place, even in a shared chunk. See getWritableNode. */
+void setMatchedNodeFlag(Graph *graph, int index)
+{
+   nodeSlot(&(graph->nodes), index)->matched_epoch = graph->match_epoch;
+   if(graph->node_columns != NULL)
+      graph->node_columns->matched[index >> 6] |= (uint64_t)1 << (index & 63);
 }
 
 void resetMatchedNodeFlag(Graph *graph, int index)
 {
-   graph->nodes.items[index].matched = false;
+   nodeSlot(&(graph->nodes), index)->matched_epoch = 0;
+   if(graph->node_columns != NULL)
+      graph->node_columns->matched[index >> 6] &= ~((uint64_t)1 << (index & 63));
 }
 
 void relabelEdge(Graph *graph, int index, HostLabel new_label)
 {	
-   removeHostList(graph->edges.items[index].label.list);
-   graph->edges.items[index].label = new_label;
+   removeFromEdgeClassTable(graph, index);
+   Edge *edge = getWritableEdge(graph, index);
+   removeHostList(edge->label.list);
+   edge->label = new_label;
+   addToEdgeClassTable(graph, index);
 }
 
 void changeEdgeMark(Graph *graph, int index, MarkType new_mark)
 {
-   graph->edges.items[index].label.mark = new_mark;
+   removeFromEdgeClassTable(graph, index);
+   getWritableEdge(graph, index)->label.mark = new_mark;
+   addToEdgeClassTable(graph, index);
 }
 
 void resetMatchedEdgeFlag(Graph *graph, int index)
 {
-   graph->edges.items[index].matched = false; 
+   edgeSlot(&(graph->edges), index)->matched_epoch = 0;
 }
 
-/* ========================
- * Graph Querying Functions 
- * ======================== */
-Node *getNode(Graph *graph, int index)
+void resetMatchedFlags(Graph *graph)
 {
-   assert(index < graph->nodes.size);
-   if(index == -1) return NULL;
-   else return &(graph->nodes.items[index]);
+   graph->match_epoch = ++last_match_epoch;
 }
 
-Edge *getEdge(Graph *graph, int index)
+/* Items are appended to their class table. Removal moves the last item of the
+ * table into the vacated position, so the tables never contain holes. */
+void addToNodeClassTable(Graph *graph, int index)
 {
-   assert(index < graph->edges.size);
-   if(index == -1) return NULL;
-   else return &(graph->edges.items[index]);
+   Node *node = getWritableNode(graph, index);
+   IntArray *table = writableClassTable(&(graph->node_classes[node->label.mark]
+                                                             [getLabelClass(node->label)]));
+   node->class_position = table->size;
+   addToIntArray(table, index);
 }
 
-RootNodes *getRootNodeList(Graph *graph)
+void removeFromNodeClassTable(Graph *graph, int index)
 {
-   return graph->root_nodes;
+   Node *node = getWritableNode(graph, index);
+   IntArray *table = writableClassTable(&(graph->node_classes[node->label.mark]
+                                                             [getLabelClass(node->label)]));
+   assert(table->items[node->class_position] == index);
+   int last = table->items[--table->size];
+   table->items[node->class_position] = last;
+   getWritableNode(graph, last)->class_position = node->class_position;
+   table->items[table->size] = -1;
+   node->class_position = -1;
 }
 
-Edge *getNthOutEdge(Graph *graph, Node *node, int n)
+void addToEdgeClassTable(Graph *graph, int index)
 {
-   assert(n >= 0);
-   if(n == 0) return getEdge(graph, node->first_out_edge);
-   else if(n == 1) return getEdge(graph, node->second_out_edge);
-   else
-   {
-      assert(n - 2 < node->out_edges.size);
-      return getEdge(graph, node->out_edges.items[n - 2]);
-   }
+   Edge *edge = getWritableEdge(graph, index);
+   IntArray *table = writableClassTable(&(graph->edge_classes[edge->label.mark]
+                                                             [getLabelClass(edge->label)]));
+   edge->class_position = table->size;
+   addToIntArray(table, index);
 }
 
-Edge *getNthInEdge(Graph *graph, Node *node, int n)
+void removeFromEdgeClassTable(Graph *graph, int index)
 {
-   assert(n >= 0);
-   if(n == 0) return getEdge(graph, node->first_in_edge);
-   else if(n == 1) return getEdge(graph, node->second_in_edge);
-   else
-   {
-      assert(n - 2 < node->in_edges.size);
-      return getEdge(graph, node->in_edges.items[n - 2]);
-   }
+   Edge *edge = getWritableEdge(graph, index);
+   IntArray *table = writableClassTable(&(graph->edge_classes[edge->label.mark]
+                                                             [getLabelClass(edge->label)]));
+   assert(table->items[edge->class_position] == index);
+   int last = table->items[--table->size];
+   table->items[edge->class_position] = last;
+   getWritableEdge(graph, last)->class_position = edge->class_position;
+   table->items[table->size] = -1;
+   edge->class_position = -1;
 }
 
-Node *getSource(Graph *graph, Edge *edge) 
+void addIncidentEdge(Graph *graph, int index)
 {
-   return getNode(graph, edge->source);
+   Edge *edge = getWritableEdge(graph, index);
+   Node *source = getWritableNode(graph, edge->source);
+   assert(source != NULL);
+   edge->source_position = source->out_edges.size;
+   addToIntArray(&(source->out_edges), index);
+   source->outdegree++;
+   updateNodeColumns(graph, edge->source);
+
+   Node *target = getWritableNode(graph, edge->target);
+   assert(target != NULL);
+   edge->target_position = target->in_edges.size;
+   addToIntArray(&(target->in_edges), index);
+   target->indegree++;
+   updateNodeColumns(graph, edge->target);
 }
 
-Node *getTarget(Graph *graph, Edge *edge) 
+void removeIncidentEdge(Graph *graph, int index)
 {
-   return getNode(graph, edge->target);
+   Edge *edge = getWritableEdge(graph, index);
+   Node *source = getWritableNode(graph, edge->source);
+   assert(source->out_edges.items[edge->source_position] == index);
+   int last = source->out_edges.items[--source->out_edges.size];
+   source->out_edges.items[edge->source_position] = last;
+   getWritableEdge(graph, last)->source_position = edge->source_position;
+   source->out_edges.items[source->out_edges.size] = -1;
+   source->outdegree--;
+   updateNodeColumns(graph, edge->source);
+
+   Node *target = getWritableNode(graph, edge->target);
+   assert(target->in_edges.items[edge->target_position] == index);
+   last = target->in_edges.items[--target->in_edges.size];
+   target->in_edges.items[edge->target_position] = last;
+   getWritableEdge(graph, last)->target_position = edge->target_position;
+   target->in_edges.items[target->in_edges.size] = -1;
+   target->indegree--;
+   updateNodeColumns(graph, edge->target);
+
+   edge->source_position = -1;
+   edge->target_position = -1;
 }
 
-HostLabel getNodeLabel(Graph *graph, int index) 
+/* ===============
+ * Adjacency Index
+ * =============== */
+/* Node pairs are hashed with multiplicative hashing. The capacity of the index
+ * is kept at least twice its size to keep the probe sequences short. */
+static int hashNodePair(int source, int target, int capacity)
 {
-   Node *node = getNode(graph, index);
-   return node->label;
+   unsigned hash = (unsigned)source * 2654435761u ^ (unsigned)target * 2246822519u;
+   hash ^= hash >> 16;
+   return (int)(hash & (capacity - 1));
 }
 
-HostLabel getEdgeLabel(Graph *graph, int index) 
+static AdjacencyEntry *makeAdjacencyEntries(int capacity)
 {
-   Edge *edge = getEdge(graph, index);
-   return edge->label;
+   AdjacencyEntry *entries = malloc(capacity * sizeof(AdjacencyEntry));
+   if(entries == NULL)
+   {
+      print_to_log("Error (makeAdjacencyEntries): malloc failure.\n");
+      exit(1);
+   }
+   int slot;
+   for(slot = 0; slot < capacity; slot++)
+   {
+      entries[slot].source = -1;
+      entries[slot].target = -1;
+      entries[slot].edges = makeIntArray(0);
+   }
+   return entries;
 }
 
-int getIndegree(Graph *graph, int index) 
+/* Returns the entry of the node pair. If there is no such entry, a new entry
+ * is created if insert is true, and NULL is returned otherwise. */
+static AdjacencyEntry *findAdjacencyEntry(AdjacencyIndex *index, int source,
+                                          int target, bool insert)
 {
-   Node *node = getNode(graph, index);
-   return node->indegree;
+   int slot = hashNodePair(source, target, index->capacity);
+   while(index->entries[slot].source != -1)
+   {
+      if(index->entries[slot].source == source && 
+         index->entries[slot].target == target) return &(index->entries[slot]);
+      slot = (slot + 1) & (index->capacity - 1);
+   }
+   if(!insert) return NULL;
+   index->entries[slot].source = source;
+   index->entries[slot].target = target;
+   index->size++;
+   return &(index->entries[slot]);
 }
 
-int getOutdegree(Graph *graph, int index) 
+static void growAdjacencyIndex(AdjacencyIndex *index)
 {
-   Node *node = getNode(graph, index);
-   return node->outdegree;
+   AdjacencyEntry *old_entries = index->entries;
+   int old_capacity = index->capacity, slot;
+   index->capacity = 2 * old_capacity;
+   index->entries = makeAdjacencyEntries(index->capacity);
+   for(slot = 0; slot < old_capacity; slot++)
+   {
+      if(old_entries[slot].source == -1) continue;
+      int new_slot = hashNodePair(old_entries[slot].source, old_entries[slot].target,
+                                  index->capacity);
+      while(index->entries[new_slot].source != -1)
+         new_slot = (new_slot + 1) & (index->capacity - 1);
+      index->entries[new_slot] = old_entries[slot];
+   }
+   free(old_entries);
 }
 
-void printGraph(Graph *graph, FILE *file) 
+/* Deletes the entry in the given slot. The following entries of the probe
+ * sequence are shifted back into the vacated slot where possible, so that no
+ * lookup is cut short by the new empty slot. */
+static void removeAdjacencyEntry(AdjacencyIndex *index, int slot)
 {
-   /* The node and edge counts are used in the IDs of the printed graph. The item's 
-    * index in the graph is not suitable for this purpose because there may be holes
-    * in the graph's node array. The counts are also used to control the number of
-    * nodes and edges printed per line. */
-   int index, node_count = 0, edge_count = 0;
-   if(graph == NULL || graph->number_of_nodes == 0) 
+   int mask = index->capacity - 1;
+   int hole = slot, next = (slot + 1) & mask;
+   while(index->entries[next].source != -1)
    {
-      PTF("[ | ]\n\n");
-      return;
+      int home = hashNodePair(index->entries[next].source, index->entries[next].target,
+                              index->capacity);
+      /* The entry can fill the hole if the hole lies between the entry's home
+       * slot and its current slot. */
+      if(((next - home) & mask) >= ((next - hole) & mask))
+      {
+         index->entries[hole] = index->entries[next];
+         hole = next;
+      }
+      next = (next + 1) & mask;
    }
-   PTF("[ ");
-   /* Maps a node's graph-index to the ID it is printed with (node_count). */
-   int output_indices[graph->nodes.size];
-   for(index = 0; index < graph->nodes.size; index++)
+   index->entries[hole].source = -1;
+   index->entries[hole].target = -1;
+   index->entries[hole].edges = makeIntArray(0);
+   index->size--;
+}
+
+void enableAdjacencyIndex(Graph *graph)
+{
+   if(graph->adjacency != NULL) return;
+   AdjacencyIndex *index = malloc(sizeof(AdjacencyIndex));
+   if(index == NULL)
    {
-      Node *node = getNode(graph, index);
-      if(node->index == -1) 
+      print_to_log("Error (enableAdjacencyIndex): malloc failure.\n");
+      exit(1);
+   }
+   index->references = 1;
+   index->capacity = 16;
+   while(index->capacity < 2 * graph->number_of_edges) index->capacity *= 2;
+   index->size = 0;
+   index->entries = makeAdjacencyEntries(index->capacity);
+   graph->adjacency = index;
+
+   int edge_index;
+   for(edge_index = 0; edge_index < graph->edges.size; edge_index++)
+      if(getEdge(graph, edge_index)->index >= 0) addToAdjacencyIndex(graph, edge_index);
+}
+
+static AdjacencyIndex *copyAdjacencyIndex(AdjacencyIndex *source)
+{
+   AdjacencyIndex *index = malloc(sizeof(AdjacencyIndex));
+   if(index == NULL)
+   {
+      print_to_log("Error (copyAdjacencyIndex): malloc failure.\n");
+      exit(1);
+   }
+   index->references = 1;
+   index->capacity = source->capacity;
+   index->size = source->size;
+   index->entries = makeAdjacencyEntries(index->capacity);
+   int slot;
+   for(slot = 0; slot < index->capacity; slot++)
+   {
+      AdjacencyEntry *entry = &(source->entries[slot]);
+      if(entry->source == -1) continue;
+      index->entries[slot].source = entry->source;
+      index->entries[slot].target = entry->target;
+      copyIntArray(&(index->entries[slot].edges), &(entry->edges));
+   }
+   return index;
+}
+
+/* Returns the graph's adjacency index for modification, first replacing it
+ * with a copy if it is shared with a snapshot. */
+static AdjacencyIndex *writableAdjacencyIndex(Graph *graph)
+{
+   AdjacencyIndex *index = graph->adjacency;
+   if(index != NULL && index->references > 1)
+   {
+      index->references--;
+      graph->adjacency = copyAdjacencyIndex(index);
+   }
+   return graph->adjacency;
+}
+
+void addToAdjacencyIndex(Graph *graph, int index)
+{
+   AdjacencyIndex *adjacency = writableAdjacencyIndex(graph);
+   if(adjacency == NULL) return;
+   if(2 * (adjacency->size + 1) > adjacency->capacity) growAdjacencyIndex(adjacency);
+   Edge *edge = getEdge(graph, index);
+   AdjacencyEntry *entry = findAdjacencyEntry(adjacency, edge->source, edge->target, true);
+   addToIntArray(&(entry->edges), index);
+}
+
+/* Edges between the same pair of nodes are stored in no particular order. The
+ * removed edge is replaced by the last edge of the entry. */
+void removeFromAdjacencyIndex(Graph *graph, int index)
+{
+   AdjacencyIndex *adjacency = writableAdjacencyIndex(graph);
+   if(adjacency == NULL) return;
+   Edge *edge = getEdge(graph, index);
+   AdjacencyEntry *entry = findAdjacencyEntry(adjacency, edge->source, edge->target, false);
+   assert(entry != NULL);
+   int position;
+   for(position = 0; position < entry->edges.size; position++)
+   {
+      if(entry->edges.items[position] != index) continue;
+      entry->edges.size--;
+      entry->edges.items[position] = entry->edges.items[entry->edges.size];
+      entry->edges.items[entry->edges.size] = -1;
+      break;
+   }
+   if(entry->edges.size == 0)
+   {
+      free(entry->edges.items);
+      removeAdjacencyEntry(adjacency, entry - adjacency->entries);
+   }
+}
+
+static void freeAdjacencyIndex(AdjacencyIndex *index)
+{
+   if(index == NULL || --index->references > 0) return;
+   int slot;
+   for(slot = 0; slot < index->capacity; slot++)
+      if(index->entries[slot].edges.items != NULL) free(index->entries[slot].edges.items);
+   free(index->entries);
+   free(index);
+}
+
+/* ============
+ * Node Columns
+ * ============ */
+/* The columns grow with the node array. The bitsets are allocated in whole
+ * 64-bit words, so the capacity is kept a multiple of 64. */
+static void *reallocColumn(void *column, int old_size, int new_size)
+{
+   column = realloc(column, new_size);
+   if(column == NULL)
+   {
+      print_to_log("Error (reallocColumn): malloc failure.\n");
+      exit(1);
+   }
+   memset((char *)column + old_size, 0, new_size - old_size);
+   adviseHugePages(column, new_size);
+   return column;
+}
+
+static void growNodeColumns(NodeColumns *columns, int minimum_capacity)
+{
+   int old_capacity = columns->capacity;
+   int capacity = old_capacity == 0 ? 64 : old_capacity;
+   while(capacity < minimum_capacity) capacity = grownCapacity(capacity);
+   capacity = (capacity + 63) & ~63;
+   columns->alive = reallocColumn(columns->alive, old_capacity / 8, capacity / 8);
+   columns->matched = reallocColumn(columns->matched, old_capacity / 8, capacity / 8);
+   columns->marks = reallocColumn(columns->marks, old_capacity, capacity);
+   columns->outdegrees = reallocColumn(columns->outdegrees,
+                                       old_capacity * sizeof(int32_t),
+                                       capacity * sizeof(int32_t));
+   columns->indegrees = reallocColumn(columns->indegrees,
+                                      old_capacity * sizeof(int32_t),
+                                      capacity * sizeof(int32_t));
+   columns->capacity = capacity;
+}
+
+void enableNodeColumns(Graph *graph)
+{
+   if(graph->node_columns != NULL) return;
+   NodeColumns *columns = malloc(sizeof(NodeColumns));
+   if(columns == NULL)
+   {
+      print_to_log("Error (enableNodeColumns): malloc failure.\n");
+      exit(1);
+   }
+   columns->capacity = 0;
+   columns->alive = NULL;
+   columns->matched = NULL;
+   columns->marks = NULL;
+   columns->outdegrees = NULL;
+   columns->indegrees = NULL;
+   growNodeColumns(columns, graph->nodes.size > graph_storage.node_hint ?
+                            graph->nodes.size : graph_storage.node_hint);
+   graph->node_columns = columns;
+
+   int index;
+   for(index = 0; index < graph->nodes.size; index++) updateNodeColumns(graph, index);
+}
+
+void updateNodeColumns(Graph *graph, int index)
+{
+   NodeColumns *columns = graph->node_columns;
+   if(columns == NULL) return;
+   if(index >= columns->capacity) growNodeColumns(columns, index + 1);
+   Node *node = nodeSlot(&(graph->nodes), index);
+   uint64_t bit = (uint64_t)1 << (index & 63);
+   if(node->index >= 0) columns->alive[index >> 6] |= bit;
+   else columns->alive[index >> 6] &= ~bit;
+   if(nodeMatched(graph, node)) columns->matched[index >> 6] |= bit;
+   else columns->matched[index >> 6] &= ~bit;
+   columns->marks[index] = (uint8_t)node->label.mark;
+   columns->outdegrees[index] = node->outdegree;
+   columns->indegrees[index] = node->indegree;
+}
+
+/* Candidate filters test 64 nodes at a time. The x86 implementations compare
+ * 8 (AVX2) or 4 (SSE2) columns per instruction and are selected on the first
+ * call according to the features of the running processor. */
+static uint64_t scalarFilter(NodeColumns *columns, int first, const NodeFilter *filter)
+{
+   uint64_t mask = 0;
+   int offset;
+   for(offset = 0; offset < 64; offset++)
+   {
+      int index = first + offset;
+      int mark = columns->marks[index];
+      int32_t indegree = columns->indegrees[index], outdegree = columns->outdegrees[index];
+      if(filter->mark < 0 ? mark == 0 : mark != filter->mark) continue;
+      if(indegree < filter->indegree || outdegree < filter->outdegree) continue;
+      if(filter->exact_degree ? indegree + outdegree != filter->degree
+                              : indegree + outdegree < filter->degree) continue;
+      mask |= (uint64_t)1 << offset;
+   }
+   return mask;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+__attribute__((target("sse2")))
+static uint64_t sse2Filter(NodeColumns *columns, int first, const NodeFilter *filter)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i mark = _mm_set1_epi32(filter->mark < 0 ? 0 : filter->mark);
+   __m128i indegree = _mm_set1_epi32(filter->indegree - 1);
+   __m128i outdegree = _mm_set1_epi32(filter->outdegree - 1);
+   __m128i degree = _mm_set1_epi32(filter->exact_degree ? filter->degree : filter->degree - 1);
+   uint64_t mask = 0;
+   int offset;
+   for(offset = 0; offset < 64; offset += 4)
+   {
+      int index = first + offset;
+      int32_t packed_marks;
+      memcpy(&packed_marks, columns->marks + index, sizeof(int32_t));
+      __m128i marks = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed_marks),
+                                                           zero), zero);
+      __m128i in = _mm_loadu_si128((__m128i *)(columns->indegrees + index));
+      __m128i out = _mm_loadu_si128((__m128i *)(columns->outdegrees + index));
+      __m128i total = _mm_add_epi32(in, out);
+      __m128i result = _mm_cmpeq_epi32(marks, mark);
+      if(filter->mark < 0) result = _mm_xor_si128(result, _mm_set1_epi32(-1));
+      result = _mm_and_si128(result, _mm_cmpgt_epi32(in, indegree));
+      result = _mm_and_si128(result, _mm_cmpgt_epi32(out, outdegree));
+      if(filter->exact_degree) 
+         result = _mm_and_si128(result, _mm_cmpeq_epi32(total, degree));
+      else result = _mm_and_si128(result, _mm_cmpgt_epi32(total, degree));
+      mask |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(result)) << offset;
+   }
+   return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t avx2Filter(NodeColumns *columns, int first, const NodeFilter *filter)
+{
+   __m256i mark = _mm256_set1_epi32(filter->mark < 0 ? 0 : filter->mark);
+   __m256i indegree = _mm256_set1_epi32(filter->indegree - 1);
+   __m256i outdegree = _mm256_set1_epi32(filter->outdegree - 1);
+   __m256i degree = _mm256_set1_epi32(filter->exact_degree ? filter->degree 
+                                                           : filter->degree - 1);
+   uint64_t mask = 0;
+   int offset;
+   for(offset = 0; offset < 64; offset += 8)
+   {
+      int index = first + offset;
+      __m256i marks = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i *)(columns->marks + index)));
+      __m256i in = _mm256_loadu_si256((__m256i *)(columns->indegrees + index));
+      __m256i out = _mm256_loadu_si256((__m256i *)(columns->outdegrees + index));
+      __m256i total = _mm256_add_epi32(in, out);
+      __m256i result = _mm256_cmpeq_epi32(marks, mark);
+      if(filter->mark < 0) result = _mm256_xor_si256(result, _mm256_set1_epi32(-1));
+      result = _mm256_and_si256(result, _mm256_cmpgt_epi32(in, indegree));
+      result = _mm256_and_si256(result, _mm256_cmpgt_epi32(out, outdegree));
+      if(filter->exact_degree) 
+         result = _mm256_and_si256(result, _mm256_cmpeq_epi32(total, degree));
+      else result = _mm256_and_si256(result, _mm256_cmpgt_epi32(total, degree));
+      mask |= (uint64_t)(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(result)) << offset;
+   }
+   return mask;
+}
+#endif
+
+static uint64_t (*node_filter)(NodeColumns *, int, const NodeFilter *) = NULL;
+
+/* The filter is chosen in a local and stored once, so that threads of a
+ * parallel matcher racing through the first call all read a usable filter. */
+static void selectNodeFilter(void)
+{
+   uint64_t (*filter)(NodeColumns *, int, const NodeFilter *) = scalarFilter;
+   #if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+      __builtin_cpu_init();
+      if(__builtin_cpu_supports("avx2")) filter = avx2Filter;
+      else if(__builtin_cpu_supports("sse2")) filter = sse2Filter;
+   #endif
+   node_filter = filter;
+}
+
+uint64_t filterNodeColumns(Graph *graph, int block, const NodeFilter *filter)
+{
+   NodeColumns *columns = graph->node_columns;
+   int first = 64 * block;
+   assert(first < columns->capacity);
+   if(node_filter == NULL) selectNodeFilter();
+   uint64_t candidates = columns->alive[block] & ~columns->matched[block];
+   if(candidates == 0) return 0;
+   return candidates & node_filter(columns, first, filter);
+}
+
+/* Snapshots are matched against by no one, so the copy's matched bits are 
+ * cleared. */
+static NodeColumns *copyNodeColumns(NodeColumns *columns)
+{
+   if(columns == NULL) return NULL;
+   NodeColumns *copy = malloc(sizeof(NodeColumns));
+   if(copy == NULL)
+   {
+      print_to_log("Error (copyNodeColumns): malloc failure.\n");
+      exit(1);
+   }
+   copy->capacity = 0;
+   copy->alive = NULL;
+   copy->matched = NULL;
+   copy->marks = NULL;
+   copy->outdegrees = NULL;
+   copy->indegrees = NULL;
+   growNodeColumns(copy, columns->capacity);
+   memcpy(copy->alive, columns->alive, columns->capacity / 8);
+   memcpy(copy->marks, columns->marks, columns->capacity);
+   memcpy(copy->outdegrees, columns->outdegrees, columns->capacity * sizeof(int32_t));
+   memcpy(copy->indegrees, columns->indegrees, columns->capacity * sizeof(int32_t));
+   return copy;
+}
+
+static void freeNodeColumns(NodeColumns *columns)
+{
+   if(columns == NULL) return;
+   free(columns->alive);
+   free(columns->matched);
+   free(columns->marks);
+   free(columns->outdegrees);
+   free(columns->indegrees);
+   free(columns);
+}
+
+/* ===========
+ * Renumbering
+ * =========== */
+bool sparseGraph(Graph *graph)
+{
+   int holes = graph->nodes.holes.size + graph->edges.holes.size;
+   return holes >= COMPACTION_MINIMUM_HOLES &&
+          holes >= graph->number_of_nodes + graph->number_of_edges;
+}
+
+/* Returns an array of the given size for a map from old to new indices, with
+ * every entry -1. */
+static int *makeIndexMap(int size)
+{
+   int *map = malloc((size + 1) * sizeof(int));
+   if(map == NULL)
+   {
+      print_to_log("Error (makeIndexMap): malloc failure.\n");
+      exit(1);
+   }
+   memset(map, -1, (size + 1) * sizeof(int));
+   return map;
+}
+
+/* Rewrites the first size items of the array with the map from old to new
+ * indices. */
+static void renumberIntArray(IntArray *array, int *map)
+{
+   int position;
+   for(position = 0; position < array->size; position++)
+      array->items[position] = map[array->items[position]];
+}
+
+/* Rewrites the indices held outside the node and edge arrays after their items
+ * have been renumbered with the maps. The items keep their positions in the
+ * root node arrays and class tables. The adjacency index and node columns are
+ * keyed by indices, so they are rebuilt. */
+static void renumberReferences(Graph *graph, int *node_map, int *edge_map)
+{
+   int mark, label_class;
+   for(mark = 0; mark < NUMBER_OF_MARKS; mark++)
+   {
+      renumberIntArray(&(graph->root_nodes[mark]), node_map);
+      for(label_class = 0; label_class < NUMBER_OF_CLASSES; label_class++)
       {
-         output_indices[index] = -1;
-         continue; 
+         renumberIntArray(writableClassTable(&(graph->node_classes[mark][label_class])),
+                          node_map);
+         renumberIntArray(writableClassTable(&(graph->edge_classes[mark][label_class])),
+                          edge_map);
       }
-      /* Five nodes per line */
-      if(node_count != 0 && node_count % 5 == 0) PTF("\n  ");
-      output_indices[index] = node_count;
-      if(node->root) PTF("(%d(R), ", node_count++);
-      else PTF("(%d, ", node_count++);
-      printHostLabel(node->label, file);
-      PTF(") ");
    }
-   if(graph->number_of_edges == 0)
+   if(graph->adjacency != NULL)
    {
-      PTF("| ]\n\n");
-      return;
+      freeAdjacencyIndex(graph->adjacency);
+      graph->adjacency = NULL;
+      enableAdjacencyIndex(graph);
+   }
+   if(graph->node_columns != NULL)
+   {
+      freeNodeColumns(graph->node_columns);
+      graph->node_columns = NULL;
+      enableNodeColumns(graph);
+   }
+}
+
+/* Items are moved down the arrays in increasing order of their old indices, so
+ * the slot an item moves to is either a hole or the slot of an item that has
+ * already moved. */
+void compactGraph(Graph *graph)
+{
+   NodeArray *nodes = &(graph->nodes);
+   EdgeArray *edges = &(graph->edges);
+   if(nodes->holes.size == 0 && edges->holes.size == 0) return;
+   int old_node_size = nodes->size, old_edge_size = edges->size;
+   int *node_map = makeIndexMap(old_node_size);
+   int *edge_map = makeIndexMap(old_edge_size);
+   int index, count = 0;
+   for(index = 0; index < old_node_size; index++)
+      if(nodeSlot(nodes, index)->index >= 0) node_map[index] = count++;
+   count = 0;
+   for(index = 0; index < old_edge_size; index++)
+      if(edgeSlot(edges, index)->index >= 0) edge_map[index] = count++;
+
+   for(index = 0; index < old_node_size; index++)
+   {
+      if(node_map[index] < 0) continue;
+      Node *slot = writableNodeSlot(nodes, index);
+      Node node = *slot;
+      int key = *nodeKey(nodes, index);
+      node.index = node_map[index];
+      renumberIntArray(&(node.out_edges), edge_map);
+      renumberIntArray(&(node.in_edges), edge_map);
+      if(node.index != index) *slot = dummy_node;
+      *writableNodeSlot(nodes, node.index) = node;
+      *nodeKey(nodes, node.index) = key;
+   }
+   for(index = 0; index < old_edge_size; index++)
+   {
+      if(edge_map[index] < 0) continue;
+      Edge *slot = writableEdgeSlot(edges, index);
+      Edge edge = *slot;
+      int key = *edgeKey(edges, index);
+      edge.index = edge_map[index];
+      edge.source = node_map[edge.source];
+      edge.target = node_map[edge.target];
+      if(edge.index != index) *slot = dummy_edge;
+      *writableEdgeSlot(edges, edge.index) = edge;
+      *edgeKey(edges, edge.index) = key;
+   }
+
+   nodes->size = graph->number_of_nodes;
+   edges->size = graph->number_of_edges;
+   for(index = 0; index < nodes->holes.size; index++) nodes->holes.items[index] = -1;
+   nodes->holes.size = 0;
+   for(index = 0; index < edges->holes.size; index++) edges->holes.items[index] = -1;
+   edges->holes.size = 0;
+   int chunk;
+   for(chunk = chunkCount(nodes->size); chunk < chunkCount(old_node_size); chunk++)
+   {
+      releaseNodeChunk(nodes->chunks[chunk]);
+      nodes->chunks[chunk] = NULL;
+   }
+   for(chunk = chunkCount(edges->size); chunk < chunkCount(old_edge_size); chunk++)
+   {
+      releaseEdgeChunk(edges->chunks[chunk]);
+      edges->chunks[chunk] = NULL;
+   }
+   renumberReferences(graph, node_map, edge_map);
+   free(node_map);
+   free(edge_map);
+}
+
+/* Moves the items of the graph to the indices given by the maps, which number
+ * the items densely, in new node and edge arrays. Each old chunk holding an
+ * item is made private before the item is moved, so that the item's incidence
+ * arrays and label reference belong to the graph, and is then freed without
+ * its items. The key of a moved item is its old index if index_keys is set,
+ * and its old key otherwise. */
+static void permuteGraph(Graph *graph, int *node_map, int *edge_map, bool index_keys)
+{
+   NodeArray old_nodes = graph->nodes;
+   EdgeArray old_edges = graph->edges;
+   NodeArray *nodes = &(graph->nodes);
+   EdgeArray *edges = &(graph->edges);
+   *nodes = makeNodeArray(graph->number_of_nodes);
+   *edges = makeEdgeArray(graph->number_of_edges);
+   nodes->size = graph->number_of_nodes;
+   edges->size = graph->number_of_edges;
+
+   int index;
+   for(index = 0; index < old_nodes.size; index++)
+   {
+      if(node_map[index] < 0) continue;
+      Node node = *writableNodeSlot(&old_nodes, index);
+      int key = index_keys ? index : *nodeKey(&old_nodes, index);
+      node.index = node_map[index];
+      renumberIntArray(&(node.out_edges), edge_map);
+      renumberIntArray(&(node.in_edges), edge_map);
+      *writableNodeSlot(nodes, node.index) = node;
+      *nodeKey(nodes, node.index) = key;
+   }
+   for(index = 0; index < old_edges.size; index++)
+   {
+      if(edge_map[index] < 0) continue;
+      Edge edge = *writableEdgeSlot(&old_edges, index);
+      int key = index_keys ? index : *edgeKey(&old_edges, index);
+      edge.index = edge_map[index];
+      edge.source = node_map[edge.source];
+      edge.target = node_map[edge.target];
+      *writableEdgeSlot(edges, edge.index) = edge;
+      *edgeKey(edges, edge.index) = key;
+   }
+
+   int chunk;
+   for(chunk = 0; chunk < old_nodes.capacity >> GRAPH_CHUNK_BITS; chunk++)
+      if(old_nodes.chunks[chunk] != NULL && --old_nodes.chunks[chunk]->references == 0)
+         freeChunk(&node_chunk_pool, old_nodes.chunks[chunk]);
+   free(old_nodes.chunks);
+   if(old_nodes.holes.items != NULL) free(old_nodes.holes.items);
+   for(chunk = 0; chunk < old_edges.capacity >> GRAPH_CHUNK_BITS; chunk++)
+      if(old_edges.chunks[chunk] != NULL && --old_edges.chunks[chunk]->references == 0)
+         freeChunk(&edge_chunk_pool, old_edges.chunks[chunk]);
+   free(old_edges.chunks);
+   if(old_edges.holes.items != NULL) free(old_edges.holes.items);
+   renumberReferences(graph, node_map, edge_map);
+}
+
+/* The breadth-first search uses the new node order as its queue. */
+void reorderGraph(Graph *graph)
+{
+   NodeArray *nodes = &(graph->nodes);
+   EdgeArray *edges = &(graph->edges);
+   int *node_map = makeIndexMap(nodes->size);
+   int *edge_map = makeIndexMap(edges->size);
+   int *order = makeIndexMap(graph->number_of_nodes);
+   int seed, count = 0, head = 0, position;
+   for(seed = 0; seed < nodes->size; seed++)
+   {
+      if(nodeSlot(nodes, seed)->index < 0 || node_map[seed] >= 0) continue;
+      node_map[seed] = count;
+      order[count++] = seed;
+      while(head < count)
+      {
+         Node *node = nodeSlot(nodes, order[head++]);
+         for(position = 0; position < node->outdegree; position++)
+         {
+            int target = edgeSlot(edges, node->out_edges.items[position])->target;
+            if(node_map[target] >= 0) continue;
+            node_map[target] = count;
+            order[count++] = target;
+         }
+         for(position = 0; position < node->indegree; position++)
+         {
+            int source = edgeSlot(edges, node->in_edges.items[position])->source;
+            if(node_map[source] >= 0) continue;
+            node_map[source] = count;
+            order[count++] = source;
+         }
+      }
+   }
+   count = 0;
+   for(head = 0; head < graph->number_of_nodes; head++)
+   {
+      Node *node = nodeSlot(nodes, order[head]);
+      for(position = 0; position < node->outdegree; position++)
+         edge_map[node->out_edges.items[position]] = count++;
+   }
+   free(order);
+   permuteGraph(graph, node_map, edge_map, !graph->reordered);
+   graph->reordered = true;
+   free(node_map);
+   free(edge_map);
+}
+
+/* Keys are compared as unsigned integers, so that the items without keys (-1)
+ * come last, in index order. */
+typedef struct KeyedIndex {
+   unsigned key;
+   int index;
+} KeyedIndex;
+
+static int compareKeyedIndices(const void *first, const void *second)
+{
+   const KeyedIndex *a = first, *b = second;
+   if(a->key != b->key) return a->key < b->key ? -1 : 1;
+   return a->index - b->index;
+}
+
+/* Sorts the keyed indices and numbers them in the map in the sorted order. */
+static void mapByKeys(KeyedIndex *items, int count, int *map)
+{
+   qsort(items, count, sizeof(KeyedIndex), compareKeyedIndices);
+   int position;
+   for(position = 0; position < count; position++) map[items[position].index] = position;
+}
+
+void restoreGraphOrder(Graph *graph)
+{
+   if(!graph->reordered) return;
+   NodeArray *nodes = &(graph->nodes);
+   EdgeArray *edges = &(graph->edges);
+   int *node_map = makeIndexMap(nodes->size);
+   int *edge_map = makeIndexMap(edges->size);
+   int items = graph->number_of_nodes > graph->number_of_edges ?
+               graph->number_of_nodes : graph->number_of_edges;
+   KeyedIndex *keyed = malloc((items + 1) * sizeof(KeyedIndex));
+   if(keyed == NULL)
+   {
+      print_to_log("Error (restoreGraphOrder): malloc failure.\n");
+      exit(1);
+   }
+   int index, count = 0;
+   for(index = 0; index < nodes->size; index++)
+   {
+      if(nodeSlot(nodes, index)->index < 0) continue;
+      keyed[count].key = (unsigned)*nodeKey(nodes, index);
+      keyed[count++].index = index;
+   }
+   mapByKeys(keyed, count, node_map);
+   count = 0;
+   for(index = 0; index < edges->size; index++)
+   {
+      if(edgeSlot(edges, index)->index < 0) continue;
+      keyed[count].key = (unsigned)*edgeKey(edges, index);
+      keyed[count++].index = index;
+   }
+   mapByKeys(keyed, count, edge_map);
+   free(keyed);
+   permuteGraph(graph, node_map, edge_map, false);
+   graph->reordered = false;
+   free(node_map);
+   free(edge_map);
+}
+
+/* Writing a key makes the item's chunk private. A freshly loaded graph shares
+ * no chunks, so only a graph keyed after a snapshot pays for copies. */
+void keyGraphItems(Graph *graph)
+{
+   int index;
+   for(index = 0; index < graph->nodes.size; index++)
+   {
+      if(nodeSlot(&(graph->nodes), index)->index < 0) continue;
+      writableNodeSlot(&(graph->nodes), index);
+      *nodeKey(&(graph->nodes), index) = index;
    }
-   PTF("|\n  ");
    for(index = 0; index < graph->edges.size; index++)
    {
-      Edge *edge = getEdge(graph, index);
-      if(edge->index == -1) continue; 
+      if(edgeSlot(&(graph->edges), index)->index < 0) continue;
+      writableEdgeSlot(&(graph->edges), index);
+      *edgeKey(&(graph->edges), index) = index;
+   }
+}
 
-      /* Three edges per line */
-      if(edge_count != 0 && edge_count % 3 == 0) PTF("\n  ");
-      PTF("(%d, ", edge_count++);
-      PTF("%d, %d, ", output_indices[edge->source], output_indices[edge->target]);
-      printHostLabel(edge->label, file);
-      PTF(") ");
+/* =================
+ * Bulk Construction
+ * ================= */
+typedef struct ThreadTask {
+   void (*task)(void *data, int thread);
+   void *data;
+   int thread;
+   /* The log file of the calling thread, as log_file is thread-local. */
+   FILE *log_file;
+} ThreadTask;
+
+static void *runThreadTask(void *argument)
+{
+   ThreadTask *task = argument;
+   log_file = task->log_file;
+   task->task(task->data, task->thread);
+   return NULL;
+}
+
+void runOnThreads(int threads, void (*task)(void *data, int thread), void *data)
+{
+   if(threads <= 1)
+   {
+      task(data, 0);
+      return;
+   }
+   pthread_t *handles = malloc(threads * sizeof(pthread_t));
+   ThreadTask *tasks = malloc(threads * sizeof(ThreadTask));
+   bool *started = malloc(threads * sizeof(bool));
+   if(handles == NULL || tasks == NULL || started == NULL)
+   {
+      print_to_log("Error (runOnThreads): malloc failure.\n");
+      exit(1);
+   }
+   int thread;
+   for(thread = 1; thread < threads; thread++)
+   {
+      tasks[thread].task = task;
+      tasks[thread].data = data;
+      tasks[thread].thread = thread;
+      tasks[thread].log_file = log_file;
+      started[thread] = pthread_create(&handles[thread], NULL, runThreadTask,
+                                       &tasks[thread]) == 0;
    }
-   PTF("]\n\n");
+   task(data, 0);
+   /* The tasks of threads that could not be created run on this thread. */
+   for(thread = 1; thread < threads; thread++)
+   {
+      if(started[thread]) pthread_join(handles[thread], NULL);
+      else task(data, thread);
+   }
+   free(handles);
+   free(tasks);
+   free(started);
 }
 
-void freeGraph(Graph *graph) 
+/* The state of buildGraph shared by its threads. Each thread works on the
+ * same range of whole chunks of the node array, and of the edge array, in
+ * every phase. The counts of the items of each class table and root node
+ * array in the thread's ranges are replaced by the positions at which the
+ * thread's items start in the table. */
+typedef struct GraphBuild {
+   Graph *graph;
+   int nodes, edges, threads;
+   const bool *roots;
+   const int *node_labels, *edge_labels, *sources, *targets;
+   const HostLabel *labels;
+   int (*node_counts)[NUMBER_OF_MARKS][NUMBER_OF_CLASSES];
+   int (*edge_counts)[NUMBER_OF_MARKS][NUMBER_OF_CLASSES];
+   int (*root_counts)[NUMBER_OF_MARKS];
+} GraphBuild;
+
+/* Sets [first, last) to the thread's range of the indices of count items, in
+ * whole chunks. last may exceed count in the final chunk. */
+static void chunkRange(int count, int thread, int threads, int *first, int *last)
 {
-   if(graph == NULL) return;
+   int64_t chunks = (count + GRAPH_CHUNK_SIZE - 1) >> GRAPH_CHUNK_BITS;
+   *first = (int)(chunks * thread / threads) << GRAPH_CHUNK_BITS;
+   *last = (int)(chunks * (thread + 1) / threads) << GRAPH_CHUNK_BITS;
+}
+
+/* Writes the nodes and edges into their chunks, the slots past the last item
+ * as holes, and counts the items of each class table and root node array. */
+static void fillGraphItems(void *data, int thread)
+{
+   GraphBuild *build = data;
+   Graph *graph = build->graph;
+   int first, last, index;
+   chunkRange(build->nodes, thread, build->threads, &first, &last);
+   for(index = first; index < last; index++)
+   {
+      Node *node = nodeSlot(&(graph->nodes), index);
+      *nodeKey(&(graph->nodes), index) = -1;
+      *node = dummy_node;
+      if(index >= build->nodes) continue;
+      node->index = index;
+      node->root = build->roots[index];
+      node->label = build->labels[build->node_labels[index]];
+      build->node_counts[thread][node->label.mark][getLabelClass(node->label)]++;
+      if(node->root) build->root_counts[thread][node->label.mark]++;
+   }
+   chunkRange(build->edges, thread, build->threads, &first, &last);
+   for(index = first; index < last; index++)
+   {
+      Edge *edge = edgeSlot(&(graph->edges), index);
+      *edgeKey(&(graph->edges), index) = -1;
+      *edge = dummy_edge;
+      if(index >= build->edges) continue;
+      edge->index = index;
+      edge->label = build->labels[build->edge_labels[index]];
+      edge->source = build->sources[index];
+      edge->target = build->targets[index];
+      build->edge_counts[thread][edge->label.mark][getLabelClass(edge->label)]++;
+   }
+}
+
+/* Turns a column of per-thread counts into per-thread starting positions and
+ * returns an array sized to their total. */
+static IntArray sumThreadCounts(int *counts, size_t stride, int threads)
+{
+   int total = 0, thread;
+   for(thread = 0; thread < threads; thread++)
+   {
+      int *count = (int *)((char *)counts + thread * stride);
+      int items = *count;
+      *count = total;
+      total += items;
+   }
+   IntArray array = makeIntArray(total);
+   array.size = total;
+   return array;
+}
+
+static void countDegrees(void *data, int thread)
+{
+   GraphBuild *build = data;
+   int first, last, index;
+   chunkRange(build->edges, thread, build->threads, &first, &last);
+   if(last > build->edges) last = build->edges;
+   for(index = first; index < last; index++)
+   {
+      __atomic_fetch_add(&(nodeSlot(&(build->graph->nodes), build->sources[index])->outdegree),
+                         1, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&(nodeSlot(&(build->graph->nodes), build->targets[index])->indegree),
+                         1, __ATOMIC_RELAXED);
+   }
+}
+
+static int *allocateIncidence(int degree)
+{
+   if(degree == 0) return NULL;
+   int *items = malloc(degree * sizeof(int));
+   if(items == NULL)
+   {
+      print_to_log("Error (buildGraph): malloc failure.\n");
+      exit(1);
+   }
+   return items;
+}
+
+/* Allocates the incidence arrays at the size of the node's degrees, and fills
+ * the node class tables and root node arrays. The sizes of the incidence
+ * arrays are the cursors of placeEdges. */
+static void placeNodes(void *data, int thread)
+{
+   GraphBuild *build = data;
+   Graph *graph = build->graph;
+   int first, last, index;
+   chunkRange(build->nodes, thread, build->threads, &first, &last);
+   if(last > build->nodes) last = build->nodes;
+   for(index = first; index < last; index++)
+   {
+      Node *node = nodeSlot(&(graph->nodes), index);
+      node->out_edges.capacity = node->outdegree;
+      node->out_edges.items = allocateIncidence(node->outdegree);
+      node->in_edges.capacity = node->indegree;
+      node->in_edges.items = allocateIncidence(node->indegree);
+      MarkType mark = node->label.mark;
+      LabelClass label_class = getLabelClass(node->label);
+      node->class_position = build->node_counts[thread][mark][label_class]++;
+      graph->node_classes[mark][label_class]->items.items[node->class_position] = index;
+      if(node->root)
+      {
+         node->root_position = build->root_counts[thread][mark]++;
+         graph->root_nodes[mark].items[node->root_position] = index;
+      }
+   }
+}
+
+/* Places each edge in the incidence arrays of its nodes, in the order in which
+ * the threads reach it, and fills the edge class tables. */
+static void placeEdges(void *data, int thread)
+{
+   GraphBuild *build = data;
+   Graph *graph = build->graph;
+   int first, last, index;
+   chunkRange(build->edges, thread, build->threads, &first, &last);
+   if(last > build->edges) last = build->edges;
+   for(index = first; index < last; index++)
+   {
+      Edge *edge = edgeSlot(&(graph->edges), index);
+      Node *source = nodeSlot(&(graph->nodes), edge->source);
+      Node *target = nodeSlot(&(graph->nodes), edge->target);
+      source->out_edges.items[__atomic_fetch_add(&(source->out_edges.size), 1,
+                                                 __ATOMIC_RELAXED)] = index;
+      target->in_edges.items[__atomic_fetch_add(&(target->in_edges.size), 1,
+                                                __ATOMIC_RELAXED)] = index;
+      MarkType mark = edge->label.mark;
+      LabelClass label_class = getLabelClass(edge->label);
+      edge->class_position = build->edge_counts[thread][mark][label_class]++;
+      graph->edge_classes[mark][label_class]->items.items[edge->class_position] = index;
+   }
+}
+
+static int compareIndices(const void *first, const void *second)
+{
+   return *(const int *)first - *(const int *)second;
+}
+
+/* Sorts the incidence array into index order, the order in which addEdge
+ * would have appended the edges. Most arrays are already sorted or short. */
+static void sortIncidence(IntArray *array)
+{
+   int index;
+   for(index = 1; index < array->size; index++)
+      if(array->items[index - 1] > array->items[index]) break;
+   if(index >= array->size) return;
+   if(array->size > 16)
+   {
+      qsort(array->items, array->size, sizeof(int), compareIndices);
+      return;
+   }
+   for(index = 1; index < array->size; index++)
+   {
+      int item = array->items[index], position = index;
+      for(; position > 0 && array->items[position - 1] > item; position--)
+         array->items[position] = array->items[position - 1];
+      array->items[position] = item;
+   }
+}
+
+/* The thread of a node's range writes the source positions of its outgoing
+ * edges and the target positions of its incoming edges. */
+static void orderIncidence(void *data, int thread)
+{
+   GraphBuild *build = data;
+   Graph *graph = build->graph;
+   int first, last, index, position;
+   chunkRange(build->nodes, thread, build->threads, &first, &last);
+   if(last > build->nodes) last = build->nodes;
+   for(index = first; index < last; index++)
+   {
+      Node *node = nodeSlot(&(graph->nodes), index);
+      sortIncidence(&(node->out_edges));
+      sortIncidence(&(node->in_edges));
+      for(position = 0; position < node->outdegree; position++)
+         edgeSlot(&(graph->edges), node->out_edges.items[position])->source_position = position;
+      for(position = 0; position < node->indegree; position++)
+         edgeSlot(&(graph->edges), node->in_edges.items[position])->target_position = position;
+   }
+}
+
+Graph *buildGraph(int nodes, int edges, const bool *roots, const int *node_labels,
+                  const int *edge_labels, const int *sources, const int *targets,
+                  const HostLabel *labels, int threads)
+{
+   Graph *graph = newGraph(nodes, edges);
+   /* Chunks are allocated on this thread, from its chunk pools. */
+   int chunk;
+   for(chunk = 0; chunk << GRAPH_CHUNK_BITS < nodes; chunk++)
+   {
+      graph->nodes.chunks[chunk] = allocateChunk(&node_chunk_pool);
+      graph->nodes.chunks[chunk]->references = 1;
+   }
+   for(chunk = 0; chunk << GRAPH_CHUNK_BITS < edges; chunk++)
+   {
+      graph->edges.chunks[chunk] = allocateChunk(&edge_chunk_pool);
+      graph->edges.chunks[chunk]->references = 1;
+   }
+   graph->nodes.size = graph->number_of_nodes = nodes;
+   graph->edges.size = graph->number_of_edges = edges;
+   if(threads < 1) threads = 1;
+
+   GraphBuild build = {graph, nodes, edges, threads, roots, node_labels, edge_labels,
+                       sources, targets, labels, NULL, NULL, NULL};
+   build.node_counts = calloc(threads, sizeof(*build.node_counts));
+   build.edge_counts = calloc(threads, sizeof(*build.edge_counts));
+   build.root_counts = calloc(threads, sizeof(*build.root_counts));
+   if(build.node_counts == NULL || build.edge_counts == NULL || build.root_counts == NULL)
+   {
+      print_to_log("Error (buildGraph): malloc failure.\n");
+      exit(1);
+   }
+   runOnThreads(threads, fillGraphItems, &build);
+
+   int mark, label_class;
+   for(mark = 0; mark < NUMBER_OF_MARKS; mark++)
+   {
+      free(graph->root_nodes[mark].items);
+      graph->root_nodes[mark] = sumThreadCounts(&(build.root_counts[0][mark]),
+                                                sizeof(*build.root_counts), threads);
+      for(label_class = 0; label_class < NUMBER_OF_CLASSES; label_class++)
+      {
+         free(graph->node_classes[mark][label_class]->items.items);
+         graph->node_classes[mark][label_class]->items =
+            sumThreadCounts(&(build.node_counts[0][mark][label_class]),
+                            sizeof(*build.node_counts), threads);
+         free(graph->edge_classes[mark][label_class]->items.items);
+         graph->edge_classes[mark][label_class]->items =
+            sumThreadCounts(&(build.edge_counts[0][mark][label_class]),
+                            sizeof(*build.edge_counts), threads);
+      }
+   }
+   runOnThreads(threads, countDegrees, &build);
+   runOnThreads(threads, placeNodes, &build);
+   runOnThreads(threads, placeEdges, &build);
+   runOnThreads(threads, orderIncidence, &build);
+
+   /* The list store and list pools belong to this thread, so the references
+    * to the lists are taken here. */
    int index;
+   for(index = 0; index < nodes; index++)
+   {
+      #ifdef LIST_HASHING
+         addHostList(labels[node_labels[index]].list);
+      #else
+         Node *node = nodeSlot(&(graph->nodes), index);
+         node->label.list = copyHostList(node->label.list);
+      #endif
+   }
+   for(index = 0; index < edges; index++)
+   {
+      #ifdef LIST_HASHING
+         addHostList(labels[edge_labels[index]].list);
+      #else
+         Edge *edge = edgeSlot(&(graph->edges), index);
+         edge->label.list = copyHostList(edge->label.list);
+      #endif
+   }
+   free(build.node_counts);
+   free(build.edge_counts);
+   free(build.root_counts);
+   return graph;
+}
+
+/* ========================
+ * Graph Querying Functions 
+ * ======================== */
+Node *getNode(Graph *graph, int index)
+{
+   assert(index < graph->nodes.size);
+   if(index == -1) return NULL;
+   else return nodeSlot(&(graph->nodes), index);
+}
+
+Edge *getEdge(Graph *graph, int index)
+{
+   assert(index < graph->edges.size);
+   if(index == -1) return NULL;
+   else return edgeSlot(&(graph->edges), index);
+}
+
+Node *getWritableNode(Graph *graph, int index)
+{
+   assert(index >= 0 && index < graph->nodes.capacity);
+   return writableNodeSlot(&(graph->nodes), index);
+}
+
+Edge *getWritableEdge(Graph *graph, int index)
+{
+   assert(index >= 0 && index < graph->edges.capacity);
+   return writableEdgeSlot(&(graph->edges), index);
+}
+
+int getNodeKey(Graph *graph, int index)
+{
+   assert(index >= 0 && index < graph->nodes.size);
+   return *nodeKey(&(graph->nodes), index);
+}
+
+int getEdgeKey(Graph *graph, int index)
+{
+   assert(index >= 0 && index < graph->edges.size);
+   return *edgeKey(&(graph->edges), index);
+}
+
+IntArray *getRootNodes(Graph *graph, MarkType mark)
+{
+   return &(graph->root_nodes[mark]);
+}
+
+IntArray *getNodeClassTable(Graph *graph, MarkType mark, LabelClass label_class)
+{
+   return &(graph->node_classes[mark][label_class]->items);
+}
+
+IntArray *getEdgeClassTable(Graph *graph, MarkType mark, LabelClass label_class)
+{
+   return &(graph->edge_classes[mark][label_class]->items);
+}
+
+IntArray *getEdgesBetween(Graph *graph, int source, int target)
+{
+   assert(graph->adjacency != NULL);
+   AdjacencyEntry *entry = findAdjacencyEntry(graph->adjacency, source, target, false);
+   return entry == NULL ? NULL : &(entry->edges);
+}
+
+Edge *getNthOutEdge(Graph *graph, Node *node, int n)
+{
+   assert(n >= 0 && n < node->outdegree);
+   return getEdge(graph, node->out_edges.items[n]);
+}
+
+Edge *getNthInEdge(Graph *graph, Node *node, int n)
+{
+   assert(n >= 0 && n < node->indegree);
+   return getEdge(graph, node->in_edges.items[n]);
+}
+
+Edge *getIncidentEdge(Graph *graph, Node *node, int *counter)
+{
+   if(*counter < node->outdegree) return getEdge(graph, node->out_edges.items[*counter]);
+   for(; *counter < node->outdegree + node->indegree; (*counter)++)
+   {
+      Edge *edge = getEdge(graph, node->in_edges.items[*counter - node->outdegree]);
+      if(edge->source != edge->target) return edge;
+   }
+   return NULL;
+}
+
+Node *getSource(Graph *graph, Edge *edge) 
+{
+   return getNode(graph, edge->source);
+}
+
+Node *getTarget(Graph *graph, Edge *edge) 
+{
+   return getNode(graph, edge->target);
+}
+
+HostLabel getNodeLabel(Graph *graph, int index) 
+{
+   Node *node = getNode(graph, index);
+   return node->label;
+}
+
+HostLabel getEdgeLabel(Graph *graph, int index) 
+{
+   Edge *edge = getEdge(graph, index);
+   return edge->label;
+}
+
+int getIndegree(Graph *graph, int index) 
+{
+   Node *node = getNode(graph, index);
+   return node->indegree;
+}
+
+int getOutdegree(Graph *graph, int index) 
+{
+   Node *node = getNode(graph, index);
+   return node->outdegree;
+}
+
+/* printGraph formats the graph into a large buffer, which is written to the
+ * file whenever it fills. A text buffer without a file grows instead, and is
+ * used to hold the formatted text of host lists. */
+#define PRINT_BUFFER_SIZE (1 << 20)
+
+typedef struct TextBuffer {
+   char *data;
+   size_t size;
+   size_t capacity;
+   FILE *file;
+} TextBuffer;
+
+static TextBuffer makeTextBuffer(size_t capacity, FILE *file)
+{
+   TextBuffer buffer = {malloc(capacity), 0, capacity, file};
+   if(buffer.data == NULL)
+   {
+      print_to_log("Error (makeTextBuffer): malloc failure.\n");
+      exit(1);
+   }
+   return buffer;
+}
+
+static void flushText(TextBuffer *buffer)
+{
+   if(buffer->size > 0) fwrite(buffer->data, 1, buffer->size, buffer->file);
+   buffer->size = 0;
+}
+
+/* Ensures that the passed number of bytes can be appended to the buffer. */
+static void reserveText(TextBuffer *buffer, size_t bytes)
+{
+   if(buffer->size + bytes <= buffer->capacity) return;
+   if(buffer->file != NULL)
+   {
+      flushText(buffer);
+      if(bytes <= buffer->capacity) return;
+   }
+   while(buffer->capacity < buffer->size + bytes) buffer->capacity *= 2;
+   buffer->data = realloc(buffer->data, buffer->capacity);
+   if(buffer->data == NULL)
+   {
+      print_to_log("Error (reserveText): malloc failure.\n");
+      exit(1);
+   }
+}
+
+static void appendText(TextBuffer *buffer, const char *text, size_t length)
+{
+   reserveText(buffer, length);
+   memcpy(buffer->data + buffer->size, text, length);
+   buffer->size += length;
+}
+
+#define appendLiteral(buffer, literal) appendText(buffer, literal, sizeof(literal) - 1)
+
+static void appendInt(TextBuffer *buffer, int value)
+{
+   char digits[12];
+   int length = 0;
+   unsigned magnitude = value < 0 ? -(unsigned)value : (unsigned)value;
+   do
+   {
+      digits[length++] = '0' + magnitude % 10;
+      magnitude /= 10;
+   } while(magnitude > 0);
+   reserveText(buffer, length + 1);
+   if(value < 0) buffer->data[buffer->size++] = '-';
+   while(length > 0) buffer->data[buffer->size++] = digits[--length];
+}
+
+/* Formats the list as printHostList does. The strings of host lists are
+ * interned, so their lengths are known. */
+static void appendHostList(TextBuffer *buffer, HostList *list)
+{
+   int index;
+   for(index = 0; index < list->length; index++)
+   {
+      HostAtom atom = list->atoms[index];
+      if(index > 0) appendLiteral(buffer, " : ");
+      if(atom.type == 'i') appendInt(buffer, atom.num);
+      else
+      {
+         appendLiteral(buffer, "\"");
+         appendText(buffer, atom.str, symbolLength(atom.str));
+         appendLiteral(buffer, "\"");
+      }
+   }
+}
+
+static const char *const mark_suffixes[NUMBER_OF_MARKS] =
+   {"", " # red", " # green", " # blue", " # grey", " # dashed"};
+
+/* The text of lists with more than one reference is formatted once per call
+ * of printGraph: the table maps each such list to its text in a text buffer. */
+typedef struct ListText {
+   HostList *list;
+   size_t offset;
+   size_t length;
+} ListText;
+
+typedef struct ListTextTable {
+   int capacity;
+   int size;
+   ListText *slots;
+   TextBuffer text;
+} ListTextTable;
+
+#ifdef LIST_HASHING
+static ListText *findListText(ListTextTable *table, HostList *list)
+{
+   unsigned slot = hashListPointer(list) & (table->capacity - 1);
+   while(table->slots[slot].list != NULL && table->slots[slot].list != list)
+      slot = (slot + 1) & (table->capacity - 1);
+   return &(table->slots[slot]);
+}
+
+static void resizeListTextTable(ListTextTable *table, int capacity)
+{
+   ListText *old_slots = table->slots;
+   int old_capacity = table->capacity, index;
+   table->capacity = capacity;
+   table->slots = calloc(capacity, sizeof(ListText));
+   if(table->slots == NULL)
+   {
+      print_to_log("Error (resizeListTextTable): malloc failure.\n");
+      exit(1);
+   }
+   for(index = 0; index < old_capacity; index++)
+      if(old_slots[index].list != NULL) *findListText(table, old_slots[index].list) = old_slots[index];
+   free(old_slots);
+}
+#endif
+
+static void appendHostLabel(TextBuffer *buffer, ListTextTable *table, HostLabel label)
+{
+   if(label.length == 0) appendLiteral(buffer, "empty");
+   #ifdef LIST_HASHING
+   else if(label.list->reference_count > 1)
+   {
+      if(2 * (table->size + 1) > table->capacity) resizeListTextTable(table, 2 * table->capacity);
+      ListText *entry = findListText(table, label.list);
+      if(entry->list == NULL)
+      {
+         entry->list = label.list;
+         entry->offset = table->text.size;
+         appendHostList(&(table->text), label.list);
+         entry->length = table->text.size - entry->offset;
+         table->size++;
+      }
+      appendText(buffer, table->text.data + entry->offset, entry->length);
+   }
+   #endif
+   else appendHostList(buffer, label.list);
+   const char *suffix = mark_suffixes[label.mark];
+   appendText(buffer, suffix, strlen(suffix));
+}
+
+void printGraph(Graph *graph, FILE *file) 
+{
+   /* The node and edge counts are used in the IDs of the printed graph. The item's 
+    * index in the graph is not suitable for this purpose because there may be holes
+    * in the graph's node array. The counts are also used to control the number of
+    * nodes and edges printed per line. */
+   int index, node_count = 0, edge_count = 0;
+   if(graph == NULL || graph->number_of_nodes == 0) 
+   {
+      PTF("[ | ]\n\n");
+      return;
+   }
+   TextBuffer buffer = makeTextBuffer(PRINT_BUFFER_SIZE, file);
+   ListTextTable table = {0, 0, NULL, makeTextBuffer(4096, NULL)};
+   #ifdef LIST_HASHING
+      resizeListTextTable(&table, 256);
+   #endif
+   appendLiteral(&buffer, "[ ");
+   /* Maps a node's graph-index to the ID it is printed with (node_count). */
+   int *output_indices = malloc(graph->nodes.size * sizeof(int));
+   if(output_indices == NULL)
+   {
+      print_to_log("Error (printGraph): malloc failure.\n");
+      exit(1);
+   }
    for(index = 0; index < graph->nodes.size; index++)
    {
       Node *node = getNode(graph, index);
-      if(node == NULL) continue;
-      if(node->out_edges.items != NULL) free(node->out_edges.items);
-      if(node->in_edges.items != NULL) free(node->in_edges.items);
-      removeHostList(node->label.list);
+      if(node->index == -1) 
+      {
+         output_indices[index] = -1;
+         continue; 
+      }
+      /* Five nodes per line */
+      if(node_count != 0 && node_count % 5 == 0) appendLiteral(&buffer, "\n  ");
+      output_indices[index] = node_count;
+      appendLiteral(&buffer, "(");
+      appendInt(&buffer, node_count++);
+      if(node->root) appendLiteral(&buffer, "(R), ");
+      else appendLiteral(&buffer, ", ");
+      appendHostLabel(&buffer, &table, node->label);
+      appendLiteral(&buffer, ") ");
    }
-   if(graph->nodes.holes.items) free(graph->nodes.holes.items);
-   if(graph->nodes.items) free(graph->nodes.items);
-
-   for(index = 0; index < graph->edges.size; index++)
+   if(graph->number_of_edges == 0) appendLiteral(&buffer, "| ]\n\n");
+   else
    {
-      Edge *edge = getEdge(graph, index);
-      if(edge == NULL) continue;
-      removeHostList(edge->label.list);
+      appendLiteral(&buffer, "|\n  ");
+      for(index = 0; index < graph->edges.size; index++)
+      {
+         Edge *edge = getEdge(graph, index);
+         if(edge->index == -1) continue; 
+
+         /* Three edges per line */
+         if(edge_count != 0 && edge_count % 3 == 0) appendLiteral(&buffer, "\n  ");
+         appendLiteral(&buffer, "(");
+         appendInt(&buffer, edge_count++);
+         appendLiteral(&buffer, ", ");
+         appendInt(&buffer, output_indices[edge->source]);
+         appendLiteral(&buffer, ", ");
+         appendInt(&buffer, output_indices[edge->target]);
+         appendLiteral(&buffer, ", ");
+         appendHostLabel(&buffer, &table, edge->label);
+         appendLiteral(&buffer, ") ");
+      }
+      appendLiteral(&buffer, "]\n\n");
    }
+   flushText(&buffer);
+   free(buffer.data);
+   free(table.slots);
+   free(table.text.data);
+   free(output_indices);
+}
+
+void printGraphStatistics(Graph *graph, FILE *file)
+{
+   int roots = 0, mark, label_class;
+   for(mark = 0; mark < NUMBER_OF_MARKS; mark++) roots += graph->root_nodes[mark].size;
+   PTF("# GP 2 host graph statistics\n");
+   PTF("nodes %d\nedges %d\nroots %d\n", graph->number_of_nodes,
+       graph->number_of_edges, roots);
+   PTF("# <item> <mark> <label class> <count>\n");
+   for(mark = 0; mark < NUMBER_OF_MARKS; mark++)
+      for(label_class = 0; label_class < NUMBER_OF_CLASSES; label_class++)
+         if(graph->node_classes[mark][label_class]->items.size > 0)
+            PTF("node %d %d %d\n", mark, label_class, 
+                graph->node_classes[mark][label_class]->items.size);
+   for(mark = 0; mark < NUMBER_OF_MARKS; mark++)
+      for(label_class = 0; label_class < NUMBER_OF_CLASSES; label_class++)
+         if(graph->edge_classes[mark][label_class]->items.size > 0)
+            PTF("edge %d %d %d\n", mark, label_class, 
+                graph->edge_classes[mark][label_class]->items.size);
+}
+
+void freeGraph(Graph *graph) 
+{
+   if(graph == NULL) return;
+   int chunk;
+   for(chunk = 0; chunk < graph->nodes.capacity >> GRAPH_CHUNK_BITS; chunk++)
+      releaseNodeChunk(graph->nodes.chunks[chunk]);
+   if(graph->nodes.holes.items) free(graph->nodes.holes.items);
+   free(graph->nodes.chunks);
+
+   for(chunk = 0; chunk < graph->edges.capacity >> GRAPH_CHUNK_BITS; chunk++)
+      releaseEdgeChunk(graph->edges.chunks[chunk]);
    if(graph->edges.holes.items) free(graph->edges.holes.items);
-   if(graph->edges.items) free(graph->edges.items);
-   if(graph->root_nodes != NULL) 
+   free(graph->edges.chunks);
+   int mark, label_class;
+   for(mark = 0; mark < NUMBER_OF_MARKS; mark++)
    {
-      RootNodes *iterator = graph->root_nodes;
-      while(iterator != NULL)
+      if(graph->root_nodes[mark].items != NULL) free(graph->root_nodes[mark].items);
+      for(label_class = 0; label_class < NUMBER_OF_CLASSES; label_class++)
       {
-         RootNodes *temp = iterator;
-         iterator = iterator->next;
-         free(temp);
+         releaseClassTable(graph->node_classes[mark][label_class]);
+         releaseClassTable(graph->edge_classes[mark][label_class]);
       }
    }
+   freeAdjacencyIndex(graph->adjacency);
+   freeNodeColumns(graph->node_columns);
    free(graph);
 }
 
@@ -32,6 +32,7 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h> 
 #include <stdio.h> 
 
@@ -48,21 +49,112 @@ typedef struct IntArray {
 IntArray makeIntArray(int initial_capacity);
 void addToIntArray(IntArray *array, int item);
 void removeFromIntArray(IntArray *array, int index);
+/* Frees the items of target and replaces them with a copy of source's items. */
+void copyIntArray(IntArray *target, IntArray *source);
+
+/* Node and edge arrays are stored in chunks of GRAPH_CHUNK_SIZE items, so that
+ * a graph and its snapshots (see snapshotGraph) can share the chunks that
+ * neither of them has modified. The item at index i is item i % GRAPH_CHUNK_SIZE
+ * of chunk i / GRAPH_CHUNK_SIZE. capacity is the number of items the chunk table
+ * can address; chunks are allocated when the array first reaches them. */
+#define GRAPH_CHUNK_BITS 8
+#define GRAPH_CHUNK_SIZE (1 << GRAPH_CHUNK_BITS)
+
+/* The storage policy of graph arrays, set by the runtime's flags before the
+ * first graph is created and not changed afterwards.
+ *
+ * node_hint and edge_hint are the numbers of nodes and edges a host graph is
+ * expected to reach. newGraph sizes the chunk tables to them, and
+ * enableNodeColumns the node columns, so that a growing graph does not
+ * reallocate them. The loader already sizes a graph to the item counts of its
+ * file (for a binary graph, those of the header), so the hints only matter for
+ * programs that enlarge their host graph.
+ *
+ * growth_percent is the percentage by which a full integer array, chunk table
+ * or node column grows: 100 doubles it. A lower percentage lowers the memory
+ * needed while realloc copies a large array, at the price of more copies.
+ *
+ * huge_pages selects the memory of the node and edge chunks. By default they
+ * are allocated with malloc. Otherwise they are carved from 2MB slabs mapped
+ * with MAP_HUGETLB (EXPLICIT_HUGE_PAGES, falling back to transparent huge
+ * pages when the reserved pages run out) or advised with MADV_HUGEPAGE
+ * (TRANSPARENT_HUGE_PAGES), and integer arrays and node columns of at least
+ * two huge pages are advised too. Freed chunks are kept for reuse by the
+ * thread that freed them.
+ *
+ * backing_file, if not NULL, names a file that takes the place of swap space
+ * for the node and edge chunks, which hold most of the memory of a large
+ * graph: the chunks are carved from slabs of the file mapped with MAP_SHARED,
+ * so the kernel writes cold chunks back to the file instead of failing when
+ * the graph outgrows memory. The file is created, and unlinked at once, when
+ * the first chunk is allocated; it grows by a slab at a time. Its contents
+ * hold pointers and are not a saved graph: a graph is saved by
+ * printBinaryGraph, whose output the loader maps back. Incidence arrays,
+ * class tables and labels stay in anonymous memory. A backing file takes
+ * precedence over huge pages. */
+typedef enum {NO_HUGE_PAGES = 0, TRANSPARENT_HUGE_PAGES, EXPLICIT_HUGE_PAGES} HugePageMode;
+
+typedef struct GraphStoragePolicy {
+   int node_hint, edge_hint;
+   int growth_percent;
+   HugePageMode huge_pages;
+   const char *backing_file;
+} GraphStoragePolicy;
+
+extern GraphStoragePolicy graph_storage;
 
 typedef struct NodeArray {
    int capacity;
    int size;
-   struct Node *items;
+   struct NodeChunk **chunks;
    struct IntArray holes;
 } NodeArray;
 
 typedef struct EdgeArray {
    int capacity;
    int size;
-   struct Edge *items;
+   struct EdgeChunk **chunks;
    struct IntArray holes;
 } EdgeArray;
 
+/* A label class table. Shared by reference between a graph and its snapshots
+ * in the same way as the item chunks. */
+typedef struct ClassTable {
+   int references;
+   IntArray items;
+} ClassTable;
+
+/* An adjacency index maps a (source, target) pair of node indices to the
+ * indices of the edges from source to target. It is a hash table with linear
+ * probing whose capacity is a power of 2. An entry with source -1 is empty. */
+typedef struct AdjacencyEntry {
+   int source, target;
+   IntArray edges;
+} AdjacencyEntry;
+
+typedef struct AdjacencyIndex {
+   /* The number of graphs sharing the index. */
+   int references;
+   int capacity;
+   int size;
+   AdjacencyEntry *entries;
+} AdjacencyIndex;
+
+/* Node columns store the node fields tested by the matcher's candidate filters
+ * in parallel arrays indexed by node index, so that the filters read contiguous
+ * memory instead of whole Node structures. alive and matched are bitsets: bit i
+ * is set if the node array holds a node (a matched node) at index i. The other
+ * arrays hold the mark, outdegree and indegree of node i. Entries at dummy node
+ * indices are not meaningful beyond the alive bit. */
+typedef struct NodeColumns {
+   int capacity;
+   uint64_t *alive, *matched;
+   uint8_t *marks;
+   int32_t *outdegrees, *indegrees;
+} NodeColumns;
+
+#define nodeColumnBit(bitset, index) (((bitset)[(index) >> 6] >> ((index) & 63)) & 1)
+
 /* ================================
  * Graph Data Structure + Functions
  * ================================ */
@@ -81,18 +173,66 @@ typedef struct Graph
     * a dummy node (a hole created by the removal of a node), or a valid node. */
    int number_of_nodes, number_of_edges;
    
-   /* Root nodes referenced in a linked list for fast access. */
-   struct RootNodes *root_nodes;
+   /* Root node index. root_nodes[m] stores the indices of the root nodes with
+    * mark m, in no particular order. Each root node stores its position in its
+    * array so that it can be removed or moved to another mark in constant time.
+    * The matching code for rooted rule nodes iterates over the array of the
+    * rule node's mark. */
+   IntArray root_nodes[NUMBER_OF_MARKS];
+
+   /* Label class tables. node_classes[m][c] stores the indices of the nodes
+    * with mark m whose label is in label class c, in no particular order.
+    * Each node stores its position in its class table so that it can be removed
+    * in constant time. The edge tables are analogous. The matching code
+    * iterates over the tables compatible with a rule item's label instead of
+    * scanning the whole node or edge array. */
+   ClassTable *node_classes[NUMBER_OF_MARKS][NUMBER_OF_CLASSES];
+   ClassTable *edge_classes[NUMBER_OF_MARKS][NUMBER_OF_CLASSES];
+
+   /* Optional index of the edges between each pair of nodes. NULL unless
+    * enabled by enableAdjacencyIndex. Used by the matching code generated with
+    * the compiler's -a flag to find the edges between two matched nodes 
+    * without scanning the incident edges of either node. */
+   AdjacencyIndex *adjacency;
+
+   /* Optional column copy of the nodes' alive and matched flags, marks and
+    * degrees. NULL unless enabled by enableNodeColumns. Used by the matching
+    * code generated with the compiler's -n flag. */
+   NodeColumns *node_columns;
+
+   /* Matched flags are epoch stamps: a node or edge is matched if its
+    * matched_epoch equals the graph's match_epoch. resetMatchedFlags unmatches
+    * every item of the graph by giving it a new epoch. Epochs are drawn from a
+    * counter of the running thread, so a new graph or snapshot never takes the
+    * epoch of a graph whose stamps it shares through its chunks. 0 is not an
+    * epoch. */
+   uint64_t match_epoch;
+
+   /* Set by reorderGraph and cleared by restoreGraphOrder. */
+   bool reordered;
 } Graph;
 
 /* The arguments nodes and edges are the initial sizes of the node array and the
- * edge array respectively. */
+ * edge array respectively, raised to the hints of graph_storage. */
 Graph *newGraph(int nodes, int edges);
 
+/* Returns a snapshot of the graph: a new graph equal to the passed graph that
+ * shares its node and edge chunks, label class tables and adjacency index. The
+ * holes arrays, root node arrays and node columns are copied. A graph that
+ * modifies a shared chunk, table or index first replaces it with a private copy,
+ * so that neither graph observes the changes made to the other. Taking a 
+ * snapshot therefore costs time proportional to the number of chunks, and each
+ * subsequent change copies at most one chunk of each kind it touches. 
+ * Matched flags are not part of a snapshot: they must be clear whenever a
+ * snapshot is taken or reverted to, which holds between rule calls. */
+Graph *snapshotGraph(Graph *graph);
+
 /* Nodes and edges are created and added to the graph with the addNode and addEdge
  * functions. They take the necessary construction data as their arguments and 
  * return their index in the graph. */
 int addNode(Graph *graph, bool root, HostLabel label);
+/* Insert or delete a node in the root node array of its current mark. They
+ * do not change the node's root flag. */
 void addRootNode(Graph *graph, int index);
 int addEdge(Graph *graph, HostLabel label, int source_index, int target_index);
 void removeNode(Graph *graph, int index);
@@ -101,10 +241,122 @@ void removeEdge(Graph *graph, int index);
 void relabelNode(Graph *graph, int index, HostLabel new_label);
 void changeNodeMark(Graph *graph, int index, MarkType new_mark);
 void changeRoot(Graph *graph, int index);
+void setMatchedNodeFlag(Graph *graph, int index);
 void resetMatchedNodeFlag(Graph *graph, int index);
 void relabelEdge(Graph *graph, int index, HostLabel new_label);
 void changeEdgeMark(Graph *graph, int index, MarkType new_mark);
 void resetMatchedEdgeFlag(Graph *graph, int index);
+/* Resets the matched flags of all items of the graph in constant time. The
+ * bits of the node columns are not reset: the caller resets those of the
+ * matched nodes with resetMatchedNodeFlag first. */
+void resetMatchedFlags(Graph *graph);
+
+#define nodeMatched(graph, node) ((node)->matched_epoch == (graph)->match_epoch)
+#define edgeMatched(graph, edge) ((edge)->matched_epoch == (graph)->match_epoch)
+
+/* Removing items leaves holes in the node and edge arrays that are reused but
+ * never given back, so a graph that shrinks keeps the memory of its largest
+ * size and the matcher's array scans visit the holes. compactGraph renumbers
+ * the nodes and edges densely, keeping their relative order, and rewrites
+ * every stored index: the incidence arrays, class tables, root node arrays,
+ * adjacency index and node columns. The chunks beyond the new sizes are
+ * freed. No morphism may hold an index of the graph and no changes to it may
+ * be recorded for undoing; the generated programs compact the host graph only
+ * after the commands and loop iterations of the main body, where neither
+ * holds.
+ * sparseGraph returns true if the holes outnumber the items of the graph, and
+ * there are at least COMPACTION_MINIMUM_HOLES of them. Compacting only then
+ * costs a constant amortised time per removed item. */
+#define COMPACTION_MINIMUM_HOLES (4 * GRAPH_CHUNK_SIZE)
+bool sparseGraph(Graph *graph);
+void compactGraph(Graph *graph);
+
+/* The host graph loader numbers the nodes in the order of the host graph file,
+ * which need not keep neighbouring nodes close in memory. reorderGraph
+ * renumbers the nodes in breadth-first order, each connected component from
+ * its node of least index, and numbers the outgoing edges of each node
+ * consecutively in the new node order, so that the matcher's walks along
+ * edges stay within few chunks. All stored indices are rewritten as by
+ * compactGraph, under the same conditions. Each item keeps its old index as
+ * its print key; items created later have no key. restoreGraphOrder undoes
+ * the reordering before the graph is printed: it renumbers the items in the
+ * order of their keys, followed by the items without keys in index order, so
+ * that the items of the loaded graph are printed in their original order. It
+ * does nothing if the graph is not reordered. */
+void reorderGraph(Graph *graph);
+void restoreGraphOrder(Graph *graph);
+
+/* Sets the print key of every item of the graph to its index. Keys survive
+ * compaction, reordering and restoreGraphOrder, and items added later have no
+ * key, so the key of an item of a later state of the graph is its index in
+ * the keyed state. With a snapshot of the keyed graph this identifies the
+ * items that a program kept (see printGraphDelta). Called on a loaded graph
+ * before reorderGraph, which then keeps the same keys. */
+void keyGraphItems(Graph *graph);
+
+/* Runs task(data, t) for each thread number 0 <= t < threads: task 0 on the
+ * calling thread and the others on new POSIX threads. Returns when every task
+ * has finished. The tasks must not use the thread-local state of the runtime,
+ * such as the list store, chunk pools and list pools. */
+void runOnThreads(int threads, void (*task)(void *data, int thread), void *data);
+
+/* Returns a new graph of the passed nodes and edges, built on the passed
+ * number of threads, as by the host graph loader for large files. Node i has
+ * the root flag roots[i] and the label labels[node_labels[i]]; edge i has the
+ * label labels[edge_labels[i]] and runs from node sources[i] to node
+ * targets[i]. The graph is the one that adding the nodes and then the edges in
+ * order with addNode and addEdge would make: the items have the indices of
+ * their order, and the incidence arrays, class tables and root node arrays are
+ * in index order. The incidence arrays are sized by counting the degrees, and
+ * the edges are placed in them in parallel and then sorted. Each item takes
+ * its own reference to its label's list. */
+Graph *buildGraph(int nodes, int edges, const bool *roots, const int *node_labels,
+                  const int *edge_labels, const int *sources, const int *targets,
+                  const HostLabel *labels, int threads);
+
+/* Insert or delete an item in the label class table determined by its current
+ * label. Used by the functions above and by the graph backtracking code, which
+ * adds and removes items from the graph's arrays manually. */
+void addToNodeClassTable(Graph *graph, int index);
+void removeFromNodeClassTable(Graph *graph, int index);
+void addToEdgeClassTable(Graph *graph, int index);
+void removeFromEdgeClassTable(Graph *graph, int index);
+
+/* Insert or delete an edge in the incidence arrays of its source and target
+ * and update their degrees. An edge is removed by moving the last edge of each
+ * array into its slot. Used by addEdge, removeEdge and the graph backtracking
+ * code. */
+void addIncidentEdge(Graph *graph, int index);
+void removeIncidentEdge(Graph *graph, int index);
+
+/* Builds the adjacency index of the graph. From then on the index is maintained
+ * by addEdge, removeEdge and the graph backtracking code. */
+void enableAdjacencyIndex(Graph *graph);
+void addToAdjacencyIndex(Graph *graph, int index);
+void removeFromAdjacencyIndex(Graph *graph, int index);
+
+/* Builds the node columns of the graph from its node array. From then on the
+ * columns are maintained by the functions above and the graph backtracking
+ * code, which calls updateNodeColumns after changing a node manually. Matched
+ * flags must be changed with setMatchedNodeFlag and resetMatchedNodeFlag. */
+void enableNodeColumns(Graph *graph);
+void updateNodeColumns(Graph *graph, int index);
+
+/* Constraints on the candidate host nodes of a rule node, checked against the
+ * node columns. mark is -1 for the any mark, which matches every non-zero mark.
+ * A candidate has at least indegree incoming and outdegree outgoing edges, and
+ * at least degree incident edges in total, or exactly degree if exact_degree
+ * is set. */
+typedef struct NodeFilter {
+   int mark;
+   int32_t indegree, outdegree, degree;
+   bool exact_degree;
+} NodeFilter;
+
+/* Returns a bitmask of the unmatched nodes with indices 64 * block to 
+ * 64 * block + 63 that satisfy the filter. Bit i refers to node 64 * block + i.
+ * Vectorised with AVX2 or SSE2 when the processor supports them. */
+uint64_t filterNodeColumns(Graph *graph, int block, const NodeFilter *filter);
 
 /* =========================
  * Node and Edge Definitions
@@ -114,46 +366,106 @@ typedef struct Node {
    bool root;
    HostLabel label;
    int outdegree, indegree;
-   int first_out_edge, second_out_edge;
-   int first_in_edge, second_in_edge;
-   /* Dynamic integer arrays for the node's outgoing and incoming edges. */
+   /* Dynamic integer arrays for the node's outgoing and incoming edges. The
+    * arrays are kept free of holes: the first outdegree (indegree) items are
+    * exactly the indices of the node's outgoing (incoming) edges. */
    IntArray out_edges, in_edges;
-   bool matched;
+   /* The node's position in its label class table. */
+   int class_position;
+   /* The root node's position in the root node array of its mark, or -1 if the
+    * node is not a root. */
+   int root_position;
+   /* See match_epoch in the definition of Graph. */
+   uint64_t matched_epoch;
 } Node;
 
 extern struct Node dummy_node;
 
-typedef struct RootNodes {
-   int index;
-   struct RootNodes *next;
-} RootNodes;
+typedef struct NodeChunk {
+   /* The number of graphs whose node array holds the chunk. */
+   int references;
+   Node items[GRAPH_CHUNK_SIZE];
+   /* The print keys of the items of a reordered graph (see reorderGraph). */
+   int keys[GRAPH_CHUNK_SIZE];
+} NodeChunk;
 
 typedef struct Edge {
    int index;
+   /* The edge's position in its label class table. */
+   int class_position;
    HostLabel label;
    int source, target;
-   bool matched;
+   /* The edge's positions in the out_edges array of its source and in the
+    * in_edges array of its target. Used to remove the edge from those arrays
+    * in constant time. */
+   int source_position, target_position;
+   uint64_t matched_epoch;
 } Edge;
 
 extern struct Edge dummy_edge;
 
+typedef struct EdgeChunk {
+   int references;
+   Edge items[GRAPH_CHUNK_SIZE];
+   int keys[GRAPH_CHUNK_SIZE];
+} EdgeChunk;
+
 /* ========================
  * Graph Querying Functions
  * ======================== */
 Node *getNode(Graph *graph, int index);
 Edge *getEdge(Graph *graph, int index);
-RootNodes *getRootNodeList(Graph *graph);
-
-/* Called with a positive integer n. The node structures store two outedge indices
- * and two inedge indices. More incident edges are placed in a dynamic array.
- * Pass n = 0 to get the node's first incident edge.
- * Pass n = 1 to get the node's second incident edge.
- * Pass n >= 2 to get the (n-2)th incident edge in the appropriate array. 
- * Designed for iteration e.g. 
- * for(i = 0; i < n->out_edges.size + 2; i++) getNthOutEdge(g, n, i); 
- * I'm sure there's a nicer way to do this... */
+/* Return the item for modification, first copying its chunk if the chunk is
+ * shared with another graph. Pointers returned by getNode and getEdge must not
+ * be used to modify anything other than the matched flags, which are transient
+ * and may be changed in a shared chunk. */
+Node *getWritableNode(Graph *graph, int index);
+Edge *getWritableEdge(Graph *graph, int index);
+/* Return the print key of the item at the given index, or -1 if it has none. */
+int getNodeKey(Graph *graph, int index);
+int getEdgeKey(Graph *graph, int index);
+/* Returns the indices of the root nodes with the given mark. */
+IntArray *getRootNodes(Graph *graph, MarkType mark);
+/* Returns the label class table of nodes (edges) with the given mark and
+ * label class. */
+IntArray *getNodeClassTable(Graph *graph, MarkType mark, LabelClass label_class);
+IntArray *getEdgeClassTable(Graph *graph, MarkType mark, LabelClass label_class);
+/* Returns the indices of the edges from source to target, or NULL if there
+ * are none. Requires the graph's adjacency index. */
+IntArray *getEdgesBetween(Graph *graph, int source, int target);
+
+/* Returns the nth outgoing (incoming) edge of the node, where
+ * 0 <= n < node->outdegree (node->indegree). */
 Edge *getNthOutEdge(Graph *graph, Node *node, int n);
 Edge *getNthInEdge(Graph *graph, Node *node, int n);
+
+/* Iterate over the outgoing (incoming) edges of a node. edge is an Edge pointer
+ * and counter an int, both declared by the caller. The incident edges of the
+ * node must not be added or removed in the loop body. Example:
+ * Edge *edge; int counter;
+ * forEachOutEdge(graph, node, edge, counter) printf("%d\n", edge->target); */
+#define forEachOutEdge(graph, node, edge, counter) \
+   for((counter) = 0; (counter) < (node)->outdegree && \
+       ((edge) = getEdge(graph, (node)->out_edges.items[counter]), true); \
+       (counter)++)
+
+#define forEachInEdge(graph, node, edge, counter) \
+   for((counter) = 0; (counter) < (node)->indegree && \
+       ((edge) = getEdge(graph, (node)->in_edges.items[counter]), true); \
+       (counter)++)
+
+/* Returns the incident edge of the node at position *counter of the sequence of
+ * its outgoing edges followed by its incoming edges, or NULL if *counter is past
+ * the end. A loop is in both edge lists of its node: it is returned only as an
+ * outgoing edge, and *counter is advanced past its position in the incoming
+ * edges. */
+Edge *getIncidentEdge(Graph *graph, Node *node, int *counter);
+
+/* Iterate over the incident edges of a node in a single pass, each edge once.
+ * The same conditions as forEachOutEdge apply. */
+#define forEachIncidentEdge(graph, node, edge, counter) \
+   for((counter) = 0; ((edge) = getIncidentEdge(graph, node, &(counter))) != NULL; \
+       (counter)++)
 Node *getSource(Graph *graph, Edge *edge); 
 Node *getTarget(Graph *graph, Edge *edge);
 HostLabel getNodeLabel(Graph *graph, int index);
@@ -161,7 +473,13 @@ HostLabel getEdgeLabel(Graph *graph, int index);
 int getIndegree(Graph *graph, int index);
 int getOutdegree(Graph *graph, int index);
 
+/* Prints the graph in the text format of host graphs. The output is formatted
+ * in a user-space buffer and written to the file in large blocks. */
 void printGraph(Graph *graph, FILE *file);
+/* Prints the number of nodes, edges and root nodes of the graph and the size
+ * of each non-empty label class table. The output is read by the compiler's
+ * cost-based searchplan generator. */
+void printGraphStatistics(Graph *graph, FILE *file);
 void freeGraph(Graph *graph);
 
 #endif /* INC_GRAPH_H */
@@ -15,14 +15,86 @@
 
 #include "graphStacks.h"
 
+/* The graph change stack is a byte log. Each change is stored as a record of
+ * its natural size: the fields of the change, packed without padding, followed
+ * by a tag byte whose low four bits hold the GraphChangeType and whose high
+ * four bits hold the change's boolean flags. The tag is the last byte of the
+ * record so that the log can be read backwards from its top. */
 typedef struct GraphChangeStack {
    int size;
    int capacity;
-   GraphChange *stack;
+   unsigned char *log;
 } GraphChangeStack;
 
-GraphChangeStack *graph_change_stack = NULL;
-int graph_change_count = 0;
+__thread GraphChangeStack *graph_change_stack = NULL;
+__thread int graph_change_count = 0;
+
+/* The number of bytes a record of each GraphChangeType holds before its tag.
+ * A packed label is its mark byte, its length and its list pointer. */
+#define PACKED_LABEL_SIZE (1 + sizeof(int) + sizeof(HostList *))
+static const int change_size[] = {
+   sizeof(int),                         /* ADDED_NODE */
+   sizeof(int),                         /* ADDED_EDGE */
+   sizeof(int) + PACKED_LABEL_SIZE,     /* REMOVED_NODE */
+   3 * sizeof(int) + PACKED_LABEL_SIZE, /* REMOVED_EDGE */
+   sizeof(int) + PACKED_LABEL_SIZE,     /* RELABELLED_NODE */
+   sizeof(int) + PACKED_LABEL_SIZE,     /* RELABELLED_EDGE */
+   sizeof(int) + 1,                     /* REMARKED_NODE */
+   sizeof(int) + 1,                     /* REMARKED_EDGE */
+   sizeof(int)                          /* CHANGED_ROOT_NODE */
+};
+
+#define HOLE_FLAG 0x10
+#define ROOT_FLAG 0x20
+
+/* Relabellings and re-markings are coalesced: a change to the label of an item
+ * is not recorded if undoing the changes recorded since the last restore point
+ * already restores that label, namely if the item has been relabelled since
+ * then, or re-marked and the new change is also a re-marking. Undo then skips
+ * the intermediate labels, which no other undo operation depends on.
+ * Each item has a stamp recording the epoch of its last recorded relabelling
+ * or re-marking (stamp >> 1) and whether it was a relabelling (stamp & 1).
+ * The epoch advances whenever a restore point is taken or the log shrinks, which
+ * invalidates all stamps at once. */
+static __thread unsigned change_epoch = 1;
+static __thread unsigned *node_stamps = NULL, *edge_stamps = NULL;
+static __thread int node_stamps_capacity = 0, edge_stamps_capacity = 0;
+
+static void newChangeEpoch(void)
+{
+   change_epoch++;
+   /* Reset the stamps before the epoch wraps around in the stamp's 31 bits. */
+   if(change_epoch == 1u << 31)
+   {
+      if(node_stamps != NULL) memset(node_stamps, 0, node_stamps_capacity * sizeof(unsigned));
+      if(edge_stamps != NULL) memset(edge_stamps, 0, edge_stamps_capacity * sizeof(unsigned));
+      change_epoch = 1;
+   }
+}
+
+/* Returns true if the relabelling (relabel is true) or re-marking of the item
+ * with the passed index need not be recorded. Otherwise the item is stamped
+ * and false is returned. */
+static bool coalesceChange(unsigned **stamps, int *capacity, int index, bool relabel)
+{
+   if(index >= *capacity)
+   {
+      int old_capacity = *capacity;
+      *capacity = old_capacity == 0 ? 64 : old_capacity;
+      while(*capacity <= index) *capacity *= 2;
+      *stamps = realloc(*stamps, *capacity * sizeof(unsigned));
+      if(*stamps == NULL)
+      {
+         print_to_log("Error (coalesceChange): malloc failure.\n");
+         exit(1);
+      }
+      memset(*stamps + old_capacity, 0, (*capacity - old_capacity) * sizeof(unsigned));
+   }
+   unsigned stamp = (*stamps)[index];
+   if(stamp >> 1 == change_epoch && ((stamp & 1) || !relabel)) return true;
+   (*stamps)[index] = change_epoch << 1 | (relabel ? 1 : 0);
+   return false;
+}
 
 static void makeGraphChangeStack(int initial_capacity)
 {
@@ -34,8 +106,8 @@ static void makeGraphChangeStack(int initial_capacity)
    }
    stack->size = 0;
    stack->capacity = initial_capacity;
-   stack->stack = calloc(initial_capacity, sizeof(GraphChange)); 
-   if(stack->stack == NULL)
+   stack->log = malloc(initial_capacity); 
+   if(stack->log == NULL)
    {
       print_to_log("Error (makeGraphChangeStack): malloc failure.\n");
       exit(1);
@@ -46,146 +118,221 @@ static void makeGraphChangeStack(int initial_capacity)
 static void growGraphChangeStack(void)
 {
    graph_change_stack->capacity *= 2;
-   graph_change_stack->stack = realloc(graph_change_stack->stack,
-                                       graph_change_stack->capacity * sizeof(GraphChange)); 
-   if(graph_change_stack->stack == NULL)
+   graph_change_stack->log = realloc(graph_change_stack->log, graph_change_stack->capacity); 
+   if(graph_change_stack->log == NULL)
    {
       print_to_log("Error (growGraphChangeStack): malloc failure.\n");
       exit(1);
    }
 }
 
-static void pushGraphChange(GraphChange change)
+/* Reserves space for a record of the given type at the top of the log and
+ * writes its tag. Returns a pointer to the start of the record, to which the
+ * caller writes the record's fields in order. */
+static unsigned char *pushGraphChange(GraphChangeType type, int flags)
 {
-   if(graph_change_stack == NULL) makeGraphChangeStack(128);
-   else if(graph_change_stack->size >= graph_change_stack->capacity) growGraphChangeStack();
-   graph_change_stack->stack[graph_change_stack->size++] = change;
+   int size = change_size[type] + 1;
+   if(graph_change_stack == NULL) makeGraphChangeStack(1024);
+   while(graph_change_stack->size + size > graph_change_stack->capacity) growGraphChangeStack();
+   unsigned char *record = graph_change_stack->log + graph_change_stack->size;
+   graph_change_stack->size += size;
+   record[size - 1] = (unsigned char)(type | flags);
    graph_change_count++;
+   return record;
+}
+
+static unsigned char *packInt(unsigned char *field, int value)
+{
+   memcpy(field, &value, sizeof(int));
+   return field + sizeof(int);
+}
+
+static unsigned char *packLabel(unsigned char *field, HostLabel label)
+{
+   *field++ = (unsigned char)label.mark;
+   field = packInt(field, label.length);
+   memcpy(field, &(label.list), sizeof(HostList *));
+   return field + sizeof(HostList *);
+}
+
+static const unsigned char *unpackInt(const unsigned char *field, int *value)
+{
+   memcpy(value, field, sizeof(int));
+   return field + sizeof(int);
 }
 
+static const unsigned char *unpackLabel(const unsigned char *field, HostLabel *label)
+{
+   label->mark = (MarkType)*field++;
+   field = unpackInt(field, &(label->length));
+   memcpy(&(label->list), field, sizeof(HostList *));
+   return field + sizeof(HostList *);
+}
+
+/* Removes the top record from the log and returns it decoded. */
 static GraphChange pullGraphChange(void)
 {
    assert(graph_change_stack != NULL);
    assert(graph_change_stack->size > 0);
-   return graph_change_stack->stack[--graph_change_stack->size];
+   unsigned char tag = graph_change_stack->log[graph_change_stack->size - 1];
+   GraphChange change = { .type = (GraphChangeType)(tag & 0x0f) };
+   graph_change_stack->size -= change_size[change.type] + 1;
+   const unsigned char *field = graph_change_stack->log + graph_change_stack->size;
+   switch(change.type)
+   {
+      case ADDED_NODE:
+           unpackInt(field, &(change.added_node.index));
+           change.added_node.hole_filled = tag & HOLE_FLAG;
+           break;
+
+      case ADDED_EDGE:
+           unpackInt(field, &(change.added_edge.index));
+           change.added_edge.hole_filled = tag & HOLE_FLAG;
+           break;
+
+      case REMOVED_NODE:
+           field = unpackInt(field, &(change.removed_node.index));
+           unpackLabel(field, &(change.removed_node.label));
+           change.removed_node.root = tag & ROOT_FLAG;
+           change.removed_node.hole_created = tag & HOLE_FLAG;
+           break;
+
+      case REMOVED_EDGE:
+           field = unpackInt(field, &(change.removed_edge.index));
+           field = unpackInt(field, &(change.removed_edge.source));
+           field = unpackInt(field, &(change.removed_edge.target));
+           unpackLabel(field, &(change.removed_edge.label));
+           change.removed_edge.hole_created = tag & HOLE_FLAG;
+           break;
+
+      case RELABELLED_NODE:
+           field = unpackInt(field, &(change.relabelled_node.index));
+           unpackLabel(field, &(change.relabelled_node.old_label));
+           break;
+
+      case RELABELLED_EDGE:
+           field = unpackInt(field, &(change.relabelled_edge.index));
+           unpackLabel(field, &(change.relabelled_edge.old_label));
+           break;
+
+      case REMARKED_NODE:
+           field = unpackInt(field, &(change.remarked_node.index));
+           change.remarked_node.old_mark = (MarkType)*field;
+           break;
+
+      case REMARKED_EDGE:
+           field = unpackInt(field, &(change.remarked_edge.index));
+           change.remarked_edge.old_mark = (MarkType)*field;
+           break;
+
+      case CHANGED_ROOT_NODE:
+           unpackInt(field, &(change.changed_root_index));
+           break;
+   }
+   return change;
 }
 
 int topOfGraphChangeStack(void)
 {
-   return graph_change_stack->size;
+   newChangeEpoch();
+   return graph_change_stack == NULL ? 0 : graph_change_stack->size;
+}
+
+int graphChangeStackSize(void)
+{
+   return graph_change_stack == NULL ? 0 : graph_change_stack->size;
 }
 
 void pushAddedNode(int index, bool hole_filled)
 {
-   GraphChange change;
-   change.type = ADDED_NODE;
-   change.added_node.index = index;
-   change.added_node.hole_filled = hole_filled;
-   pushGraphChange(change);
+   packInt(pushGraphChange(ADDED_NODE, hole_filled ? HOLE_FLAG : 0), index);
 }
    
 void pushAddedEdge(int index, bool hole_filled)
 {
-   GraphChange change;
-   change.type = ADDED_EDGE;
-   change.added_edge.index = index;
-   change.added_edge.hole_filled = hole_filled;
-   pushGraphChange(change);
+   packInt(pushGraphChange(ADDED_EDGE, hole_filled ? HOLE_FLAG : 0), index);
 }
 
 void pushRemovedNode(bool root, HostLabel label, int index, bool hole_created)
 {
-   GraphChange change;
-   change.type = REMOVED_NODE;
-   change.removed_node.root = root;
-   change.removed_node.label = label;
    /* Keep a record of the list as the removal of the node could free this list
-    * or remove its bucket from the hash table. */
+    * or remove it from the hash table. */
    #ifdef LIST_HASHING
       addHostList(label.list);
    #else
-      change.removed_node.label.list = copyHostList(label.list);
+      label.list = copyHostList(label.list);
    #endif
-   change.removed_node.index = index;
-   change.removed_node.hole_created = hole_created;
-   pushGraphChange(change);
+   unsigned char *field = pushGraphChange(REMOVED_NODE, (root ? ROOT_FLAG : 0) |
+                                                        (hole_created ? HOLE_FLAG : 0));
+   field = packInt(field, index);
+   packLabel(field, label);
 }
 
 void pushRemovedEdge(HostLabel label, int source, int target, int index, bool hole_created)
 {
-   GraphChange change;
-   change.type = REMOVED_EDGE;
-   change.removed_edge.label = label;
    /* Keep a record of the list as the removal of the node could free this list
-    * or remove its bucket from the hash table. */
+    * or remove it from the hash table. */
    #ifdef LIST_HASHING
       addHostList(label.list);
    #else
-      change.removed_edge.label.list = copyHostList(label.list);
+      label.list = copyHostList(label.list);
    #endif
-   change.removed_edge.source = source;
-   change.removed_edge.target = target;
-   change.removed_edge.index = index;
-   change.removed_edge.hole_created = hole_created;
-   pushGraphChange(change);
+   unsigned char *field = pushGraphChange(REMOVED_EDGE, hole_created ? HOLE_FLAG : 0);
+   field = packInt(field, index);
+   field = packInt(field, source);
+   field = packInt(field, target);
+   packLabel(field, label);
 }
 
 void pushRelabelledNode(int index, HostLabel old_label)
 {
-   GraphChange change;
-   change.type = RELABELLED_NODE;
-   change.relabelled_node.index = index;
-   change.relabelled_node.old_label = old_label;
+   if(coalesceChange(&node_stamps, &node_stamps_capacity, index, true)) return;
    /* Keep a record of the list as the relabelling of the node could free this
-    * list or remove its bucket from the hash table. */
+    * list or remove it from the hash table. */
    #ifdef LIST_HASHING
       addHostList(old_label.list);
    #else
-      change.relabelled_node.old_label.list = copyHostList(old_label.list);
+      old_label.list = copyHostList(old_label.list);
    #endif
-   pushGraphChange(change);
+   unsigned char *field = pushGraphChange(RELABELLED_NODE, 0);
+   field = packInt(field, index);
+   packLabel(field, old_label);
 }
 
 void pushRelabelledEdge(int index, HostLabel old_label)
 {
-   GraphChange change;
-   change.type = RELABELLED_EDGE;
-   change.relabelled_edge.index = index;
-   change.relabelled_edge.old_label = old_label;
+   if(coalesceChange(&edge_stamps, &edge_stamps_capacity, index, true)) return;
    /* Keep a record of the list as the relabelling of the edge could free this
-    * list or remove its bucket from the hash table. */
+    * list or remove it from the hash table. */
    #ifdef LIST_HASHING
       addHostList(old_label.list);
    #else
-      change.relabelled_edge.old_label.list = copyHostList(old_label.list);
+      old_label.list = copyHostList(old_label.list);
    #endif
-   pushGraphChange(change);
+   unsigned char *field = pushGraphChange(RELABELLED_EDGE, 0);
+   field = packInt(field, index);
+   packLabel(field, old_label);
 }
 
 void pushRemarkedNode(int index, MarkType old_mark)
 {
-   GraphChange change;
-   change.type = REMARKED_NODE;
-   change.remarked_node.index = index;
-   change.remarked_node.old_mark = old_mark;
-   pushGraphChange(change);
+   if(coalesceChange(&node_stamps, &node_stamps_capacity, index, false)) return;
+   unsigned char *field = pushGraphChange(REMARKED_NODE, 0);
+   field = packInt(field, index);
+   *field = (unsigned char)old_mark;
 }
 
 void pushRemarkedEdge(int index, MarkType old_mark)
 {
-   GraphChange change;
-   change.type = REMARKED_EDGE;
-   change.remarked_edge.index = index;
-   change.remarked_edge.old_mark = old_mark;
-   pushGraphChange(change);
+   if(coalesceChange(&edge_stamps, &edge_stamps_capacity, index, false)) return;
+   unsigned char *field = pushGraphChange(REMARKED_EDGE, 0);
+   field = packInt(field, index);
+   *field = (unsigned char)old_mark;
 }
 
 void pushChangedRootNode(int index)
 {
-   GraphChange change;
-   change.type = CHANGED_ROOT_NODE; 
-   change.changed_root_index = index;
-   pushGraphChange(change);
+   packInt(pushGraphChange(CHANGED_ROOT_NODE, 0), index);
 }
   
 /* The reversal of addition and removal of graph items is done manually as opposed
@@ -197,6 +344,7 @@ void undoChanges(Graph *graph, int restore_point)
 {
    if(graph_change_stack == NULL) return;
    assert(restore_point >= 0);
+   newChangeEpoch();
    while(graph_change_stack->size > restore_point)
    { 
       GraphChange change = pullGraphChange();
@@ -205,18 +353,20 @@ void undoChanges(Graph *graph, int restore_point)
          case ADDED_NODE:
          {
               int index = change.added_node.index;
-              Node *node = getNode(graph, index);  
+              Node *node = getWritableNode(graph, index);  
 
               if(node->out_edges.items != NULL) free(node->out_edges.items);
               if(node->in_edges.items != NULL) free(node->in_edges.items); 
               if(node->root) removeRootNode(graph, index);
+              removeFromNodeClassTable(graph, index);
               removeHostList(node->label.list);
 
+              *node = dummy_node;
               if(change.added_node.hole_filled) 
                  graph->nodes.holes.items[graph->nodes.holes.size++] = index;
               else graph->nodes.size--;
 
-              graph->nodes.items[index] = dummy_node;
+              updateNodeColumns(graph, index);
               graph->number_of_nodes--;
               break;
          }
@@ -224,26 +374,18 @@ void undoChanges(Graph *graph, int restore_point)
          case ADDED_EDGE:
          {
               int index = change.added_edge.index;
-              Edge *edge = getEdge(graph, index);
-
-              Node *source = getNode(graph, edge->source);
-              if(source->first_out_edge == index) source->first_out_edge = -1;
-              else if(source->second_out_edge == index) source->second_out_edge = -1;
-              else removeFromIntArray(&(source->out_edges), index);
-              source->outdegree--;
-
-              Node *target = getNode(graph, edge->target);
-              if(target->first_in_edge == index) target->first_in_edge = -1;
-              else if(target->second_in_edge == index) target->second_in_edge = -1;
-              else removeFromIntArray(&(target->in_edges), index);
-              target->indegree--;
+              Edge *edge = getWritableEdge(graph, index);
+
+              removeIncidentEdge(graph, index);
+              removeFromEdgeClassTable(graph, index);
+              removeFromAdjacencyIndex(graph, index);
               removeHostList(edge->label.list);
 
+              *edge = dummy_edge;
               if(change.added_edge.hole_filled)
                  graph->edges.holes.items[graph->edges.holes.size++] = index;
               else graph->edges.size--;
 
-              graph->edges.items[index] = dummy_edge;
               graph->number_of_edges--;
               break;
          }
@@ -253,17 +395,15 @@ void undoChanges(Graph *graph, int restore_point)
               node.index = change.removed_node.index;
               node.root = change.removed_node.root;
               node.label = change.removed_node.label;
-              node.first_out_edge = -1;
-              node.second_out_edge = -1;
-              node.first_in_edge = -1;
-              node.second_in_edge = -1;
               node.out_edges = makeIntArray(0);
               node.in_edges = makeIntArray(0);
               node.outdegree = 0;
               node.indegree = 0;
-	      node.matched = false;
+              node.class_position = -1;
+              node.root_position = -1;
+              node.matched_epoch = 0;
 
-              graph->nodes.items[change.removed_node.index] = node;
+              *getWritableNode(graph, change.removed_node.index) = node;
               /* If the removal of the node created a hole, manually remove it from
                * the holes array. */
               if(change.removed_node.hole_created)
@@ -272,6 +412,8 @@ void undoChanges(Graph *graph, int restore_point)
                  graph->nodes.holes.items[graph->nodes.holes.size] = -1;
               }
               else graph->nodes.size++;
+              addToNodeClassTable(graph, change.removed_node.index);
+              updateNodeColumns(graph, change.removed_node.index);
               if(node.root) addRootNode(graph, change.removed_node.index);
               graph->number_of_nodes++;
               break;
@@ -283,23 +425,12 @@ void undoChanges(Graph *graph, int restore_point)
               edge.label = change.removed_edge.label;
               edge.source = change.removed_edge.source;
               edge.target = change.removed_edge.target;
-	      edge.matched = false;
+              edge.source_position = -1;
+              edge.target_position = -1;
+              edge.class_position = -1;
+              edge.matched_epoch = 0;
  
-              graph->edges.items[change.removed_edge.index] = edge;
-
-              Node *source = getNode(graph, change.removed_edge.source);
-              assert(source != NULL);
-              if(source->first_out_edge == -1) source->first_out_edge = edge.index;
-              else if(source->second_out_edge == -1) source->second_out_edge = edge.index;
-              else addToIntArray(&(source->out_edges), edge.index);
-              source->outdegree++;
-
-              Node *target = getNode(graph, change.removed_edge.target);
-              assert(target != NULL);
-              if(target->first_in_edge == -1) target->first_in_edge = edge.index;
-              else if(target->second_in_edge == -1) target->second_in_edge = edge.index;
-              else addToIntArray(&(target->in_edges), edge.index);
-              target->indegree++;
+              *getWritableEdge(graph, change.removed_edge.index) = edge;
               /* If the removal of the edge created a hole, manually remove it from
                * the holes array. */
               if(change.removed_edge.hole_created)
@@ -308,6 +439,9 @@ void undoChanges(Graph *graph, int restore_point)
                  graph->edges.holes.items[graph->edges.holes.size] = -1;
               }
               else graph->edges.size++;
+              addIncidentEdge(graph, change.removed_edge.index);
+              addToEdgeClassTable(graph, change.removed_edge.index);
+              addToAdjacencyIndex(graph, change.removed_edge.index);
               graph->number_of_edges++;
               break;
          }
@@ -345,6 +479,8 @@ static void freeGraphChange(GraphChange change)
    {
       case ADDED_NODE:
       case ADDED_EDGE:
+      case REMARKED_NODE:
+      case REMARKED_EDGE:
       case CHANGED_ROOT_NODE:
            break;
 
@@ -374,6 +510,7 @@ static void freeGraphChange(GraphChange change)
 void discardChanges(int restore_point)
 {
    if(graph_change_stack == NULL) return;
+   newChangeEpoch();
    while(graph_change_stack->size > restore_point) 
    {
       GraphChange change = pullGraphChange();
@@ -387,136 +524,40 @@ void freeGraphChangeStack(void)
    #ifndef LIST_HASHING
       discardChanges(0);
    #endif
-   free(graph_change_stack->stack);
+   free(graph_change_stack->log);
    free(graph_change_stack);
+   graph_change_stack = NULL;
+   free(node_stamps);
+   free(edge_stamps);
+   node_stamps = edge_stamps = NULL;
+   node_stamps_capacity = edge_stamps_capacity = 0;
 }
 
 
-Graph **graph_stack = NULL;
-int graph_stack_index = 0;
-int graph_copy_count = 0;
+__thread Graph **graph_stack = NULL;
+__thread int graph_stack_index = 0;
+__thread int graph_stack_capacity = 0;
+__thread int graph_copy_count = 0;
 
-void copyGraph(Graph *graph)
+int copyGraph(Graph *graph)
 { 
-   printf("Copying host graph.\n");
-   if(graph_stack_index == GRAPH_STACK_SIZE)
+   if(graph_stack_index == graph_stack_capacity)
    {
-      print_to_log("Error: copyGraph called with a full graph stack.\n");
-      return;
-   }
-   if(graph_stack == NULL) graph_stack = calloc(GRAPH_STACK_SIZE, sizeof(Graph*));
-   if(graph_stack == NULL)
-   {
-      print_to_log("Error (copyGraph): malloc failure.\n");
-      exit(1);
-   }
-   Graph *graph_copy = newGraph(graph->nodes.capacity, graph->edges.capacity); 
-
-   graph_copy->nodes.size = graph->nodes.size;
-   graph_copy->nodes.capacity = graph->nodes.capacity;
-   memcpy(graph_copy->nodes.items, graph->nodes.items, graph->nodes.capacity * sizeof(Node));
-
-   graph_copy->edges.size = graph->edges.size;
-   graph_copy->edges.capacity = graph->edges.capacity;
-   memcpy(graph_copy->edges.items, graph->edges.items, graph->edges.capacity * sizeof(Edge));
-
-   /* newGraph allocates an initial holes array of size 16. This may be smaller
-    * then the holes array in the original graph. */
-   if(graph_copy->nodes.holes.capacity < graph->nodes.holes.capacity)
-   {
-      free(graph_copy->nodes.holes.items);
-      graph_copy->nodes.holes.items = calloc(graph->nodes.holes.capacity, sizeof(int));
-      if(graph_copy->nodes.holes.items == NULL)
+      graph_stack_capacity = graph_stack_capacity == 0 ? 4 : 2 * graph_stack_capacity;
+      graph_stack = realloc(graph_stack, graph_stack_capacity * sizeof(Graph *));
+      if(graph_stack == NULL)
       {
          print_to_log("Error (copyGraph): malloc failure.\n");
          exit(1);
       }
    }
-   graph_copy->nodes.holes.size = graph->nodes.holes.size;
-   graph_copy->nodes.holes.capacity = graph->nodes.holes.capacity;
-   memcpy(graph_copy->nodes.holes.items, graph->nodes.holes.items,
-          graph->nodes.holes.capacity * sizeof(int));
-
-   if(graph_copy->edges.holes.capacity < graph->edges.holes.capacity)
-   {
-      free(graph_copy->edges.holes.items);
-      graph_copy->edges.holes.items = calloc(graph->edges.holes.capacity, sizeof(int));
-      if(graph_copy->edges.holes.items == NULL)
-      {
-         print_to_log("Error (copyGraph): malloc failure.\n");
-         exit(1);
-      }
-   }
-   graph_copy->edges.holes.size = graph->edges.holes.size;
-   graph_copy->edges.holes.capacity = graph->edges.holes.capacity;
-   memcpy(graph_copy->edges.holes.items, graph->edges.holes.items,
-          graph->edges.holes.capacity * sizeof(int));
-   
-   graph_copy->number_of_nodes = graph->number_of_nodes;
-   graph_copy->number_of_edges = graph->number_of_edges;
-   graph_copy->root_nodes = NULL;
- 
-   int index;
-   for(index = 0; index < graph_copy->nodes.size; index++)
-   {
-      Node *node_copy = getNode(graph_copy, index);
-      /* The entry in the node array may be a dummy node, in which case nothing
-       * needs to be done. This is tested by checking the node's index. */
-      if(node_copy->index >= 0)
-      {
-         Node *node = getNode(graph, index);
-         /* If necessary, copy the edges arrays of the original node. */
-         if(node->out_edges.items != NULL)
-         {
-            node_copy->out_edges.items = calloc(node_copy->out_edges.size, sizeof(int));
-            if(node_copy->out_edges.items == NULL)
-            {
-               print_to_log("Error: (copyGraph): malloc failure.\n");
-               exit(1);
-            }
-            memcpy(node_copy->out_edges.items, node->out_edges.items,
-                   node_copy->out_edges.size * sizeof(int));
-         }
-         if(node->in_edges.items != NULL)
-         {
-            node_copy->in_edges.items = calloc(node_copy->in_edges.size, sizeof(int));
-            if(node_copy->in_edges.items == NULL)
-            {
-               print_to_log("Error: (copyGraph): malloc failure.\n");
-               exit(1);
-            }
-            memcpy(node_copy->in_edges.items, node->in_edges.items,
-                   node_copy->in_edges.size * sizeof(int));
-         }
-         /* Populate the root nodes list. */
-         if(node_copy->root) addRootNode(graph_copy, node_copy->index);
-         #ifdef LIST_HASHING
-            addHostList(node->label.list);
-         #else
-            node_copy->label.list = copyHostList(node->label.list);
-         #endif
-      }
-   }
-   for(index = 0; index < graph_copy->edges.size; index++)
-   {
-      Edge *edge_copy = getEdge(graph_copy, index);
-      if(edge_copy->index >= 0)
-      {
-         HostLabel label = getEdgeLabel(graph, index);
-         #ifdef LIST_HASHING
-            addHostList(label.list);
-         #else
-            edge_copy->label.list = copyHostList(label.list);
-         #endif
-      }
-   }
-   graph_stack[graph_stack_index++] = graph_copy;
+   graph_stack[graph_stack_index] = snapshotGraph(graph);
    graph_copy_count++;
+   return graph_stack_index++;
 }
 
 Graph *revertGraph(Graph *current_graph, int restore_point)
 {
-   printf("Popping copy of host graph.\n");
    if(graph_stack == NULL) return NULL;
    assert(graph_stack_index >= restore_point);
    if(graph_stack_index == restore_point) return current_graph;
@@ -543,5 +584,6 @@ void freeGraphStack(void)
    if(graph_stack == NULL) return;
    discardGraphs(0);
    free(graph_stack);
+   graph_stack = NULL;
+   graph_stack_capacity = 0;
 }
-
@@ -21,7 +21,8 @@
 
   Data structures and functions for graph backtracking. There are two types
   of graph backtracking: 
-  (1) A complete memory copy of the working graph.
+  (1) A snapshot of the working graph, which shares the unmodified parts of
+      the graph's storage with the working graph (see snapshotGraph).
   (2) A stack of graph changes maintained so that the graph can be rolled back
       if necessary.
 
@@ -30,8 +31,6 @@
 #ifndef INC_GRAPH_STACKS_H
 #define INC_GRAPH_STACKS_H
 
-#define GRAPH_STACK_SIZE 4
-
 #include "common.h"
 #include "graph.h"
 #include "label.h"
@@ -44,7 +43,9 @@
 /* A GraphChange stores the data sufficient to undo a particular graph modification.
  * Specifically, an undo operation must restore the graph to its exact state,
  * which includes the indices of nodes and edges in their arrays and the graph's
- * holes arrays. */
+ * holes arrays. Changes are kept on the graph change stack as packed records of
+ * their natural size and are decoded into a GraphChange when they are undone or
+ * discarded. */
 typedef enum { ADDED_NODE = 0, ADDED_EDGE, REMOVED_NODE, REMOVED_EDGE, 
 	       RELABELLED_NODE, RELABELLED_EDGE, REMARKED_NODE, REMARKED_EDGE,
                CHANGED_ROOT_NODE} GraphChangeType; 
@@ -95,10 +96,16 @@ typedef struct GraphChange
 } GraphChange; 
 
 struct GraphChangeStack;
-extern struct GraphChangeStack *graph_change_stack;
-extern int graph_change_count;
+extern __thread struct GraphChangeStack *graph_change_stack;
+extern __thread int graph_change_count;
 
+/* Returns the position of the top of the stack, to be used as a restore point.
+ * Changes pushed after the call are never coalesced with changes pushed before
+ * it. The push functions do not record a relabelling or re-marking that
+ * undoing back to the last restore point would overwrite anyway. */
 int topOfGraphChangeStack(void);
+/* Returns the size in bytes of the change log, without taking a restore point. */
+int graphChangeStackSize(void);
 void pushAddedNode(int index, bool hole_filled);
 void pushAddedEdge(int index, bool hole_filled);
 void pushRemovedNode(bool root, HostLabel label, int index, bool hole_created);
@@ -113,16 +120,21 @@ void discardChanges(int restore_point);
 void freeGraphChangeStack(void);
 
 
-extern Graph **graph_stack;
-extern int graph_stack_index;
-extern int graph_copy_count;
+/* The graph stack grows as needed. */
+extern __thread Graph **graph_stack;
+extern __thread int graph_stack_index;
+extern __thread int graph_stack_capacity;
+extern __thread int graph_copy_count;
 
-/* Creates a memory copy of the passed graph and pushes it to the graph stack. */
-void copyGraph(Graph *graph);
+/* Pushes a snapshot of the passed graph to the graph stack. Returns the restore
+ * point of the snapshot: its position in the stack, to be passed to revertGraph
+ * or discardGraphs. */
+int copyGraph(Graph *graph);
 
 /* Returns the graph at the stack entry <restore_point> entries from the
  * bottom of the stack. Frees the passed graph unless the restore point
- * refers to the stack's index. */
+ * refers to the stack's index. The pushed snapshot is returned as it is,
+ * so reverting costs no more than freeing the graphs it replaces. */
 Graph *revertGraph(Graph *current_graph, int restore_point);
 void discardGraphs(int depth);
 void freeGraphStack(void);
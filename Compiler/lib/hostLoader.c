@@ -0,0 +1,1955 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#include "hostLoader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* The text of the host graph file is not null-terminated: every read is
+ * bounded by end. */
+typedef struct HostReader {
+   string file_name;
+   const char *text;
+   const char *end;
+   const char *position;
+   /* The line of the file on which text starts, so that errors in a graph
+    * read from a stream are reported at their line in the stream. */
+   int first_line;
+   /* Buffer for the atoms of the label being read. */
+   HostAtom *atoms;
+   int atom_capacity;
+   /* Set for the readers of the parallel loader, whose errors are reported by
+    * the serial loader when it reads the file again. */
+   bool silent;
+} HostReader;
+
+/* Maps the node IDs of the host graph file to the indices of their nodes.
+ * The map is an open-addressing hash table with linear probing, whose size is
+ * a power of two. Empty slots have ID -1: node IDs are non-negative. */
+typedef struct NodeIdSlot {
+   int id;
+   int index;
+} NodeIdSlot;
+
+typedef struct NodeIdMap {
+   int capacity;
+   int size;
+   NodeIdSlot *slots;
+} NodeIdMap;
+
+static NodeIdSlot *makeNodeIdSlots(int capacity)
+{
+   NodeIdSlot *slots = malloc(capacity * sizeof(NodeIdSlot));
+   if(slots == NULL)
+   {
+      print_to_log("Error (makeNodeIdSlots): malloc failure.\n");
+      exit(1);
+   }
+   int index;
+   for(index = 0; index < capacity; index++) slots[index].id = -1;
+   return slots;
+}
+
+static unsigned hashNodeId(int id)
+{
+   return (unsigned)id * 2654435761u;
+}
+
+/* Empties the map and sizes it for the passed number of nodes. The slots are
+ * kept if their number suits the graph. */
+static void prepareNodeIdMap(NodeIdMap *map, int nodes)
+{
+   int capacity = 16;
+   while(capacity < 2 * nodes) capacity *= 2;
+   if(map->slots != NULL && map->capacity >= capacity && map->capacity <= 4 * capacity)
+   {
+      int index;
+      for(index = 0; index < map->capacity; index++) map->slots[index].id = -1;
+   }
+   else
+   {
+      free(map->slots);
+      map->capacity = capacity;
+      map->slots = makeNodeIdSlots(capacity);
+   }
+   map->size = 0;
+}
+
+static void growNodeIdMap(NodeIdMap *map)
+{
+   NodeIdSlot *old_slots = map->slots;
+   int old_capacity = map->capacity, index;
+   map->capacity *= 2;
+   map->slots = makeNodeIdSlots(map->capacity);
+   for(index = 0; index < old_capacity; index++)
+   {
+      if(old_slots[index].id < 0) continue;
+      unsigned slot = hashNodeId(old_slots[index].id) & (map->capacity - 1);
+      while(map->slots[slot].id >= 0) slot = (slot + 1) & (map->capacity - 1);
+      map->slots[slot] = old_slots[index];
+   }
+   free(old_slots);
+}
+
+/* Returns the slot of the passed ID, or the empty slot where it belongs. */
+static NodeIdSlot *findNodeId(NodeIdMap *map, int id)
+{
+   unsigned slot = hashNodeId(id) & (map->capacity - 1);
+   while(map->slots[slot].id >= 0 && map->slots[slot].id != id)
+      slot = (slot + 1) & (map->capacity - 1);
+   return &(map->slots[slot]);
+}
+
+/* The items of a range of the text of a host graph, found by scanItems. */
+typedef struct TextRange {
+   const char *start, *end;
+   /* The opening bracket of the first item of the range and the last '|' of
+    * the range, or NULL if there are none. */
+   const char *first_item, *last_bar;
+   /* The numbers of items in the range and of those before its last '|'. */
+   int items, items_before_bar;
+} TextRange;
+
+/* Counts the items of the range by counting their opening brackets outside
+ * strings and comments. The range must start outside a string or comment,
+ * as it does at the start of the text or of a line. For the whole text of a
+ * host graph, the nodes are the items before the last '|' and the edges
+ * those after it. The count is exact for valid host graphs and only used to
+ * size the graph, or to divide it among the threads of the parallel loader,
+ * which check it. Strings and comments end at the end of a line, so they do
+ * not run past the end of a range that ends at one. */
+static void scanItems(TextRange *range, const char *text_end)
+{
+   range->first_item = range->last_bar = NULL;
+   range->items = range->items_before_bar = 0;
+   const char *position = range->start;
+   while(position < range->end)
+   {
+      char c = *position++;
+      if(c == '"')
+      {
+         while(position < text_end && *position != '"' && *position != '\n') position++;
+         position++;
+      }
+      else if(c == '/' && position < text_end && *position == '/')
+      {
+         while(position < text_end && *position != '\n') position++;
+      }
+      else if(c == '(')
+      {
+         /* Skip the root node marker "(R)". */
+         if(text_end - position >= 2 && position[0] == 'R' && position[1] == ')') position += 2;
+         else
+         {
+            if(range->first_item == NULL) range->first_item = position - 1;
+            range->items++;
+         }
+      }
+      else if(c == '|')
+      {
+         range->last_bar = position - 1;
+         range->items_before_bar = range->items;
+      }
+   }
+}
+
+static bool loaderError(HostReader *reader, const char *message)
+{
+   if(reader->silent) return false;
+   int line = reader->first_line;
+   const char *position;
+   for(position = reader->text; position < reader->position && position < reader->end; position++)
+      if(*position == '\n') line++;
+   fprintf(stderr, "Error (%s, line %d): %s.\n", reader->file_name, line, message);
+   return false;
+}
+
+/* Skips white space and comments. */
+static void skipLayout(HostReader *reader)
+{
+   while(reader->position < reader->end)
+   {
+      char c = *(reader->position);
+      if(c == ' ' || c == '\t' || c == '\r' || c == '\n') reader->position++;
+      else if(c == '/' && reader->end - reader->position >= 2 && reader->position[1] == '/')
+      {
+         while(reader->position < reader->end && *(reader->position) != '\n')
+            reader->position++;
+      }
+      else break;
+   }
+}
+
+/* Skips layout, then consumes the passed character if it comes next. */
+static bool acceptCharacter(HostReader *reader, char c)
+{
+   skipLayout(reader);
+   if(reader->position < reader->end && *(reader->position) == c)
+   {
+      reader->position++;
+      return true;
+   }
+   return false;
+}
+
+static bool expectCharacter(HostReader *reader, char c)
+{
+   if(acceptCharacter(reader, c)) return true;
+   char message[32];
+   if(reader->position >= reader->end) sprintf(message, "expected '%c' before end of file", c);
+   else sprintf(message, "expected '%c'", c);
+   return loaderError(reader, message);
+}
+
+static bool readNumber(HostReader *reader, int *value)
+{
+   skipLayout(reader);
+   if(reader->position >= reader->end || *(reader->position) < '0' ||
+      *(reader->position) > '9') return loaderError(reader, "expected a number");
+   long number = 0;
+   while(reader->position < reader->end && *(reader->position) >= '0' &&
+         *(reader->position) <= '9')
+   {
+      number = 10 * number + (*(reader->position) - '0');
+      if(number > INT_MAX) return loaderError(reader, "number out of range");
+      reader->position++;
+   }
+   *value = (int)number;
+   return true;
+}
+
+/* Consumes and returns the length of the word of letters at the current
+ * position. */
+static int readWord(HostReader *reader, const char **word)
+{
+   skipLayout(reader);
+   *word = reader->position;
+   while(reader->position < reader->end &&
+         ((*(reader->position) >= 'a' && *(reader->position) <= 'z') ||
+          (*(reader->position) >= 'A' && *(reader->position) <= 'Z')))
+      reader->position++;
+   return reader->position - *word;
+}
+
+static bool equalWord(const char *word, int length, const char *keyword)
+{
+   return (int)strlen(keyword) == length && strncmp(word, keyword, length) == 0;
+}
+
+/* Layout information for the editor, <x, y>, is ignored. */
+static bool skipPosition(HostReader *reader)
+{
+   while(reader->position < reader->end && *(reader->position) != '>')
+      reader->position++;
+   return expectCharacter(reader, '>');
+}
+
+static void addAtom(HostReader *reader, int length, HostAtom atom)
+{
+   if(length == reader->atom_capacity)
+   {
+      reader->atom_capacity *= 2;
+      reader->atoms = realloc(reader->atoms, reader->atom_capacity * sizeof(HostAtom));
+      if(reader->atoms == NULL)
+      {
+         print_to_log("Error (addAtom): malloc failure.\n");
+         exit(1);
+      }
+   }
+   reader->atoms[length] = atom;
+}
+
+/* Reads a string atom. Strings are interned directly from the file text. */
+static bool readString(HostReader *reader, HostAtom *atom)
+{
+   const char *start = ++(reader->position);
+   while(reader->position < reader->end && *(reader->position) != '"')
+   {
+      char c = *(reader->position);
+      if(c == '\n') return loaderError(reader, "string continues on new line");
+      if(c < 040 || c > 0176) return loaderError(reader, "invalid character in string");
+      reader->position++;
+   }
+   if(reader->position >= reader->end) return loaderError(reader, "unterminated string");
+   atom->type = 's';
+   atom->str = internSubstring(start, reader->position - start);
+   reader->position++;
+   return true;
+}
+
+static bool readLabel(HostReader *reader, HostLabel *label)
+{
+   int length = 0;
+   do
+   {
+      HostAtom atom;
+      skipLayout(reader);
+      if(reader->position >= reader->end) return loaderError(reader, "expected a label");
+      char c = *(reader->position);
+      if(c == '"')
+      {
+         if(!readString(reader, &atom)) return false;
+      }
+      else if(c == '-')
+      {
+         reader->position++;
+         atom.type = 'i';
+         if(!readNumber(reader, &atom.num)) return false;
+         atom.num = -atom.num;
+      }
+      else if(c >= '0' && c <= '9')
+      {
+         atom.type = 'i';
+         if(!readNumber(reader, &atom.num)) return false;
+      }
+      else
+      {
+         /* The empty list may occur anywhere in a list. */
+         const char *word;
+         int word_length = readWord(reader, &word);
+         if(equalWord(word, word_length, "empty")) continue;
+         return loaderError(reader, "expected a host list");
+      }
+      addAtom(reader, length++, atom);
+   } while(acceptCharacter(reader, ':'));
+
+   MarkType mark = NONE;
+   if(acceptCharacter(reader, '#'))
+   {
+      const char *word;
+      int word_length = readWord(reader, &word);
+      if(equalWord(word, word_length, "red")) mark = RED;
+      else if(equalWord(word, word_length, "green")) mark = GREEN;
+      else if(equalWord(word, word_length, "blue")) mark = BLUE;
+      else if(equalWord(word, word_length, "grey")) mark = GREY;
+      else if(equalWord(word, word_length, "dashed")) mark = DASHED;
+      else return loaderError(reader, "expected a mark");
+   }
+   if(length == 0) *label = makeEmptyLabel(mark);
+   else *label = makeHostLabel(mark, length, makeInternedHostList(reader->atoms, length));
+   return true;
+}
+
+/* Consumes the root node marker "(R)" if it comes next. */
+static bool readRootMarker(HostReader *reader)
+{
+   skipLayout(reader);
+   if(reader->end - reader->position >= 3 && strncmp(reader->position, "(R)", 3) == 0)
+   {
+      reader->position += 3;
+      return true;
+   }
+   return false;
+}
+
+/* Reads the node after its opening bracket. */
+static bool readNode(HostReader *reader, Graph *graph, NodeIdMap *map)
+{
+   int id;
+   if(!readNumber(reader, &id)) return false;
+   bool root = readRootMarker(reader);
+   if(!expectCharacter(reader, ',')) return false;
+   HostLabel label;
+   if(!readLabel(reader, &label)) return false;
+   if(acceptCharacter(reader, '<') && !skipPosition(reader)) return false;
+   if(!expectCharacter(reader, ')')) return false;
+
+   if(2 * (map->size + 1) > map->capacity) growNodeIdMap(map);
+   NodeIdSlot *slot = findNodeId(map, id);
+   if(slot->id >= 0)
+   {
+      removeHostList(label.list);
+      return loaderError(reader, "duplicate node ID");
+   }
+   slot->id = id;
+   slot->index = addNode(graph, root, label);
+   map->size++;
+   return true;
+}
+
+/* Reads the edge after its opening bracket. */
+static bool readEdge(HostReader *reader, Graph *graph, NodeIdMap *map)
+{
+   int id, source, target;
+   if(!readNumber(reader, &id) || !expectCharacter(reader, ',')) return false;
+   if(!readNumber(reader, &source) || !expectCharacter(reader, ',')) return false;
+   if(!readNumber(reader, &target) || !expectCharacter(reader, ',')) return false;
+   NodeIdSlot *source_slot = findNodeId(map, source);
+   NodeIdSlot *target_slot = findNodeId(map, target);
+   if(source_slot->id < 0 || target_slot->id < 0)
+      return loaderError(reader, "edge refers to an undefined node");
+   HostLabel label;
+   if(!readLabel(reader, &label)) return false;
+   if(!expectCharacter(reader, ')'))
+   {
+      removeHostList(label.list);
+      return false;
+   }
+   addEdge(graph, label, source_slot->index, target_slot->index);
+   return true;
+}
+
+static bool readGraph(HostReader *reader, Graph *graph, NodeIdMap *map)
+{
+   if(!expectCharacter(reader, '[')) return false;
+   if(acceptCharacter(reader, '<') && (!skipPosition(reader) || !expectCharacter(reader, '|')))
+      return false;
+   while(acceptCharacter(reader, '('))
+      if(!readNode(reader, graph, map)) return false;
+   if(!expectCharacter(reader, '|')) return false;
+   while(acceptCharacter(reader, '('))
+      if(!readEdge(reader, graph, map)) return false;
+   if(!expectCharacter(reader, ']')) return false;
+   skipLayout(reader);
+   if(reader->position < reader->end)
+      return loaderError(reader, "unexpected text after the host graph");
+   return true;
+}
+
+/* The header of a binary graph is the magic followed by nine integers. */
+#define BINARY_GRAPH_MAGIC "GP2B"
+#define BINARY_GRAPH_HEADER_SIZE 10
+#define BYTE_ORDER_MARK 0x01020304
+
+/* Rounds the size of a section of bytes up to a multiple of 4. */
+#define PADDED(bytes) (((bytes) + 3) & ~(int64_t)3)
+
+static bool binaryError(HostReader *reader, const char *message)
+{
+   fprintf(stderr, "Error (%s): %s.\n", reader->file_name, message);
+   return false;
+}
+
+static void addRootFlags(bool *roots, const int32_t *root_numbers, int count)
+{
+   int index;
+   for(index = 0; index < count; index++) roots[root_numbers[index]] = true;
+}
+
+/* Returns the list of a label of the binary graph, with a new reference. */
+static HostLabel makeBinaryLabel(HostList **lists, int32_t number, unsigned char mark)
+{
+   if(number < 0) return makeEmptyLabel(mark);
+   HostList *list = lists[number];
+   #ifdef LIST_HASHING
+      addHostList(list);
+   #else
+      list = copyHostList(list);
+   #endif
+   return makeHostLabel(mark, list->length, list);
+}
+
+/* Checks the numbers of the passed section against the bound: each number n
+ * must satisfy minimum <= n < bound. */
+static bool validNumbers(const int32_t *numbers, int count, int minimum, int bound)
+{
+   int index;
+   for(index = 0; index < count; index++)
+      if(numbers[index] < minimum || numbers[index] >= bound) return false;
+   return true;
+}
+
+static bool validMarks(const unsigned char *marks, int count)
+{
+   int index;
+   for(index = 0; index < count; index++)
+      if(marks[index] >= NUMBER_OF_MARKS) return false;
+   return true;
+}
+
+/* Returns the size in bytes of the binary graph with the passed header, or -1
+ * if the header is invalid. */
+static int64_t binaryGraphSize(const int32_t *header)
+{
+   if(header[2] != BYTE_ORDER_MARK) return -1;
+   int index;
+   for(index = 3; index < BINARY_GRAPH_HEADER_SIZE; index++)
+      if(header[index] < 0) return -1;
+   int64_t nodes = header[3], edges = header[4], roots = header[5], strings = header[6],
+           string_bytes = header[7], lists = header[8], atoms = header[9];
+   return 4 * BINARY_GRAPH_HEADER_SIZE + 4 * strings + PADDED(string_bytes) +
+          4 * lists + 8 * atoms + PADDED(nodes) + 4 * nodes + 4 * roots +
+          PADDED(edges) + 12 * edges;
+}
+
+static Graph *loadBinaryGraph(HostReader *reader)
+{
+   int64_t size = reader->end - reader->text;
+   if(size < BINARY_GRAPH_HEADER_SIZE * 4)
+   {
+      binaryError(reader, "truncated binary graph header");
+      return NULL;
+   }
+   const int32_t *header = (const int32_t *)reader->text;
+   if(header[1] != BINARY_GRAPH_VERSION)
+   {
+      binaryError(reader, "unsupported binary graph version");
+      return NULL;
+   }
+   if(header[2] != BYTE_ORDER_MARK)
+   {
+      binaryError(reader, "binary graph written with a different byte order");
+      return NULL;
+   }
+   int64_t expected = binaryGraphSize(header);
+   if(expected < 0)
+   {
+      binaryError(reader, "invalid binary graph header");
+      return NULL;
+   }
+   int nodes = header[3], edges = header[4], roots = header[5], strings = header[6],
+       string_bytes = header[7], lists = header[8], atoms = header[9];
+   if(size != expected)
+   {
+      binaryError(reader, "binary graph size does not match its header");
+      return NULL;
+   }
+
+   /* Locate the sections. */
+   const char *section = reader->text + 4 * BINARY_GRAPH_HEADER_SIZE;
+   const int32_t *string_lengths = (const int32_t *)section;
+   section += 4 * (int64_t)strings;
+   const char *string_text = section;
+   section += PADDED((int64_t)string_bytes);
+   const int32_t *list_lengths = (const int32_t *)section;
+   section += 4 * (int64_t)lists;
+   const int32_t *atom_pairs = (const int32_t *)section;
+   section += 8 * (int64_t)atoms;
+   const unsigned char *node_marks = (const unsigned char *)section;
+   section += PADDED((int64_t)nodes);
+   const int32_t *node_labels = (const int32_t *)section;
+   section += 4 * (int64_t)nodes;
+   const int32_t *root_numbers = (const int32_t *)section;
+   section += 4 * (int64_t)roots;
+   const unsigned char *edge_marks = (const unsigned char *)section;
+   section += PADDED((int64_t)edges);
+   const int32_t *edge_labels = (const int32_t *)section;
+   const int32_t *sources = edge_labels + edges;
+   const int32_t *targets = sources + edges;
+
+   if(!validNumbers(node_labels, nodes, -1, lists) ||
+      !validNumbers(edge_labels, edges, -1, lists) ||
+      !validNumbers(root_numbers, roots, 0, nodes) ||
+      !validNumbers(sources, edges, 0, nodes) || !validNumbers(targets, edges, 0, nodes) ||
+      !validMarks(node_marks, nodes) || !validMarks(edge_marks, edges))
+   {
+      binaryError(reader, "invalid item in binary graph");
+      return NULL;
+   }
+
+   /* Intern the strings, then make the lists of the label table. */
+   string *symbols = malloc((strings > 0 ? strings : 1) * sizeof(string));
+   HostList **host_lists = malloc((lists > 0 ? lists : 1) * sizeof(HostList *));
+   bool *root_flags = calloc(nodes > 0 ? nodes : 1, sizeof(bool));
+   if(symbols == NULL || host_lists == NULL || root_flags == NULL)
+   {
+      print_to_log("Error (loadBinaryGraph): malloc failure.\n");
+      exit(1);
+   }
+   bool valid = true;
+   int64_t offset = 0;
+   int index, list_count = 0;
+   for(index = 0; index < strings && valid; index++)
+   {
+      if(string_lengths[index] < 0 || offset + string_lengths[index] > string_bytes)
+         valid = false;
+      else
+      {
+         symbols[index] = internSubstring(string_text + offset, string_lengths[index]);
+         offset += string_lengths[index];
+      }
+   }
+   offset = 0;
+   for(list_count = 0; list_count < lists && valid; list_count++)
+   {
+      int length = list_lengths[list_count], atom;
+      if(length <= 0 || offset + length > atoms)
+      {
+         valid = false;
+         break;
+      }
+      for(atom = 0; atom < length && valid; atom++)
+      {
+         const int32_t *pair = atom_pairs + 2 * (offset + atom);
+         HostAtom host_atom;
+         host_atom.type = pair[0];
+         if(pair[0] == 'i') host_atom.num = pair[1];
+         else if(pair[0] == 's' && pair[1] >= 0 && pair[1] < strings)
+            host_atom.str = symbols[pair[1]];
+         else valid = false;
+         addAtom(reader, atom, host_atom);
+      }
+      if(!valid) break;
+      host_lists[list_count] = makeInternedHostList(reader->atoms, length);
+      offset += length;
+   }
+
+   Graph *graph = NULL;
+   if(!valid) binaryError(reader, "invalid label table in binary graph");
+   else
+   {
+      graph = newGraph(nodes, edges);
+      addRootFlags(root_flags, root_numbers, roots);
+      /* Nodes are added to an empty graph, so node i has index i. */
+      for(index = 0; index < nodes; index++)
+         addNode(graph, root_flags[index],
+                 makeBinaryLabel(host_lists, node_labels[index], node_marks[index]));
+      for(index = 0; index < edges; index++)
+         addEdge(graph, makeBinaryLabel(host_lists, edge_labels[index], edge_marks[index]),
+                 sources[index], targets[index]);
+   }
+   for(index = 0; index < list_count; index++) removeHostList(host_lists[index]);
+   free(symbols);
+   free(host_lists);
+   free(root_flags);
+   return graph;
+}
+
+/* Numbers the distinct lists and strings of a graph for printBinaryGraph.
+ * Lists are numbered through an open-addressing hash table keyed on the list
+ * pointer: with list hashing, equal lists are the same list. */
+typedef struct BinaryTables {
+   HostList **lists;
+   int list_count;
+   int list_capacity;
+   int *list_slots;
+   int slot_capacity;
+   string *strings;
+   int string_count;
+   int string_capacity;
+   /* The string number of each symbol, indexed by symbol ID. */
+   int *string_numbers;
+   int symbol_capacity;
+   int atoms;
+   int string_bytes;
+} BinaryTables;
+
+static void *growTable(void *table, int *capacity, int minimum, size_t item_size)
+{
+   int new_capacity = *capacity == 0 ? 64 : *capacity;
+   while(new_capacity < minimum) new_capacity *= 2;
+   table = realloc(table, new_capacity * item_size);
+   if(table == NULL)
+   {
+      print_to_log("Error (printBinaryGraph): malloc failure.\n");
+      exit(1);
+   }
+   *capacity = new_capacity;
+   return table;
+}
+
+static int findListSlot(BinaryTables *tables, HostList *list)
+{
+   unsigned slot = hashListPointer(list) & (tables->slot_capacity - 1);
+   while(tables->list_slots[slot] >= 0 && tables->lists[tables->list_slots[slot]] != list)
+      slot = (slot + 1) & (tables->slot_capacity - 1);
+   return slot;
+}
+
+static void growListSlots(BinaryTables *tables)
+{
+   free(tables->list_slots);
+   tables->slot_capacity = tables->slot_capacity == 0 ? 1024 : 2 * tables->slot_capacity;
+   tables->list_slots = malloc(tables->slot_capacity * sizeof(int));
+   if(tables->list_slots == NULL)
+   {
+      print_to_log("Error (printBinaryGraph): malloc failure.\n");
+      exit(1);
+   }
+   int index;
+   for(index = 0; index < tables->slot_capacity; index++) tables->list_slots[index] = -1;
+   for(index = 0; index < tables->list_count; index++)
+      tables->list_slots[findListSlot(tables, tables->lists[index])] = index;
+}
+
+static void numberString(BinaryTables *tables, string symbol)
+{
+   int id = symbolId(symbol), index;
+   if(id >= tables->symbol_capacity)
+   {
+      int old_capacity = tables->symbol_capacity;
+      tables->string_numbers = growTable(tables->string_numbers, &tables->symbol_capacity,
+                                         id + 1, sizeof(int));
+      for(index = old_capacity; index < tables->symbol_capacity; index++)
+         tables->string_numbers[index] = -1;
+   }
+   if(tables->string_numbers[id] >= 0) return;
+   if(tables->string_count == tables->string_capacity)
+      tables->strings = growTable(tables->strings, &tables->string_capacity,
+                                  tables->string_count + 1, sizeof(string));
+   tables->string_numbers[id] = tables->string_count;
+   tables->strings[tables->string_count++] = symbol;
+   tables->string_bytes += symbolLength(symbol);
+}
+
+/* Returns the number of the list, numbering it and its strings if it is new. */
+static int numberList(BinaryTables *tables, HostList *list)
+{
+   if(list == NULL) return -1;
+   if(2 * (tables->list_count + 1) > tables->slot_capacity) growListSlots(tables);
+   int slot = findListSlot(tables, list);
+   if(tables->list_slots[slot] >= 0) return tables->list_slots[slot];
+   if(tables->list_count == tables->list_capacity)
+      tables->lists = growTable(tables->lists, &tables->list_capacity,
+                                tables->list_count + 1, sizeof(HostList *));
+   tables->list_slots[slot] = tables->list_count;
+   tables->lists[tables->list_count] = list;
+   tables->atoms += list->length;
+   int index;
+   for(index = 0; index < list->length; index++)
+      if(list->atoms[index].type == 's') numberString(tables, list->atoms[index].str);
+   return tables->list_count++;
+}
+
+static void writeInt(int32_t value, FILE *file)
+{
+   fwrite(&value, sizeof(int32_t), 1, file);
+}
+
+static void writePadding(int64_t bytes, FILE *file)
+{
+   static const char zeros[4] = {0, 0, 0, 0};
+   fwrite(zeros, 1, PADDED(bytes) - bytes, file);
+}
+
+void printBinaryGraph(Graph *graph, FILE *file)
+{
+   BinaryTables tables = {NULL, 0, 0, NULL, 0, NULL, 0, 0, NULL, 0, 0, 0};
+   int node_slots = graph == NULL ? 0 : graph->nodes.size;
+   int edge_slots = graph == NULL ? 0 : graph->edges.size;
+   /* Maps a node's graph-index to its node number. */
+   int *node_numbers = malloc((node_slots > 0 ? node_slots : 1) * sizeof(int));
+   if(node_numbers == NULL)
+   {
+      print_to_log("Error (printBinaryGraph): malloc failure.\n");
+      exit(1);
+   }
+   int nodes = 0, edges = 0, roots = 0, index;
+   for(index = 0; index < node_slots; index++)
+   {
+      Node *node = getNode(graph, index);
+      if(node->index == -1)
+      {
+         node_numbers[index] = -1;
+         continue;
+      }
+      node_numbers[index] = nodes++;
+      if(node->root) roots++;
+      numberList(&tables, node->label.list);
+   }
+   for(index = 0; index < edge_slots; index++)
+   {
+      Edge *edge = getEdge(graph, index);
+      if(edge->index == -1) continue;
+      edges++;
+      numberList(&tables, edge->label.list);
+   }
+
+   fwrite(BINARY_GRAPH_MAGIC, 1, 4, file);
+   writeInt(BINARY_GRAPH_VERSION, file);
+   writeInt(BYTE_ORDER_MARK, file);
+   writeInt(nodes, file);
+   writeInt(edges, file);
+   writeInt(roots, file);
+   writeInt(tables.string_count, file);
+   writeInt(tables.string_bytes, file);
+   writeInt(tables.list_count, file);
+   writeInt(tables.atoms, file);
+
+   for(index = 0; index < tables.string_count; index++)
+      writeInt(symbolLength(tables.strings[index]), file);
+   for(index = 0; index < tables.string_count; index++)
+      fwrite(tables.strings[index], 1, symbolLength(tables.strings[index]), file);
+   writePadding(tables.string_bytes, file);
+
+   for(index = 0; index < tables.list_count; index++)
+      writeInt(tables.lists[index]->length, file);
+   for(index = 0; index < tables.list_count; index++)
+   {
+      HostList *list = tables.lists[index];
+      int atom;
+      for(atom = 0; atom < list->length; atom++)
+      {
+         writeInt(list->atoms[atom].type, file);
+         if(list->atoms[atom].type == 'i') writeInt(list->atoms[atom].num, file);
+         else writeInt(tables.string_numbers[symbolId(list->atoms[atom].str)], file);
+      }
+   }
+
+   for(index = 0; index < node_slots; index++)
+   {
+      Node *node = getNode(graph, index);
+      if(node->index != -1) fputc(node->label.mark, file);
+   }
+   writePadding(nodes, file);
+   for(index = 0; index < node_slots; index++)
+   {
+      Node *node = getNode(graph, index);
+      if(node->index != -1) writeInt(numberList(&tables, node->label.list), file);
+   }
+   for(index = 0; index < node_slots; index++)
+   {
+      Node *node = getNode(graph, index);
+      if(node->index != -1 && node->root) writeInt(node_numbers[index], file);
+   }
+
+   for(index = 0; index < edge_slots; index++)
+   {
+      Edge *edge = getEdge(graph, index);
+      if(edge->index != -1) fputc(edge->label.mark, file);
+   }
+   writePadding(edges, file);
+   for(index = 0; index < edge_slots; index++)
+   {
+      Edge *edge = getEdge(graph, index);
+      if(edge->index != -1) writeInt(numberList(&tables, edge->label.list), file);
+   }
+   for(index = 0; index < edge_slots; index++)
+   {
+      Edge *edge = getEdge(graph, index);
+      if(edge->index != -1) writeInt(node_numbers[edge->source], file);
+   }
+   for(index = 0; index < edge_slots; index++)
+   {
+      Edge *edge = getEdge(graph, index);
+      if(edge->index != -1) writeInt(node_numbers[edge->target], file);
+   }
+
+   free(node_numbers);
+   free(tables.lists);
+   free(tables.list_slots);
+   free(tables.strings);
+   free(tables.string_numbers);
+}
+
+/* Reads a file that cannot be mapped, such as a pipe, into a buffer. */
+static char *readHostFile(int descriptor, size_t *size)
+{
+   size_t capacity = 4096;
+   char *buffer = malloc(capacity);
+   if(buffer == NULL)
+   {
+      print_to_log("Error (readHostFile): malloc failure.\n");
+      exit(1);
+   }
+   *size = 0;
+   while(true)
+   {
+      if(*size == capacity)
+      {
+         capacity *= 2;
+         buffer = realloc(buffer, capacity);
+         if(buffer == NULL)
+         {
+            print_to_log("Error (readHostFile): malloc failure.\n");
+            exit(1);
+         }
+      }
+      ssize_t bytes = read(descriptor, buffer + *size, capacity - *size);
+      if(bytes < 0)
+      {
+         free(buffer);
+         return NULL;
+      }
+      if(bytes == 0) return buffer;
+      *size += bytes;
+   }
+}
+
+static void initialiseReader(HostReader *reader, string name)
+{
+   reader->file_name = name;
+   reader->text = reader->end = reader->position = NULL;
+   reader->first_line = 1;
+   reader->atom_capacity = 16;
+   reader->silent = false;
+   reader->atoms = malloc(reader->atom_capacity * sizeof(HostAtom));
+   if(reader->atoms == NULL)
+   {
+      print_to_log("Error (initialiseReader): malloc failure.\n");
+      exit(1);
+   }
+}
+
+int loader_threads = 1;
+
+/* Smaller text graphs are read by the serial loader, as the threads would cost
+ * more than they save. */
+#define PARALLEL_LOAD_MINIMUM (1 << 20)
+
+static int loaderThreads(void)
+{
+   if(loader_threads > 0) return loader_threads;
+   long processors = sysconf(_SC_NPROCESSORS_ONLN);
+   return processors > 0 ? (int)processors : 1;
+}
+
+/* The distinct label texts of a host graph, numbered by the threads of the
+ * parallel loader as they meet them. The table is an open-addressing hash
+ * table with linear probing, sized for a distinct label per item so that it
+ * never grows. A slot holds the number of its label plus 1, or 0 if it is
+ * empty. A thread writes the key of a new number before it claims an empty
+ * slot for the number with a compare-and-swap; if an equal key takes the slot
+ * first, the new number is left unused, with length -1. Labels written
+ * differently, such as "1:2" and "1 : 2", have different numbers, but the
+ * list store makes them the same list. */
+typedef struct LabelKey {
+   const char *text;
+   int length;
+   unsigned hash;
+} LabelKey;
+
+typedef struct LabelTable {
+   size_t capacity;
+   int *slots;
+   LabelKey *keys;
+   int count;
+} LabelTable;
+
+static unsigned hashLabelText(const char *text, int length)
+{
+   unsigned hash = 2166136261u;
+   int index;
+   for(index = 0; index < length; index++)
+      hash = (hash ^ (unsigned char)text[index]) * 16777619u;
+   return hash;
+}
+
+static int numberLabel(LabelTable *table, const char *text, int length)
+{
+   unsigned hash = hashLabelText(text, length);
+   size_t slot = hash & (table->capacity - 1);
+   int number = -1;
+   while(true)
+   {
+      int entry = __atomic_load_n(&(table->slots[slot]), __ATOMIC_ACQUIRE);
+      if(entry == 0)
+      {
+         if(number < 0)
+         {
+            number = __atomic_fetch_add(&(table->count), 1, __ATOMIC_RELAXED);
+            table->keys[number].text = text;
+            table->keys[number].length = length;
+            table->keys[number].hash = hash;
+         }
+         if(__atomic_compare_exchange_n(&(table->slots[slot]), &entry, number + 1, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) return number;
+      }
+      LabelKey *key = &(table->keys[entry - 1]);
+      if(key->hash == hash && key->length == length && memcmp(key->text, text, length) == 0)
+      {
+         if(number >= 0) table->keys[number].length = -1;
+         return entry - 1;
+      }
+      slot = (slot + 1) & (table->capacity - 1);
+   }
+}
+
+/* A span of the text read by one thread of the parallel loader. It runs from
+ * its entry, the start of the text or the opening bracket of an item, to the
+ * entry of the next span, or to the end of the text for the last span. Its
+ * nodes and edges, as counted by scanItems, are stored from first_node and
+ * first_edge on. */
+typedef struct LoaderSpan {
+   const char *entry, *stop;
+   int first_node, nodes, first_edge, edges;
+   /* Set if the span starts after the '|' before the edges. */
+   bool in_edges;
+   /* Set if the ID of each node of the span is the node's index. */
+   bool identity;
+} LoaderSpan;
+
+/* The state of loadInParallel shared by its threads. The items are read into
+ * arrays, with the label numbers of the label table, and the node IDs of the
+ * edges are then replaced by node indices. */
+typedef struct ParallelLoad {
+   HostReader *reader;
+   int threads;
+   TextRange *ranges;
+   LoaderSpan *spans;
+   int span_count;
+   /* The '|' before the edges. */
+   const char *separator;
+   int nodes, edges;
+   int *node_ids, *node_labels;
+   bool *roots;
+   int *sources, *targets, *edge_labels;
+   LabelTable labels;
+   NodeIdMap map;
+   /* Set by a thread that finds an error. */
+   bool failed;
+} ParallelLoad;
+
+/* Finds the text of the label at the current position, which ends at the '<'
+ * of a node's position or at the closing bracket of the item, and returns its
+ * number, or -1 if there is no label. The layout after the label is not part
+ * of its text. The text is checked when its label is made. */
+static int scanLabel(HostReader *reader, LabelTable *table)
+{
+   skipLayout(reader);
+   const char *start = reader->position, *finish = start;
+   while(reader->position < reader->end)
+   {
+      char c = *(reader->position);
+      if(c == '<' || c == ')') break;
+      if(c == '"')
+      {
+         reader->position++;
+         while(reader->position < reader->end && *(reader->position) != '"')
+         {
+            if(*(reader->position) == '\n') return -1;
+            reader->position++;
+         }
+         if(reader->position >= reader->end) return -1;
+      }
+      reader->position++;
+      finish = reader->position;
+      skipLayout(reader);
+   }
+   if(finish == start) return -1;
+   return numberLabel(table, start, finish - start);
+}
+
+/* Read the item after its opening bracket into the arrays of the load. */
+static bool readNodeItem(HostReader *reader, ParallelLoad *load, int node)
+{
+   if(!readNumber(reader, &(load->node_ids[node]))) return false;
+   load->roots[node] = readRootMarker(reader);
+   if(!expectCharacter(reader, ',')) return false;
+   if((load->node_labels[node] = scanLabel(reader, &(load->labels))) < 0) return false;
+   if(acceptCharacter(reader, '<') && !skipPosition(reader)) return false;
+   return expectCharacter(reader, ')');
+}
+
+static bool readEdgeItem(HostReader *reader, ParallelLoad *load, int edge)
+{
+   int id;
+   if(!readNumber(reader, &id) || !expectCharacter(reader, ',')) return false;
+   if(!readNumber(reader, &(load->sources[edge])) || !expectCharacter(reader, ',')) return false;
+   if(!readNumber(reader, &(load->targets[edge])) || !expectCharacter(reader, ',')) return false;
+   if((load->edge_labels[edge] = scanLabel(reader, &(load->labels))) < 0) return false;
+   return expectCharacter(reader, ')');
+}
+
+/* Reads the span as readGraph reads the text. The span must hold exactly the
+ * items counted for it. */
+static bool readSpan(ParallelLoad *load, LoaderSpan *span)
+{
+   HostReader reader = *(load->reader);
+   reader.position = span->entry;
+   reader.silent = true;
+   int node = span->first_node, node_end = span->first_node + span->nodes;
+   int edge = span->first_edge, edge_end = span->first_edge + span->edges;
+   bool in_edges = span->in_edges;
+   span->identity = true;
+   if(span->entry == reader.text)
+   {
+      if(!expectCharacter(&reader, '[')) return false;
+      if(acceptCharacter(&reader, '<') && (!skipPosition(&reader) || !expectCharacter(&reader, '|')))
+         return false;
+   }
+   while(true)
+   {
+      skipLayout(&reader);
+      if(span->stop != NULL && reader.position >= span->stop) break;
+      if(acceptCharacter(&reader, '('))
+      {
+         if(!in_edges)
+         {
+            if(node == node_end || !readNodeItem(&reader, load, node)) return false;
+            if(load->node_ids[node] != node) span->identity = false;
+            node++;
+         }
+         else if(edge == edge_end || !readEdgeItem(&reader, load, edge++)) return false;
+      }
+      else if(!in_edges && reader.position == load->separator && acceptCharacter(&reader, '|'))
+         in_edges = true;
+      else if(in_edges && span->stop == NULL && acceptCharacter(&reader, ']'))
+      {
+         skipLayout(&reader);
+         break;
+      }
+      else return false;
+   }
+   return reader.position == (span->stop == NULL ? reader.end : span->stop) &&
+          node == node_end && edge == edge_end;
+}
+
+static void failLoad(ParallelLoad *load)
+{
+   __atomic_store_n(&(load->failed), true, __ATOMIC_RELAXED);
+}
+
+static void scanRangeTask(void *data, int thread)
+{
+   ParallelLoad *load = data;
+   scanItems(&(load->ranges[thread]), load->reader->end);
+}
+
+static void readSpanTask(void *data, int thread)
+{
+   ParallelLoad *load = data;
+   if(!readSpan(load, &(load->spans[thread]))) failLoad(load);
+}
+
+/* Inserts the node IDs of the thread's share of the nodes into the node ID
+ * map, which is sized for all nodes. A thread claims an empty slot for an ID
+ * with a compare-and-swap; no slot is read until every ID is inserted. */
+static void mapNodeIdsTask(void *data, int thread)
+{
+   ParallelLoad *load = data;
+   NodeIdMap *map = &(load->map);
+   int first = (int64_t)load->nodes * thread / load->threads;
+   int last = (int64_t)load->nodes * (thread + 1) / load->threads, node;
+   for(node = first; node < last; node++)
+   {
+      int id = load->node_ids[node];
+      unsigned slot = hashNodeId(id) & (map->capacity - 1);
+      while(true)
+      {
+         int empty = -1;
+         if(__atomic_compare_exchange_n(&(map->slots[slot].id), &empty, id, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+         {
+            map->slots[slot].index = node;
+            break;
+         }
+         if(empty == id)
+         {
+            failLoad(load);
+            return;
+         }
+         slot = (slot + 1) & (map->capacity - 1);
+      }
+   }
+}
+
+/* Replaces the node IDs of the thread's share of the edges by node indices.
+ * The map is not used if every node ID is the node's index. */
+static void resolveEdgesTask(void *data, int thread)
+{
+   ParallelLoad *load = data;
+   int first = (int64_t)load->edges * thread / load->threads;
+   int last = (int64_t)load->edges * (thread + 1) / load->threads, edge;
+   for(edge = first; edge < last; edge++)
+   {
+      if(load->map.slots == NULL)
+      {
+         if(load->sources[edge] >= load->nodes || load->targets[edge] >= load->nodes)
+         {
+            failLoad(load);
+            return;
+         }
+         continue;
+      }
+      NodeIdSlot *source_slot = findNodeId(&(load->map), load->sources[edge]);
+      NodeIdSlot *target_slot = findNodeId(&(load->map), load->targets[edge]);
+      if(source_slot->id < 0 || target_slot->id < 0)
+      {
+         failLoad(load);
+         return;
+      }
+      load->sources[edge] = source_slot->index;
+      load->targets[edge] = target_slot->index;
+   }
+}
+
+static void *allocateLoadArray(int64_t count, size_t item_size)
+{
+   void *array = malloc((count > 0 ? count : 1) * item_size);
+   if(array == NULL)
+   {
+      print_to_log("Error (loadInParallel): malloc failure.\n");
+      exit(1);
+   }
+   return array;
+}
+
+/* Divides the text into ranges of about equal size that start at the start of
+ * a line, counts the items of each range, and makes the spans: a range in
+ * which no item starts is read with the span before it. Returns false if the
+ * text has no '|' or too many items. */
+static bool divideText(ParallelLoad *load)
+{
+   HostReader *reader = load->reader;
+   size_t size = reader->end - reader->text;
+   const char *start = reader->text;
+   int thread;
+   for(thread = 0; thread < load->threads; thread++)
+   {
+      const char *end = reader->end;
+      if(thread < load->threads - 1)
+      {
+         end = reader->text + size * (thread + 1) / load->threads;
+         if(end < start) end = start;
+         const char *newline = memchr(end, '\n', reader->end - end);
+         end = newline == NULL ? reader->end : newline + 1;
+      }
+      load->ranges[thread].start = start;
+      load->ranges[thread].end = end;
+      start = end;
+   }
+   runOnThreads(load->threads, scanRangeTask, load);
+
+   int separator_range = -1;
+   for(thread = 0; thread < load->threads; thread++)
+      if(load->ranges[thread].last_bar != NULL) separator_range = thread;
+   if(separator_range < 0) return false;
+   load->separator = load->ranges[separator_range].last_bar;
+
+   int64_t nodes = 0, edges = 0;
+   load->span_count = 0;
+   for(thread = 0; thread < load->threads; thread++)
+   {
+      TextRange *range = &(load->ranges[thread]);
+      LoaderSpan *span;
+      if(thread == 0 || range->first_item != NULL)
+      {
+         span = &(load->spans[load->span_count++]);
+         span->entry = thread == 0 ? reader->text : range->first_item;
+         span->stop = NULL;
+         if(load->span_count > 1) load->spans[load->span_count - 2].stop = span->entry;
+         span->first_node = nodes;
+         span->first_edge = edges;
+         span->nodes = span->edges = 0;
+         span->in_edges = span->entry > load->separator;
+      }
+      else span = &(load->spans[load->span_count - 1]);
+      int range_nodes = thread < separator_range ? range->items :
+                        thread == separator_range ? range->items_before_bar : 0;
+      span->nodes += range_nodes;
+      span->edges += range->items - range_nodes;
+      nodes += range_nodes;
+      edges += range->items - range_nodes;
+      if(nodes > INT_MAX || edges > INT_MAX) return false;
+   }
+   load->nodes = nodes;
+   load->edges = edges;
+   return true;
+}
+
+/* Makes the label of each label number on this thread, which owns the symbol
+ * table and the list store. Returns the number of labels made, which is less
+ * than the number of labels if the text of a label is not a valid label. */
+static int makeLabels(ParallelLoad *load, HostLabel *labels)
+{
+   HostReader reader = *(load->reader);
+   reader.silent = true;
+   int number;
+   for(number = 0; number < load->labels.count; number++)
+   {
+      LabelKey *key = &(load->labels.keys[number]);
+      labels[number] = makeEmptyLabel(NONE);
+      if(key->length < 0) continue;
+      reader.text = reader.position = key->text;
+      reader.end = key->text + key->length;
+      if(!readLabel(&reader, &labels[number])) break;
+      skipLayout(&reader);
+      if(reader.position < reader.end)
+      {
+         removeHostList(labels[number].list);
+         break;
+      }
+   }
+   /* The atom buffer may have been reallocated. */
+   load->reader->atoms = reader.atoms;
+   load->reader->atom_capacity = reader.atom_capacity;
+   return number;
+}
+
+/* Reads a text graph on the passed number of threads. The threads divide the
+ * text between them and read their spans into arrays, numbering the labels
+ * they meet in a shared label table. Node IDs are then mapped to indices, the
+ * labels are made once per distinct text on this thread, and the graph is
+ * built by buildGraph. Returns NULL if the text is not a valid host graph, or
+ * its division among the threads does not match the items read: the serial
+ * loader then reads the text again and reports the error. */
+static Graph *loadInParallel(HostReader *reader, int threads)
+{
+   ParallelLoad load;
+   memset(&load, 0, sizeof(ParallelLoad));
+   load.reader = reader;
+   load.threads = threads;
+   load.ranges = allocateLoadArray(threads, sizeof(TextRange));
+   load.spans = allocateLoadArray(threads, sizeof(LoaderSpan));
+   Graph *graph = NULL;
+   if(!divideText(&load))
+   {
+      free(load.ranges);
+      free(load.spans);
+      return NULL;
+   }
+
+   int64_t items = (int64_t)load.nodes + load.edges;
+   load.node_ids = allocateLoadArray(load.nodes, sizeof(int));
+   load.node_labels = allocateLoadArray(load.nodes, sizeof(int));
+   load.roots = allocateLoadArray(load.nodes, sizeof(bool));
+   load.sources = allocateLoadArray(load.edges, sizeof(int));
+   load.targets = allocateLoadArray(load.edges, sizeof(int));
+   load.edge_labels = allocateLoadArray(load.edges, sizeof(int));
+   load.labels.capacity = 16;
+   while(load.labels.capacity < 2 * (size_t)items) load.labels.capacity *= 2;
+   load.labels.slots = calloc(load.labels.capacity, sizeof(int));
+   if(load.labels.slots == NULL)
+   {
+      print_to_log("Error (loadInParallel): malloc failure.\n");
+      exit(1);
+   }
+   load.labels.keys = allocateLoadArray(items, sizeof(LabelKey));
+   runOnThreads(load.span_count, readSpanTask, &load);
+
+   int span;
+   bool identity = true;
+   for(span = 0; span < load.span_count; span++)
+      if(!load.spans[span].identity) identity = false;
+   if(!load.failed && !identity)
+   {
+      prepareNodeIdMap(&(load.map), load.nodes);
+      runOnThreads(threads, mapNodeIdsTask, &load);
+   }
+   if(!load.failed) runOnThreads(threads, resolveEdgesTask, &load);
+   if(!load.failed)
+   {
+      HostLabel *labels = allocateLoadArray(load.labels.count, sizeof(HostLabel));
+      int made = makeLabels(&load, labels), number;
+      if(made == load.labels.count)
+         graph = buildGraph(load.nodes, load.edges, load.roots, load.node_labels,
+                            load.edge_labels, load.sources, load.targets, labels, threads);
+      for(number = 0; number < made; number++) removeHostList(labels[number].list);
+      free(labels);
+   }
+   free(load.ranges);
+   free(load.spans);
+   free(load.node_ids);
+   free(load.node_labels);
+   free(load.roots);
+   free(load.sources);
+   free(load.targets);
+   free(load.edge_labels);
+   free(load.labels.slots);
+   free(load.labels.keys);
+   free(load.map.slots);
+   return graph;
+}
+
+/* Builds the graph of the passed text, which holds one host graph in either
+ * format. Large text graphs are read in parallel if loader_threads allows. */
+static Graph *buildHostGraph(HostReader *reader, const char *text, size_t size,
+                             NodeIdMap *map)
+{
+   reader->text = reader->position = text;
+   reader->end = text + size;
+   if(size >= 4 && memcmp(text, BINARY_GRAPH_MAGIC, 4) == 0) return loadBinaryGraph(reader);
+   if(size >= PARALLEL_LOAD_MINIMUM && loaderThreads() > 1)
+   {
+      Graph *graph = loadInParallel(reader, loaderThreads());
+      if(graph != NULL) return graph;
+      /* The serial loader reads the graph again and reports the error. */
+      reader->position = text;
+   }
+   TextRange range = {reader->text, reader->end, NULL, NULL, 0, 0};
+   scanItems(&range, reader->end);
+   int nodes = range.items_before_bar, edges = range.items - range.items_before_bar;
+   Graph *graph = newGraph(nodes, edges);
+   prepareNodeIdMap(map, nodes);
+   if(!readGraph(reader, graph, map))
+   {
+      freeGraph(graph);
+      return NULL;
+   }
+   return graph;
+}
+
+/* Returns the text of the named file, mapped into memory if the file is a
+ * regular file and read into a buffer otherwise, or NULL if the file cannot be
+ * read. The text is released by closeHostFile. */
+static char *openHostFile(string name, size_t *size, bool *mapped)
+{
+   int descriptor = open(name, O_RDONLY);
+   if(descriptor < 0)
+   {
+      perror(name);
+      return NULL;
+   }
+   struct stat status;
+   if(fstat(descriptor, &status) < 0)
+   {
+      perror(name);
+      close(descriptor);
+      return NULL;
+   }
+   *size = status.st_size;
+   *mapped = false;
+   char *text = NULL;
+   if(S_ISREG(status.st_mode) && *size > 0)
+   {
+      text = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      if(text == MAP_FAILED) text = NULL;
+      else
+      {
+         *mapped = true;
+         madvise(text, *size, MADV_SEQUENTIAL);
+      }
+   }
+   if(text == NULL) text = readHostFile(descriptor, size);
+   close(descriptor);
+   if(text == NULL) perror(name);
+   return text;
+}
+
+static void closeHostFile(char *text, size_t size, bool mapped)
+{
+   if(mapped) munmap(text, size);
+   else free(text);
+}
+
+Graph *loadHostGraph(string host_file)
+{
+   size_t size;
+   bool mapped;
+   char *text = openHostFile(host_file, &size, &mapped);
+   if(text == NULL) return NULL;
+
+   HostReader reader;
+   initialiseReader(&reader, host_file);
+   NodeIdMap map = {0, 0, NULL};
+   Graph *graph = buildHostGraph(&reader, text, size, &map);
+   free(map.slots);
+   free(reader.atoms);
+   closeHostFile(text, size, mapped);
+   return graph;
+}
+
+/* The unread input of a stream is held at the start of its buffer. The bytes
+ * of the graph returned by the last read are discarded at the next read, so
+ * that each graph starts at the start of the buffer, where the integer
+ * sections of a binary graph are aligned. */
+#define HOST_STREAM_READ_SIZE 65536
+
+struct HostStream {
+   string name;
+   int descriptor;
+   char *buffer;
+   size_t size;
+   size_t capacity;
+   /* The number of bytes of the buffer taken by the last graph. */
+   size_t consumed;
+   bool end_of_file;
+   /* The state of the search for the end of a text graph, so that the text
+    * scanned before the last refill is not scanned again. */
+   size_t scan;
+   bool in_string;
+   bool in_comment;
+   HostReader reader;
+   NodeIdMap map;
+};
+
+HostStream *openHostStream(string name)
+{
+   int descriptor = strcmp(name, "-") == 0 ? STDIN_FILENO : open(name, O_RDONLY);
+   if(descriptor < 0)
+   {
+      perror(name);
+      return NULL;
+   }
+   HostStream *stream = malloc(sizeof(HostStream));
+   if(stream == NULL)
+   {
+      print_to_log("Error (openHostStream): malloc failure.\n");
+      exit(1);
+   }
+   stream->name = strcmp(name, "-") == 0 ? "stdin" : name;
+   stream->descriptor = descriptor;
+   stream->capacity = HOST_STREAM_READ_SIZE;
+   stream->buffer = malloc(stream->capacity);
+   if(stream->buffer == NULL)
+   {
+      print_to_log("Error (openHostStream): malloc failure.\n");
+      exit(1);
+   }
+   stream->size = 0;
+   stream->consumed = 0;
+   stream->end_of_file = false;
+   stream->scan = 0;
+   stream->in_string = false;
+   stream->in_comment = false;
+   initialiseReader(&stream->reader, stream->name);
+   stream->map.capacity = 0;
+   stream->map.size = 0;
+   stream->map.slots = NULL;
+   return stream;
+}
+
+/* The lines of the discarded input are counted, so that the reader's line
+ * numbers continue from the start of the stream. */
+static void discardStreamInput(HostStream *stream, size_t bytes)
+{
+   const char *position = stream->buffer, *end = stream->buffer + bytes;
+   while((position = memchr(position, '\n', end - position)) != NULL)
+   {
+      stream->reader.first_line++;
+      position++;
+   }
+   memmove(stream->buffer, stream->buffer + bytes, stream->size - bytes);
+   stream->size -= bytes;
+}
+
+/* Reads more input into the buffer, growing it if it is full. */
+static void fillHostStream(HostStream *stream)
+{
+   if(stream->size == stream->capacity)
+   {
+      stream->capacity *= 2;
+      stream->buffer = realloc(stream->buffer, stream->capacity);
+      if(stream->buffer == NULL)
+      {
+         print_to_log("Error (fillHostStream): malloc failure.\n");
+         exit(1);
+      }
+   }
+   ssize_t bytes;
+   do bytes = read(stream->descriptor, stream->buffer + stream->size,
+                   stream->capacity - stream->size);
+   while(bytes < 0 && errno == EINTR);
+   if(bytes < 0) perror(stream->name);
+   if(bytes <= 0) stream->end_of_file = true;
+   else stream->size += bytes;
+}
+
+/* Returns the number of bytes of white space and comments at the start of the
+ * buffer. Sets complete to false if more input is needed to find their end. */
+static size_t streamLayout(HostStream *stream, bool *complete)
+{
+   size_t position = 0;
+   *complete = true;
+   while(position < stream->size)
+   {
+      char c = stream->buffer[position];
+      if(c == ' ' || c == '\t' || c == '\r' || c == '\n') position++;
+      else if(c == '/' && position + 1 == stream->size && !stream->end_of_file)
+      {
+         *complete = false;
+         break;
+      }
+      else if(c == '/' && position + 1 < stream->size && stream->buffer[position + 1] == '/')
+      {
+         char *newline = memchr(stream->buffer + position, '\n', stream->size - position);
+         if(newline != NULL) position = newline - stream->buffer + 1;
+         else
+         {
+            if(!stream->end_of_file) *complete = false;
+            else position = stream->size;
+            break;
+         }
+      }
+      else break;
+   }
+   return position;
+}
+
+/* Returns the length of the text graph at the start of the buffer, which ends
+ * at its closing bracket, or 0 if the buffer does not hold all of it. */
+static size_t scanTextGraph(HostStream *stream)
+{
+   size_t position = stream->scan;
+   while(position < stream->size)
+   {
+      char c = stream->buffer[position];
+      if(stream->in_string)
+      {
+         if(c == '"' || c == '\n') stream->in_string = false;
+      }
+      else if(stream->in_comment)
+      {
+         if(c == '\n') stream->in_comment = false;
+      }
+      else if(c == '"') stream->in_string = true;
+      else if(c == '/')
+      {
+         if(position + 1 == stream->size && !stream->end_of_file) break;
+         if(position + 1 < stream->size && stream->buffer[position + 1] == '/')
+         {
+            stream->in_comment = true;
+            position++;
+         }
+      }
+      else if(c == ']')
+      {
+         stream->scan = 0;
+         return position + 1;
+      }
+      position++;
+   }
+   stream->scan = position;
+   return 0;
+}
+
+int readHostStream(HostStream *stream, Graph **graph)
+{
+   *graph = NULL;
+   discardStreamInput(stream, stream->consumed);
+   stream->consumed = 0;
+   while(true)
+   {
+      bool complete;
+      discardStreamInput(stream, streamLayout(stream, &complete));
+      if(complete && stream->size > 0) break;
+      if(stream->end_of_file) return 0;
+      fillHostStream(stream);
+   }
+
+   size_t length = 0;
+   bool binary = stream->buffer[0] == BINARY_GRAPH_MAGIC[0];
+   stream->scan = 0;
+   stream->in_string = stream->in_comment = false;
+   while(true)
+   {
+      if(!binary) length = scanTextGraph(stream);
+      else if(stream->size >= 4 * BINARY_GRAPH_HEADER_SIZE)
+      {
+         int64_t size = binaryGraphSize((const int32_t *)stream->buffer);
+         if(size < 0)
+         {
+            /* The end of the graph is unknown, so the rest of the stream is lost. */
+            fprintf(stderr, "Error (%s): invalid binary graph header.\n", stream->name);
+            stream->size = 0;
+            stream->end_of_file = true;
+            return -1;
+         }
+         if((int64_t)stream->size >= size) length = size;
+      }
+      if(length > 0) break;
+      if(stream->end_of_file)
+      {
+         fprintf(stderr, "Error (%s): unexpected end of stream.\n", stream->name);
+         stream->size = 0;
+         return -1;
+      }
+      fillHostStream(stream);
+   }
+   stream->consumed = length;
+   *graph = buildHostGraph(&stream->reader, stream->buffer, length, &stream->map);
+   return *graph == NULL ? -1 : 1;
+}
+
+void closeHostStream(HostStream *stream)
+{
+   if(stream == NULL) return;
+   if(stream->descriptor != STDIN_FILENO) close(stream->descriptor);
+   free(stream->buffer);
+   free(stream->reader.atoms);
+   free(stream->map.slots);
+   free(stream);
+}
+
+/* Numbers the live nodes (edges) of the graph from 0 in the order of their
+ * indices, as printGraph does. Returns the numbers by index, -1 for holes, and
+ * the number of items in *count. */
+static int *numberNodes(Graph *graph, int *count)
+{
+   int *numbers = malloc((graph->nodes.size + 1) * sizeof(int));
+   if(numbers == NULL)
+   {
+      print_to_log("Error (numberNodes): malloc failure.\n");
+      exit(1);
+   }
+   int index;
+   *count = 0;
+   for(index = 0; index < graph->nodes.size; index++)
+      numbers[index] = getNode(graph, index)->index < 0 ? -1 : (*count)++;
+   return numbers;
+}
+
+static int *numberEdges(Graph *graph, int *count)
+{
+   int *numbers = malloc((graph->edges.size + 1) * sizeof(int));
+   if(numbers == NULL)
+   {
+      print_to_log("Error (numberEdges): malloc failure.\n");
+      exit(1);
+   }
+   int index;
+   *count = 0;
+   for(index = 0; index < graph->edges.size; index++)
+      numbers[index] = getEdge(graph, index)->index < 0 ? -1 : (*count)++;
+   return numbers;
+}
+
+static void printDeltaNode(const char *change, int id, Node *node, FILE *file)
+{
+   fprintf(file, "%s node (%d%s, ", change, id, node->root ? "(R)" : "");
+   printHostLabel(node->label, file);
+   fprintf(file, ")\n");
+}
+
+void printGraphDelta(Graph *base, Graph *graph, FILE *file)
+{
+   int base_nodes, base_edges, index, added = 0;
+   int *base_node_ids = numberNodes(base, &base_nodes);
+   int *base_edge_ids = numberEdges(base, &base_edges);
+   /* The IDs of the nodes of the graph in the delta, and the kept base items. */
+   int *node_ids = malloc((graph->nodes.size + 1) * sizeof(int));
+   bool *kept_nodes = calloc(base->nodes.size + 1, sizeof(bool));
+   bool *kept_edges = calloc(base->edges.size + 1, sizeof(bool));
+   if(node_ids == NULL || kept_nodes == NULL || kept_edges == NULL)
+   {
+      print_to_log("Error (printGraphDelta): malloc failure.\n");
+      exit(1);
+   }
+   fprintf(file, "delta [ %d | %d ]\n", base_nodes, base_edges);
+
+   for(index = 0; index < graph->nodes.size; index++)
+   {
+      Node *node = getNode(graph, index);
+      if(node->index < 0) continue;
+      int key = getNodeKey(graph, index);
+      if(key >= 0)
+      {
+         assert(key < base->nodes.size && base_node_ids[key] >= 0);
+         node_ids[index] = base_node_ids[key];
+         kept_nodes[key] = true;
+         continue;
+      }
+      node_ids[index] = base_nodes + added++;
+      printDeltaNode("add", node_ids[index], node, file);
+   }
+   added = 0;
+   for(index = 0; index < graph->edges.size; index++)
+   {
+      Edge *edge = getEdge(graph, index);
+      if(edge->index < 0) continue;
+      int key = getEdgeKey(graph, index);
+      if(key >= 0)
+      {
+         assert(key < base->edges.size && base_edge_ids[key] >= 0);
+         kept_edges[key] = true;
+         continue;
+      }
+      fprintf(file, "add edge (%d, %d, %d, ", base_edges + added++,
+              node_ids[edge->source], node_ids[edge->target]);
+      printHostLabel(edge->label, file);
+      fprintf(file, ")\n");
+   }
+   for(index = 0; index < graph->nodes.size; index++)
+   {
+      Node *node = getNode(graph, index);
+      int key = node->index < 0 ? -1 : getNodeKey(graph, index);
+      if(key < 0) continue;
+      Node *base_node = getNode(base, key);
+      if(node->root != base_node->root || !equalHostLabels(node->label, base_node->label))
+         printDeltaNode("relabel", node_ids[index], node, file);
+   }
+   for(index = 0; index < graph->edges.size; index++)
+   {
+      Edge *edge = getEdge(graph, index);
+      int key = edge->index < 0 ? -1 : getEdgeKey(graph, index);
+      if(key < 0 || equalHostLabels(edge->label, getEdge(base, key)->label)) continue;
+      fprintf(file, "relabel edge (%d, ", base_edge_ids[key]);
+      printHostLabel(edge->label, file);
+      fprintf(file, ")\n");
+   }
+   for(index = 0; index < base->edges.size; index++)
+      if(base_edge_ids[index] >= 0 && !kept_edges[index])
+         fprintf(file, "remove edge (%d)\n", base_edge_ids[index]);
+   for(index = 0; index < base->nodes.size; index++)
+      if(base_node_ids[index] >= 0 && !kept_nodes[index])
+         fprintf(file, "remove node (%d)\n", base_node_ids[index]);
+   fprintf(file, "\n");
+   free(base_node_ids);
+   free(base_edge_ids);
+   free(node_ids);
+   free(kept_nodes);
+   free(kept_edges);
+}
+
+/* The indices of the items named in a delta: the base items by their IDs, -1
+ * once removed, and the added nodes in the order of their IDs, which follow
+ * the base node IDs. */
+typedef struct DeltaIndices {
+   int base_nodes;
+   int base_edges;
+   int *nodes;
+   int *edges;
+   IntArray added_nodes;
+} DeltaIndices;
+
+/* Reads a node ID and returns the index of its node in *index. */
+static bool readDeltaNode(HostReader *reader, DeltaIndices *indices, int *index)
+{
+   int id;
+   if(!readNumber(reader, &id)) return false;
+   if(id < indices->base_nodes) *index = indices->nodes[id];
+   else if(id - indices->base_nodes < indices->added_nodes.size)
+      *index = indices->added_nodes.items[id - indices->base_nodes];
+   else *index = -1;
+   if(*index < 0) return loaderError(reader, "undefined or removed node");
+   return true;
+}
+
+static bool readDeltaEdge(HostReader *reader, DeltaIndices *indices, int *index)
+{
+   int id;
+   if(!readNumber(reader, &id)) return false;
+   *index = id < indices->base_edges ? indices->edges[id] : -1;
+   if(*index < 0) return loaderError(reader, "undefined or removed edge");
+   return true;
+}
+
+/* Reads and applies one change after its kind, "node" or "edge", and its
+ * opening bracket. */
+static bool readDeltaChange(HostReader *reader, Graph *graph, DeltaIndices *indices,
+                            const char *change, bool node)
+{
+   int index, source, target;
+   HostLabel label;
+   if(strcmp(change, "add") == 0 && node)
+   {
+      if(!readNumber(reader, &index)) return false;
+      if(index != indices->base_nodes + indices->added_nodes.size)
+         return loaderError(reader, "added nodes must be numbered consecutively");
+      bool root = readRootMarker(reader);
+      if(!expectCharacter(reader, ',') || !readLabel(reader, &label)) return false;
+      addToIntArray(&(indices->added_nodes), addNode(graph, root, label));
+   }
+   else if(strcmp(change, "add") == 0)
+   {
+      /* As in host graph files, the IDs of added edges are ignored. */
+      if(!readNumber(reader, &index) || !expectCharacter(reader, ',')) return false;
+      if(!readDeltaNode(reader, indices, &source) || !expectCharacter(reader, ','))
+         return false;
+      if(!readDeltaNode(reader, indices, &target) || !expectCharacter(reader, ','))
+         return false;
+      if(!readLabel(reader, &label)) return false;
+      addEdge(graph, label, source, target);
+   }
+   else if(strcmp(change, "relabel") == 0 && node)
+   {
+      if(!readDeltaNode(reader, indices, &index)) return false;
+      bool root = readRootMarker(reader);
+      if(!expectCharacter(reader, ',') || !readLabel(reader, &label)) return false;
+      relabelNode(graph, index, label);
+      if(getNode(graph, index)->root != root) changeRoot(graph, index);
+   }
+   else if(strcmp(change, "relabel") == 0)
+   {
+      if(!readDeltaEdge(reader, indices, &index) || !expectCharacter(reader, ',')) return false;
+      if(!readLabel(reader, &label)) return false;
+      relabelEdge(graph, index, label);
+   }
+   else
+   {
+      /* Only base items are removed: the items that a delta adds are not in
+       * its base graph. */
+      int id;
+      if(!readNumber(reader, &id)) return false;
+      int bound = node ? indices->base_nodes : indices->base_edges;
+      index = id >= bound ? -1 : node ? indices->nodes[id] : indices->edges[id];
+      if(index < 0) return loaderError(reader, "undefined or removed base item");
+      if(node)
+      {
+         Node *removed = getNode(graph, index);
+         if(removed->indegree > 0 || removed->outdegree > 0)
+            return loaderError(reader, "removed node has incident edges");
+         removeNode(graph, index);
+         indices->nodes[id] = -1;
+      }
+      else
+      {
+         removeEdge(graph, index);
+         indices->edges[id] = -1;
+      }
+   }
+   return expectCharacter(reader, ')');
+}
+
+static bool readDelta(HostReader *reader, Graph *graph, DeltaIndices *indices)
+{
+   const char *word;
+   int length = readWord(reader, &word), nodes, edges;
+   if(!equalWord(word, length, "delta")) return loaderError(reader, "expected 'delta'");
+   if(!expectCharacter(reader, '[') || !readNumber(reader, &nodes) ||
+      !expectCharacter(reader, '|') || !readNumber(reader, &edges) ||
+      !expectCharacter(reader, ']')) return false;
+   if(nodes != indices->base_nodes || edges != indices->base_edges)
+      return loaderError(reader, "the host graph is not the base graph of the delta");
+   while(true)
+   {
+      skipLayout(reader);
+      if(reader->position >= reader->end) return true;
+      const char *change;
+      length = readWord(reader, &word);
+      if(equalWord(word, length, "add")) change = "add";
+      else if(equalWord(word, length, "relabel")) change = "relabel";
+      else if(equalWord(word, length, "remove")) change = "remove";
+      else return loaderError(reader, "expected 'add', 'relabel' or 'remove'");
+      length = readWord(reader, &word);
+      bool node = equalWord(word, length, "node");
+      if(!node && !equalWord(word, length, "edge"))
+         return loaderError(reader, "expected 'node' or 'edge'");
+      if(!expectCharacter(reader, '(')) return false;
+      if(!readDeltaChange(reader, graph, indices, change, node)) return false;
+   }
+}
+
+bool applyGraphDelta(Graph *graph, string delta_file)
+{
+   size_t size;
+   bool mapped;
+   char *text = openHostFile(delta_file, &size, &mapped);
+   if(text == NULL) return false;
+
+   HostReader reader;
+   initialiseReader(&reader, delta_file);
+   reader.text = reader.position = text;
+   reader.end = text + size;
+   DeltaIndices indices;
+   indices.base_nodes = graph->number_of_nodes;
+   indices.base_edges = graph->number_of_edges;
+   indices.nodes = malloc((indices.base_nodes + 1) * sizeof(int));
+   indices.edges = malloc((indices.base_edges + 1) * sizeof(int));
+   if(indices.nodes == NULL || indices.edges == NULL)
+   {
+      print_to_log("Error (applyGraphDelta): malloc failure.\n");
+      exit(1);
+   }
+   indices.added_nodes = makeIntArray(16);
+   int index, count = 0;
+   for(index = 0; index < graph->nodes.size; index++)
+      if(getNode(graph, index)->index >= 0) indices.nodes[count++] = index;
+   count = 0;
+   for(index = 0; index < graph->edges.size; index++)
+      if(getEdge(graph, index)->index >= 0) indices.edges[count++] = index;
+
+   bool applied = readDelta(&reader, graph, &indices);
+   /* The graph is numbered densely, as it would be if it were loaded from the
+    * printed result. */
+   if(applied) compactGraph(graph);
+   free(indices.nodes);
+   free(indices.edges);
+   free(indices.added_nodes.items);
+   free(reader.atoms);
+   closeHostFile(text, size, mapped);
+   return applied;
+}
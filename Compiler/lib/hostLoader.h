@@ -0,0 +1,140 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ==================
+  Host Loader Module
+  ==================
+
+  Reads and writes the host graphs of GP 2 programs. Host graphs are read
+  either from their textual description,
+  [ (id, label) ... | (id, source, target, label) ... ], or from the binary
+  host graph format described below, which is written by printBinaryGraph.
+  The host graph file is mapped into memory. A text graph is read twice: the
+  first pass counts the nodes and edges of the graph, so that the node and
+  edge arrays are allocated once at their final size, and the second pass
+  adds the items to the graph, mapping the node IDs of the file to node
+  indices through a hash table, so node IDs need not be small or contiguous.
+  A large text graph may instead be read by several threads, each reading a
+  share of the text into arrays from which the graph is built in parallel
+  (see loader_threads).
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_HOST_LOADER_H
+#define INC_HOST_LOADER_H
+
+#include "common.h"
+#include "graph.h"
+#include "label.h"
+
+/* The host graph of a GP 2 program, defined in the generated main.c. */
+extern __thread struct Graph *host;
+
+/* The binary host graph format stores a graph as a header followed by
+ * sections of 32-bit integers, in the byte order of the machine that wrote it.
+ * The header is the magic "GP2B", the format version, the byte order mark
+ * 0x01020304, and the numbers of nodes, edges, root nodes, strings, string
+ * bytes, lists and atoms. The sections are, in order:
+ *
+ * - The strings: the length of each string, then the text of all strings
+ *   without terminators.
+ * - The label table: the length of each list, then all atoms of the lists,
+ *   each as a pair (type, value). The type is 'i' or 's', and the value of a
+ *   string atom is its string number. Each distinct list is stored once, as
+ *   in the list store.
+ * - The nodes: the mark of each node, as one byte per node, then the list
+ *   number of the label of each node, or -1 for the empty list, then the node
+ *   numbers of the root nodes.
+ * - The edges: the mark of each edge, as one byte per edge, then the list
+ *   numbers of the labels, the source node numbers and the target node
+ *   numbers of the edges.
+ *
+ * Nodes and edges are numbered from 0 in the order of their indices, as in
+ * printGraph. Sections of bytes are padded to a multiple of 4 bytes, so that
+ * the integer sections of a mapped file are aligned. */
+#define BINARY_GRAPH_VERSION 1
+
+/* The number of threads that read a text host graph of at least 1MB, set by
+ * the runtime's -P flag; 0 selects a thread per online processor. The threads
+ * divide the text at line breaks and read the items of their shares into
+ * arrays, numbering the distinct label texts in a shared lock-free table. The
+ * lists of the labels are made once per distinct text by the loading thread,
+ * which owns the list store, and the graph is built by buildGraph. The graph
+ * equals the one the serial loader makes. A text that the threads cannot
+ * read, such as one that is not a valid host graph, is read again by the
+ * serial loader, which reports any error. */
+extern int loader_threads;
+
+/* Returns the graph described by the passed host graph file, or NULL if the
+ * file cannot be read or is not a valid host graph. In the latter case the
+ * position and cause of the error are printed to stderr. Files that begin with
+ * the magic of the binary format are read as binary graphs. */
+Graph *loadHostGraph(string host_file);
+
+/* Writes the graph in the binary host graph format. */
+void printBinaryGraph(Graph *graph, FILE *file);
+
+/* A delta describes a graph by its changes to a base graph:
+ *
+ * delta [ <base nodes> | <base edges> ]
+ * add node (id[(R)], label)
+ * add edge (id, source, target, label)
+ * relabel node (id[(R)], label)
+ * relabel edge (id, label)
+ * remove edge (id)
+ * remove node (id)
+ *
+ * The items of the base graph are numbered from 0 in the order of their
+ * indices, as by printGraph and printBinaryGraph, so that the IDs of a delta
+ * name the items of the printed or binary base graph in the order of the file.
+ * The added nodes are numbered consecutively after the base nodes, and the
+ * IDs of added edges are ignored. A relabelled node takes the root flag of its
+ * change as well as the label. printGraphDelta writes the changes in the
+ * order above.
+ *
+ * printGraphDelta writes the delta from base to graph, where base is a
+ * snapshot of a graph taken after keyGraphItems and graph is a later state of
+ * the same graph: the items of the graph with print keys are the base items
+ * they were keyed from (see keyGraphItems), and the other items are added.
+ *
+ * applyGraphDelta applies the changes of the delta file to the graph, which
+ * must be the base graph as loaded from its printed or binary form, and
+ * compacts the graph. Returns false if the file cannot be read or is not a
+ * delta of the graph, after printing the position and cause of the error to
+ * stderr; the graph is then left partly changed. */
+void printGraphDelta(Graph *base, Graph *graph, FILE *file);
+bool applyGraphDelta(Graph *graph, string delta_file);
+
+/* A stream of host graphs in either format, read one after another from a file
+ * descriptor such as stdin, a pipe or a socket. A text graph ends at its closing
+ * bracket, and the length of a binary graph is given by its header, so the
+ * graphs of a stream need no separators. The buffers of a stream are reused
+ * for each graph read from it. */
+typedef struct HostStream HostStream;
+
+/* Opens the named file as a host graph stream. The name "-" opens stdin.
+ * Returns NULL if the file cannot be opened. */
+HostStream *openHostStream(string name);
+
+/* Reads the next graph of the stream into *graph. Returns 1 if a graph was
+ * read and 0 at the end of the stream. Returns -1 if the next graph of the
+ * stream is not a valid host graph: the error is printed to stderr and the
+ * graph is skipped. */
+int readHostStream(HostStream *stream, Graph **graph);
+void closeHostStream(HostStream *stream);
+
+#endif /* INC_HOST_LOADER_H */
@@ -15,217 +15,366 @@
 
 #include "label.h"
 
+#include <stdint.h>
+
 HostLabel blank_label = {NONE, 0, NULL};
 
-#ifdef LIST_HASHING
-Bucket **list_store = NULL;
-
-/* The list hash table has 400 buckets. It is structured as follows:
- * Lists of length 1 occupy buckets 0 - 99.
- * Lists of length 2 occupy buckets 100 - 199.
- * Lists of length 3 occupy buckets 200 - 299.
- * Lists of length > 3 occupy buckets 300 - 399.
- * The first unit in the first atom (an integer or the first character of a string)
- * gives the index to add to the 'base' (the appropriate multiple of 100) as defined
- * in the function. */
-static unsigned hashHostList(HostAtom *list, int length)
+/* Host lists are allocated from pools of objects of a fixed size.
+ * A pool carves its objects out of slabs of POOL_SLAB_OBJECTS objects and keeps
+ * freed objects on a free list for reuse, so that building and removing host
+ * lists in rewriting loops does not call malloc and free for every list. The
+ * first word of a free object links it to the next free object. The first word
+ * of a slab links it to the previously allocated slab. 
+ *
+ * There is one list pool for each list length up to POOL_LIST_LENGTHS. Longer
+ * lists are allocated with malloc. */
+#define POOL_SLAB_OBJECTS 1024
+#define POOL_LIST_LENGTHS 4
+
+typedef struct Pool {
+   size_t object_size;
+   void *free_objects;
+   void *slabs;
+} Pool;
+
+#define LIST_SIZE(length) (sizeof(HostList) + (length) * sizeof(HostAtom))
+
+static __thread Pool list_pools[POOL_LIST_LENGTHS] = {
+   {LIST_SIZE(1), NULL, NULL}, {LIST_SIZE(2), NULL, NULL},
+   {LIST_SIZE(3), NULL, NULL}, {LIST_SIZE(4), NULL, NULL}
+};
+
+static void *allocateFromPool(Pool *pool)
+{
+   if(pool->free_objects == NULL)
+   {
+      char *slab = malloc(sizeof(void *) + POOL_SLAB_OBJECTS * pool->object_size);
+      if(slab == NULL)
+      {
+         print_to_log("Error (allocateFromPool): malloc failure.\n");
+         exit(1);
+      }
+      *(void **)slab = pool->slabs;
+      pool->slabs = slab;
+      char *objects = slab + sizeof(void *);
+      int index;
+      for(index = POOL_SLAB_OBJECTS - 1; index >= 0; index--)
+      {
+         void *object = objects + index * pool->object_size;
+         *(void **)object = pool->free_objects;
+         pool->free_objects = object;
+      }
+   }
+   void *object = pool->free_objects;
+   pool->free_objects = *(void **)object;
+   return object;
+}
+
+static void returnToPool(Pool *pool, void *object)
 {
-   unsigned hash = 0;
+   *(void **)object = pool->free_objects;
+   pool->free_objects = object;
+}
+
+static void freePool(Pool *pool)
+{
+   while(pool->slabs != NULL)
+   {
+      void *previous = *(void **)pool->slabs;
+      free(pool->slabs);
+      pool->slabs = previous;
+   }
+   pool->free_objects = NULL;
+}
+
+/* The symbol table is an open-addressing hash table of symbols with linear
+ * probing. Its size is a power of two, and it is doubled when it becomes half
+ * full. */
+#define SYMBOL_TABLE_INITIAL_SIZE 1024
+
+static __thread Symbol **symbol_table = NULL;
+static __thread int symbol_table_size = 0;
+static __thread int symbol_count = 0;
+
+/* FNV-1a. */
+static unsigned hashString(const char *str, int length)
+{
+   unsigned hash = 2166136261u;
    int index;
    for(index = 0; index < length; index++)
    {
-      HostAtom atom = list[index];
-      int value = atom.type == 'i' ? atom.num : atom.str[0];
-      hash = ((hash << 5) + hash) + value; /* hash = hash * 33 + value */
+      hash ^= (unsigned char)str[index];
+      hash *= 16777619u;
    }
-   return hash % LIST_TABLE_SIZE ;
+   return hash;
 }
-#endif
 
-static HostList *appendHostAtom(HostList *list, HostAtom atom, bool free_strings)
+static void growSymbolTable(void)
 {
-   HostListItem *new_item = malloc(sizeof(HostListItem));
-   if(new_item == NULL)
+   int new_size = symbol_table_size == 0 ? SYMBOL_TABLE_INITIAL_SIZE : 
+                  2 * symbol_table_size;
+   Symbol **new_table = calloc(new_size, sizeof(Symbol *));
+   if(new_table == NULL)
    {
-      print_to_log("Error (appendAtom): malloc failure.\n");
+      print_to_log("Error (growSymbolTable): malloc failure.\n");
       exit(1);
    }
-   new_item->atom = atom;
-   if(atom.type == 's') 
+   int index;
+   for(index = 0; index < symbol_table_size; index++)
    {
-      if(free_strings) new_item->atom.str = atom.str;
-      else new_item->atom.str = strdup(atom.str);
+      Symbol *symbol = symbol_table[index];
+      if(symbol == NULL) continue;
+      unsigned slot = symbol->hash & (new_size - 1);
+      while(new_table[slot] != NULL) slot = (slot + 1) & (new_size - 1);
+      new_table[slot] = symbol;
    }
-   new_item->next = NULL;
+   free(symbol_table);
+   symbol_table = new_table;
+   symbol_table_size = new_size;
+}
 
-   if(list == NULL)
+string internSubstring(const char *str, int length)
+{
+   if(2 * (symbol_count + 1) > symbol_table_size) growSymbolTable();
+   unsigned hash = hashString(str, length);
+   unsigned slot = hash & (symbol_table_size - 1);
+   while(symbol_table[slot] != NULL)
+   {
+      Symbol *symbol = symbol_table[slot];
+      if(symbol->hash == hash && symbol->length == length &&
+         memcmp(symbol->text, str, length) == 0) return symbol->text;
+      slot = (slot + 1) & (symbol_table_size - 1);
+   }
+   Symbol *symbol = malloc(sizeof(Symbol) + length + 1);
+   if(symbol == NULL)
    {
-      new_item->prev = NULL;
-      HostList *new_list = malloc(sizeof(HostList));
-      if(new_list == NULL)
+      print_to_log("Error (internSubstring): malloc failure.\n");
+      exit(1);
+   }
+   symbol->id = symbol_count++;
+   symbol->length = length;
+   symbol->hash = hash;
+   memcpy(symbol->text, str, length);
+   symbol->text[length] = '\0';
+   symbol_table[slot] = symbol;
+   return symbol->text;
+}
+
+string internString(string str)
+{
+   return internSubstring(str, strlen(str));
+}
+
+static void freeSymbolTable(void)
+{
+   int index;
+   for(index = 0; index < symbol_table_size; index++) free(symbol_table[index]);
+   free(symbol_table);
+   symbol_table = NULL;
+   symbol_table_size = 0;
+   symbol_count = 0;
+}
+
+/* Replaces the strings in the array by their interned copies. */
+static void internAtoms(HostAtom *array, int length, bool free_strings)
+{
+   int index;
+   for(index = 0; index < length; index++)
+   {
+      if(array[index].type != 's') continue;
+      string symbol = internString(array[index].str);
+      if(free_strings) free(array[index].str);
+      array[index].str = symbol;
+   }
+}
+
+/* Compares two arrays of atoms with interned strings. */
+static bool equalAtoms(HostAtom *left, HostAtom *right, int length)
+{
+   int index;
+   for(index = 0; index < length; index++)
+   {
+      if(left[index].type != right[index].type) return false;
+      if(left[index].type == 'i')
       {
-         print_to_log("Error (appendAtom): malloc failure.\n");
-         exit(1);
+         if(left[index].num != right[index].num) return false;
       }
-      new_list->hash = -1;
-      new_list->first = new_item;
-      new_list->last = new_item;
-      return new_list;
+      else if(left[index].str != right[index].str) return false;
    }
-   else
+   return true;
+}
+
+#ifdef LIST_HASHING
+/* The list store is an open-addressing hash table of host lists with linear
+ * probing. Its size is a power of two, and it is doubled when its load factor
+ * exceeds LIST_STORE_MAX_LOAD percent. Lists are removed by shifting the
+ * following lists of the probe sequence back, so the table has no tombstones. */
+#define LIST_STORE_INITIAL_SIZE 1024
+#define LIST_STORE_MAX_LOAD 70
+
+static __thread HostList **list_store = NULL;
+static __thread int list_store_size = 0;
+static __thread int list_store_count = 0;
+static __thread int list_store_resizes = 0;
+static __thread long list_store_lookups = 0;
+static __thread long list_store_probes = 0;
+
+static unsigned mixHash(unsigned hash)
+{
+   hash ^= hash >> 16;
+   hash *= 0x85ebca6bu;
+   hash ^= hash >> 13;
+   hash *= 0xc2b2ae35u;
+   hash ^= hash >> 16;
+   return hash;
+}
+
+/* Hashes every atom of the list: integers by value and strings by symbol ID,
+ * which identifies an interned string. */
+static unsigned hashHostList(HostAtom *list, int length)
+{
+   unsigned hash = length;
+   int index;
+   for(index = 0; index < length; index++)
    {
-      list->last->next = new_item;
-      new_item->prev = list->last;
-      list->last = new_item;
-      return list;
+      HostAtom *atom = &list[index];
+      unsigned value = atom->type == 'i' ? (unsigned)atom->num : 
+                                           (unsigned)symbolId(atom->str);
+      hash = mixHash(hash ^ value) + (unsigned char)atom->type;
    }
+   return mixHash(hash);
 }
 
-#ifdef LIST_HASHING
-/* Create a new bucket, allocate a list defined by the function arguments, and
- * point the bucket to that list. */
-static Bucket *makeBucket(HostAtom *array, int length, bool free_strings)
+static void growListStore(void)
 {
-   Bucket *bucket = malloc(sizeof(Bucket));
-   if(bucket == NULL)
+   int new_size = list_store_size == 0 ? LIST_STORE_INITIAL_SIZE : 
+                  2 * list_store_size;
+   HostList **new_store = calloc(new_size, sizeof(HostList *));
+   if(new_store == NULL)
    {
-      print_to_log("Error (makeBucket): malloc failure.\n");
+      print_to_log("Error (growListStore): malloc failure.\n");
       exit(1);
    }
-   HostList *list = NULL;
    int index;
-   for(index = 0; index < length; index++) 
-      list = appendHostAtom(list, array[index], free_strings);
-   bucket->list = list;
-   bucket->reference_count = 1;
-   bucket->next = NULL;
-   bucket->prev = NULL;
-   return bucket;
+   for(index = 0; index < list_store_size; index++)
+   {
+      HostList *list = list_store[index];
+      if(list == NULL) continue;
+      unsigned slot = list->hash & (new_size - 1);
+      while(new_store[slot] != NULL) slot = (slot + 1) & (new_size - 1);
+      new_store[slot] = list;
+   }
+   if(list_store != NULL) list_store_resizes++;
+   free(list_store);
+   list_store = new_store;
+   list_store_size = new_size;
 }
 #endif
 
+/* Allocates a host list with the atoms in the passed array, whose strings
+ * must be interned. */
+static HostList *allocateHostList(HostAtom *array, int length)
+{
+   if(length == 0) return NULL;
+   HostList *list = NULL;
+   if(length <= POOL_LIST_LENGTHS) list = allocateFromPool(&list_pools[length - 1]);
+   else
+   {
+      list = malloc(LIST_SIZE(length));
+      if(list == NULL)
+      {
+         print_to_log("Error (allocateHostList): malloc failure.\n");
+         exit(1);
+      }
+   }
+   list->hash = 0;
+   list->reference_count = 1;
+   list->length = length;
+   memcpy(list->atoms, array, length * sizeof(HostAtom));
+   return list;
+}
+
 /* Adds a host list, represented by the passed array and its length, to the hash
  * table. The array and the length is passed to the hashing function. 
  *
  * The free_strings flag is true if the strings in the passed array have already
- * been allocated by the caller. It controls the freeing of such strings in the
- * case that the passed list already exists in the hash table. 
+ * been allocated by the caller. Such strings are freed once they are interned.
  * This is a necessary inconvenience: addListToStore is called by the Bison/Flex generated
  * host graph parser which requires the strings it parses to be strdup'd (otherwise 
  * things go wrong). Calls to addListToStore in other contexts pass arrays with 
  * automatic strings which should not be freed. */
 HostList *makeHostList(HostAtom *array, int length, bool free_strings)
 {
+   if(length == 0) return NULL;
+   internAtoms(array, length, free_strings);
+   return makeInternedHostList(array, length);
+}
+
+HostList *makeInternedHostList(HostAtom *array, int length)
+{
+   if(length == 0) return NULL;
    #ifdef LIST_HASHING
-      if(list_store == NULL)
-      {
-         list_store = calloc(LIST_TABLE_SIZE, sizeof(Bucket*));
-         if(list_store == NULL)
-         {
-            print_to_log("Error(addListToStore): malloc failure.\n");
-            exit(1);
-         }
-      }
-      int hash = hashHostList(array, length);
-      if(list_store[hash] == NULL)
-      {
-         Bucket *bucket = makeBucket(array, length, free_strings);
-         list_store[hash] = bucket;
-         bucket->list->hash = hash;
-         return bucket->list;
-      }
-      /* Check each list in the bucket for equality with the list represented
-       * by the passed array. */
-      else
+      if(100 * (list_store_count + 1) > LIST_STORE_MAX_LOAD * list_store_size)
+         growListStore();
+      unsigned hash = hashHostList(array, length);
+      unsigned slot = hash & (list_store_size - 1);
+      list_store_lookups++;
+      while(list_store[slot] != NULL)
       {
-         Bucket *bucket = list_store[hash];
-         int index;
-         bool make_bucket = true;
-         while(bucket != NULL)
-         {
-            HostListItem *item = bucket->list->first;
-            for(index = 0; index < length; index++) 
-            {
-               if(item == NULL) break;
-               HostAtom atom = array[index];
-               if(item->atom.type != atom.type) break;
-               if(item->atom.type == 'i') 
-               {
-                  if(item->atom.num != atom.num) break;
-               }
-               else
-               {
-                  if(strcmp(item->atom.str, atom.str) != 0) break;
-               }
-               item = item->next;
-            }
-            /* The lists are equal if and only if the ends of both lists are reached.
-             * If an atom comparison failed, the for loop breaks before the end of
-             * either list is reached. If the array is shorter, then the for loop
-             * exits before item reaches its terminating NULL pointer. If the list
-             * is shorter, the first line in the for loop body will cause the loop
-             * to break before index == length. */
-            if(index == length && item == NULL)
-            {
-               make_bucket = false; 
-               break;
-            }
-            /* Exit the loop while maintaining the pointer to the last item in the
-             * bucket list, because a list is going to be appended! */
-            if(bucket->next == NULL) break;
-            bucket = bucket->next;
-         }
-         /* If control reaches this point, then no list in the bucket is equal to
-          * the passed list. Make a new list! */
-         if(make_bucket)
-         {
-            Bucket *new_bucket = makeBucket(array, length, free_strings);
-            bucket->next = new_bucket;
-            new_bucket->prev = bucket;
-            new_bucket->list->hash = hash;
-            return new_bucket->list;
-         }
-         else 
+         HostList *list = list_store[slot];
+         list_store_probes++;
+         if(list->hash == hash && list->length == length && 
+            equalAtoms(list->atoms, array, length))
          {
-            bucket->reference_count++;
-            if(free_strings)
-            {
-               for(index = 0; index < length; index++) 
-                  if(array[index].type == 's') free(array[index].str);
-            }
-            return bucket->list;
+            list->reference_count++;
+            return list;
          }
+         slot = (slot + 1) & (list_store_size - 1);
       }
-   #else
-      HostList *list = NULL;
-      int index;
-      for(index = 0; index < length; index++) 
-         list = appendHostAtom(list, array[index], free_strings);
+      /* No list in the table is equal to the passed list. Make a new list! */
+      HostList *list = allocateHostList(array, length);
+      list->hash = hash;
+      list_store[slot] = list;
+      list_store_count++;
       return list;
+   #else
+      return allocateHostList(array, length);
    #endif
 }
 
 #ifdef LIST_HASHING
-/* Returns the bucket containing the passed list. */
-static Bucket *getBucket(HostList *list)
+void addHostList(HostList *list)
 {
-   Bucket *bucket = list_store[list->hash];
-   assert(bucket != NULL);
-   while(bucket != NULL)
-   {
-      if(bucket->list == list) return bucket;
-      bucket = bucket->next;
-   } 
-   return NULL;
+   if(list == NULL) return;
+   list->reference_count++;
 }
 
-void addHostList(HostList *list)
+/* Removes the passed list from the table. Each list after it in its probe
+ * sequence that could have been placed in the vacated slot is moved there. */
+static void deleteFromListStore(HostList *list)
 {
-   if(list == NULL) return;
-   Bucket *bucket = getBucket(list); 
-   /* The passed list is expected to exist in the host table. */
-   assert(bucket != NULL);
-   bucket->reference_count++;
+   unsigned mask = list_store_size - 1;
+   unsigned slot = list->hash & mask;
+   while(list_store[slot] != list) 
+   {
+      /* The passed list is expected to exist in the host table. */
+      assert(list_store[slot] != NULL);
+      slot = (slot + 1) & mask;
+   }
+   unsigned next = (slot + 1) & mask;
+   while(list_store[next] != NULL)
+   {
+      unsigned home = list_store[next]->hash & mask;
+      /* Move the list at next back if its home slot is not in (slot, next]. */
+      if(((next - home) & mask) >= ((next - slot) & mask))
+      {
+         list_store[slot] = list_store[next];
+         slot = next;
+      }
+      next = (next + 1) & mask;
+   }
+   list_store[slot] = NULL;
+   list_store_count--;
 }
 #endif
 
@@ -233,24 +382,71 @@ void removeHostList(HostList *list)
 {
    if(list == NULL) return;
    #ifdef LIST_HASHING
-      Bucket *bucket = getBucket(list); 
-      /* The passed list is expected to exist in the host table. */
-      assert(bucket != NULL);
-      bucket->reference_count--;
-      if(bucket->reference_count == 0)
+      list->reference_count--;
+      if(list->reference_count == 0)
       {
-         /* Delete the bucket. */
-         if(bucket->prev == NULL) list_store[list->hash] = bucket->next;
-         else bucket->prev->next = bucket->next;
-         if(bucket->next != NULL) bucket->next->prev = bucket->prev;
+         deleteFromListStore(list);
          freeHostList(list);
-         free(bucket);
       }
    #else
       freeHostList(list);
    #endif
 }
 
+#ifdef LIST_HASHING
+int hostListStoreCount(void)
+{
+   return list_store_count;
+}
+
+void getListStoreStatistics(ListStoreStatistics *statistics)
+{
+   statistics->size = list_store_size;
+   statistics->lists = list_store_count;
+   statistics->resizes = list_store_resizes;
+   statistics->lookups = list_store_lookups;
+   statistics->probes = list_store_probes;
+   statistics->max_displacement = 0;
+   statistics->mean_displacement = 0.0;
+   long total_displacement = 0;
+   unsigned mask = list_store_size - 1;
+   int index;
+   for(index = 0; index < list_store_size; index++)
+   {
+      HostList *list = list_store[index];
+      if(list == NULL) continue;
+      int displacement = (index - list->hash) & mask;
+      total_displacement += displacement;
+      if(displacement > statistics->max_displacement) 
+         statistics->max_displacement = displacement;
+   }
+   if(list_store_count > 0) 
+      statistics->mean_displacement = (double)total_displacement / list_store_count;
+   statistics->symbols = symbol_count;
+}
+
+void printListStoreStatistics(FILE *file)
+{
+   ListStoreStatistics statistics;
+   getListStoreStatistics(&statistics);
+   fprintf(file, "List store: %d lists in %d slots (load %.2f), %d resizes.\n",
+           statistics.lists, statistics.size, 
+           statistics.size == 0 ? 0.0 : (double)statistics.lists / statistics.size,
+           statistics.resizes);
+   fprintf(file, "List store: %ld lookups, %.2f probes per lookup.\n", 
+           statistics.lookups, statistics.lookups == 0 ? 0.0 :
+           (double)statistics.probes / statistics.lookups);
+   fprintf(file, "List store: displacement mean %.2f, max %d.\n",
+           statistics.mean_displacement, statistics.max_displacement);
+   fprintf(file, "Symbol table: %d strings.\n", statistics.symbols);
+}
+#endif
+
+unsigned hashListPointer(HostList *list)
+{
+   return (unsigned)((uintptr_t)list >> 4) * 2654435761u;
+}
+
 HostLabel makeEmptyLabel(MarkType mark)
 {
    HostLabel label = { .mark = mark, .length = 0, .list = NULL };
@@ -263,6 +459,19 @@ HostLabel makeHostLabel(MarkType mark, int length, HostList *list)
    return label;
 }
 
+LabelClass getLabelClass(HostLabel label)
+{
+   switch(label.length)
+   {
+      case 0: return EMPTY_L;
+      case 1: return label.list->atoms[0].type == 'i' ? INTEGER_L : STRING_L;
+      case 2: return LIST2_L;
+      case 3: return LIST3_L;
+      case 4: return LIST4_L;
+      default: return LONG_LIST_L;
+   }
+}
+
 bool equalHostLabels(HostLabel label1, HostLabel label2)
 {
    if(label1.mark != label2.mark) return false;
@@ -278,15 +487,16 @@ bool equalHostLists(HostAtom *left_list, HostAtom *right_list,
    int index;
    for(index = 0; index < left_length; index++)
    {
-      HostAtom left_atom = left_list[index];
-      HostAtom right_atom = right_list[index];
+      HostAtom *left_atom = &left_list[index];
+      HostAtom *right_atom = &right_list[index];
 
-      if(left_atom.type != right_atom.type) return false;
-      else if(left_atom.type == 'i')
+      if(left_atom->type != right_atom->type) return false;
+      else if(left_atom->type == 'i')
       {
-         if(left_atom.num != right_atom.num) return false;
+         if(left_atom->num != right_atom->num) return false;
       }
-      else if(strcmp(left_atom.str, right_atom.str) != 0) return false;
+      else if(left_atom->str != right_atom->str && 
+              strcmp(left_atom->str, right_atom->str) != 0) return false;
    }
    return true;
 }
@@ -294,20 +504,13 @@ bool equalHostLists(HostAtom *left_list, HostAtom *right_list,
 HostList *copyHostList(HostList *list)
 {
    if(list == NULL) return NULL;
-   HostList *list_copy = NULL;
-   HostListItem *item = list->first;
-   while(item != NULL)
-   {
-      list_copy = appendHostAtom(list_copy, item->atom, false);
-      item = item->next;
-   }
-   return list_copy;
+   return allocateHostList(list->atoms, list->length);
 }
    
 void printHostLabel(HostLabel label, FILE *file) 
 {
    if(label.length == 0) fprintf(file, "empty");
-   else printHostList(label.list->first, file);
+   else printHostList(label.list->atoms, label.length, file);
    if(label.mark == RED) fprintf(file, " # red"); 
    if(label.mark == GREEN) fprintf(file, " # green");
    if(label.mark == BLUE) fprintf(file, " # blue");
@@ -315,47 +518,42 @@ void printHostLabel(HostLabel label, FILE *file)
    if(label.mark == DASHED) fprintf(file, " # dashed");
 }
 
-void printHostList(HostListItem *item, FILE *file)
+void printHostList(HostAtom *atoms, int length, FILE *file)
 {
-   while(item != NULL)
+   int index;
+   for(index = 0; index < length; index++)
    {
-      if(item->atom.type == 'i') fprintf(file, "%d", item->atom.num);
-      else fprintf(file, "\"%s\"", item->atom.str);
-      if(item->next != NULL) fprintf(file, " : ");
-      item = item->next;
+      if(atoms[index].type == 'i') fprintf(file, "%d", atoms[index].num);
+      else fprintf(file, "\"%s\"", atoms[index].str);
+      if(index < length - 1) fprintf(file, " : ");
    }
 }
 
-static void freeHostListItems(HostListItem *item)
-{
-   if(item == NULL) return;
-   if(item->atom.type == 's') free(item->atom.str);
-   freeHostListItems(item->next);
-   free(item);
-}
-
 void freeHostList(HostList *list)
 {
    if(list == NULL) return;
-   freeHostListItems(list->first);
-   free(list);
+   if(list->length <= POOL_LIST_LENGTHS) returnToPool(&list_pools[list->length - 1], list);
+   else free(list);
 }
 
 
 #ifdef LIST_HASHING
-static void freeBuckets(Bucket *bucket)
-{
-   if(bucket == NULL) return; 
-   freeHostList(bucket->list);
-   freeBuckets(bucket->next);
-   free(bucket);
-}
-
 void freeHostListStore(void)
 {
    if(list_store == NULL) return;
    int index;
-   for(index = 0; index < LIST_TABLE_SIZE; index++) freeBuckets(list_store[index]);
+   for(index = 0; index < list_store_size; index++) freeHostList(list_store[index]);
    free(list_store);
+   list_store = NULL;
+   list_store_size = 0;
+   list_store_count = 0;
+   freeLabelPools();
 }
 #endif
+
+void freeLabelPools(void)
+{
+   int index;
+   for(index = 0; index < POOL_LIST_LENGTHS; index++) freePool(&list_pools[index]);
+   freeSymbolTable();
+}
@@ -20,7 +20,7 @@
   ============
 
   Defines data types and operations host labels. Host lists are implemented 
-  as doubly-linked lists, and are stored in a hash table to avoid duplication
+  as packed arrays of atoms, and are stored in a hash table to avoid duplication
   of lists that occur multiple times in a graph over the course of a program
   execution.
 
@@ -29,12 +29,11 @@
 #ifndef INC_LABEL_H
 #define INC_LABEL_H
 
-#define LIST_TABLE_SIZE 100003
-
 #include "common.h"
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h> 
 #include <stdio.h> 
 #include <string.h> 
@@ -49,55 +48,102 @@ typedef struct HostLabel {
 
 extern struct HostLabel blank_label;
 
-typedef struct HostList {
-   int hash;
-   struct HostListItem *first;
-   struct HostListItem *last;
-} HostList;
+/* Host labels are partitioned into classes according to the length of their
+ * list and, for lists of length 1, the type of the atom. Graphs index their
+ * nodes and edges by mark and label class so that the matching code only
+ * examines host items whose labels can match the rule label. */
+typedef enum {EMPTY_L = 0, INTEGER_L, STRING_L, LIST2_L, LIST3_L, LIST4_L,
+              LONG_LIST_L} LabelClass;
+
+/* The strings of host lists are interned: each distinct string is stored once,
+ * in a symbol table, with an integer ID and its length. A string atom of a host
+ * list points to the text of its symbol, so two string atoms of host lists are
+ * equal if and only if their str pointers are equal. Symbols are never freed
+ * before the symbol table itself. */
+typedef struct Symbol {
+   int id;
+   int length;
+   unsigned hash;
+   char text[];
+} Symbol;
+
+/* Returns the text of the symbol for the passed string, adding the string to
+ * the symbol table if it is not already there. The passed string is not
+ * retained. */
+string internString(string str);
+/* As internString, for the first length characters of str, which need not be
+ * null-terminated. */
+string internSubstring(const char *str, int length);
+
+/* The following macros operate on interned strings only. */
+#define getSymbol(symbol) ((Symbol *)((symbol) - offsetof(Symbol, text)))
+#define symbolId(symbol) (getSymbol(symbol)->id)
+#define symbolLength(symbol) (getSymbol(symbol)->length)
 
 typedef struct HostAtom {
    char type; /* (i)nteger or (s)tring */
    union {
       int num;
-      string str;
+      string str; /* Interned in host lists. */
    };
 } HostAtom;
 
-typedef struct HostListItem {
-   struct HostAtom atom;
-   struct HostListItem *next;
-   struct HostListItem *prev;
-} HostListItem;
-
-typedef struct Bucket {
-   HostList *list;
+/* A host list is a single allocation holding its length, its hash and its
+ * atoms in a contiguous array, so that the atom at position i of a list is
+ * list->atoms[i]. Host lists are never empty: the empty list is represented
+ * by a NULL list pointer. */
+typedef struct HostList {
+   unsigned hash;
    int reference_count;
-   struct Bucket *next;
-   struct Bucket *prev;
-} Bucket;
+   int length;
+   HostAtom atoms[];
+} HostList;
 
-/* Hash table to store lists at runtime. Collisions are handled by separate chaining
- * implemented by singly-linked lists ("buckets" as defined above). Lists are added
- * to the host table by making an array of HostAtoms representing the list and 
- * passing it to makeHostList. In this way, each specific list is allocated to heap
- * exactly once and has a single point of reference. */
-extern Bucket **list_store;
+/* Hash table to store lists at runtime (the list store). Lists are added to the
+ * table by making an array of HostAtoms representing the list and passing it to
+ * makeHostList. In this way, each specific list is allocated to heap exactly once
+ * and has a single point of reference. The table is hashed on the full content
+ * of the list and grows with the number of lists. */
+typedef struct ListStoreStatistics {
+   int size;             /* Number of slots. */
+   int lists;            /* Number of occupied slots. */
+   int resizes;
+   long lookups;         /* Calls to makeHostList. */
+   long probes;          /* Lists compared by those calls. */
+   /* Distance of each list from the slot its hash maps to. */
+   int max_displacement;
+   double mean_displacement;
+   int symbols;          /* Number of interned strings. */
+} ListStoreStatistics;
+
+void getListStoreStatistics(ListStoreStatistics *statistics);
+void printListStoreStatistics(FILE *file);
+/* The number of lists in the store, without the scan of getListStoreStatistics. */
+int hostListStoreCount(void);
 
 /* If list hashing is enabled, makeHostList returns a pointer to the HostList represented 
  * by the passed array from the hash table (list_store). If not, the function returns a
- * pointer to a newly-allocated HostList. */
+ * pointer to a newly-allocated HostList. The strings in the array are replaced by their
+ * interned copies, and are freed if free_strings is true. */
 HostList *makeHostList(HostAtom *array, int length, bool free_strings);
+/* As makeHostList, for an array whose strings are already interned. Used by the
+ * host graph loader, which interns strings as it reads them. */
+HostList *makeInternedHostList(HostAtom *array, int length);
 /* Expects the passed pointer to exist in the list hash table. Increments the reference
- * count of the list's bucket. */
+ * count of the list. */
 void addHostList(HostList *list);
 /* Expects the passed pointer to exist in the list hash table. Decrements the reference
- * count of the list's bucket. Deletes/frees the list and its containing bucket if
- * the new reference count is 0. */
+ * count of the list. Deletes/frees the list if the new reference count is 0. */
 void removeHostList(HostList *list);
 
+/* Hashes the address of a host list, for the tables of the runtime that are
+ * keyed by list pointer. */
+unsigned hashListPointer(HostList *list);
+
 /* Called at runtime to build labels. */
 HostLabel makeEmptyLabel(MarkType mark);
 HostLabel makeHostLabel(MarkType mark, int length, HostList *list);
+LabelClass getLabelClass(HostLabel label);
 
 /* Used to determine whether a node or edge needs relabelling, and to evaluate
  * the edge predicate if a label argument is provided. */
@@ -109,9 +155,13 @@ bool equalHostLists(HostAtom *left_list, HostAtom *right_list,
 HostList *copyHostList(HostList *list);
 
 void printHostLabel(HostLabel label, FILE *file);
-void printHostList(HostListItem *item, FILE *file);
+void printHostList(HostAtom *atoms, int length, FILE *file);
 
 void freeHostList(HostList *list);
+/* Also releases the label pools. */
 void freeHostListStore(void);
+/* Releases the slabs from which host lists are allocated, and the
+ * symbol table. No host list or interned string may be used afterwards. */
+void freeLabelPools(void);
 
 #endif /* INC_LABEL_H */
@@ -15,6 +15,205 @@
 
 #include "morphism.h"
 
+#include <limits.h>
+#include <time.h>
+
+/* The default size of a chunk of a morphism's scratch arena. Longer strings
+ * get a chunk of their own size. */
+#define SCRATCH_CHUNK_SIZE 4096
+
+/* The state of the generator of sampleCandidate. It is never 0. */
+static __thread uint64_t sample_state = 0x9E3779B97F4A7C15ULL;
+
+void seedMatchSampling(unsigned seed)
+{
+   /* One step of splitmix64 spreads the bits of small seeds over the state. */
+   uint64_t state = (uint64_t)seed + 0x9E3779B97F4A7C15ULL;
+   state = (state ^ (state >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   state = (state ^ (state >> 27)) * 0x94D049BB133111EBULL;
+   state ^= state >> 31;
+   sample_state = state != 0 ? state : 0x9E3779B97F4A7C15ULL;
+}
+
+/* xorshift64*. The high 32 bits of the output are scaled to the bound by a
+ * multiplication instead of a division. */
+int sampleCandidate(int bound)
+{
+   sample_state ^= sample_state >> 12;
+   sample_state ^= sample_state << 25;
+   sample_state ^= sample_state >> 27;
+   uint64_t bits = (sample_state * 0x2545F4914F6CDD1DULL) >> 32;
+   return (int)((bits * (uint64_t)bound) >> 32);
+}
+
+MatchBudget global_match_budget = {NULL, 0, 0, 0};
+__thread long match_steps = LONG_MAX;
+
+/* A search with a time limit runs in slices of this many steps, after each of
+ * which the clock is read. */
+#define BUDGET_SLICE 4096
+
+static __thread MatchBudget *search_budget = NULL;
+/* The steps of the search beyond the current slice, and its deadline on the
+ * monotonic clock in nanoseconds, 0 if it has no time limit. */
+static __thread long search_steps = 0;
+static __thread uint64_t search_deadline = 0;
+static __thread bool search_exceeded = false;
+
+static uint64_t budgetClock(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/* Moves up to one slice of the search's steps into match_steps, less the step
+ * being taken. */
+static void nextBudgetSlice(void)
+{
+   long slice = search_deadline == 0 || search_steps < BUDGET_SLICE ? 
+                search_steps : BUDGET_SLICE;
+   search_steps -= slice;
+   match_steps = slice;
+}
+
+void startMatchBudget(MatchBudget *budget)
+{
+   long steps = budget->steps > 0 ? budget->steps : global_match_budget.steps;
+   long milliseconds = budget->milliseconds > 0 ? budget->milliseconds :
+                       global_match_budget.milliseconds;
+   search_budget = budget;
+   search_exceeded = false;
+   search_steps = steps > 0 ? steps : LONG_MAX;
+   search_deadline = milliseconds > 0 ? 
+                     budgetClock() + (uint64_t)milliseconds * 1000000u : 0;
+   nextBudgetSlice();
+}
+
+bool matchBudgetExceeded(void)
+{
+   if(!search_exceeded)
+   {
+      string limit = NULL;
+      if(search_steps == 0) limit = "steps";
+      else if(search_deadline != 0 && budgetClock() >= search_deadline) limit = "time";
+      if(limit == NULL)
+      {
+         nextBudgetSlice();
+         match_steps--;
+         return false;
+      }
+      search_exceeded = true;
+      search_budget->exceeded++;
+      print_to_log("Rule %s: the search for a match exceeded its %s budget and failed.\n",
+                   search_budget->rule_name, limit);
+      if(search_budget->exceeded == 1)
+         fprintf(stderr, "Warning: a search for a match of rule %s exceeded its %s "
+                 "budget. The rule is treated as having no match.\n",
+                 search_budget->rule_name, limit);
+   }
+   match_steps = 0;
+   return true;
+}
+
+bool setMatchBudget(MatchBudget **budgets, string setting, bool time)
+{
+   MatchBudget *budget = &global_match_budget;
+   string limit = strchr(setting, '=');
+   if(limit == NULL) limit = setting;
+   else
+   {
+      int length = limit - setting;
+      for(; *budgets != NULL; budgets++)
+         if(strncmp((*budgets)->rule_name, setting, length) == 0 &&
+            (*budgets)->rule_name[length] == '\0') break;
+      budget = *budgets;
+      limit++;
+   }
+   char *end = NULL;
+   long value = strtol(limit, &end, 10);
+   if(budget == NULL || end == limit || *end != '\0' || value < 0) return false;
+   if(time) budget->milliseconds = value;
+   else budget->steps = value;
+   return true;
+}
+
+/* Copies the string to the top of the morphism's scratch arena. The search for
+ * a chunk with enough space moves forward through the chain, emptying the
+ * chunks it passes, and appends a new chunk at its end if necessary. */
+static string pushScratchString(Morphism *morphism, string str)
+{
+   size_t length = strlen(str) + 1;
+   ScratchChunk *chunk = morphism->scratch;
+   while(chunk == NULL || chunk->used + length > chunk->size)
+   {
+      if(chunk != NULL && chunk->next != NULL)
+      {
+         chunk = chunk->next;
+         chunk->used = 0;
+         continue;
+      }
+      size_t size = length > SCRATCH_CHUNK_SIZE ? length : SCRATCH_CHUNK_SIZE;
+      ScratchChunk *new_chunk = malloc(sizeof(ScratchChunk) + size);
+      if(new_chunk == NULL)
+      {
+         print_to_log("Error (pushScratchString): malloc failure.\n");
+         exit(1);
+      }
+      new_chunk->prev = chunk;
+      new_chunk->next = NULL;
+      new_chunk->size = size;
+      new_chunk->used = 0;
+      if(chunk != NULL) chunk->next = new_chunk;
+      chunk = new_chunk;
+   }
+   morphism->scratch = chunk;
+   string copy = chunk->data + chunk->used;
+   memcpy(copy, str, length);
+   chunk->used += length;
+   return copy;
+}
+
+/* Pops the passed string, which must be the most recent string in the arena. */
+static void popScratchString(Morphism *morphism, string str)
+{
+   ScratchChunk *chunk = morphism->scratch;
+   while(str < chunk->data || str >= chunk->data + chunk->size)
+   {
+      chunk->used = 0;
+      chunk = chunk->prev;
+      assert(chunk != NULL);
+   }
+   chunk->used = str - chunk->data;
+   morphism->scratch = chunk;
+}
+
+static void resetScratch(Morphism *morphism)
+{
+   ScratchChunk *chunk = morphism->scratch;
+   if(chunk == NULL) return;
+   while(chunk->prev != NULL)
+   {
+      chunk->used = 0;
+      chunk = chunk->prev;
+   }
+   chunk->used = 0;
+   morphism->scratch = chunk;
+}
+
+static void freeScratch(Morphism *morphism)
+{
+   resetScratch(morphism);
+   ScratchChunk *chunk = morphism->scratch;
+   while(chunk != NULL)
+   {
+      ScratchChunk *next = chunk->next;
+      free(chunk);
+      chunk = next;
+   }
+   morphism->scratch = NULL;
+}
+
 Morphism *makeMorphism(int nodes, int edges, int variables)
 {
    Morphism *morphism = malloc(sizeof(Morphism));
@@ -49,6 +248,7 @@ Morphism *makeMorphism(int nodes, int edges, int variables)
 
    morphism->variables = variables;
    morphism->variable_index = 0;
+   morphism->scratch = NULL;
    if(variables > 0) 
    {
       morphism->assignment = calloc(variables, sizeof(Assignment));
@@ -76,27 +276,35 @@ Morphism *makeMorphism(int nodes, int edges, int variables)
 void initialiseMorphism(Morphism *morphism, Graph *graph)
 { 
    int index;
+   /* The matched flags are reset by a new epoch, without visiting the host
+    * items. Only the matched bits of the node columns are cleared one by one. */
+   if(graph != NULL && graph->node_columns != NULL)
+   {
+      uint64_t *matched = graph->node_columns->matched;
+      for(index = 0; index < morphism->nodes; index++)
+      {
+         int host_index = morphism->node_map[index].host_index;
+         if(host_index >= 0) matched[host_index >> 6] &= ~((uint64_t)1 << (host_index & 63));
+      }
+   }
+   if(graph != NULL) resetMatchedFlags(graph);
    for(index = 0; index < morphism->nodes; index++)
    {
-      if(graph != NULL && morphism->node_map[index].host_index >= 0)
-         resetMatchedNodeFlag(graph, morphism->node_map[index].host_index);
       morphism->node_map[index].host_index = -1;
       morphism->node_map[index].assignments = 0;
    }
    for(index = 0; index < morphism->edges; index++)
    {
-      if(graph != NULL && morphism->edge_map[index].host_index >= 0)
-         resetMatchedEdgeFlag(graph, morphism->edge_map[index].host_index);
       morphism->edge_map[index].host_index = -1;
       morphism->edge_map[index].assignments = 0;
    }
    morphism->variable_index = 0;
    for(index = 0; index < morphism->variables; index++)
    {
-      if(morphism->assignment[index].type == 's')
+      if(morphism->assignment[index].type == 's') 
       {
-         free(morphism->assignment[index].str);
          morphism->assignment[index].str = NULL;
+         morphism->assignment[index].scratch = false;
       }
       if(morphism->assignment[index].type == 'l')
       {
@@ -106,6 +314,7 @@ void initialiseMorphism(Morphism *morphism, Graph *graph)
       morphism->assignment[index].type = 'n';
       morphism->assigned_variables[index] = -1;
    }
+   resetScratch(morphism);
 }
 
 void addNodeMap(Morphism *morphism, int left_index, int host_index, int assignments)
@@ -157,6 +366,8 @@ int addIntegerAssignment(Morphism *morphism, int id, int num)
       pushVariableId(morphism, id);
       return 1;
    }
+   /* An atom variable may already be assigned a string. */
+   else if(morphism->assignment[id].type != 'i') return -1;
    else
    {
       if(morphism->assignment[id].num == num) return 0;
@@ -170,10 +381,13 @@ int addStringAssignment(Morphism *morphism, int id, string str)
    if(morphism->assignment[id].type == 'n') 
    {
       morphism->assignment[id].type = 's';
-      morphism->assignment[id].str = strdup(str);
+      morphism->assignment[id].scratch = true;
+      morphism->assignment[id].str = pushScratchString(morphism, str);
       pushVariableId(morphism, id);
       return 1;
    }
+   /* An atom variable may already be assigned an integer. */
+   else if(morphism->assignment[id].type != 's') return -1;
    else
    {
       if(strcmp(morphism->assignment[id].str, str) == 0) return 0;
@@ -181,6 +395,28 @@ int addStringAssignment(Morphism *morphism, int id, string str)
    }
 }
 
+int addSymbolAssignment(Morphism *morphism, int id, string symbol)
+{
+   assert(id < morphism->variables);
+   if(morphism->assignment[id].type == 'n') 
+   {
+      morphism->assignment[id].type = 's';
+      morphism->assignment[id].scratch = false;
+      morphism->assignment[id].str = symbol;
+      pushVariableId(morphism, id);
+      return 1;
+   }
+   else if(morphism->assignment[id].type != 's') return -1;
+   /* Interned strings are equal if and only if they are the same symbol. */
+   else if(morphism->assignment[id].str == symbol) return 0;
+   else if(!morphism->assignment[id].scratch) return -1;
+   else
+   {
+      if(strcmp(morphism->assignment[id].str, symbol) == 0) return 0;
+      else return -1;
+   }
+}
+
 void removeNodeMap(Morphism *morphism, int left_index)
 {
    morphism->node_map[left_index].host_index = -1;
@@ -203,8 +439,10 @@ void removeAssignments(Morphism *morphism, int number)
       int id = popVariableId(morphism);
       if(morphism->assignment[id].type == 's')
       {
-         free(morphism->assignment[id].str);
+         if(morphism->assignment[id].scratch)
+            popScratchString(morphism, morphism->assignment[id].str);
          morphism->assignment[id].str = NULL;
+         morphism->assignment[id].scratch = false;
       }
       if(morphism->assignment[id].type == 'l')
       {
@@ -238,6 +476,55 @@ int lookupEdge(Morphism *morphism, int left_index)
    return morphism->edge_map[left_index].host_index;
 }
 
+bool nodeInMorphism(Morphism *morphism, int host_index)
+{
+   int index;
+   for(index = 0; index < morphism->nodes; index++)
+      if(morphism->node_map[index].host_index == host_index) return true;
+   return false;
+}
+
+bool edgeInMorphism(Morphism *morphism, int host_index)
+{
+   int index;
+   for(index = 0; index < morphism->edges; index++)
+      if(morphism->edge_map[index].host_index == host_index) return true;
+   return false;
+}
+
+void copyMorphism(Morphism *target, Morphism *source)
+{
+   assert(target->nodes == source->nodes && target->edges == source->edges &&
+          target->variables == source->variables);
+   initialiseMorphism(target, NULL);
+   int index;
+   for(index = 0; index < source->nodes; index++)
+      target->node_map[index] = source->node_map[index];
+   for(index = 0; index < source->edges; index++)
+      target->edge_map[index] = source->edge_map[index];
+   for(index = 0; index < source->variables; index++)
+      target->assigned_variables[index] = source->assigned_variables[index];
+   target->variable_index = source->variable_index;
+   /* The assignments are copied in the order they were made, so that the
+    * strings are stacked in the target's arena in the order they are popped. */
+   for(index = 0; index < source->variable_index; index++)
+   {
+      int id = source->assigned_variables[index];
+      Assignment assignment = source->assignment[id];
+      if(assignment.type == 's' && assignment.scratch) 
+         assignment.str = pushScratchString(target, assignment.str);
+      if(assignment.type == 'l')
+      {
+         #ifdef LIST_HASHING
+            addHostList(assignment.list);
+         #else
+            assignment.list = copyHostList(assignment.list);
+         #endif
+      }
+      target->assignment[id] = assignment;
+   }
+}
+
 int getIntegerValue(Morphism *morphism, int id)
 {
    assert(id < morphism->variables);
@@ -260,38 +547,30 @@ int getAssignmentLength(Assignment assignment)
 {
    if(assignment.type != 'l') return 1;
    if(assignment.list == NULL) return 0;
-   HostListItem *item = assignment.list->first;
-   int length = 0;
-   while(item != NULL) 
-   {
-      length++;
-      item = item->next;
-   }
-   return length;
+   return assignment.list->length;
 }
 
 /* If rule_string is a prefix of host_string, return the position in host_string
  * immediately after the end of rule_string. Otherwise return -1. */
-int isPrefix(const string rule_string, const string host_string)
+int isPrefix(const string rule_string, int rule_length, 
+             const string host_string, int host_length)
 {
-   int length = strlen(rule_string);
-   int offset = strlen(host_string) - length;
-   if(offset < 0) return -1;
-   /* strncmp compares rule_string against the first strlen(rule_string) characters
-    * of host_string. */
-   if(!strncmp(host_string, rule_string, length)) return length;
+   if(host_length < rule_length) return -1;
+   /* Compare rule_string against the first rule_length characters of host_string. */
+   if(!memcmp(host_string, rule_string, rule_length)) return rule_length;
    else return -1;
 }
 
 /* If rule_string is a proper suffix of host_string, return the position in 
  * host_string immediately before the start of rule_string. If rule_string
  * equals host_string, return 0. Otherwise return -1. */
-int isSuffix(const string rule_string, const string host_string)
+int isSuffix(const string rule_string, int rule_length, 
+             const string host_string, int host_length)
 {
-   int offset = strlen(host_string) - strlen(rule_string);
+   int offset = host_length - rule_length;
    if(offset < 0) return -1;
-   /* Compare the last strlen(rule_string) characters of str with rule_string. */
-   if(!strcmp(host_string + offset, rule_string)) 
+   /* Compare the last rule_length characters of host_string with rule_string. */
+   if(!memcmp(host_string + offset, rule_string, rule_length)) 
       return offset == 0 ? 0 : offset - 1;
    else return -1;
 }
@@ -331,7 +610,8 @@ void printMorphism(Morphism *morphism)
          if(morphism->assignment[index].type == 'l')
          {
             if(morphism->assignment[index].list == NULL) printf("empty");
-            else printHostList(morphism->assignment[index].list->first, stdout);
+            else printHostList(morphism->assignment[index].list->atoms,
+                               morphism->assignment[index].list->length, stdout);
          }
          printf("\n\n");
       }
@@ -348,8 +628,6 @@ void freeMorphism(Morphism *morphism)
       int index;
       for(index = 0; index < morphism->variables; index++)
       {
-         if(morphism->assignment[index].type == 's') 
-            free(morphism->assignment[index].str);
          #ifdef LIST_HASHING
             if(morphism->assignment[index].type == 'l')
                removeHostList(morphism->assignment[index].list);
@@ -358,6 +636,7 @@ void freeMorphism(Morphism *morphism)
       free(morphism->assignment);
    }
    if(morphism->assigned_variables != NULL) free(morphism->assigned_variables);
+   freeScratch(morphism);
    free(morphism);
 }
 
@@ -41,6 +41,9 @@
 
 typedef struct Assignment {
    char type; /* (n)ot assigned, (i)nteger, (s)tring, (l)ist */
+   /* True if the string is a copy in the morphism's scratch arena, false if
+    * it is an interned host string. */
+   bool scratch;
    union {
       int num;
       string str;
@@ -56,6 +59,20 @@ typedef struct Map {
    int assignments;
 } Map;
 
+/* The strings assigned to variables by matching that are not interned host
+ * strings, namely substrings of host strings, are copied into a scratch
+ * arena owned by the morphism. The arena is a chain of chunks used as a stack:
+ * assignments are removed in the reverse order of their addition, so removing
+ * a string assignment pops its string, and initialiseMorphism, which is called
+ * after each rule application, empties the arena while keeping its chunks. */
+typedef struct ScratchChunk {
+   struct ScratchChunk *prev;
+   struct ScratchChunk *next;
+   size_t size;
+   size_t used;
+   char data[];
+} ScratchChunk;
+
 /* A graph morphism is a set of node-to-node mappings, a set of edge-to-edge
  * mappings and a variable-value assignment. Maps and assignments are
  * stored as static arrays, whose sizes are determined at compile time by
@@ -73,6 +90,9 @@ typedef struct Morphism {
    /* Stack to record the order of variable assignments during rule matching. */
    int *assigned_variables;
    int variable_index;
+
+   /* The chunk of the scratch arena holding the most recent string. */
+   ScratchChunk *scratch;
 } Morphism;
 
 /* Allocates memory for the morphism, and calls initialiseMorphism. */
@@ -82,7 +102,8 @@ Morphism *makeMorphism(int nodes, int edges, int variables);
  * reset the morphism after each rule application. The data in the morphism
  * are reset to their default values. 
  * The host graph is passed as an optional second argument to reset the matched flags
- * of all host graph items matched by the morphism. */
+ * of all host graph items. This takes constant time (see resetMatchedFlags in
+ * graph.h), so it also resets any flags set by other morphisms. */
 void initialiseMorphism(Morphism *morphism, Graph *graph);
 void addNodeMap(Morphism *morphism, int left_index, int host_index, int assignments);
 void removeNodeMap(Morphism *morphism, int left_index);
@@ -101,6 +122,9 @@ void removeEdgeMap(Morphism *morphism, int left_index);
 int addListAssignment(Morphism *morphism, int id, HostList *list);
 int addIntegerAssignment(Morphism *morphism, int id, int num);
 int addStringAssignment(Morphism *morphism, int id, string value);
+/* Assigns an interned string without copying it. Used when a variable matches
+ * a whole string atom of a host list. */
+int addSymbolAssignment(Morphism *morphism, int id, string symbol);
 
 void removeAssignments(Morphism *morphism, int number);
 void pushVariableId(Morphism *morphism, int id);
@@ -109,6 +133,61 @@ int popVariableId(Morphism *morphism);
 int lookupNode(Morphism *morphism, int left_index);
 int lookupEdge(Morphism *morphism, int left_index);
 
+/* Return true if the host item is the image of some item of the morphism.
+ * The parallel matcher tests injectivity with these, since the matched flags
+ * of the host graph are shared by all matching threads. */
+bool nodeInMorphism(Morphism *morphism, int host_index);
+bool edgeInMorphism(Morphism *morphism, int host_index);
+
+/* Resets the target morphism and copies the maps and assignments of the source
+ * morphism into it. Both morphisms must have been made for the same rule. */
+void copyMorphism(Morphism *target, Morphism *source);
+
+/* Sampled matching (the -R flag of the compiler) starts the search for the first
+ * item of a rule at a random candidate. sampleCandidate returns an integer from
+ * 0 to bound - 1 (bound > 0), drawn from a thread-local xorshift generator that
+ * seedMatchSampling seeds, so that the matches chosen by a run can be
+ * reproduced from its seed. */
+void seedMatchSampling(unsigned seed);
+int sampleCandidate(int bound);
+
+/* Match budgets (the -L flag of the compiler) bound the search for a match of a
+ * rule on a host graph on which it backtracks exponentially. A budget limits
+ * the number of candidate host items that one search examines (its steps) and
+ * its running time in milliseconds, 0 being no limit. Each rule has its own
+ * budget, and the limits it leaves at 0 are taken from global_match_budget.
+ * A search that exceeds its budget fails as if the rule had no match, trading
+ * completeness for bounded latency. The failure is written to the log file,
+ * and to stderr at the first failure of the rule, so that a run never appears
+ * to hang in a single search. */
+typedef struct MatchBudget {
+   string rule_name;
+   long steps;
+   long milliseconds;
+   /* The number of searches that exceeded the budget. */
+   unsigned long exceeded;
+} MatchBudget;
+
+extern MatchBudget global_match_budget;
+
+/* The steps left in the current slice of the running search. The generated
+ * matchers decrement it at each candidate and call matchBudgetExceeded when it
+ * falls below 0, so that a search with a time limit reads the clock once per
+ * slice and an unlimited search never calls the function. */
+extern __thread long match_steps;
+
+/* Starts the budget of a search for a match of the rule. */
+void startMatchBudget(MatchBudget *budget);
+/* Starts the next slice of the running search and returns false, or reports
+ * the failure of the search and returns true if its budget is exceeded. It
+ * returns true at every later call of the same search. */
+bool matchBudgetExceeded(void);
+/* Reads a setting "[<rule>=]<limit>" of gp2run's -L (steps) or -W (time) flag
+ * into the budget of the named rule, found in the NULL-terminated array, or
+ * into the global budget if no rule is named. Returns false if the rule is
+ * unknown or the limit is not a non-negative number. */
+bool setMatchBudget(MatchBudget **budgets, string setting, bool time);
+
 /* These functions expect to be passed the id of a variable of the appropriate type. */
 int getIntegerValue(Morphism *morphism, int id);
 string getStringValue(Morphism *morphism, int id);
@@ -116,20 +195,23 @@ Assignment getAssignment(Morphism *morphism, int id);
 /* Used in rule application to get the length of the value matched by a list variable. */
 int getAssignmentLength(Assignment assignment);
 
-/* Used to test string constants in the rule against a host string. If 
- * rule_string is a prefix of the host_string, then the index of the host 
- * character directly after this prefix is returned, so that the caller knows
- * where in the host string to resume matching. 
- * For example, isPrefix("ab", "abcd") returns 2, the index of the first 
+/* Used to test string constants in the rule against a host string. The lengths
+ * of both strings are passed by the caller. If rule_string is a prefix of the
+ * host_string, then the index of the host character directly after this prefix
+ * is returned, so that the caller knows where in the host string to resume
+ * matching. 
+ * For example, isPrefix("ab", 2, "abcd", 4) returns 2, the index of the first 
  * character ('c') after the matched substring ("ab").
  * Returns -1 if it the rule string is not a prefix of the host string. */
-int isPrefix(const string rule_string, const string host_string);
+int isPrefix(const string rule_string, int rule_length, 
+             const string host_string, int host_length);
 
-/* Analogous to isPrefix. Example: isSuffix("cd", "abcd") returns 1, the index
- * of the character ('b') directly preceding the matched suffix ("cd"). 
+/* Analogous to isPrefix. Example: isSuffix("cd", 2, "abcd", 4) returns 1, the
+ * index of the character ('b') directly preceding the matched suffix ("cd"). 
  * The exception is if rule_string equals host_string, in which case 0 is
  * returned. */
-int isSuffix(const string rule_string, const string host_string);
+int isSuffix(const string rule_string, int rule_length, 
+             const string host_string, int host_length);
 
 void printMorphism(Morphism *morphism);
 void freeMorphism(Morphism *morphism);
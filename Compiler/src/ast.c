@@ -526,6 +526,10 @@ GPRule *newASTRule(YYLTYPE location, string name, List *variables,
     rule->predicate_count = 0;
     rule->empty_lhs = false;
     rule->is_predicate = false;
+    rule->batch_apply = false;
+    rule->scan_member = false;
+    rule->reachable = false;
+    rule->label_constants = false;
     return rule;
 }    
 
@@ -288,6 +288,18 @@ typedef struct GPRule {
    int predicate_count;
    bool empty_lhs;
    bool is_predicate;
+   /* Set if the rule is the body of a loop that applies it to sets of
+    * disjoint matches (see markBatchLoops in genProgram.h). */
+   bool batch_apply;
+   /* Set if the rule is a member of a rule set that is matched by one scan of
+    * the host nodes (see markRuleSetScans in genProgram.h). */
+   bool scan_member;
+   /* Set if the constants of the rule's LHS labels are resolved when the
+    * runtime starts (see collectLabelConstants in genLabel.h). */
+   bool label_constants;
+   /* Set if the main program calls the rule (see pruneProgram in
+    * genProgram.h). Code is generated only for reachable rules. */
+   bool reachable;
 } GPRule;
 
 GPRule *newASTRule(YYLTYPE location, string name, List *variables, 
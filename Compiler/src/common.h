@@ -56,6 +56,20 @@ typedef char* string;
 
 extern FILE *log_file;
 extern bool graph_copying;
+extern bool costed_searchplans;
+extern bool adjacency_index;
+extern bool node_columns;
+extern bool resume_matching;
+extern int match_threads;
+extern bool batch_loops;
+extern bool rule_profiling;
+extern bool fused_matching;
+extern bool rule_set_scans;
+extern bool sampled_matching;
+extern bool match_budgets;
+extern bool unity_build;
+extern int rule_modules;
+extern bool shared_library;
 
 /* Bison uses a global variable yylloc of type YYLTYPE to keep track of the 
  * locations of tokens and nonterminals. The scanner will set these values upon
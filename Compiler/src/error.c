@@ -15,6 +15,8 @@
 
 #include "error.h"
 
+#include <time.h>
+
 FILE *log_file = NULL;
 
 void openLogFile(string log_file_name)
@@ -32,3 +34,39 @@ void closeLogFile(void)
    fclose(log_file);
 }
 
+static const string phase_names[COMPILE_PHASES] = {
+   "parsing", "semantic analysis", "program passes", "rule transformation",
+   "rule code generation", "main code generation" };
+static double phase_start[COMPILE_PHASES];
+static double phase_seconds[COMPILE_PHASES];
+
+static double compileClock(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void startPhase(CompilePhase phase)
+{
+   phase_start[phase] = compileClock();
+}
+
+void endPhase(CompilePhase phase)
+{
+   phase_seconds[phase] += compileClock() - phase_start[phase];
+}
+
+void logCompileTimes(void)
+{
+   double total = 0;
+   int phase;
+   print_to_log("Compile times (ms):\n");
+   for(phase = 0; phase < COMPILE_PHASES; phase++)
+   {
+      print_to_log("  %-22s %10.3f\n", phase_names[phase], 1000 * phase_seconds[phase]);
+      total += phase_seconds[phase];
+   }
+   print_to_log("  %-22s %10.3f\n", "total", 1000 * total);
+}
+
@@ -46,4 +46,15 @@
 void openLogFile(string log_file_name);
 void closeLogFile(void);
 
+/* The phases of the compiler, whose times logCompileTimes writes to the log.
+ * The time of a phase is the sum of the intervals between its calls of
+ * startPhase and endPhase, so that a phase run once per rule, such as rule
+ * transformation, is timed over all rules. */
+typedef enum {PARSE_PHASE = 0, ANALYSIS_PHASE, PROGRAM_PHASE, TRANSFORM_PHASE,
+              RULE_PHASE, MAIN_PHASE, COMPILE_PHASES} CompilePhase;
+
+void startPhase(CompilePhase phase);
+void endPhase(CompilePhase phase);
+void logCompileTimes(void);
+
 #endif /* INC_ERROR_H */
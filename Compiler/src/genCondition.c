@@ -16,23 +16,26 @@
 #include "genCondition.h"
 
 /* For each predicate in the condition, generate a boolean value 'bx', where x
- * is the ID of the predicate. The variables are initialised in such a way that
- * the condition always evaluates to true, so that the condition isn't erroneously
- * falsified when one of these variables is modified by the evaluation of a 
- * predicate. */
+ * is the ID of the predicate, and the flag 'evaluatedx' that records whether
+ * bx holds the predicate's value for the current match. The values are 
+ * initialised to the values under which the condition is true, the values 
+ * taken by predicates whose variables are never assigned. Hoisted predicates
+ * need neither. */
 void generateConditionVariables(Condition *condition)
 {
-   static int bool_count = 0;
    switch(condition->type)
    {
-      /* Booleans representing positive predicates are initialised with true. */
       case 'e':
-           PTF("bool b%d = true;\n", bool_count++);
+      {
+           Predicate *predicate = condition->predicate;
+           if(predicate->hoisted) break;
+           PTF("__thread bool b%d = %s;\n", predicate->bool_id,
+               predicate->negated ? "false" : "true");
+           PTF("static __thread bool evaluated%d = false;\n", predicate->bool_id);
            break;
-
-      /* Booleans representing 'not' predicates are initialised with false. */
+      }
       case 'n':
-           PTF("bool b%d = false;\n", bool_count++);
+           generateConditionVariables(condition->neg_condition);
            break;
 
       case 'a':
@@ -48,52 +51,385 @@ void generateConditionVariables(Condition *condition)
    }
 }
 
-/* Generates a boolean expression over the variables generated by the above function.
- * The tree structure of the condition is used to print the correct expression. */
-void generateConditionEvaluator(Condition *condition, bool nested)
+/* The nodes and variables on which a predicate depends. stage is the latest
+ * searchplan position at which one of them is matched. node is the only node
+ * of the predicate, -1 if it has none, and -2 if it has several. */
+typedef struct Dependencies {
+   int stage, node;
+   bool variables;
+   /* The searchplan positions at which the rule's nodes are matched and at 
+    * which the rule's variables are first assigned. */
+   int *node_stages, *variable_stages;
+} Dependencies;
+
+static void addNodeDependency(Dependencies *dependencies, int node)
+{
+   if(dependencies->node_stages[node] > dependencies->stage)
+      dependencies->stage = dependencies->node_stages[node];
+   if(dependencies->node == -1) dependencies->node = node;
+   else if(dependencies->node != node) dependencies->node = -2;
+}
+
+static void addAtomDependencies(Dependencies *dependencies, RuleAtom *atom)
 {
-   static int bool_count = 0;
-   if(!nested)
+   switch(atom->type)
    {
-      PTF("static bool evaluateCondition(void)\n");
-      PTF("{\n");
-      PTFI("return (", 3);
+      case VARIABLE:
+      case LENGTH:
+           if(dependencies->variable_stages[atom->variable.id] > dependencies->stage)
+              dependencies->stage = dependencies->variable_stages[atom->variable.id];
+           dependencies->variables = true;
+           break;
+
+      case INDEGREE:
+      case OUTDEGREE:
+           addNodeDependency(dependencies, atom->node_id);
+           break;
+
+      case NEG:
+           addAtomDependencies(dependencies, atom->neg_exp);
+           break;
+
+      case ADD:
+      case SUBTRACT:
+      case MULTIPLY:
+      case DIVIDE:
+      case CONCAT:
+           addAtomDependencies(dependencies, atom->bin_op.left_exp);
+           addAtomDependencies(dependencies, atom->bin_op.right_exp);
+           break;
+
+      default:
+           break;
+   }
+}
+
+static void addLabelDependencies(Dependencies *dependencies, RuleLabel label)
+{
+   if(label.length <= 0) return;
+   RuleListItem *item = label.list->first;
+   for(; item != NULL; item = item->next) addAtomDependencies(dependencies, item->atom);
+}
+
+/* Records the searchplan position of the first assignment of each variable in
+ * the label. */
+static void setVariableStages(RuleAtom *atom, int *variable_stages, int stage)
+{
+   switch(atom->type)
+   {
+      case VARIABLE:
+           if(variable_stages[atom->variable.id] > stage)
+              variable_stages[atom->variable.id] = stage;
+           break;
+
+      case NEG:
+           setVariableStages(atom->neg_exp, variable_stages, stage);
+           break;
+
+      case CONCAT:
+           setVariableStages(atom->bin_op.left_exp, variable_stages, stage);
+           setVariableStages(atom->bin_op.right_exp, variable_stages, stage);
+           break;
+
+      default:
+           break;
+   }
+}
+
+static bool labelIsIntegerExpression(RuleLabel label);
+
+/* Predicates that are tested on the candidates of a node compare integer
+ * expressions or test for a loop without a label, so that they build no host
+ * lists. */
+static bool filterPredicate(Predicate *predicate)
+{
+   switch(predicate->type)
+   {
+      case GREATER:
+      case GREATER_EQUAL:
+      case LESS:
+      case LESS_EQUAL:
+           return true;
+
+      case EQUAL:
+      case NOT_EQUAL:
+           return labelIsIntegerExpression(predicate->list_comp.left_label) &&
+                  labelIsIntegerExpression(predicate->list_comp.right_label);
+
+      case EDGE_PRED:
+           return predicate->edge_pred.label.length < 0;
+
+      default:
+           return false;
+   }
+}
+
+/* Sets the stage of each predicate of the condition. required is set if the
+ * predicate must hold, or, for a negated predicate, must not hold, for the
+ * condition to hold: the predicate is a conjunct of the condition, possibly 
+ * under a chain of negations of the predicate alone. */
+static void setPredicateStages(Condition *condition, Dependencies *dependencies,
+                               bool required)
+{
+   switch(condition->type)
+   {
+      case 'e':
+      {
+           Predicate *predicate = condition->predicate;
+           dependencies->stage = 0;
+           dependencies->node = -1;
+           dependencies->variables = false;
+           switch(predicate->type)
+           {
+              case INT_CHECK:
+              case CHAR_CHECK:
+              case STRING_CHECK:
+              case ATOM_CHECK:
+                   if(dependencies->variable_stages[predicate->variable_id] > 
+                      dependencies->stage)
+                      dependencies->stage = 
+                         dependencies->variable_stages[predicate->variable_id];
+                   dependencies->variables = true;
+                   break;
+
+              case EDGE_PRED:
+                   addNodeDependency(dependencies, predicate->edge_pred.source);
+                   addNodeDependency(dependencies, predicate->edge_pred.target);
+                   addLabelDependencies(dependencies, predicate->edge_pred.label);
+                   break;
+
+              case EQUAL:
+              case NOT_EQUAL:
+                   addLabelDependencies(dependencies, predicate->list_comp.left_label);
+                   addLabelDependencies(dependencies, predicate->list_comp.right_label);
+                   break;
+
+              default:
+                   addAtomDependencies(dependencies, predicate->atom_comp.left_atom);
+                   addAtomDependencies(dependencies, predicate->atom_comp.right_atom);
+                   break;
+           }
+           predicate->stage = dependencies->stage;
+           predicate->hoisted = required && dependencies->node >= 0 &&
+                                !dependencies->variables && filterPredicate(predicate);
+           break;
+      }
+      case 'n':
+           setPredicateStages(condition->neg_condition, dependencies,
+                              required && condition->neg_condition->type != 'a' &&
+                              condition->neg_condition->type != 'o');
+           break;
+
+      case 'a':
+           setPredicateStages(condition->left_condition, dependencies, required);
+           setPredicateStages(condition->right_condition, dependencies, required);
+           break;
+
+      case 'o':
+           setPredicateStages(condition->left_condition, dependencies, false);
+           setPredicateStages(condition->right_condition, dependencies, false);
+           break;
+
+      default:
+           print_to_log("Error (setPredicateStages): Unexpected condition "
+                        "type '%c'.\n", condition->type);
+           break;
    }
+}
+
+void prepareCondition(Rule *rule, Searchplan *searchplan)
+{
+   int nodes = rule->lhs->node_index, variables = rule->variables;
+   int node_stages[nodes > 0 ? nodes : 1], variable_stages[variables > 0 ? variables : 1];
+   int index, stage = 0, last_stage = 0;
+   /* Variables that occur in no LHS label are never assigned. Predicates on
+    * them are evaluated after the last operation. */
+   SearchOp *operation;
+   for(operation = searchplan->first; operation != NULL && operation->next != NULL;
+       operation = operation->next)
+      last_stage++;
+   for(index = 0; index < nodes; index++) node_stages[index] = last_stage;
+   for(index = 0; index < variables; index++) variable_stages[index] = last_stage;
+
+   for(operation = searchplan->first; operation != NULL; operation = operation->next)
+   {
+      RuleLabel label;
+      if(operation->is_node)
+      {
+         node_stages[operation->index] = stage;
+         label = getRuleNode(rule->lhs, operation->index)->label;
+      }
+      else label = getRuleEdge(rule->lhs, operation->index)->label;
+      if(label.length > 0)
+      {
+         RuleListItem *item = label.list->first;
+         for(; item != NULL; item = item->next)
+            setVariableStages(item->atom, variable_stages, stage);
+      }
+      stage++;
+   }
+   Dependencies dependencies = {0, -1, false, node_stages, variable_stages};
+   setPredicateStages(rule->condition, &dependencies, true);
+}
+
+void generatePredicateResets(Condition *condition, int stage, int indent)
+{
    switch(condition->type)
    {
       case 'e':
-           PTF("b%d", bool_count++);
+           if(condition->predicate->stage == stage && !condition->predicate->hoisted)
+              PTFI("evaluated%d = false;\n", indent, condition->predicate->bool_id);
            break;
 
       case 'n':
-           PTF("!b%d", bool_count++);
+           generatePredicateResets(condition->neg_condition, stage, indent);
            break;
 
       case 'a':
-           if(nested) PTF("(");
-           generateConditionEvaluator(condition->left_condition, true);
-           PTF(" && ");
-           generateConditionEvaluator(condition->right_condition, true);
-           if(nested) PTF(")");
+      case 'o':
+           generatePredicateResets(condition->left_condition, stage, indent);
+           generatePredicateResets(condition->right_condition, stage, indent);
            break;
-           
+
+      default:
+           break;
+   }
+}
+
+/* Returns true if the condition at the stage depends on the predicates that
+ * are evaluated at the stage or before, and false if it is true whatever their
+ * values. Predicates of later stages and hoisted predicates are assumed to take
+ * the value under which the condition is true. Each predicate occurs once in
+ * the condition, so this is the value that makes its literal true, where
+ * positive is false for a subcondition under an odd number of negations. Under
+ * these, a conjunction behaves as a disjunction and vice versa. */
+static bool conditionOpen(Condition *condition, int stage, bool positive)
+{
+   switch(condition->type)
+   {
+      case 'e':
+           return condition->predicate->stage <= stage && !condition->predicate->hoisted;
+
+      case 'n':
+           return conditionOpen(condition->neg_condition, stage, !positive);
+
+      case 'a':
       case 'o':
-           if(nested) PTF("(");
-           generateConditionEvaluator(condition->left_condition, true);
-           PTF(" || ");
-           generateConditionEvaluator(condition->right_condition, true);
-           if(nested) PTF(")");
+           if((condition->type == 'a') == positive)
+              return conditionOpen(condition->left_condition, stage, positive) ||
+                     conditionOpen(condition->right_condition, stage, positive);
+           else
+              return conditionOpen(condition->left_condition, stage, positive) &&
+                     conditionOpen(condition->right_condition, stage, positive);
+
+      default:
+           return false;
+   }
+}
+
+static bool stageHasPredicates(Condition *condition, int stage)
+{
+   switch(condition->type)
+   {
+      case 'e':
+           return condition->predicate->stage == stage && !condition->predicate->hoisted;
+
+      case 'n':
+           return stageHasPredicates(condition->neg_condition, stage);
+
+      case 'a':
+      case 'o':
+           return stageHasPredicates(condition->left_condition, stage) ||
+                  stageHasPredicates(condition->right_condition, stage);
+
+      default:
+           return false;
+   }
+}
+
+/* The condition is retested only at the stages that evaluate new predicates.
+ * At the other stages it takes the same value as at the previous test. */
+bool conditionTested(Condition *condition, int stage)
+{
+   return stageHasPredicates(condition, stage) && conditionOpen(condition, stage, true);
+}
+
+/* Prints the open part of the condition: a subcondition that is true at the
+ * stage is left out of its conjunction, and a disjunction with one is not 
+ * printed at all. */
+static void generateOpenExpression(Condition *condition, int stage, bool positive)
+{
+   switch(condition->type)
+   {
+      case 'e':
+           PTF("evaluatePredicate%d(morphism)", condition->predicate->bool_id);
            break;
 
+      case 'n':
+           if(condition->neg_condition->type == 'e') PTF("!");
+           else PTF("!(");
+           generateOpenExpression(condition->neg_condition, stage, !positive);
+           if(condition->neg_condition->type != 'e') PTF(")");
+           break;
+
+      case 'a':
+      case 'o':
+      {
+           bool left = conditionOpen(condition->left_condition, stage, positive);
+           bool right = conditionOpen(condition->right_condition, stage, positive);
+           if(left && right)
+           {
+              PTF("(");
+              generateOpenExpression(condition->left_condition, stage, positive);
+              PTF(condition->type == 'a' ? " && " : " || ");
+              generateOpenExpression(condition->right_condition, stage, positive);
+              PTF(")");
+           }
+           else if(left) generateOpenExpression(condition->left_condition, stage, positive);
+           else generateOpenExpression(condition->right_condition, stage, positive);
+           break;
+      }
       default:
            print_to_log("Error (generateConditionExpression): Unexpected condition "
                         "type '%c'.\n", condition->type);
            break;
    }
-   if(!nested)
+}
+
+void generateConditionExpression(Condition *condition, int stage)
+{
+   generateOpenExpression(condition, stage, true);
+}
+
+void generatePredicateFilters(Condition *condition, RuleNode *node, string fail_code,
+                              int indent)
+{
+   switch(condition->type)
    {
-      PTF(");\n");
-      PTF("}\n\n");
+      case 'e':
+      {
+           Predicate *predicate = condition->predicate;
+           if(!predicate->hoisted) break;
+           int p;
+           for(p = 0; p < node->predicate_count; p++)
+              if(node->predicates[p] == predicate) break;
+           if(p == node->predicate_count) break;
+           PTFI("if(%stestPredicate%d(host_node->index)) %s\n", indent, 
+                predicate->negated ? "" : "!", predicate->bool_id, fail_code);
+           break;
+      }
+      case 'n':
+           generatePredicateFilters(condition->neg_condition, node, fail_code, indent);
+           break;
+
+      case 'a':
+      case 'o':
+           generatePredicateFilters(condition->left_condition, node, fail_code, indent);
+           generatePredicateFilters(condition->right_condition, node, fail_code, indent);
+           break;
+
+      default:
+           break;
    }
 }
 
@@ -126,112 +462,88 @@ static bool labelIsIntegerExpression(RuleLabel label)
    return false;
 }
 
-/* Writes a function that evaluates a predicate. The generated function checks
- * if all appropriate nodes and variables are instantiated. If so, it sets the
- * appropriate runtime boolean value to the result of the predicate's evalution
- * and returns true. Otherwise, it returns false. */
-static void generatePredicateCode(Rule *rule, Predicate *predicate)
+bool conditionIsThreadSafe(Condition *condition)
 {
-   PTF("static void evaluatePredicate%d(Morphism *morphism)\n", predicate->bool_id);
-   PTF("{\n");
-   int index;
-   /* Generate code for any nodes that participate in this predicate. */
-   for(index = 0; index < rule->lhs->node_index; index++)
+   switch(condition->type)
    {
-      RuleNode *node = getRuleNode(rule->lhs, index);
-      if(node->predicates == NULL) continue;
-      int p;
-      for(p = 0; p < node->predicate_count; p++)
+      case 'e':
+      case 'n':
       {
-         if(node->predicates[p] == predicate)
-         {
-            PTFI("int n%d = lookupNode(morphism, %d);\n", 3, index, index);
-            PTFI("/* If the node is not yet matched by the morphism, return. */\n", 3);
-            PTFI("if(n%d == -1) return;\n\n", 3, index);
-            break;
-         }
+           Predicate *predicate = condition->predicate;
+           if(predicate->type == EDGE_PRED) 
+              return predicate->edge_pred.label.length < 0;
+           if(predicate->type == EQUAL || predicate->type == NOT_EQUAL)
+              return labelIsIntegerExpression(predicate->list_comp.left_label) &&
+                     labelIsIntegerExpression(predicate->list_comp.right_label);
+           return true;
       }
-   }
-   /* Generate code for any variables that participate in this predicate. */
-   for(index = 0; index < rule->variables; index++)
-   {
-      Variable variable = rule->variable_list[index];
-      if(variable.predicates == NULL) continue;
-      int p;
-      for(p = 0; p < variable.predicate_count; p++)
-      {
-         if(variable.predicates[p] == predicate)
-         {
-            PTFI("Assignment assignment_%d = getAssignment(morphism, %d);\n",
-                 3, index, index);
-            PTFI("/* If the variable is not yet assigned, return. */\n", 3);
-            PTFI("if(assignment_%d.type == 'n') return;\n", 3, index);
-            switch(variable.type)
-            {
-               case INTEGER_VAR:
-                    PTFI("int var_%d = getIntegerValue(morphism, %d);\n\n", 3, 
-                         index, index);
-                    break;
-
-               case CHARACTER_VAR:
-               case STRING_VAR:
-                    PTFI("string var_%d = getStringValue(morphism, %d);\n\n", 3, 
-                         index, index);
-                    break;
+      case 'a':
+      case 'o':
+           return conditionIsThreadSafe(condition->left_condition) &&
+                  conditionIsThreadSafe(condition->right_condition);
 
-               case ATOM_VAR:
-               case LIST_VAR:
-                    PTFI("Assignment var_%d = assignment_%d;\n", 3, index, index);
-                    break;
-               
-               default:
-                    print_to_log("Error (generateVariableCode): Unexpected type %d\n",
-                                 variable.type);
-                    break;
-            }
-            break;
-         }
-      }
+      default:
+           return false;
    }
+}
+
+/* Writes the code that sets the runtime boolean 'result' to the value of the
+ * predicate. The nodes and variables of the predicate are in the runtime
+ * variables nx and var_x. */
+static void generatePredicateTest(Predicate *predicate, string result)
+{
    int list_count = 0;
    switch(predicate->type)
    {
       case INT_CHECK:
-           PTFI("if(assignment_%d.type == 'i') b%d = true;\n", 3,
-                predicate->variable_id, predicate->bool_id);
-           PTFI("else b%d = false;\n", 3, predicate->bool_id);
+           PTFI("if(assignment_%d.type == 'i') %s = true;\n", 3,
+                predicate->variable_id, result);
+           PTFI("else %s = false;\n", 3, result);
            break;
 
       case CHAR_CHECK:
            PTFI("if(assignment_%d.type == 's' &&\n", 3, predicate->variable_id);
            PTFI("strlen(assignment_%d.string) == 1)\n", 6, predicate->variable_id);
-           PTFI("b%d = true;\n", 6, predicate->bool_id);
-           PTFI("else b%d = false;\n", 3, predicate->bool_id);
+           PTFI("%s = true;\n", 6, result);
+           PTFI("else %s = false;\n", 3, result);
            break;
 
       case STRING_CHECK:
-           PTFI("if(assignment_%d.type == 's') b%d = true;\n",
-                3, predicate->variable_id, predicate->bool_id);
-           PTFI("else b%d = false;\n", 3, predicate->bool_id);
+           PTFI("if(assignment_%d.type == 's') %s = true;\n",
+                3, predicate->variable_id, result);
+           PTFI("else %s = false;\n", 3, result);
            break;
 
       case ATOM_CHECK:
-           PTFI("if(assignment_%d.type != 'l') b%d = true;\n",
-                3, predicate->variable_id, predicate->bool_id);
-           PTFI("else b%d = false;\n", 3, predicate->bool_id);
+           PTFI("if(assignment_%d.type != 'l') %s = true;\n",
+                3, predicate->variable_id, result);
+           PTFI("else %s = false;\n", 3, result);
            break;
 
       case EDGE_PRED:
       {
            int source = predicate->edge_pred.source;    
            int target = predicate->edge_pred.target;    
-           PTFI("Node *source = getNode(host, n%d);\n", 3, source);
            PTFI("bool edge_found = false;\n", 3);
            PTFI("int counter;\n", 3);
-           PTFI("for(counter = 0; counter < source->out_edges.size + 2; counter++)\n", 3);
-           PTFI("{\n", 3);
-           PTFI("Edge *edge = getNthOutEdge(host, source, counter);\n", 6);
-           PTFI("if(edge != NULL && edge->target == n%d)\n", 6, target);
+           if(adjacency_index)
+           {
+              /* Only the edges between the two nodes are examined. */
+              PTFI("IntArray *parallel_edges = getEdgesBetween(host, n%d, n%d);\n", 3,
+                   source, target);
+              PTFI("for(counter = 0; parallel_edges != NULL && "
+                   "counter < parallel_edges->size; counter++)\n", 3);
+              PTFI("{\n", 3);
+              PTFI("Edge *edge = getEdge(host, parallel_edges->items[counter]);\n", 6);
+           }
+           else
+           {
+              PTFI("Node *source = getNode(host, n%d);\n", 3, source);
+              PTFI("Edge *edge;\n", 3);
+              PTFI("forEachOutEdge(host, source, edge, counter)\n", 3);
+              PTFI("{\n", 3);
+           }
+           PTFI("if(edge->target == n%d)\n", 6, target);
            if(predicate->edge_pred.label.length >= 0)
            { 
               PTFI("{\n", 6);
@@ -252,7 +564,7 @@ static void generatePredicateCode(Rule *rule, Predicate *predicate)
               generateLabelEvaluationCode(predicate->edge_pred.label, false, list_count++, 1, 9);
               PTFI("if(equalHostLabels(label, edge->label))\n", 9);
               PTFI("{\n", 9);
-              PTFI("b%d = true;\n", 12, predicate->bool_id);
+              PTFI("%s = true;\n", 12, result);
               PTFI("edge_found = true;\n", 12);
               PTFI("removeHostList(label.list);\n", 12);
               PTFI("break;\n", 12);
@@ -263,13 +575,13 @@ static void generatePredicateCode(Rule *rule, Predicate *predicate)
            else
            {
               PTFI("{\n", 6);
-              PTFI("b%d = true;\n", 9, predicate->bool_id);
+              PTFI("%s = true;\n", 9, result);
               PTFI("edge_found = true;\n", 9);
               PTFI("break;\n", 9);
               PTFI("}\n", 6);
            }
            PTFI("}\n", 3);
-           PTFI("if(!edge_found) b%d = false;\n", 3, predicate->bool_id);
+           PTFI("if(!edge_found) %s = false;\n", 3, result);
            break;
       }
       case EQUAL:
@@ -286,8 +598,8 @@ static void generatePredicateCode(Rule *rule, Predicate *predicate)
               if(predicate->type == EQUAL) PTF(" == ");
               if(predicate->type == NOT_EQUAL) PTF(" != ");
               generateIntExpression(right_label.list->first->atom, 1, false);
-              PTF(") b%d = true;\n", predicate->bool_id);
-              PTFI("else b%d = false;\n", 3, predicate->bool_id);
+              PTF(") %s = true;\n", result);
+              PTFI("else %s = false;\n", 3, result);
            }
            else
            {
@@ -296,9 +608,9 @@ static void generatePredicateCode(Rule *rule, Predicate *predicate)
               PTFI("if(", 3);
               if(predicate->type == NOT_EQUAL) PTF("!");
               PTF("equalHostLists(array%d, array%d, list_length%d, list_length%d)) "
-                  "b%d = true;\n", list_count - 2, list_count - 1, list_count - 2,
-                  list_count - 1, predicate->bool_id);
-              PTFI("else b%d = false;\n", 3, predicate->bool_id);
+                  "%s = true;\n", list_count - 2, list_count - 1, list_count - 2,
+                  list_count - 1, result);
+              PTFI("else %s = false;\n", 3, result);
            }
            break;
       }
@@ -313,8 +625,8 @@ static void generatePredicateCode(Rule *rule, Predicate *predicate)
            if(predicate->type == LESS) PTF(" < ");
            if(predicate->type == LESS_EQUAL) PTF(" <= ");
            generateIntExpression(predicate->atom_comp.right_atom, 1, false);
-           PTF(") b%d = true;\n", predicate->bool_id);
-           PTFI("else b%d = false;\n", 3, predicate->bool_id);
+           PTF(") %s = true;\n", result);
+           PTFI("else %s = false;\n", 3, result);
            break;
 
       default:
@@ -322,6 +634,103 @@ static void generatePredicateCode(Rule *rule, Predicate *predicate)
                         predicate->type);
            break;
    }
+}
+
+/* Writes a function that evaluates a predicate, once per assignment of its
+ * nodes and variables. The generated function is only called from the stage of
+ * the searchplan at which all of them are matched, and the stage resets the 
+ * flag 'evaluatedx' each time it matches a new host item. The function returns
+ * the value of the predicate, the runtime boolean 'bx'.
+ *
+ * A hoisted predicate instead gets a function that tests it on a candidate
+ * host node for its only node. */
+static void generatePredicateCode(Rule *rule, Predicate *predicate)
+{
+   int index;
+   if(predicate->hoisted)
+   {
+      for(index = 0; index < rule->lhs->node_index; index++)
+      {
+         RuleNode *node = getRuleNode(rule->lhs, index);
+         int p;
+         for(p = 0; p < node->predicate_count; p++)
+            if(node->predicates[p] == predicate) break;
+         if(p < node->predicate_count) break;
+      }
+      PTF("static bool testPredicate%d(int n%d)\n", predicate->bool_id, index);
+      PTF("{\n");
+      PTFI("bool result;\n", 3);
+      generatePredicateTest(predicate, "result");
+      PTFI("return result;\n", 3);
+      PTF("}\n\n");
+      return;
+   }
+   char result[16];
+   sprintf(result, "b%d", predicate->bool_id);
+   PTF("static bool evaluatePredicate%d(Morphism *morphism)\n", predicate->bool_id);
+   PTF("{\n");
+   PTFI("if(evaluated%d) return b%d;\n", 3, predicate->bool_id, predicate->bool_id);
+   PTFI("evaluated%d = true;\n", 3, predicate->bool_id);
+   /* Generate code for any nodes that participate in this predicate. */
+   for(index = 0; index < rule->lhs->node_index; index++)
+   {
+      RuleNode *node = getRuleNode(rule->lhs, index);
+      if(node->predicates == NULL) continue;
+      int p;
+      for(p = 0; p < node->predicate_count; p++)
+      {
+         if(node->predicates[p] == predicate)
+         {
+            PTFI("int n%d = lookupNode(morphism, %d);\n", 3, index, index);
+            break;
+         }
+      }
+   }
+   /* Generate code for any variables that participate in this predicate. */
+   for(index = 0; index < rule->variables; index++)
+   {
+      Variable variable = rule->variable_list[index];
+      if(variable.predicates == NULL) continue;
+      int p;
+      for(p = 0; p < variable.predicate_count; p++)
+      {
+         if(variable.predicates[p] == predicate)
+         {
+            PTFI("Assignment assignment_%d = getAssignment(morphism, %d);\n",
+                 3, index, index);
+            /* A variable that is not in the LHS is never assigned. The
+             * predicate then takes the value under which the condition holds. */
+            PTFI("if(assignment_%d.type == 'n') return b%d = %s;\n", 3, index,
+                 predicate->bool_id, predicate->negated ? "false" : "true");
+            switch(variable.type)
+            {
+               case INTEGER_VAR:
+                    PTFI("int var_%d = getIntegerValue(morphism, %d);\n", 3, 
+                         index, index);
+                    break;
+
+               case CHARACTER_VAR:
+               case STRING_VAR:
+                    PTFI("string var_%d = getStringValue(morphism, %d);\n", 3, 
+                         index, index);
+                    break;
+
+               case ATOM_VAR:
+               case LIST_VAR:
+                    PTFI("Assignment var_%d = assignment_%d;\n", 3, index, index);
+                    break;
+               
+               default:
+                    print_to_log("Error (generateVariableCode): Unexpected type %d\n",
+                                 variable.type);
+                    break;
+            }
+            break;
+         }
+      }
+   }
+   generatePredicateTest(predicate, result);
+   PTFI("return b%d;\n", 3, predicate->bool_id);
    PTF("}\n\n");
 }
 
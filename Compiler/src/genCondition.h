@@ -29,6 +29,7 @@
 #include "common.h"
 #include "genLabel.h"
 #include "rule.h"
+#include "searchplan.h"
 
 #include <stdarg.h>
 #include <stdbool.h>
@@ -38,49 +39,88 @@
 /* GP 2's condition code generation is demonstrated by example. 
  * Consider the condition
  *
- * (indegree(0) > 1 or length(l) = 2) and not atom(l).
+ * (indegree(0) > 1 or length(l) = 2) and not atom(l)
  *
- * generateConditionVariables prints the following global variables
- * to the source file of the rule matcher.
+ * of a rule whose searchplan matches node 1, whose label binds the variable l,
+ * and then node 0. The predicates are evaluated during rule matching, each at
+ * most once for each match of its nodes and variables. prepareCondition assigns
+ * a predicate the stage of the searchplan operation after which all of its nodes
+ * and variables are matched: length(l) = 2 and atom(l) stage 0, indegree(0) > 1
+ * stage 1.
  *
- * bool b0 = true; 
- * bool b1 = true;
- * bool b2 = false;
+ * generateConditionVariables prints the following global variables to the
+ * source file of the rule matcher: b0 holds the value of indegree(0) > 1, b1 the
+ * value of length(l) = 2 and b2 the value of atom(l), and evaluated0 to
+ * evaluated2 record whether the value is computed for the current match.
  *
- * b0 corresponds to the predicate indegree(0) > 1.
- * b1 corresponds to the predicate length(1) = 2.
- * b2 corresponds to the predicate atom(1).
+ * __thread bool b0 = true; 
+ * static __thread bool evaluated0 = false;
+ * ...
  *
- * generateConditionEvaluator prints the following function:
+ * generatePredicateEvaluators writes a function for each predicate that
+ * computes the predicate's value the first time it is called at a stage, for
+ * example:
  *
- * static bool evaluateCondition(void)
+ * static bool evaluatePredicate0(Morphism *morphism)
  * {
- *    return ((b0 || b1) and !b2);
+ *    if(evaluated0) return b0;
+ *    evaluated0 = true;
+ *    int n0 = lookupNode(morphism, 0);
+ *    if(getIndegree(host, n0) > 1) b0 = true;
+ *    else b0 = false;
+ *    return b0;
  * }
  *
- * The initial values of the variables are assigned such that evaluateCondition
- * evaluates to true under these variables. This is because the condition is
- * evaluated during rule matching, in which case In particular, b3 is assigned false
- * because its predicate is negated in the condition. 
+ * The operation of each stage that completes a predicate clears the evaluated
+ * flags of its predicates and tests the condition with the predicates of the
+ * later stages assumed to hold, so that the condition is false only if no
+ * match extending the current one satisfies it. generateConditionExpression
+ * removes the assumed predicates at compile time, so at stage 0 the test is
  *
- * generatePredicateEvaluators writes functions to evaluate the predicates and
- * set its associated boolean variable to the result. For example, indegree(0) > 1
- * translates to:
+ * !evaluatePredicate2(morphism)
  *
- * static bool evaluatePredicate1(void)
- * {
- *    int n0 = lookupNode(morphism, 0);
- *    if(n0 == -1) return false;
- *    
- *    if(getIndegree(host, 0) > 1) b0 = true;
- *    return true;
- * }
+ * and at stage 1 it is 
+ *
+ * (evaluatePredicate0(morphism) || evaluatePredicate1(morphism)) && 
+ * !evaluatePredicate2(morphism)
  *
- * The function returns false if the values requires for the condition (node degrees
- * and variable values) have not yet been instantiated by rule matching. */
+ * in which C's short-circuit evaluation computes only the predicates that 
+ * decide the result. 
+ *
+ * A predicate that must hold for the condition to hold, depends on a single 
+ * node and no variables, and builds no host lists, such as indegree(0) > 1 in
+ * the condition "indegree(0) > 1 and not atom(l)", is hoisted: it is printed as
+ * a function testPredicate0(int n0) that generatePredicateFilters calls on the
+ * candidates of node 0 before their labels are matched, and it is not part of
+ * the condition tests. */
+
+/* Sets the stage and hoisted fields of the predicates of the rule's condition
+ * for the searchplan. */
+void prepareCondition(Rule *rule, Searchplan *searchplan);
 
+/* The variables are thread-local, like the rest of the runtime state, so that
+ * each thread running the program, and each thread of a parallel matcher,
+ * evaluates the condition on its own copies. */
 void generateConditionVariables(Condition *condition);
-void generateConditionEvaluator(Condition *condition, bool nested);
 void generatePredicateEvaluators(Rule *rule, Condition *condition);
 
+/* Print the code of the operation at the stage: generatePredicateResets clears
+ * the evaluated flags of the stage's predicates. If conditionTested returns 
+ * true, the operation tests the condition, and generateConditionExpression 
+ * prints the test. */
+void generatePredicateResets(Condition *condition, int stage, int indent);
+bool conditionTested(Condition *condition, int stage);
+void generateConditionExpression(Condition *condition, int stage);
+
+/* Prints the tests of the hoisted predicates of the node on a candidate bound
+ * to host_node, followed by fail_code if a test fails. */
+void generatePredicateFilters(Condition *condition, RuleNode *node, string fail_code,
+                              int indent);
+
+/* Returns false if evaluating the condition builds host lists at runtime.
+ * Edge predicates with labels and list comparisons do so, and host lists are
+ * interned in the list store of the thread running the program, so such
+ * conditions must not be evaluated by the other threads of a parallel matcher. */
+bool conditionIsThreadSafe(Condition *condition);
+
 #endif /* INC_GEN_CONDITION_H */
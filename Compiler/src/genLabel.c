@@ -119,6 +119,161 @@ void freeStringList(StringList *list)
  * declared at most once per label at runtime. */
 bool result_declared = false;
 
+/* The constants of the LHS labels of the rule being generated, which the
+ * runtime resolves when it starts (see collectLabelConstants). A constant is
+ * either the list of a label without variables, whose host list is looked up
+ * in the list store, or a string constant of another label, whose string is
+ * interned. The C variable holding a constant is named by its
+ * position in the array. */
+typedef struct LabelConstant {
+   RuleList *list; /* NULL for a string constant. */
+   RuleAtom *atom;
+} LabelConstant;
+
+static LabelConstant *label_constants = NULL;
+static int label_constant_count = 0, label_constant_capacity = 0;
+
+static int findLabelConstant(RuleList *list, RuleAtom *atom)
+{
+   int index;
+   for(index = 0; index < label_constant_count; index++)
+      if(label_constants[index].list == list && label_constants[index].atom == atom)
+         return index;
+   return -1;
+}
+
+static void addLabelConstant(RuleList *list, RuleAtom *atom)
+{
+   if(findLabelConstant(list, atom) >= 0) return;
+   if(label_constant_count == label_constant_capacity)
+   {
+      label_constant_capacity = label_constant_capacity == 0 ? 8 : 2 * label_constant_capacity;
+      label_constants = realloc(label_constants, 
+                                label_constant_capacity * sizeof(LabelConstant));
+      if(label_constants == NULL)
+      {
+         print_to_log("Error (addLabelConstant): malloc failure.\n");
+         exit(1);
+      }
+   }
+   label_constants[label_constant_count].list = list;
+   label_constants[label_constant_count++].atom = atom;
+}
+
+/* Returns true if the rule list is not empty and all its atoms are constants.
+ * With list hashing, such a list is matched only by the host list of the list
+ * store equal to it. */
+static bool constantList(RuleLabel label)
+{
+   #ifdef LIST_HASHING
+      if(label.length == 0) return false;
+      RuleListItem *item = label.list->first;
+      for(; item != NULL; item = item->next)
+         if(item->atom->type != INTEGER_CONSTANT && item->atom->type != STRING_CONSTANT)
+            return false;
+      return true;
+   #else
+      return false;
+   #endif
+}
+
+static void collectConstants(RuleLabel label)
+{
+   if(label.length == 0) return;
+   if(constantList(label))
+   {
+      addLabelConstant(label.list, NULL);
+      return;
+   }
+   RuleListItem *item = label.list->first;
+   for(; item != NULL; item = item->next)
+      if(item->atom->type == STRING_CONSTANT) addLabelConstant(NULL, item->atom);
+}
+
+bool collectLabelConstants(Rule *rule)
+{
+   freeLabelConstants();
+   if(rule->lhs == NULL) return false;
+   int index;
+   for(index = 0; index < rule->lhs->node_index; index++)
+      collectConstants(getRuleNode(rule->lhs, index)->label);
+   for(index = 0; index < rule->lhs->edge_index; index++)
+      collectConstants(getRuleEdge(rule->lhs, index)->label);
+   return label_constant_count > 0;
+}
+
+bool generateLabelConstants(string rule_name)
+{
+   if(label_constant_count == 0) return false;
+   PTF("/* The constants of the LHS labels, resolved by initialise%sLabels in each\n"
+       " * thread that runs the program. */\n", rule_name);
+   int index;
+   for(index = 0; index < label_constant_count; index++)
+   {
+      if(label_constants[index].list != NULL) 
+         PTF("static __thread HostList *label_list%d = NULL;\n", index);
+      else PTF("static __thread string label_string%d = NULL;\n", index);
+   }
+   PTF("\nvoid initialise%sLabels(void)\n", rule_name);
+   PTF("{\n");
+   for(index = 0; index < label_constant_count; index++)
+   {
+      LabelConstant constant = label_constants[index];
+      if(constant.list == NULL)
+      {
+         PTFI("label_string%d = internString(\"%s\");\n", 3, index, constant.atom->string);
+         continue;
+      }
+      /* The host list takes a reference that is never released, so the list
+       * stays in the list store while the runtime runs. */
+      int length = 0;
+      RuleListItem *item = constant.list->first;
+      for(; item != NULL; item = item->next) length++;
+      PTFI("HostAtom array%d[%d];\n", 3, index, length);
+      int position = 0;
+      for(item = constant.list->first; item != NULL; item = item->next, position++)
+      {
+         if(item->atom->type == INTEGER_CONSTANT)
+         {
+            PTFI("array%d[%d].type = 'i';\n", 3, index, position);
+            PTFI("array%d[%d].num = %d;\n", 3, index, position, item->atom->number);
+         }
+         else
+         {
+            PTFI("array%d[%d].type = 's';\n", 3, index, position);
+            PTFI("array%d[%d].str = \"%s\";\n", 3, index, position, item->atom->string);
+         }
+      }
+      PTFI("label_list%d = makeHostList(array%d, %d, false);\n", 3, index, index, length);
+   }
+   PTF("}\n\n");
+   return true;
+}
+
+int countLabelConstants(void)
+{
+   return label_constant_count;
+}
+
+void generateLabelConstantCopies(string array, bool save, int indent)
+{
+   int index;
+   for(index = 0; index < label_constant_count; index++)
+   {
+      string name = label_constants[index].list != NULL ? "label_list" : "label_string";
+      if(save) PTFI("%s[%d] = %s%d;\n", indent, array, index, name, index);
+      else PTFI("%s%d = %s[%d];\n", indent, name, index, array, index);
+   }
+}
+
+void freeLabelConstants(void)
+{
+   free(label_constants);
+   label_constants = NULL;
+   label_constant_count = 0;
+   label_constant_capacity = 0;
+}
+
 void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent)
 {
    PTFI("/* Label Matching */\n", indent);
@@ -130,6 +285,15 @@ void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent)
       PTFI("match = label.length == 0 ? true : false;\n", indent);
       return;
    }
+   int constant = findLabelConstant(label.list, NULL);
+   if(constant >= 0)
+   {
+      /* Lists are unique in the list store, so the host list equals the rule
+       * list if and only if it is the list resolved for the rule list. */
+      PTFI("/* Matching a constant list. */\n", indent);
+      PTFI("match = label.list == label_list%d;\n", indent, constant);
+      return;
+   }
    else
    {
       /* A do-while loop is generated so that the label matching code can be exited
@@ -143,14 +307,14 @@ void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent)
       /* Lists without list variables admit relatively simple code generation as each
       * rule atom maps directly to the host atom in the same position. */
       RuleListItem *item = label.list->first;
-      PTFI("HostListItem *item = label.list->first;\n", indent + 3);
+      PTFI("HostAtom *atom = label.list->atoms;\n", indent + 3);
       int atom_count = 1;
       while(item != NULL)
       {
          PTFI("/* Matching rule atom %d. */\n", indent + 3, atom_count);
          generateAtomMatchingCode(rule, item->atom, indent + 3);
          atom_count++;
-         if(item->next != NULL) PTFI("item = item->next;\n\n", indent + 3);
+         if(item->next != NULL) PTFI("atom++;\n\n", indent + 3);
          item = item->next;
       }
       PTFI("match = true;\n", indent + 3);
@@ -188,10 +352,10 @@ void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
       }
       PTFI("if(label.length == 1)\n", indent );
       PTFI("{\n", indent);
-      PTFI("if(label.list->first->atom.type == 'i')\n", indent + 3);
-      PTFI("result = addIntegerAssignment(morphism, %d, label.list->first->atom.num);\n", 
+      PTFI("if(label.list->atoms[0].type == 'i')\n", indent + 3);
+      PTFI("result = addIntegerAssignment(morphism, %d, label.list->atoms[0].num);\n", 
            indent + 6, list_variable_id);
-      PTFI("else result = addStringAssignment(morphism, %d, label.list->first->atom.str);\n",
+      PTFI("else result = addSymbolAssignment(morphism, %d, label.list->atoms[0].str);\n",
            indent + 3, list_variable_id);
       PTFI("}\n", indent);
       PTFI("else result = addListAssignment(morphism, %d, label.list);\n",
@@ -210,73 +374,61 @@ void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
    /* Check if the host label has enough atoms to match those in the rule. 
     * Subtracting 1 from the rule label's length gives the number of atoms it
     * contains: the list variable is not counted because it can match the
-    * empty list. */
-   PTFI("if(label.length < %d) break;\n", indent + 3, label.length - 1); 
+    * empty list. Once this check passes, the rule atoms before the list
+    * variable match the host atoms at the same positions from the start of
+    * the host list, and the rule atoms after the list variable match the host
+    * atoms at the same positions from the end of the host list. */
+   int rule_atoms = label.length - 1;
+   PTFI("if(label.length < %d) break;\n", indent + 3, rule_atoms); 
    PTFI("/* Matching from the start of the host list. */\n", indent + 3);
-   PTFI("HostListItem *item = label.list->first;\n", indent + 3);
+   PTFI("HostAtom *atom = label.list->atoms;\n", indent + 3);
    int atom_count = 1;
    while(item != NULL)
    {
       if(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR) break;
-      PTFI("/* Check if the end of the host list has been reached. */\n", indent + 3);
-      PTFI("if(item == NULL) break;\n", indent + 3);
       PTFI("/* Matching rule atom %d. */\n", indent + 3, atom_count);
       generateAtomMatchingCode(rule, item->atom, indent + 3);
-      PTFI("item = item->next;\n\n", indent + 3);
+      PTFI("atom++;\n\n", indent + 3);
       atom_count++;
       item = item->next;
    }
-
-   item = label.list->last;
+   /* The host atoms assigned to the list variable start at this position. */
+   int sublist_start = atom_count - 1;
+   int suffix_atoms = rule_atoms - sublist_start;
    if(!result_declared)
    {
       PTFI("int result = -1;\n", indent + 3);
       result_declared = true;
    }
-   PTFI("HostListItem *start = item;\n", indent + 3);
-   int host_atoms_matched = atom_count -1;
-   atom_count = label.length;
-   if(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR)
+   if(suffix_atoms > 0)
    {
-      PTFI("/* Matching list variable %d. */\n", indent + 3, list_variable_id);
-      /* All host atoms are matched: assign the empty list to the list variable. */
-      PTFI("if(start == NULL) result = addListAssignment(morphism, %d, NULL);\n", 
-           indent + 3, list_variable_id);
-   }
-   else
-   {
-      PTFI("/* The current host list position marks the start of the list that is\n", indent + 3);
-      PTFI("   assigned to the list variable. */\n", indent + 3);
-      PTFI("/* More rule atoms to match. If the end of the host list is reached, break. */\n",
-           indent + 3);
-      PTFI("if(start == NULL) break;\n\n", indent + 3);
       PTFI("/* Matching from the end of the host list. */\n", indent + 3);
-      PTFI("item = label.list->last;\n", indent + 3);
+      PTFI("atom = label.list->atoms + label.length - %d;\n", indent + 3, suffix_atoms);
+      item = item->next;
+      atom_count++;
       while(item != NULL)
       {
-         if(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR) break;
-         PTFI("/* Check if the host list has passed \"start\". */\n", indent + 3);
-         PTFI("if(item == start->prev) break;\n", indent + 3);
-         PTFI("/* Matching rule atom %d */\n", indent + 3, atom_count);
+         PTFI("/* Matching rule atom %d. */\n", indent + 3, atom_count);
          generateAtomMatchingCode(rule, item->atom, indent + 3);
-         PTFI("item = item->prev;\n", indent + 3);
-         atom_count--;
-         item = item->prev;
+         if(item->next != NULL) PTFI("atom++;\n\n", indent + 3);
+         atom_count++;
+         item = item->next;
       }
-      /* Assign the list variable to the rest of the host list. */
-      PTFI("/* Matching list variable %d. */\n", indent + 3, list_variable_id);
-
-      /* All host atoms are matched: assign the empty list to the list variable. */
-      PTFI("if(item == start->prev) ", indent + 3);
-      PTF("result = addListAssignment(morphism, %d, NULL);\n", list_variable_id);
-   }  
+   }
+   /* Assign the list variable to the rest of the host list. */
+   PTFI("/* Matching list variable %d. */\n", indent + 3, list_variable_id);
+   PTFI("int sublist_length = label.length - %d;\n", indent + 3, rule_atoms);
+   /* All host atoms are matched: assign the empty list to the list variable. */
+   PTFI("if(sublist_length == 0) ", indent + 3);
+   PTF("result = addListAssignment(morphism, %d, NULL);\n", list_variable_id);
 
    /* All but 1 host atoms are matched: assign the remaining host atom to the list variable. */
-   PTFI("else if(item == start)\n", indent + 3);
+   PTFI("else if(sublist_length == 1)\n", indent + 3);
    PTFI("{\n", indent + 3);
-   PTFI("if(item->atom.type == 'i') result = addIntegerAssignment(morphism, %d, item->atom.num);\n", 
+   PTFI("atom = label.list->atoms + %d;\n", indent + 6, sublist_start);
+   PTFI("if(atom->type == 'i') result = addIntegerAssignment(morphism, %d, atom->num);\n", 
         indent + 6, list_variable_id);
-   PTFI("else result = addStringAssignment(morphism, %d, item->atom.str);\n", 
+   PTFI("else result = addSymbolAssignment(morphism, %d, atom->str);\n", 
         indent + 6, list_variable_id);
    PTFI("}\n", indent + 3);
 
@@ -285,19 +437,12 @@ void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
    PTFI("{\n", indent + 3);
    PTFI("/* Assign to variable %d the unmatched sublist of the host list. */\n",
         indent + 6, list_variable_id);
-   host_atoms_matched += (label.length - atom_count);
-   PTFI("HostAtom sublist[label.length - %d];\n", indent + 6, host_atoms_matched);
-   PTFI("int list_index = 0;\n", indent + 6);
-   PTFI("HostListItem *iterator = start;\n", indent + 6);
-   PTFI("while(iterator != item->next)\n", indent + 6);
-   PTFI("{\n", indent + 6);
-   PTFI("sublist[list_index++] = iterator->atom;\n", indent + 9);
-   PTFI("iterator = iterator->next;\n", indent + 9);
-   PTFI("}\n", indent + 6);
-   PTFI("HostList *list = makeHostList(sublist, label.length - %d, false);\n", indent + 6,  
-        host_atoms_matched);
+   PTFI("HostList *list = makeHostList(label.list->atoms + %d, sublist_length, false);\n",
+        indent + 6, sublist_start);
    PTFI("result = addListAssignment(morphism, %d, list);\n", indent + 6,
         list_variable_id);
+   /* The assignment holds its own reference to the sublist. */
+   PTFI("removeHostList(list);\n", indent + 6);
    PTFI("}\n", indent + 3);
 
    generateVariableResultCode(rule, list_variable_id, true, indent + 3);
@@ -315,18 +460,25 @@ static void generateAtomMatchingCode(Rule *rule, RuleAtom *atom, int indent)
            break;
       
       case INTEGER_CONSTANT:
-           PTFI("if(item->atom.type != 'i') break;\n", indent);
-           PTFI("else if(item->atom.num != %d) break;\n", indent, atom->number);
+           PTFI("if(atom->type != 'i') break;\n", indent);
+           PTFI("else if(atom->num != %d) break;\n", indent, atom->number);
            break;
 
       case STRING_CONSTANT:
-           PTFI("if(item->atom.type != 's') break;\n", indent);
-           PTFI("else if(strcmp(item->atom.str, \"%s\") != 0) break;\n",
-                indent, atom->string);
+      {
+           /* Host strings are interned, so a host string equals a string
+            * constant resolved at startup if and only if it is the same. */
+           int constant = findLabelConstant(NULL, atom);
+           PTFI("if(atom->type != 's') break;\n", indent);
+           if(constant >= 0) PTFI("else if(atom->str != label_string%d) break;\n", indent, constant);
+           else PTFI("else if(symbolLength(atom->str) != %d || "
+                     "strcmp(atom->str, \"%s\") != 0) break;\n",
+                     indent, (int)strlen(atom->string), atom->string);
            break;
+      }
 
       case CONCAT:
-           PTFI("if(item->atom.type != 's') break;\n", indent);
+           PTFI("if(atom->type != 's') break;\n", indent);
            PTFI("else\n", indent);
            PTFI("{\n", indent);
            generateConcatMatchingCode(rule, atom, indent + 3);
@@ -351,35 +503,35 @@ static void generateVariableMatchingCode(Rule *rule, RuleAtom *atom, int indent)
    {
       case INTEGER_VAR:
            PTFI("/* Matching integer variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type != 'i') break;\n", indent);
-           PTFI("result = addIntegerAssignment(morphism, %d, item->atom.num);\n",
+           PTFI("if(atom->type != 'i') break;\n", indent);
+           PTFI("result = addIntegerAssignment(morphism, %d, atom->num);\n",
                 indent, atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
 
       case CHARACTER_VAR:
            PTFI("/* Matching character variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type != 's') break;\n", indent);
-           PTFI("if(strlen(item->atom.str) != 1) break;\n", indent);
-           PTFI("result = addStringAssignment(morphism, %d, item->atom.str);\n", 
+           PTFI("if(atom->type != 's') break;\n", indent);
+           PTFI("if(symbolLength(atom->str) != 1) break;\n", indent);
+           PTFI("result = addSymbolAssignment(morphism, %d, atom->str);\n", 
                 indent , atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
 
       case STRING_VAR:
            PTFI("/* Matching string variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type != 's') break;\n", indent);
-           PTFI("result = addStringAssignment(morphism, %d, item->atom.str);\n",
+           PTFI("if(atom->type != 's') break;\n", indent);
+           PTFI("result = addSymbolAssignment(morphism, %d, atom->str);\n",
                 indent, atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
 
       case ATOM_VAR:
            PTFI("/* Matching atom variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type == 'i') "
-                "result = addIntegerAssignment(morphism, %d, item->atom.num);\n",
+           PTFI("if(atom->type == 'i') "
+                "result = addIntegerAssignment(morphism, %d, atom->num);\n",
                 indent, atom->variable.id);
-           PTFI("else result = addStringAssignment(morphism, %d, item->atom.str);\n",
+           PTFI("else result = addSymbolAssignment(morphism, %d, atom->str);\n",
                 indent, atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
@@ -414,15 +566,16 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
       iterator = iterator->next;
    }
    iterator = list;
-   PTFI("string host_string = item->atom.str;\n", indent);
-   PTFI("unsigned int start = 0, end = strlen(host_string) - 1;\n\n", indent);
+   PTFI("string host_string = atom->str;\n", indent);
+   PTFI("unsigned int host_length = symbolLength(host_string);\n", indent);
+   PTFI("unsigned int start = 0, end = host_length - 1;\n\n", indent);
    /* If there is no string variable, iterate through the StringList and 
     * generate code for each string expression. */
    if(!has_string_variable)
    {
       while(iterator != NULL) 
       {
-         PTFI("if(start >= strlen(host_string)) break;\n", indent);
+         PTFI("if(start >= host_length) break;\n", indent);
          generateStringMatchingCode(rule, iterator, true, indent);
          iterator = iterator->next;
       }
@@ -435,11 +588,11 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
       PTFI("/* Matching from the start of the host string. */\n", indent);
       while(iterator->type != 3) 
       {
-         PTFI("if(start >= strlen(host_string)) break;\n", indent);
+         PTFI("if(start >= host_length) break;\n", indent);
          generateStringMatchingCode(rule, iterator, true, indent);
          iterator = iterator->next;
       }
-      PTFI("if(start > strlen(host_string)) break;\n", indent);
+      PTFI("if(start > host_length) break;\n", indent);
       /* Move iterator to the end of the list. */
       while(iterator != NULL) 
       {
@@ -465,8 +618,12 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
    /* Assign the string variable to the rest of the host string. */
    PTF("\n");
    PTFI("/* Matching string variable %d. */\n", indent, iterator->variable_id);
-   PTFI("if(end == start - 1) ", indent);
-   PTF("result = addStringAssignment(morphism, %d, \"\");\n", iterator->variable_id);
+   PTFI("if(end == start - 1)\n", indent);
+   PTFI("{\n", indent);
+   PTFI("result = addStringAssignment(morphism, %d, \"\");\n", indent + 3,
+        iterator->variable_id);
+   generateVariableResultCode(rule, iterator->variable_id, false, indent + 3);
+   PTFI("}\n", indent);
    PTFI("else\n", indent);
    PTFI("{\n", indent);
    PTFI("char substring[end - start + 1];\n", indent + 3);
@@ -474,7 +631,7 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
    PTFI("substring[end - start + 1] = '\\0';\n", indent + 3);
    PTFI("result = addStringAssignment(morphism, %d, substring);\n", 
         indent + 3, iterator->variable_id);
-   generateVariableResultCode(rule, iterator->variable_id, false, indent);
+   generateVariableResultCode(rule, iterator->variable_id, false, indent + 3);
    PTFI("}\n", indent);
    freeStringList(list);
 }
@@ -494,8 +651,8 @@ static void generateStringMatchingCode(Rule *rule, StringList *string_exp,
             PTFI("unsigned int offset = 0;\n", indent);
             offset_declared = true;
          }
-         PTFI("offset = isPrefix(\"%s\", host_string + start);\n",
-              indent, string_exp->constant);
+         PTFI("offset = isPrefix(\"%s\", %d, host_string + start, host_length - start);\n",
+              indent, string_exp->constant, (int)strlen(string_exp->constant));
          PTFI("if(offset == -1) break; else start += offset;\n", indent);
       }
       else
@@ -505,8 +662,8 @@ static void generateStringMatchingCode(Rule *rule, StringList *string_exp,
             PTFI("unsigned int offset = 0;\n", indent);
             offset_declared = true;
          }
-         PTFI("offset = isSuffix(\"%s\", host_string);\n", 
-              indent, string_exp->constant);
+         PTFI("offset = isSuffix(\"%s\", %d, host_string, host_length);\n", 
+              indent, string_exp->constant, (int)strlen(string_exp->constant));
          PTFI("if(offset == -1) break; else end -= offset;\n", indent);
       }
    }
@@ -546,29 +703,7 @@ void generateVariableResultCode(Rule *rule, int id, bool list_variable, int inde
    PTFI("{\n", indent);
    PTFI("new_assignments += result;\n", indent + 3);
    assert(id < rule->variables);
-   Variable variable = rule->variable_list[id];
-   if(variable.predicates != NULL)
-   {
-      PTFI("/* Update global booleans for the variable's predicates. */\n", indent + 3);
-      int index;
-      for(index = 0; index < variable.predicate_count; index++)
-         PTFI("evaluatePredicate%d(morphism);\n", indent + 3, 
-              variable.predicates[index]->bool_id);
-      PTFI("if(!evaluateCondition())\n", indent + 3);
-      PTFI("{\n", indent + 3);
-      PTFI("/* Reset the boolean variables in the predicates of this variable. */\n", 
-           indent + 6);
-      for(index = 0; index < variable.predicate_count; index++)
-      { 
-         Predicate *predicate = variable.predicates[index];
-         if(predicate->negated) PTFI("b%d = false;\n", indent + 6, predicate->bool_id);
-         else PTFI("b%d = true;\n", indent + 6, predicate->bool_id);
-      } 
-      if(!list_variable) PTFI("break;\n", indent + 6);
-      PTFI("}\n", indent + 3);
-      if(list_variable) PTFI("else match = true;\n", indent + 3);
-   }
-   if(list_variable && variable.predicates == NULL) PTFI("match = true;\n", indent + 3);
+   if(list_variable) PTFI("match = true;\n", indent + 3);
    PTFI("}\n", indent);
    if(!list_variable) PTFI("else break;\n", indent); 
 }
@@ -717,12 +852,9 @@ void generateLabelEvaluationCode(RuleLabel label, bool node, int count, int cont
               {
                  PTFI("if(var_%d.type == 'l' && var_%d.list != NULL)\n", indent, id, id);
                  PTFI("{\n", indent);
-                 PTFI("HostListItem *item%d = var_%d.list->first;\n", indent + 3, count, id);
-                 PTFI("while(item%d != NULL)\n", indent + 3, count);
-                 PTFI("{\n", indent + 3);
-                 PTFI("array%d[index%d++] = item%d->atom;\n", indent + 6, count, count, count);
-                 PTFI("item%d = item%d->next;\n", indent + 6, count, count);
-                 PTFI("}\n", indent + 3);
+                 PTFI("memcpy(array%d + index%d, var_%d.list->atoms, "
+                      "var_%d.list->length * sizeof(HostAtom));\n", indent + 3, count, count, id, id);
+                 PTFI("index%d += var_%d.list->length;\n", indent + 3, count, id);
                  PTFI("}\n", indent);
                  PTFI("else if(var_%d.type == 'i')\n", indent, id);
                  PTFI("{\n", indent);
@@ -40,6 +40,27 @@
 extern FILE *file;
 
 /* Generates code to match a rule list not containing a list variable to a host graph list. */
+/* The constant parts of LHS labels are resolved when the runtime starts: the
+ * host list of each label without variables is looked up in the list store,
+ * and the other string constants are interned. The matching code compares a
+ * host list with a constant list as one pointer, and a host string with a
+ * string constant as one pointer, instead of comparing their atoms or text.
+ *
+ * collectLabelConstants finds the constants of the rule's LHS labels, which
+ * the label matching code of the rule then refers to. It returns true if the
+ * rule has any. generateLabelConstants prints their variables and the function
+ * initialise<rule_name>Labels that resolves them, and returns false if there
+ * are none. countLabelConstants returns the number of constants collected.
+ * freeLabelConstants forgets them. */
+bool collectLabelConstants(Rule *rule);
+bool generateLabelConstants(string rule_name);
+int countLabelConstants(void);
+/* Prints assignments that copy the label constants to the elements of the named
+ * array of pointers if save is true, and from them otherwise. The threads of a
+ * parallel matcher take the constants of the thread that starts them. */
+void generateLabelConstantCopies(string array, bool save, int indent);
+void freeLabelConstants(void);
+
 void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent);
 
 /* Generates code to match a rule list containing a list variable to a host graph list. */
@@ -14,6 +14,7 @@
   along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
 
 #include "genProgram.h"
+#include "transform.h"
 
 #undef RULE_TRACING
 #undef GRAPH_TRACING
@@ -53,29 +54,58 @@ typedef enum {MAIN_BODY, IF_BODY, TRY_BODY, LOOP_BODY} ContextType;
  *                 Its value is assigned the value of the global restore_point_count.
  *		   The count is incremented when assigned to ensure unique restore
  *		   point names at runtime.
+ * trim_recording - Set for the body of a loop or the condition of a try statement
+ *                  with a restore point. The changes made by the commands of the
+ *                  body after its last command that can fail are never undone to
+ *                  that restore point, so they are recorded only if 
+ *                  outer_record_changes is set. Applies to the top-level command
+ *                  sequence of the body only.
+ * outer_record_changes - The value of record_changes in the context of the loop or
+ *                        try statement.
+ * hold_match - Set for the condition of an if statement that is a call of the
+ *              rule matched_rule. The condition keeps the rule's match in its
+ *              morphism instead of discarding it. Applies to the first command
+ *              of a command sequence only, as does matched_rule.
+ * matched_rule - The rule whose match is held by its morphism, or NULL. Set for
+ *                the then branch of an if statement whose condition holds the
+ *                match and whose first command calls the same rule. The graph is
+ *                unchanged since the match was found, so the rule call applies
+ *                the held match without searching for it again. See
+ *                heldMatchRule.
  * indent - For formatting the printed C code. */
  typedef struct CommandData {
    ContextType context;
    int loop_depth;
    bool record_changes;
    int restore_point;
+   bool trim_recording;
+   bool outer_record_changes;
+   bool hold_match;
+   GPRule *matched_rule;
    int indent;
 } CommandData;
 
-/* Arguments passed to the newGraph function at runtime. */
-#define HOST_NODE_SIZE 128
-#define HOST_EDGE_SIZE 128
-
 static void generateMorphismCode(List *declarations, char type, bool first_call);
 static void generateProgramCode(GPCommand *command, CommandData data);
 static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
                              bool last_rule, CommandData data);
+static void generateRuleApplication(string rule_name, CommandData data, int indent);
 static void generateBranchStatement(GPCommand *command, CommandData data);
 static void generateLoopStatement(GPCommand *command, CommandData data);
 static void generateFailureCode(string rule_name, CommandData data);
+static void generateUndoCode(int restore_point, int indent);
+static void generateCompactionCode(int indent);
 static bool neverFails(GPCommand *command);
+static bool failsCleanly(GPCommand *command);
 static bool nullCommand(GPCommand *command);
 static bool singleRule(GPCommand *command);
+static GPRule *firstRuleCall(GPCommand *command);
+static GPRule *heldMatchRule(GPCommand *command);
+static GPRule *batchLoopRule(GPCommand *loop_body);
+static void markBatchCommand(GPCommand *command);
+static bool scannedRuleSet(GPCommand *command);
+static void generateRuleSetScan(GPCommand *command, CommandData data);
+static void generateLibraryInterface(List *declarations);
 
 void generateRuntimeMain(List *declarations, string output_dir)
 {
@@ -94,114 +124,340 @@ void generateRuntimeMain(List *declarations, string output_dir)
    PTF("#include \"debug.h\"\n");
    PTF("#include \"graph.h\"\n");
    PTF("#include \"graphStacks.h\"\n");
-   PTF("#include \"parser.h\"\n");
-   PTF("#include \"morphism.h\"\n\n");
+   PTF("#include \"hostLoader.h\"\n");
+   PTF("#include \"morphism.h\"\n");
+   if(shared_library) PTF("#include \"gp2.h\"\n");
+   PTF("\n");
 
    /* Declare the global morphism variables for each rule. */
    generateMorphismCode(declarations, 'd', true);
 
+   /* List the profiles of the rules. */
+   if(rule_profiling) generateMorphismCode(declarations, 'p', true);
+
+   /* List the application counters of the rules for the live statistics. */
+   if(!shared_library) generateMorphismCode(declarations, 'c', true);
+
+   /* List the match budgets of the rules, set by the flags of gp2run. */
+   if(match_budgets && !shared_library) generateMorphismCode(declarations, 'b', true);
+
    /* Declare the runtime global variables and functions. */
    generateMorphismCode(declarations, 'f', true);
 
-   PTF("static void garbageCollect(void)\n");
+   /* The shared library frees its runtime in gp2_close. */
+   if(!shared_library)
+   {
+      #ifdef LIST_HASHING
+         PTF("static bool list_statistics = false;\n\n");
+      #endif
+      /* The snapshot of the keyed host graph from which gp2run -d writes the
+       * delta of the output graph. */
+      PTF("static Graph *base_graph = NULL;\n\n");
+      PTF("static void garbageCollect(void)\n");
+      PTF("{\n");
+      #ifdef LIST_HASHING
+         PTF("   if(list_statistics) printListStoreStatistics(log_file);\n");
+      #endif
+      /* Morphisms are freed first: their list assignments refer to the list store. */
+      PTF("   freeMorphisms();\n");
+      PTF("   freeGraph(host);\n");
+      PTF("   if(base_graph != NULL) freeGraph(base_graph);\n");
+      #ifdef LIST_HASHING
+         PTF("   freeHostListStore();\n");
+      #endif
+      if(graph_copying) PTF("   freeGraphStack();\n");
+      else PTF("   freeGraphChangeStack();\n");
+      PTF("   closeLogFile();\n");
+      #if defined GRAPH_TRACING || defined RULE_TRACING || defined BACKTRACK_TRACING
+         PTF("   closeTraceFile();\n");
+      #endif
+      PTF("}\n\n");
+   }
+
+   /* Declare the function that resets the morphisms between the runs of a
+    * stream. */
+   generateMorphismCode(declarations, 'r', true);
+
+   PTF("__thread Graph *host = NULL;\n");
+   PTF("__thread bool success = true;\n\n");
+
+   /* The program body runs in its own function, so that the runtime can run it
+    * once per host graph of a stream. It returns false if the program fails,
+    * after reporting the failure in the output file. */
+   PTF("static bool runProgram(FILE *output_file, bool binary_output)\n");
    PTF("{\n");
-   PTF("   freeGraph(host);\n");
-   #ifdef LIST_HASHING
-      PTF("   freeHostListStore();\n");
-   #endif
-   PTF("   freeMorphisms();\n");
-   if(graph_copying) PTF("   freeGraphStack();\n");
-   else PTF("   freeGraphChangeStack();\n");
-   PTF("   closeLogFile();\n");
-   #if defined GRAPH_TRACING || defined RULE_TRACING || defined BACKTRACK_TRACING
-      PTF("   closeTraceFile();\n");
+   PTFI("success = true;\n", 3);
+   #ifdef GRAPH_TRACING
+      PTFI("print_trace(\"Start Graph: \\n\");\n", 3);
+      PTFI("printGraph(host, trace_file);\n\n", 3);
    #endif
+   /* Find the main declaration and generate code from its command sequence. */
+   List *iterator = declarations;
+   while(iterator != NULL)
+   {
+      GPDeclaration *decl = iterator->declaration;
+      if(decl->type == MAIN_DECLARATION)
+      {
+         CommandData initialData = {MAIN_BODY, 0, false, -1, false, false, false, NULL, 3}; 
+         generateProgramCode(decl->main_program, initialData);
+      }
+      iterator = iterator->next;
+   }
+   PTF("   restoreGraphOrder(host);\n");
+   /* The caller of the shared library may pass no output file. */
+   if(shared_library) PTF("   if(output_file == NULL) return true;\n");
+   else PTF("   if(base_graph != NULL) printGraphDelta(base_graph, host, output_file);\n");
+   PTF("   %sif(binary_output) printBinaryGraph(host, output_file);\n",
+       shared_library ? "" : "else ");
+   PTF("   else printGraph(host, output_file);\n");
+   PTF("   return true;\n");
    PTF("}\n\n");
 
-   PTF("Graph *host = NULL;\n");
-   PTF("int *node_map = NULL;\n\n");
+   if(shared_library)
+   {
+      generateLibraryInterface(declarations);
+      fclose(file);
+      return;
+   }
+
+   /* Clears the state left by a run of the program, keeping the allocations
+    * that the next run reuses. */
+   PTF("static void resetProgram(void)\n");
+   PTF("{\n");
+   PTFI("resetMorphisms();\n", 3);
+   if(graph_copying) PTFI("discardGraphs(0);\n", 3);
+   else PTFI("discardChanges(0);\n", 3);
+   PTFI("freeGraph(host);\n", 3);
+   PTFI("host = NULL;\n", 3);
+   PTFI("if(base_graph != NULL) freeGraph(base_graph);\n", 3);
+   PTFI("base_graph = NULL;\n", 3);
+   PTF("}\n\n");
 
-   /* Print the function that builds the host graph via the host graph parser. */
-   PTF("static Graph *buildHostGraph(char *host_file)\n");
+   /* Keys the items of the host graph and keeps a snapshot of it as the base
+    * of the delta of the output graph. */
+   PTF("static void keepBaseGraph(void)\n");
    PTF("{\n");
-   PTFI("yyin = fopen(host_file, \"r\");\n", 3);
-   PTFI("if(yyin == NULL)\n", 3);
-   PTFI("{\n", 3);
-   PTFI("perror(host_file);\n", 6);
-   PTFI("return NULL;\n", 6);
-   PTFI("}\n\n", 3);
-   PTFI("host = newGraph(%d, %d);\n", 3, HOST_NODE_SIZE, HOST_EDGE_SIZE);
-   PTFI("node_map = calloc(%d, sizeof(int));\n", 3, HOST_NODE_SIZE);
-   PTFI("if(node_map == NULL)\n", 3);
-   PTFI("{\n", 3);
-   PTFI("freeGraph(host);\n", 6);
-   PTFI("return NULL;\n", 6);
-   PTFI("}\n", 3);
-   PTFI("/* The parser populates the host graph using node_map to add edges with\n", 3);
-   PTFI(" * the correct source and target indices. */\n", 3);
-   PTFI("int result = yyparse();\n", 3);
-   PTFI("free(node_map);\n", 3);
-   PTFI("fclose(yyin);\n", 3);
-   PTFI("if(result == 0) return host;\n", 3);
-   PTFI("else\n", 3);
-   PTFI("{\n", 3);
-   PTFI("freeGraph(host);\n", 6);
-   PTFI("return NULL;\n", 6);
-   PTFI("}\n", 3);
+   PTFI("keyGraphItems(host);\n", 3);
+   PTFI("base_graph = snapshotGraph(host);\n", 3);
    PTF("}\n\n");
-   
-   PTF("bool success = true;\n\n");
 
    /* Open the runtime's main function and set up the execution environment. */
    PTF("int main(int argc, char **argv)\n");
    PTF("{\n");
-   PTFI("srand(time(NULL));\n", 3);
    PTFI("openLogFile(\"gp2.log\");\n\n", 3);
-   PTFI("if(argc != 2)\n", 3);
+   if(rule_profiling) PTFI("uint64_t profile_start = profileClock();\n", 3);
+   /* Usage: gp2run [-b] [-d] [-l] [-m] [-r] [-s] [-o <output-file>] [-D <delta-file>]
+    *               [-N <nodes>] [-E <edges>] [-G <percent>] [-H thp|hugetlb] [-M <file>]
+    *               [-P <threads>] [-S <seed>] [-t <stats-file> [-T <seconds>]] <host-file>.
+    * The -s flag writes the statistics of the host graph to gp2.stats for the
+    * compiler's cost-based searchplans. The -l flag writes the occupancy and probe statistics
+    * of the list store to gp2.log when the program exits. The -b flag writes the
+    * output graph in the binary host graph format, which the host graph loader
+    * reads as well as the text format. The -o flag replaces the output file
+    * gp2.output: an output file of "-" is stdout, so that the output graph can be
+    * streamed to another process. The -m flag reads the host file as a stream of
+    * host graphs, "-" being stdin, and runs the program on each graph in turn,
+    * writing one result per graph to the output file. The process, its list store
+    * and its morphisms persist between the runs, so a stream of small graphs
+    * does not pay the startup cost of the runtime for each graph. The -r flag
+    * renumbers the items of each host graph in breadth-first order for locality
+    * (see reorderGraph); the output graph is still printed in the order of the
+    * host graph. The flags -N, -E, -G, -H and -M set the storage policy of the
+    * graph arrays (see graph_storage): the expected numbers of nodes and edges
+    * of the host graph, the percentage (1 to 100) by which full arrays grow,
+    * the backing of the node and edge chunks by transparent or reserved huge
+    * pages, and a file on which the chunks are paged out, for host graphs
+    * larger than memory. The -P flag sets the number of threads that read a
+    * large text host graph, 0 for one per processor (see loader_threads). The
+    * -S flag seeds the random choices of the program, those of the or command
+    * and of sampled matching (gp2 -R), so that a run can be reproduced; by default they are seeded from the time. The -d flag writes
+    * the delta from the host graph to the output graph (see printGraphDelta)
+    * in place of the output graph, so that a small change to a large graph is
+    * written as a small file. The -D flag applies a delta to the host graph
+    * before the program runs: the host file holds the base graph of the delta,
+    * typically the binary output graph of an earlier run (-b), so that the
+    * result of a run that wrote a delta is loaded from the cached base without
+    * parsing the whole graph. -D does not apply to streams. The -t flag writes
+    * the live statistics of the run (see enableRuntimeStats) to the stats file
+    * when the process receives SIGUSR1, when the program ends and, with -T,
+    * every <seconds> seconds, so that a long run can be monitored. A runtime
+    * compiled with profiling takes the flag
+    * -p <profile-file>, which replaces the profile file gp2.profile.json. A
+    * runtime compiled with match budgets (gp2 -L) takes the flags
+    * -L [<rule>=]<steps> and -W [<rule>=]<milliseconds>, which set the budget
+    * of each search for a match of the named rule, or of every rule without a
+    * budget of its own (see MatchBudget). Rules are named as in the profile. */
+   PTFI("char *host_file = NULL;\n", 3);
+   PTFI("char *output_name = \"gp2.output\";\n", 3);
+   PTFI("bool write_statistics = false;\n", 3);
+   PTFI("bool binary_output = false;\n", 3);
+   PTFI("bool stream_mode = false;\n", 3);
+   PTFI("bool reorder_host = false;\n", 3);
+   PTFI("bool delta_output = false;\n", 3);
+   PTFI("char *delta_file = NULL;\n", 3);
+   PTFI("unsigned seed = time(NULL);\n", 3);
+   PTFI("char *stats_name = NULL;\n", 3);
+   PTFI("int stats_interval = 0;\n", 3);
+   if(rule_profiling) PTFI("char *profile_name = \"gp2.profile.json\";\n", 3);
+   PTFI("int argv_index;\n", 3);
+   PTFI("for(argv_index = 1; argv_index < argc; argv_index++)\n", 3);
+   PTFI("{\n", 3);
+   PTFI("if(strcmp(argv[argv_index], \"-s\") == 0) write_statistics = true;\n", 6);
+   PTFI("else if(strcmp(argv[argv_index], \"-b\") == 0) binary_output = true;\n", 6);
+   PTFI("else if(strcmp(argv[argv_index], \"-m\") == 0) stream_mode = true;\n", 6);
+   PTFI("else if(strcmp(argv[argv_index], \"-r\") == 0) reorder_host = true;\n", 6);
+   PTFI("else if(strcmp(argv[argv_index], \"-d\") == 0) delta_output = true;\n", 6);
+   PTFI("else if(strcmp(argv[argv_index], \"-D\") == 0 && argv_index + 1 < argc)\n", 6);
+   PTFI("delta_file = argv[++argv_index];\n", 9);
+   PTFI("else if(strcmp(argv[argv_index], \"-o\") == 0 && argv_index + 1 < argc)\n", 6);
+   PTFI("output_name = argv[++argv_index];\n", 9);
+   PTFI("else if(strcmp(argv[argv_index], \"-N\") == 0 && argv_index + 1 < argc)\n", 6);
+   PTFI("graph_storage.node_hint = atoi(argv[++argv_index]);\n", 9);
+   PTFI("else if(strcmp(argv[argv_index], \"-E\") == 0 && argv_index + 1 < argc)\n", 6);
+   PTFI("graph_storage.edge_hint = atoi(argv[++argv_index]);\n", 9);
+   PTFI("else if(strcmp(argv[argv_index], \"-G\") == 0 && argv_index + 1 < argc)\n", 6);
+   PTFI("{\n", 6);
+   PTFI("graph_storage.growth_percent = atoi(argv[++argv_index]);\n", 9);
+   PTFI("if(graph_storage.growth_percent < 1 || graph_storage.growth_percent > 100)\n", 9);
+   PTFI("{\n", 9);
+   PTFI("fprintf(stderr, \"Error: the growth percentage must be from 1 to 100.\\n\");\n", 12);
+   PTFI("return 0;\n", 12);
+   PTFI("}\n", 9);
+   PTFI("}\n", 6);
+   PTFI("else if(strcmp(argv[argv_index], \"-H\") == 0 && argv_index + 1 < argc)\n", 6);
+   PTFI("{\n", 6);
+   PTFI("argv_index++;\n", 9);
+   PTFI("if(strcmp(argv[argv_index], \"thp\") == 0)\n", 9);
+   PTFI("graph_storage.huge_pages = TRANSPARENT_HUGE_PAGES;\n", 12);
+   PTFI("else if(strcmp(argv[argv_index], \"hugetlb\") == 0)\n", 9);
+   PTFI("graph_storage.huge_pages = EXPLICIT_HUGE_PAGES;\n", 12);
+   PTFI("else\n", 9);
+   PTFI("{\n", 9);
+   PTFI("fprintf(stderr, \"Error: -H takes thp or hugetlb.\\n\");\n", 12);
+   PTFI("return 0;\n", 12);
+   PTFI("}\n", 9);
+   PTFI("}\n", 6);
+   PTFI("else if(strcmp(argv[argv_index], \"-M\") == 0 && argv_index + 1 < argc)\n", 6);
+   PTFI("graph_storage.backing_file = argv[++argv_index];\n", 9);
+   PTFI("else if(strcmp(argv[argv_index], \"-P\") == 0 && argv_index + 1 < argc)\n", 6);
+   PTFI("loader_threads = atoi(argv[++argv_index]);\n", 9);
+   PTFI("else if(strcmp(argv[argv_index], \"-S\") == 0 && argv_index + 1 < argc)\n", 6);
+   PTFI("seed = strtoul(argv[++argv_index], NULL, 10);\n", 9);
+   PTFI("else if(strcmp(argv[argv_index], \"-t\") == 0 && argv_index + 1 < argc)\n", 6);
+   PTFI("stats_name = argv[++argv_index];\n", 9);
+   PTFI("else if(strcmp(argv[argv_index], \"-T\") == 0 && argv_index + 1 < argc)\n", 6);
+   PTFI("stats_interval = atoi(argv[++argv_index]);\n", 9);
+   if(rule_profiling)
+   {
+      PTFI("else if(strcmp(argv[argv_index], \"-p\") == 0 && argv_index + 1 < argc)\n", 6);
+      PTFI("profile_name = argv[++argv_index];\n", 9);
+   }
+   if(match_budgets)
+   {
+      PTFI("else if((strcmp(argv[argv_index], \"-L\") == 0 ||\n", 6);
+      PTFI("         strcmp(argv[argv_index], \"-W\") == 0) && argv_index + 1 < argc)\n", 6);
+      PTFI("{\n", 6);
+      PTFI("bool time = argv[argv_index][1] == 'W';\n", 9);
+      PTFI("if(!setMatchBudget(rule_budgets, argv[++argv_index], time))\n", 9);
+      PTFI("{\n", 9);
+      PTFI("fprintf(stderr, \"Error: invalid match budget %%s.\\n\", argv[argv_index]);\n", 12);
+      PTFI("return 0;\n", 12);
+      PTFI("}\n", 9);
+      PTFI("}\n", 6);
+   }
+   #ifdef LIST_HASHING
+      PTFI("else if(strcmp(argv[argv_index], \"-l\") == 0) list_statistics = true;\n", 6);
+   #endif
+   PTFI("else host_file = argv[argv_index];\n", 6);
+   PTFI("}\n", 3);
+   PTFI("if(host_file == NULL)\n", 3);
    PTFI("{\n", 3);
    PTFI("fprintf(stderr, \"Error: missing <host-file> argument.\\n\");\n", 6);
    PTFI("return 0;\n", 6);
    PTFI("}\n\n", 3);    
+   PTFI("srand(seed);\n", 3);
+   PTFI("seedMatchSampling(seed);\n", 3);
+   PTFI("if(stats_name != NULL && !enableRuntimeStats(stats_name, stats_interval,\n", 3);
+   PTFI("                                             rule_counters, &host)) return 0;\n", 3);
    #if defined GRAPH_TRACING || defined RULE_TRACING || defined BACKTRACK_TRACING
       PTFI("openTraceFile(\"gp2.trace\");\n", 3);
    #endif
 
-   PTFI("host = buildHostGraph(argv[1]);\n", 3);
-   PTFI("if(host == NULL)\n", 3);
+   PTFI("HostStream *stream = NULL;\n", 3);
+   PTFI("if(stream_mode)\n", 3);
    PTFI("{\n", 3);
-   PTFI("fprintf(stderr, \"Error parsing host graph file.\\n\");\n", 6);
-   PTFI("return 0;\n", 6);
+   PTFI("stream = openHostStream(host_file);\n", 6);
+   PTFI("if(stream == NULL) return 0;\n", 6);
+   PTFI("}\n", 3);
+   PTFI("else\n", 3);
+   PTFI("{\n", 3);
+   PTFI("host = loadHostGraph(host_file);\n", 6);
+   PTFI("if(host == NULL)\n", 6);
+   PTFI("{\n", 6);
+   PTFI("fprintf(stderr, \"Error parsing host graph file.\\n\");\n", 9);
+   PTFI("return 0;\n", 9);
+   PTFI("}\n", 6);
+   PTFI("if(delta_file != NULL && !applyGraphDelta(host, delta_file))\n", 6);
+   PTFI("{\n", 6);
+   PTFI("fprintf(stderr, \"Error applying delta file.\\n\");\n", 9);
+   PTFI("return 0;\n", 9);
+   PTFI("}\n", 6);
+   PTFI("if(delta_output) keepBaseGraph();\n", 6);
+   PTFI("if(reorder_host) reorderGraph(host);\n", 6);
+   if(adjacency_index) PTFI("enableAdjacencyIndex(host);\n", 6);
+   if(node_columns) PTFI("enableNodeColumns(host);\n", 6);
+   PTFI("if(write_statistics)\n", 6);
+   PTFI("{\n", 6);
+   PTFI("FILE *stats_file = fopen(\"gp2.stats\", \"w\");\n", 9);
+   PTFI("if(stats_file == NULL) perror(\"gp2.stats\");\n", 9);
+   PTFI("else\n", 9);
+   PTFI("{\n", 9);
+   PTFI("printGraphStatistics(host, stats_file);\n", 12);
+   PTFI("fclose(stats_file);\n", 12);
+   PTFI("}\n", 9);
+   PTFI("}\n", 6);
    PTFI("}\n", 3);
 
-   PTFI("FILE *output_file = fopen(\"gp2.output\", \"w\");\n", 3);
+   PTFI("FILE *output_file = strcmp(output_name, \"-\") == 0 ? stdout : fopen(output_name, \"w\");\n", 3);
    PTFI("if(output_file == NULL)\n", 3);
    PTFI("{\n", 3);
-   PTFI("perror(\"gp2.output\");\n", 6);
+   PTFI("perror(output_name);\n", 6);
    PTFI("exit(1);\n", 6);
    PTFI("}\n", 3);
-
-   #ifdef GRAPH_TRACING
-      PTFI("print_trace(\"Start Graph: \\n\");\n", 3);
-      PTFI("printGraph(host, trace_file);\n\n", 3);
-   #endif
  
    /* Print the calls to allocate memory for each morphism. */
    generateMorphismCode(declarations, 'm', true);
 
-   /* Find the main declaration and generate code from its command sequence. */
-   List *iterator = declarations;
-   while(iterator != NULL)
-   {
-      GPDeclaration *decl = iterator->declaration;
-      if(decl->type == MAIN_DECLARATION)
-      {
-         CommandData initialData = {MAIN_BODY, 0, false, -1, 3}; 
-         generateProgramCode(decl->main_program, initialData);
-      }
-      iterator = iterator->next;
-   }
-   PTF("   printGraph(host, output_file);\n");
-   PTF("   printf(\"Output graph saved to file gp2.output\\n\");\n");
+   PTFI("if(stream_mode)\n", 3);
+   PTFI("{\n", 3);
+   PTFI("int status;\n", 6);
+   PTFI("while((status = readHostStream(stream, &host)) != 0)\n", 6);
+   PTFI("{\n", 6);
+   PTFI("if(status < 0) fprintf(output_file, \"No output graph: invalid host graph.\\n\");\n", 9);
+   PTFI("else\n", 9);
+   PTFI("{\n", 9);
+   PTFI("if(delta_output) keepBaseGraph();\n", 12);
+   PTFI("if(reorder_host) reorderGraph(host);\n", 12);
+   if(adjacency_index) PTFI("enableAdjacencyIndex(host);\n", 12);
+   if(node_columns) PTFI("enableNodeColumns(host);\n", 12);
+   PTFI("runProgram(output_file, binary_output);\n", 12);
+   PTFI("pollRuntimeStats();\n", 12);
+   PTFI("resetProgram();\n", 12);
+   PTFI("}\n", 9);
+   PTFI("fflush(output_file);\n", 9);
+   PTFI("}\n", 6);
+   PTFI("closeHostStream(stream);\n", 6);
+   PTFI("}\n", 3);
+   PTFI("else if(output_file != stdout)\n", 3);
+   PTFI("{\n", 3);
+   PTFI("if(runProgram(output_file, binary_output))\n", 6);
+   PTFI("printf(\"Output graph saved to file %%s\\n\", output_name);\n", 9);
+   PTFI("else printf(\"Output information saved to file %%s\\n\", output_name);\n", 6);
+   PTFI("}\n", 3);
+   PTFI("else runProgram(output_file, binary_output);\n", 3);
+   if(rule_profiling)
+      PTFI("printRuleProfiles(rule_profiles, profileClock() - profile_start, profile_name);\n", 3);
+   PTFI("if(stats_name != NULL) writeRuntimeStats();\n", 3);
    PTF("   garbageCollect();\n");
    //PTF("   printf(\"Graph changes recorded: %%d\\n\", graph_change_count);\n");
    PTF("   fclose(output_file);\n");
@@ -210,8 +466,62 @@ void generateRuntimeMain(List *declarations, string output_dir)
    fclose(file);
 }
 
+/* Prints the C interface of gp2.h for the shared library built by gp2 --shared
+ * in place of the runtime's main function. The morphisms of a thread are
+ * allocated by its first call of gp2_run and persist between its calls, as do
+ * its list store and change stack, as between the graphs of a stream. */
+static void generateLibraryInterface(List *declarations)
+{
+   PTF("static __thread bool initialised = false;\n");
+   if(rule_profiling) PTF("static __thread uint64_t profile_start = 0;\n");
+   PTF("\n");
+
+   PTF("static void initialiseProgram(void)\n");
+   PTF("{\n");
+   if(rule_profiling) PTFI("profile_start = profileClock();\n", 3);
+   generateMorphismCode(declarations, 'm', true);
+   PTFI("initialised = true;\n", 3);
+   PTF("}\n\n");
+
+   PTF("bool gp2_run(Graph **graph, const GP2Options *options)\n");
+   PTF("{\n");
+   PTFI("GP2Options defaults = {NULL, false, NULL, 0};\n", 3);
+   PTFI("if(options == NULL) options = &defaults;\n", 3);
+   PTFI("log_file = options->log != NULL ? options->log : stderr;\n", 3);
+   PTFI("if(!initialised) initialiseProgram();\n", 3);
+   PTFI("unsigned seed = options->seed != 0 ? options->seed : time(NULL);\n", 3);
+   PTFI("srand(seed);\n", 3);
+   PTFI("seedMatchSampling(seed);\n", 3);
+   PTFI("host = *graph;\n", 3);
+   if(adjacency_index) PTFI("enableAdjacencyIndex(host);\n", 3);
+   if(node_columns) PTFI("enableNodeColumns(host);\n", 3);
+   PTFI("bool result = runProgram(options->output, options->binary_output);\n", 3);
+   PTFI("*graph = host;\n", 3);
+   PTFI("resetMorphisms();\n", 3);
+   if(graph_copying) PTFI("discardGraphs(0);\n", 3);
+   else PTFI("discardChanges(0);\n", 3);
+   PTFI("host = NULL;\n", 3);
+   PTFI("return result;\n", 3);
+   PTF("}\n\n");
+
+   PTF("void gp2_close(void)\n");
+   PTF("{\n");
+   PTFI("if(!initialised) return;\n", 3);
+   if(rule_profiling)
+      PTFI("printRuleProfiles(rule_profiles, profileClock() - profile_start, "
+           "\"gp2.profile.json\");\n", 3);
+   PTFI("freeMorphisms();\n", 3);
+   #ifdef LIST_HASHING
+      PTFI("freeHostListStore();\n", 3);
+   #endif
+   if(graph_copying) PTFI("freeGraphStack();\n", 3);
+   else PTFI("freeGraphChangeStack();\n", 3);
+   PTFI("initialised = false;\n", 3);
+   PTF("}\n");
+}
+
 /* For each rule declaration, generate code to handle the morphism variables at
- * runtime. The variables are named M_<rule_name>. This function is called three
+ * runtime. The variables are named M_<rule_name>. This function is called up to five
  * times with different 'type' arguments:
  *
  * Type (d)eclarations switches on the printing of the declaration of the global 
@@ -221,15 +531,34 @@ void generateRuntimeMain(List *declarations, string output_dir)
  * Type (m)akeMorphism switches on the printing of the definition and allocation 
  * of the morphism structures by the makeMorphism function. At runtime this is done
  * at the start of the main function. Data from the rule declaration is used to print 
- * the correct arguments for calls to makeMorphism. 
+ * the correct arguments for calls to makeMorphism. The constants of the rule's
+ * LHS labels are resolved at the same time. 
  *
  * Type (f)reeMorphism switches on the printing of the freeMorphisms function.
- * For each rule declaration, a call to freeMorphism is printed. */
+ * For each rule declaration, a call to freeMorphism is printed.
+ *
+ * Type (r)esetMorphism switches on the printing of the resetMorphisms function,
+ * which clears each morphism for the next run of the program without touching
+ * the host graph.
+ *
+ * Type (p)rofile switches on the printing of the array of the rule profiles of
+ * a profiled runtime.
+ *
+ * Type (c)ounter switches on the printing of the array of the rule counters
+ * written to the live statistics of gp2run -t.
+ *
+ * Type (b)udget switches on the printing of the array of the match budgets of
+ * the rules with a left-hand side, which gp2run's -L and -W flags set. */
 
 static void generateMorphismCode(List *declarations, char type, bool first_call)
 {
-   assert(type == 'm' || type == 'f' || type == 'd');
+   assert(type == 'm' || type == 'f' || type == 'd' || type == 'r' || type == 'p' ||
+          type == 'c' || type == 'b');
    if(type == 'f' && first_call) PTF("static void freeMorphisms(void)\n{\n");
+   if(type == 'r' && first_call) PTF("static void resetMorphisms(void)\n{\n");
+   if(type == 'p' && first_call) PTF("static RuleProfile *rule_profiles[] = {\n");
+   if(type == 'c' && first_call) PTF("static RuleCounter *rule_counters[] = {\n");
+   if(type == 'b' && first_call) PTF("static MatchBudget *rule_budgets[] = {\n");
    while(declarations != NULL)
    {
       GPDeclaration *decl = declarations->declaration;
@@ -246,16 +575,25 @@ static void generateMorphismCode(List *declarations, char type, bool first_call)
          case RULE_DECLARATION:
          {
               GPRule *rule = decl->rule;
+              if(!rule->reachable) break;
               if(type == 'd')
               {
                  PTF("#include \"%s.h\"\n", rule->name);
-                 PTF("Morphism *M_%s = NULL;\n", rule->name);
+                 PTF("__thread Morphism *M_%s = NULL;\n", rule->name);
               }
               if(type == 'm')
+              {
                  PTFI("M_%s = makeMorphism(%d, %d, %d);\n", 3, rule->name, 
                       rule->left_nodes, rule->left_edges, rule->variable_count);
+                 if(rule->label_constants) PTFI("initialise%sLabels();\n", 3, rule->name);
+              }
               if(type == 'f')
                  PTFI("freeMorphism(M_%s);\n", 3, rule->name);
+              if(type == 'r')
+                 PTFI("initialiseMorphism(M_%s, NULL);\n", 3, rule->name);
+              if(type == 'p') PTFI("&profile_%s,\n", 3, rule->name);
+              if(type == 'c') PTFI("&counter_%s,\n", 3, rule->name);
+              if(type == 'b' && !rule->empty_lhs) PTFI("&budget_%s,\n", 3, rule->name);
               break;
          }
          default: 
@@ -267,36 +605,75 @@ static void generateMorphismCode(List *declarations, char type, bool first_call)
       declarations = declarations->next;
    }
    if(type == 'd' || type == 'm') PTF("\n");
+   else if((type == 'p' || type == 'c' || type == 'b') && first_call) PTF("   NULL\n};\n\n");
    else if(first_call) PTF("}\n\n");
 }
 
 
 static void generateProgramCode(GPCommand *command, CommandData data)
 {
+   bool trim_recording = data.trim_recording, hold_match = data.hold_match;
+   GPRule *matched_rule = data.matched_rule;
+   data.trim_recording = false;
+   data.hold_match = false;
+   data.matched_rule = NULL;
    switch(command->type)
    {
       case COMMAND_SEQUENCE:
       {
            List *commands = command->commands;
            CommandData new_data = data;
+           /* Find the last command of the sequence that can fail. */
+           List *last_fallible = NULL;
+           if(trim_recording)
+              for(; commands != NULL; commands = commands->next)
+                 if(!neverFails(commands->command)) last_fallible = commands;
+           commands = command->commands;
+           /* If no command can fail, the body would not have a restore point. */
+           bool past_last_fallible = trim_recording && last_fallible == NULL;
+           new_data.hold_match = hold_match;
+           new_data.matched_rule = matched_rule;
            while(commands != NULL)
            {
               GPCommand *command = commands->command;
+              if(past_last_fallible) new_data.record_changes = data.outer_record_changes;
               generateProgramCode(command, new_data);
+              new_data.hold_match = false;
+              new_data.matched_rule = NULL;
+              if(commands == last_fallible) past_last_fallible = true;
               if(data.context == LOOP_BODY && commands->next != NULL)
                  PTFI("if(!success) break;\n\n", data.indent);             
+              if(data.context == MAIN_BODY && commands->next != NULL)
+                 generateCompactionCode(data.indent);
               commands = commands->next;
            }           
            break;
       }
       case RULE_CALL:
            PTFI("/* Rule Call */\n", data.indent);
+           if(matched_rule == command->rule_call.rule)
+           {
+              #ifdef RULE_TRACING
+                 PTFI("print_trace(\"Matched %s. (held match)\\n\\n\");\n", 
+                      data.indent, matched_rule->name);
+              #endif
+              if(!matched_rule->is_predicate)
+                 generateRuleApplication(command->rule_call.rule_name, data, data.indent);
+              PTFI("success = true;\n", data.indent);
+              break;
+           }
+           data.hold_match = hold_match;
            generateRuleCall(command->rule_call.rule_name, command->rule_call.rule->empty_lhs,
                             command->rule_call.rule->is_predicate, true, data);
            break;
 
       case RULE_SET_CALL:
       {
+           if(scannedRuleSet(command))
+           {
+              generateRuleSetScan(command, data);
+              break;
+           }
            PTFI("/* Rule Set Call */\n", data.indent);
            PTFI("do\n", data.indent);
            PTFI("{\n", data.indent);
@@ -317,6 +694,9 @@ static void generateProgramCode(GPCommand *command, CommandData data)
       case PROCEDURE_CALL:
       {
            GPProcedure *procedure = command->proc_call.procedure;
+           data.trim_recording = trim_recording;
+           data.hold_match = hold_match;
+           data.matched_rule = matched_rule;
            generateProgramCode(procedure->commands, data);
            break;
       }
@@ -362,7 +742,11 @@ static void generateProgramCode(GPCommand *command, CommandData data)
            PTFI("/* Break Statement */\n", data.indent);
            if(data.restore_point >= 0)
            {
-	      if(command->inner_loop)
+	      /* Each loop takes its own snapshot, so the snapshot of the loop body is
+	       * never needed once the loop is left. */
+	      if(graph_copying) PTFI("discardGraphs(restore_point%d);\n", data.indent,
+	                             data.restore_point);
+	      else if(command->inner_loop)
 	      {
 	         PTFI("/* Update restore point for next iteration of inner loop. */\n", data.indent);
 		 #ifdef BACKTRACK_TRACING
@@ -379,20 +763,12 @@ static void generateProgramCode(GPCommand *command, CommandData data)
 		 PTFI("/* Graph changes from loop body not required.\n", data.indent);
 		 PTFI("   Discard them so that future graph roll backs are uncorrupted. */\n",
 		      data.indent);
-		 if(graph_copying) 
-		 {
-		    PTFI("Graph *copy = popGraphs(%d);\n", data.indent, data.restore_point);
-		    PTFI("freeGraph(copy);\n", data.indent);
-		 }
-		 else 
-                 {
-                    PTFI("discardChanges(restore_point%d);\n", data.indent, data.restore_point);
-		    #ifdef BACKTRACK_TRACING
-		       PTFI("print_trace(\"Discarding graph changes.\\n\");\n", data.indent);
-		       PTFI("print_trace(\"New restore point %d: %%d.\\n\\n\", restore_point%d);\n",
-		            data.indent, data.restore_point, data.restore_point);
-		    #endif
-		 }
+                 PTFI("discardChanges(restore_point%d);\n", data.indent, data.restore_point);
+		 #ifdef BACKTRACK_TRACING
+		    PTFI("print_trace(\"Discarding graph changes.\\n\");\n", data.indent);
+		    PTFI("print_trace(\"New restore point %d: %%d.\\n\\n\", restore_point%d);\n",
+		         data.indent, data.restore_point, data.restore_point);
+		 #endif
 	      }
            }
            PTFI("break;\n", data.indent);
@@ -405,6 +781,85 @@ static void generateProgramCode(GPCommand *command, CommandData data)
    }
 }
 
+/* Returns true if the rule set is matched by one scan of the host nodes. Sets
+ * of one rule are matched by the rule's own matcher. */
+static bool scannedRuleSet(GPCommand *command)
+{
+   if(!rule_set_scans) return false;
+   List *rules = command->rule_set;
+   if(rules == NULL || rules->next == NULL) return false;
+   for(; rules != NULL; rules = rules->next)
+      if(!rules->rule_call.rule->scan_member) return false;
+   return true;
+}
+
+/* The index of the rule set member whose call generateRuleCall prints, while a
+ * scanned rule set is printed, and -1 otherwise. The scan stores the index of
+ * the member it matched in the runtime variable set_member, and the call of
+ * each member tests that variable instead of calling the rule's matcher. */
+static int scan_member = -1;
+
+/* The number of rule set scans printed, which numbers the runtime variables
+ * that hold the resume positions of the scans. */
+static int rule_set_scan_count = 0;
+
+/* Prints the scan of the host nodes for a match of any member of the rule set
+ * (see markRuleSetScans in genProgram.h), followed by the rule calls of the
+ * members, which apply the member that matched. The scan stops at the first
+ * node at which a member matches, so the rule set's choice is made by the
+ * position of the node in the host graph and, at that node, by the declared
+ * order of the members. With resumed matching, the scan starts at the node
+ * where the previous scan of the set stopped and wraps around the node array,
+ * so a loop over the set does not rescan the nodes rejected before. With
+ * sampled matching, it starts at a random node. */
+static void generateRuleSetScan(GPCommand *command, CommandData data)
+{
+   int scan = rule_set_scan_count++;
+   PTFI("/* Rule Set Call (one scan of the host nodes) */\n", data.indent);
+   PTFI("do\n", data.indent);
+   PTFI("{\n", data.indent);
+   int indent = data.indent + 3;
+   PTFI("int set_member = -1, nodes = host->nodes.size, step;\n", indent);
+   if(resume_matching && !sampled_matching)
+   {
+      PTFI("static __thread int scan_position%d = 0;\n", indent, scan);
+      PTFI("int host_index = scan_position%d < nodes ? scan_position%d : 0;\n", indent,
+           scan, scan);
+   }
+   else if(sampled_matching) 
+      PTFI("int host_index = nodes > 0 ? sampleCandidate(nodes) : 0;\n", indent);
+   else PTFI("int host_index = 0;\n", indent);
+   PTFI("for(step = 0; set_member < 0 && step < nodes; step++)\n", indent);
+   PTFI("{\n", indent);
+   PTFI("Node *host_node = getNode(host, host_index);\n", indent + 3);
+   PTFI("if(host_node->index != -1)\n", indent + 3);
+   PTFI("{\n", indent + 3);
+   List *rules = command->rule_set;
+   int member = 0;
+   for(; rules != NULL; rules = rules->next, member++)
+   {
+      string rule_name = rules->rule_call.rule_name;
+      PTFI("%sif(match%sAt(M_%s, host_node)) set_member = %d;\n", indent + 6,
+           member == 0 ? "" : "else ", rule_name, rule_name, member);
+   }
+   PTFI("}\n", indent + 3);
+   PTFI("if(set_member < 0 && ++host_index == nodes) host_index = 0;\n", indent + 3);
+   PTFI("}\n", indent);
+   if(resume_matching && !sampled_matching) 
+      PTFI("scan_position%d = host_index;\n", indent, scan);
+   CommandData new_data = data;
+   new_data.indent = indent;
+   rules = command->rule_set;
+   for(scan_member = 0; rules != NULL; rules = rules->next, scan_member++)
+   {
+      string rule_name = rules->rule_call.rule_name;
+      bool predicate = rules->rule_call.rule->is_predicate;
+      generateRuleCall(rule_name, false, predicate, rules->next == NULL, new_data);
+   }
+   scan_member = -1;
+   PTFI("} while(false);\n", data.indent);
+}
+
 /* That's a lot of arguments! What do they achieve?
  * rule_name: Used to print variables and functions named after their rule,
  *            specifically the morphism, the rule matching function and the
@@ -425,7 +880,7 @@ static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
               data.indent, rule_name);
       #endif
       if(predicate) return;
-      if(data.restore_point >= 0 && !graph_copying) 
+      if(data.record_changes && !graph_copying) 
          PTFI("apply%s(true);\n", data.indent, rule_name);
       else PTFI("apply%s(false);\n", data.indent, rule_name);
       #ifdef GRAPH_TRACING
@@ -440,11 +895,16 @@ static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
       #ifdef RULE_TRACING
          PTFI("print_trace(\"Matching %s...\\n\");\n", data.indent, rule_name);
       #endif
-      PTFI("if(match%s(M_%s))\n", data.indent, rule_name, rule_name);
+      if(scan_member >= 0) PTFI("if(set_member == %d)\n", data.indent, scan_member);
+      else PTFI("if(match%s(M_%s))\n", data.indent, rule_name, rule_name);
       PTFI("{\n", data.indent);
       #ifdef RULE_TRACING
          PTFI("print_trace(\"Matched %s.\\n\\n\");\n", data.indent + 3, rule_name);
       #endif
+      /* The matching function of a predicate resets the morphism after a match,
+       * but the function called by a rule set scan does not. */
+      if(predicate && scan_member >= 0) 
+         PTFI("initialiseMorphism(M_%s, host);\n", data.indent + 3, rule_name);
       if(!predicate)
       {
          /* It is incorrect to apply the rule in a program such as "if r1 then P else Q",
@@ -453,17 +913,10 @@ static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
           * Hence, only generate rule application if the context is not IF_BODY or
           * graph recording is on (signified by a restore_point >= 0). */
          if(data.context != IF_BODY || data.restore_point >= 0)
-         { 
-            if(data.record_changes && !graph_copying) 
-                 PTFI("apply%s(M_%s, true);\n", data.indent + 3, rule_name, rule_name);
-            else PTFI("apply%s(M_%s, false);\n", data.indent + 3, rule_name, rule_name);
-            #ifdef GRAPH_TRACING
-               PTFI("print_trace(\"Graph after applying rule %s:\\n\");\n",
-                    data.indent + 3, rule_name);
-               PTFI("printGraph(host, trace_file);\n\n", data.indent + 3);
-            #endif
-         }
-         else PTFI("initialiseMorphism(M_%s, host);\n", data.indent + 3, rule_name);
+            generateRuleApplication(rule_name, data, data.indent + 3);
+         /* A held match is applied by the then branch. */
+         else if(!data.hold_match)
+            PTFI("initialiseMorphism(M_%s, host);\n", data.indent + 3, rule_name);
       }
       PTFI("success = true;\n", data.indent + 3);
       /* If this rule call is within a rule set, and it is not the last rule in that
@@ -495,6 +948,18 @@ static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
    }
 }
 
+/* Prints the application of the rule to the match in its morphism. */
+static void generateRuleApplication(string rule_name, CommandData data, int indent)
+{
+   if(data.record_changes && !graph_copying) 
+        PTFI("apply%s(M_%s, true);\n", indent, rule_name, rule_name);
+   else PTFI("apply%s(M_%s, false);\n", indent, rule_name, rule_name);
+   #ifdef GRAPH_TRACING
+      PTFI("print_trace(\"Graph after applying rule %s:\\n\");\n", indent, rule_name);
+      PTFI("printGraph(host, trace_file);\n\n", indent);
+   #endif
+}
+
 /* generateBranchStatement passes on the second argument 'data' to the calls to
  * generate code for the then and else branches.
  * The flags from the GPCommand structure are used only to generate code for
@@ -507,16 +972,18 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    condition_data.indent = data.indent + 3;
 
    /* No restore point set if:
-    * (1) The branch is if-then-else and the condition is sufficiently simple.
-    * (2) The branch is try-then-else and the condition is a null command.
-    * (3) The branch is try-then-else, the condition is sufficiently simple, and
-    *     both then and else are null commands. 
+    * (1) The branch is if-then-else and the condition is sufficiently simple
+    *     or does not change the host graph.
+    * (2) The branch is try-then-else and the condition fails only before it
+    *     changes the host graph: the graph is then unchanged if the condition
+    *     fails, and the changes are kept if it succeeds.
     * One example of a sufficiently simple command is a single rule call.
     * A single rule application in an if condition only needs to be matched: 
     * if the match succeeds, do not apply the rule and execute the then branch. */
    if(condition_data.context == IF_BODY)
    {
-      if(singleRule(command->cond_branch.condition))
+      if(singleRule(command->cond_branch.condition) ||
+         nullCommand(command->cond_branch.condition))
          condition_data.restore_point = -1;
       else
       {
@@ -526,18 +993,19 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    }
    else 
    {
-      bool null_condition = nullCommand(command->cond_branch.condition);
-      bool simple_try = singleRule(command->cond_branch.condition)
-                      && nullCommand(command->cond_branch.then_command)
-                      && nullCommand(command->cond_branch.else_command);
-      if(null_condition || simple_try) condition_data.restore_point = -1;
+      if(failsCleanly(command->cond_branch.condition)) condition_data.restore_point = -1;
       else
       {
+         condition_data.trim_recording = true;
+         condition_data.outer_record_changes = data.record_changes;
          condition_data.record_changes = true;
          condition_data.restore_point = restore_point_count++;
       }
    }
 
+   GPRule *held_rule = heldMatchRule(command);
+   condition_data.hold_match = held_rule != NULL;
+
    if(condition_data.context == IF_BODY) PTFI("/* If Statement */\n", data.indent);
    else PTFI("/* Try Statement */\n", data.indent);
    PTFI("/* Condition */\n", data.indent);
@@ -546,7 +1014,8 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
       #ifdef BACKTRACK_TRACING
          PTFI("print_trace(\"Recording graph changes.\\n\");\n", data.indent);
       #endif
-      if(graph_copying) PTFI("copyGraph(host);\n", data.indent);
+      if(graph_copying) PTFI("int restore_point%d = copyGraph(host);\n", data.indent,
+                             condition_data.restore_point);
       else 
       {
          PTFI("int restore_point%d = graph_change_stack == NULL ? 0 : topOfGraphChangeStack();\n",
@@ -566,10 +1035,7 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    {
       if(condition_data.restore_point >= 0)
       {
-         if(graph_copying) PTFI("host = popGraphs(%d);\n", data.indent, 
-                                condition_data.restore_point);
-         else PTFI("undoChanges(host, restore_point%d);\n", data.indent, 
-                   condition_data.restore_point);
+         generateUndoCode(condition_data.restore_point, data.indent);
          #ifdef BACKTRACK_TRACING
             PTFI("print_trace(\"Undoing graph changes from restore point %d: %%d.\\n\\n\", "
 		 "restore_point%d);\n", 
@@ -588,9 +1054,13 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    PTFI("/* Then Branch */\n", data.indent);
    PTFI("if(success)\n", data.indent);
    PTFI("{\n", data.indent);
+   new_data.matched_rule = held_rule;
    if(condition_data.context == TRY_BODY && condition_data.restore_point >= 0)
    {
-      PTFI("discardChanges(restore_point%d);\n", new_data.indent, condition_data.restore_point);
+      if(graph_copying) PTFI("discardGraphs(restore_point%d);\n", new_data.indent,
+                             condition_data.restore_point);
+      else PTFI("discardChanges(restore_point%d);\n", new_data.indent,
+                condition_data.restore_point);
       #ifdef BACKTRACK_TRACING
          PTFI("print_trace(\"Discarding graph changes.\\n\");\n", new_data.indent);
          PTFI("print_trace(\"New restore point %d: %%d.\\n\\n\", restore_point%d);\n",
@@ -598,6 +1068,7 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
       #endif
    }
    generateProgramCode(command->cond_branch.then_command, new_data);
+   new_data.matched_rule = NULL;
    PTFI("}\n", data.indent);
    PTFI("/* Else Branch */\n", data.indent);
    PTFI("else\n", data.indent);
@@ -606,10 +1077,7 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    {
       if(condition_data.restore_point >= 0)
       {
-         if(graph_copying) PTFI("host = popGraphs(%d);\n", new_data.indent, 
-                                condition_data.restore_point);
-         else PTFI("undoChanges(host, restore_point%d);\n", new_data.indent, 
-                   condition_data.restore_point);
+         generateUndoCode(condition_data.restore_point, new_data.indent);
          #ifdef BACKTRACK_TRACING
             PTFI("print_trace(\"Undoing graph changes from restore point %d: %%d.\\n\\n\", "
 		 "restore_point%d);\n", 
@@ -644,11 +1112,14 @@ void generateLoopStatement(GPCommand *command, CommandData data)
    loop_data.loop_depth++;
    loop_data.indent = data.indent + 3;
 
-   /* If the loop body requires recording, assign it the next restore point. */
-   if(singleRule(command->loop_stmt.loop_body)) 
+   /* If the loop body requires recording, assign it the next restore point. A body
+    * that fails only before it changes the host graph leaves nothing to undo. */
+   if(failsCleanly(command->loop_stmt.loop_body)) 
       loop_data.restore_point = -1;
    else
    {
+      loop_data.trim_recording = true;
+      loop_data.outer_record_changes = data.record_changes;
       loop_data.record_changes = true;
       loop_data.restore_point = restore_point_count++;
    }
@@ -659,7 +1130,8 @@ void generateLoopStatement(GPCommand *command, CommandData data)
       #ifdef BACKTRACK_TRACING
          PTFI("print_trace(\"Recording graph changes.\\n\\n\");\n", data.indent);
       #endif
-      if(graph_copying) PTFI("copyGraph(host);\n", data.indent);
+      if(graph_copying) PTFI("int restore_point%d = copyGraph(host);\n", data.indent,
+                             loop_data.restore_point);
       else 
       { 
          PTFI("int restore_point%d = graph_change_stack == NULL ? 0 : topOfGraphChangeStack();\n",
@@ -672,10 +1144,39 @@ void generateLoopStatement(GPCommand *command, CommandData data)
    }
    PTFI("while(success)\n", data.indent);
    PTFI("{\n", data.indent);
-   generateProgramCode(command->loop_stmt.loop_body, loop_data);
+   GPRule *batch_rule = batchLoopRule(command->loop_stmt.loop_body);
+   if(batch_rule != NULL && batch_rule->batch_apply)
+   {
+      PTFI("/* Rule Call: applied to a set of disjoint matches */\n", loop_data.indent);
+      if(loop_data.record_changes && !graph_copying)
+         PTFI("if(applyAll%s(M_%s, true) > 0) success = true;\n", loop_data.indent,
+              batch_rule->name, batch_rule->name);
+      else PTFI("if(applyAll%s(M_%s, false) > 0) success = true;\n", loop_data.indent,
+                batch_rule->name, batch_rule->name);
+      PTFI("else\n", loop_data.indent);
+      PTFI("{\n", loop_data.indent);
+      CommandData failure_data = loop_data;
+      failure_data.indent = loop_data.indent + 3;
+      generateFailureCode(batch_rule->name, failure_data);
+      PTFI("}\n", loop_data.indent);
+   }
+   else generateProgramCode(command->loop_stmt.loop_body, loop_data);
    if(loop_data.restore_point >= 0)
    {
-      if(loop_data.loop_depth > 1)
+      /* A snapshot is independent of the snapshots of enclosing loops, so after a
+       * successful iteration it is replaced by a snapshot of the current graph 
+       * at any loop depth. */
+      if(graph_copying)
+      {
+         PTFI("/* Take a new snapshot for the next iteration. */\n", data.indent + 3);
+         PTFI("if(success)\n", data.indent + 3);
+         PTFI("{\n", data.indent + 3);
+         PTFI("discardGraphs(restore_point%d);\n", data.indent + 6, loop_data.restore_point);
+         if(data.context == MAIN_BODY) generateCompactionCode(data.indent + 6);
+         PTFI("restore_point%d = copyGraph(host);\n", data.indent + 6, loop_data.restore_point);
+         PTFI("}\n", data.indent + 3);
+      }
+      else if(loop_data.loop_depth > 1)
       {
          PTFI("/* Update restore point for next iteration of inner loop. */\n", data.indent + 3);
 	 #ifdef BACKTRACK_TRACING
@@ -692,30 +1193,34 @@ void generateLoopStatement(GPCommand *command, CommandData data)
 	 PTFI("/* Graph changes from loop body may not have been used.\n", data.indent + 3);
 	 PTFI("   Discard them so that future graph roll backs are uncorrupted. */\n",
 	      data.indent + 3);
-	 if(graph_copying)
-	 {
-	    PTFI("if(success)\n", data.indent + 3);
-	    PTFI("{\n", data.indent + 3);
-	    PTFI("Graph *copy = popGraphs(%d);\n", data.indent + 6, loop_data.restore_point);
-	    PTFI("freeGraph(copy);\n", data.indent + 6);
-	    PTFI("}\n", data.indent + 3);
-	 }
-	 else 
-         {
-	    PTFI("if(success) discardChanges(restore_point%d);\n", 
-	         data.indent + 3, loop_data.restore_point);
-            #ifdef BACKTRACK_TRACING
-	         PTFI("print_trace(\"Discarding graph changes.\\n\");\n", data.indent + 3);
-	         PTFI("print_trace(\"New restore point %d: %%d.\\n\\n\", restore_point%d);\n",
-	              data.indent + 3, loop_data.restore_point, loop_data.restore_point);
-	    #endif
-         }
+	 PTFI("if(success) discardChanges(restore_point%d);\n", 
+	      data.indent + 3, loop_data.restore_point);
+         #ifdef BACKTRACK_TRACING
+	      PTFI("print_trace(\"Discarding graph changes.\\n\");\n", data.indent + 3);
+	      PTFI("print_trace(\"New restore point %d: %%d.\\n\\n\", restore_point%d);\n",
+	           data.indent + 3, loop_data.restore_point, loop_data.restore_point);
+	 #endif
       }
    }
+   /* An iteration of a loop in the main body that leaves no recorded changes
+    * ends at a safe point for compaction, as after a command of the main body. */
+   if(data.context == MAIN_BODY && (loop_data.restore_point < 0 || !graph_copying))
+   {
+      PTFI("if(success)\n", data.indent + 3);
+      generateCompactionCode(data.indent + 6);
+   }
    PTFI("}\n", data.indent);
    PTFI("success = true;\n", data.indent);
 }
 
+/* Between the commands of the main body no morphism holds a host graph index,
+ * the changes of every finished command have been discarded and no snapshot
+ * shares the host graph's chunks, so the host graph can be compacted. */
+static void generateCompactionCode(int indent)
+{
+   PTFI("if(sparseGraph(host)) compactGraph(host);\n", indent);
+}
+
 /* Generates code to handle failure, which is context-dependent. There are two
  * kinds of failure: 
  * (1) A rule fails to match. The name of the rule is passed as the first 
@@ -724,24 +1229,22 @@ void generateLoopStatement(GPCommand *command, CommandData data)
 
 static void generateFailureCode(string rule_name, CommandData data)
 {
-   /* A failure in the main body ends the execution. Emit code to report the 
-    * failure, garbage collect and return 0. */
+   /* A failure in the main body ends the run of the program. Emit code to
+    * report the failure and return false. */
    if(data.context == MAIN_BODY)
    {
       #ifdef GRAPH_TRACING
          PTFI("print_trace(\"Program failed. Final graph:\\n\");\n", data.indent);
          PTFI("printGraph(host, trace_file);\n", data.indent);
       #endif
+      if(shared_library) PTFI("if(output_file != NULL)\n", data.indent);
+      int indent = shared_library ? data.indent + 3 : data.indent;
       if(rule_name != NULL)
          PTFI("fprintf(output_file, \"No output graph: rule %s not applicable.\\n\");\n",
-              data.indent, rule_name);
+              indent, rule_name);
       else PTFI("fprintf(output_file, \"No output graph: Fail statement invoked\\n\");\n",
-                data.indent);
-      PTFI("printf(\"Output information saved to file gp2.output\\n\");\n", data.indent);
-      PTFI("garbageCollect();\n", data.indent);
-      //PTFI("printf(\"Graph changes recorded: %%d\\n\", graph_change_count);\n", data.indent);
-      PTFI("fclose(output_file);\n", data.indent);
-      PTFI("return 0;\n", data.indent);
+                indent);
+      PTFI("return false;\n", data.indent);
    }
    /* In other contexts, set the runtime success flag to false. */
    else PTFI("success = false;\n", data.indent);
@@ -751,8 +1254,7 @@ static void generateFailureCode(string rule_name, CommandData data)
    {
       if(data.restore_point >= 0) 
       {
-         if(graph_copying) PTFI("host = popGraphs(%d);\n", data.indent, data.restore_point);
-         else PTFI("undoChanges(host, restore_point%d);\n", data.indent, data.restore_point);
+         generateUndoCode(data.restore_point, data.indent);
          #ifdef BACKTRACK_TRACING
             PTFI("print_trace(\"Undoing graph changes from restore point %d: %%d\\n\\n\", "
 		 "restore_point%d);\n", data.indent, data.restore_point, data.restore_point);
@@ -765,6 +1267,17 @@ static void generateFailureCode(string rule_name, CommandData data)
    }
 }
 
+/* Prints the statement that restores the host graph to the restore point. The
+ * profiled runtime times the restoration. */
+static void generateUndoCode(int restore_point, int indent)
+{
+   if(graph_copying) 
+      PTFI("host = %s(host, restore_point%d);\n", indent,
+           rule_profiling ? "profileRevertGraph" : "revertGraph", restore_point);
+   else PTFI("%s(host, restore_point%d);\n", indent,
+             rule_profiling ? "profileUndoChanges" : "undoChanges", restore_point);
+}
+
 /* The function singleRule returns true if the passed command amounts to a single 
  * rule call or something simpler. This prevents backtracking code from being
  * generated when it would not be necessary, which would otherwise occur in 
@@ -822,6 +1335,43 @@ static bool singleRule(GPCommand *command)
 }
 
 
+/* Returns the rule called by the first command executed by the passed command if
+ * that command is a rule call, and NULL otherwise. */
+static GPRule *firstRuleCall(GPCommand *command)
+{
+   switch(command->type)
+   {
+      case COMMAND_SEQUENCE:
+           if(command->commands == NULL) return NULL;
+           return firstRuleCall(command->commands->command);
+
+      case RULE_CALL:
+           return command->rule_call.rule;
+
+      case PROCEDURE_CALL:
+           return firstRuleCall(command->proc_call.procedure->commands);
+
+      default:
+           return NULL;
+   }
+}
+
+/* Returns the rule R if the passed branch statement is "if R then (R; P) else Q",
+ * possibly with R called through procedures, and NULL otherwise. The condition
+ * only matches R, so the host graph is unchanged when the then branch starts and
+ * the condition's match can be applied by the then branch's call of R. Rules
+ * with an empty LHS are not matched, so they are excluded. */
+static GPRule *heldMatchRule(GPCommand *command)
+{
+   if(command->type != IF_STATEMENT) return NULL;
+   GPCommand *condition = command->cond_branch.condition;
+   if(!singleRule(condition)) return NULL;
+   GPRule *rule = firstRuleCall(condition);
+   if(rule == NULL || rule->empty_lhs) return NULL;
+   if(firstRuleCall(command->cond_branch.then_command) != rule) return NULL;
+   return rule;
+}
+
 /* A simple command is non-failing (NF) if it never fails. Specifically:
  * 'skip' and 'break' are NF.
  * 'fail' is not NF.
@@ -902,6 +1452,75 @@ static bool neverFails(GPCommand *command)
    return false;
 }
 
+/* A command fails cleanly (FC) if it changes the host graph only after the
+ * point at which it can no longer fail. Specifically:
+ * Rule calls, rule set calls, 'skip', 'break' and 'fail' are FC: a rule
+ * can only fail before it is applied.
+ * A looped subprogram is FC since it is NF.
+ * if C then P else Q is FC if both P and Q are FC: the changes made by C
+ * are undone before P or Q is executed.
+ * try C then P else Q is FC if Q is FC, and either P is NF or C is a null
+ * command and P is FC.
+ * P or Q is FC if both P and Q are FC.
+ * A command sequence is FC if each of its commands that can fail is FC and
+ * is preceded only by null commands.
+ *
+ * A loop body or try condition that fails cleanly does not need a restore
+ * point: if it fails, there are no changes to undo. */
+static bool failsCleanly(GPCommand *command)
+{
+   switch(command->type)
+   {
+      case COMMAND_SEQUENCE:
+      { 
+           bool changed = false;
+           List *commands = command->commands;
+           while(commands != NULL)
+           {
+              if(!neverFails(commands->command))
+              {
+                 if(changed || !failsCleanly(commands->command)) return false;
+              }
+              if(!nullCommand(commands->command)) changed = true;
+              commands = commands->next;
+           }
+           return true;
+      }
+      case RULE_CALL:
+      case RULE_SET_CALL:
+      case ALAP_STATEMENT:
+      case BREAK_STATEMENT:
+      case SKIP_STATEMENT:
+      case FAIL_STATEMENT:
+           return true;
+
+      case PROCEDURE_CALL:
+           return failsCleanly(command->proc_call.procedure->commands);
+
+      case IF_STATEMENT:
+           if(!failsCleanly(command->cond_branch.then_command)) return false;
+           if(!failsCleanly(command->cond_branch.else_command)) return false;
+           else return true;
+
+      case TRY_STATEMENT:
+           if(!failsCleanly(command->cond_branch.else_command)) return false;
+           if(neverFails(command->cond_branch.then_command)) return true;
+           if(!nullCommand(command->cond_branch.condition)) return false;
+           return failsCleanly(command->cond_branch.then_command);
+
+      case PROGRAM_OR:
+           if(!failsCleanly(command->or_stmt.left_command)) return false;
+           if(!failsCleanly(command->or_stmt.right_command)) return false;
+           else return true;
+
+      default:
+           print_to_log("Error (failsCleanly): Unexpected command type %d.\n",
+                        command->type);
+           break;
+   }
+   return false;
+}
+
 /* Returns true if the passed GP 2 command does not change the host graph. */
 static bool nullCommand(GPCommand *command)
 {
@@ -966,3 +1585,257 @@ static bool nullCommand(GPCommand *command)
    }
    return false;
 }
+
+/* Returns the rule called by a loop body consisting of a single rule call, and
+ * NULL for any other loop body. */
+static GPRule *batchLoopRule(GPCommand *loop_body)
+{
+   if(loop_body->type == COMMAND_SEQUENCE)
+   {
+      List *commands = loop_body->commands;
+      if(commands == NULL || commands->next != NULL) return NULL;
+      loop_body = commands->command;
+   }
+   if(loop_body->type != RULE_CALL) return NULL;
+   return loop_body->rule_call.rule;
+}
+
+static void markBatchCommand(GPCommand *command)
+{
+   switch(command->type)
+   {
+      case COMMAND_SEQUENCE:
+      {
+           List *commands = command->commands;
+           for(; commands != NULL; commands = commands->next)
+              markBatchCommand(commands->command);
+           break;
+      }
+      case IF_STATEMENT:
+      case TRY_STATEMENT:
+           markBatchCommand(command->cond_branch.condition);
+           markBatchCommand(command->cond_branch.then_command);
+           markBatchCommand(command->cond_branch.else_command);
+           break;
+
+      case ALAP_STATEMENT:
+      {
+           GPRule *rule = batchLoopRule(command->loop_stmt.loop_body);
+           if(rule != NULL) rule->batch_apply = true;
+           else markBatchCommand(command->loop_stmt.loop_body);
+           break;
+      }
+      case PROGRAM_OR:
+           markBatchCommand(command->or_stmt.left_command);
+           markBatchCommand(command->or_stmt.right_command);
+           break;
+
+      /* Procedure bodies are visited through their declarations. */
+      default: 
+           break;
+   }
+}
+
+void markBatchLoops(List *declarations)
+{
+   for(; declarations != NULL; declarations = declarations->next)
+   {
+      GPDeclaration *decl = declarations->declaration;
+      if(decl->type == MAIN_DECLARATION) markBatchCommand(decl->main_program);
+      if(decl->type == PROCEDURE_DECLARATION)
+      {
+         markBatchCommand(decl->procedure->commands);
+         markBatchLoops(decl->procedure->local_decls);
+      }
+   }
+}
+
+static void markScanCommand(GPCommand *command)
+{
+   switch(command->type)
+   {
+      case COMMAND_SEQUENCE:
+      {
+           List *commands = command->commands;
+           for(; commands != NULL; commands = commands->next)
+              markScanCommand(commands->command);
+           break;
+      }
+      case RULE_SET_CALL:
+      {
+           List *rules = command->rule_set;
+           for(; rules != NULL; rules = rules->next)
+              rules->rule_call.rule->scan_member = true;
+           break;
+      }
+      case IF_STATEMENT:
+      case TRY_STATEMENT:
+           markScanCommand(command->cond_branch.condition);
+           markScanCommand(command->cond_branch.then_command);
+           markScanCommand(command->cond_branch.else_command);
+           break;
+
+      case ALAP_STATEMENT:
+           markScanCommand(command->loop_stmt.loop_body);
+           break;
+
+      case PROGRAM_OR:
+           markScanCommand(command->or_stmt.left_command);
+           markScanCommand(command->or_stmt.right_command);
+           break;
+
+      /* Procedure bodies are visited through their declarations. */
+      default: 
+           break;
+   }
+}
+
+void markRuleSetScans(List *declarations)
+{
+   for(; declarations != NULL; declarations = declarations->next)
+   {
+      GPDeclaration *decl = declarations->declaration;
+      if(decl->type == MAIN_DECLARATION) markScanCommand(decl->main_program);
+      if(decl->type == PROCEDURE_DECLARATION)
+      {
+         markScanCommand(decl->procedure->commands);
+         markRuleSetScans(decl->procedure->local_decls);
+      }
+   }
+}
+
+/* Removes the members of the rule set that are subsumed by an earlier member
+ * (see subsumesRule in rule.h). A set left with one member becomes a call of
+ * that rule. Each member is transformed once, and kept for the comparisons
+ * with the later members if it has no condition, so that a large generated
+ * rule set is pruned without transforming its rules once per pair. */
+static void pruneRuleSet(GPCommand *command)
+{
+   int members = 0, kept = 0, index;
+   List *member, **link = &(command->rule_set);
+   for(member = command->rule_set; member != NULL; member = member->next) members++;
+   Rule **earlier_rules = malloc(members * sizeof(Rule *));
+   GPRule **earlier_calls = malloc(members * sizeof(GPRule *));
+   if(earlier_rules == NULL || earlier_calls == NULL)
+   {
+      print_to_log("Error (pruneRuleSet): malloc failure.\n");
+      exit(1);
+   }
+   while(*link != NULL)
+   {
+      member = *link;
+      GPRule *rule = member->rule_call.rule;
+      Rule *later_rule = transformRule(rule);
+      bool subsumed = false;
+      for(index = 0; index < kept && !subsumed; index++)
+         subsumed = earlier_calls[index] == rule ||
+                    (earlier_rules[index] != NULL &&
+                     subsumesRule(earlier_rules[index], later_rule));
+      if(!subsumed)
+      {
+         if(later_rule->condition != NULL)
+         {
+            freeRule(later_rule);
+            later_rule = NULL;
+         }
+         earlier_rules[kept] = later_rule;
+         earlier_calls[kept++] = rule;
+         link = &(member->next);
+         continue;
+      }
+      freeRule(later_rule);
+      print_to_log("Rule %s is removed from the rule set at line %d: it is subsumed by "
+                   "an earlier rule.\n", rule->name, command->location.first_line);
+      *link = member->next;
+      free(member->rule_call.rule_name);
+      free(member);
+   }
+   for(index = 0; index < kept; index++)
+      if(earlier_rules[index] != NULL) freeRule(earlier_rules[index]);
+   free(earlier_rules);
+   free(earlier_calls);
+   List *rule_set = command->rule_set;
+   if(rule_set->next != NULL) return;
+   command->type = RULE_CALL;
+   command->rule_call.rule_name = rule_set->rule_call.rule_name;
+   command->rule_call.rule = rule_set->rule_call.rule;
+   free(rule_set);
+}
+
+static void pruneCommand(GPCommand *command)
+{
+   switch(command->type)
+   {
+      case COMMAND_SEQUENCE:
+      {
+           List *commands = command->commands;
+           for(; commands != NULL; commands = commands->next)
+              pruneCommand(commands->command);
+           break;
+      }
+      case RULE_CALL:
+           command->rule_call.rule->reachable = true;
+           break;
+
+      case RULE_SET_CALL:
+      {
+           pruneRuleSet(command);
+           if(command->type == RULE_CALL)
+           {
+              command->rule_call.rule->reachable = true;
+              break;
+           }
+           List *rules = command->rule_set;
+           for(; rules != NULL; rules = rules->next) rules->rule_call.rule->reachable = true;
+           break;
+      }
+      /* The calls of a procedure share its body, which is pruned at each of
+       * them; pruning is idempotent. The walk follows the calls as code
+       * generation does, so it ends. */
+      case PROCEDURE_CALL:
+           pruneCommand(command->proc_call.procedure->commands);
+           break;
+
+      case IF_STATEMENT:
+      case TRY_STATEMENT:
+           pruneCommand(command->cond_branch.condition);
+           pruneCommand(command->cond_branch.then_command);
+           pruneCommand(command->cond_branch.else_command);
+           break;
+
+      case ALAP_STATEMENT:
+           pruneCommand(command->loop_stmt.loop_body);
+           break;
+
+      case PROGRAM_OR:
+           pruneCommand(command->or_stmt.left_command);
+           pruneCommand(command->or_stmt.right_command);
+           break;
+
+      default: 
+           break;
+   }
+}
+
+/* Logs the rules that the main program never calls. */
+static void logUnreachableRules(List *declarations)
+{
+   for(; declarations != NULL; declarations = declarations->next)
+   {
+      GPDeclaration *decl = declarations->declaration;
+      if(decl->type == PROCEDURE_DECLARATION)
+         logUnreachableRules(decl->procedure->local_decls);
+      if(decl->type == RULE_DECLARATION && !decl->rule->reachable)
+         print_to_log("Rule %s is not generated: the program never calls it.\n",
+                      decl->rule->name);
+   }
+}
+
+void pruneProgram(List *declarations)
+{
+   List *iterator;
+   for(iterator = declarations; iterator != NULL; iterator = iterator->next)
+      if(iterator->declaration->type == MAIN_DECLARATION)
+         pruneCommand(iterator->declaration->main_program);
+   logUnreachableRules(declarations);
+}
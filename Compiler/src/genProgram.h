@@ -40,6 +40,52 @@
 
 void generateRuntimeMain(List *declarations, string output_dir);
 
+/* Sets the batch_apply flag of every rule that is the whole body of a loop
+ * (R!). Called before rule generation when batch application is enabled; the
+ * rule generator clears the flag of rules that fail its independence check.
+ * The loop of a rule with the flag set is translated to:
+ *
+ * while(success)
+ * {
+ *    if(applyAllR(M_R) > 0) success = true;
+ *    else success = false;
+ * }
+ *
+ * applyAllR collects a set of pairwise disjoint matches of R in one search
+ * of the host graph and applies R to each of them. */
+void markBatchLoops(List *declarations);
+
+/* Sets the scan_member flag of every rule called in a rule set. Called before
+ * rule generation when rule set scans are enabled. The rule generator gives
+ * each such rule the additional matching function
+ *
+ * bool matchRAt(Morphism *morphism, Node *host_node);
+ *
+ * which matches R with the node of its first searchplan operation mapped to
+ * host_node, and clears the flag of rules whose searchplans do not start with
+ * a node matched in isolation. A rule set whose members all keep the flag is
+ * translated to:
+ *
+ * for each live host node n, while no member has matched:
+ *    if(matchR1At(M_R1, n)) member = 1;
+ *    else if(matchR2At(M_R2, n)) member = 2; ...
+ *
+ * followed by the application of the member that matched. The host nodes are
+ * scanned once for the whole set instead of once per member, and at each node
+ * the members are tried in the declared order. */
+void markRuleSetScans(List *declarations);
+
+/* Program-level optimisation, called before rule generation. Sets the reachable
+ * flag of every rule called by the main program, directly or through
+ * procedures; no code is generated for the other rules, including the local
+ * rules of procedures that are never called. Every rule set loses the members
+ * that an earlier member subsumes (see subsumesRule in rule.h): the earlier
+ * member is tried first and matches wherever the later one would, so the later
+ * one's search could only fail. A rule set left with one member becomes a call
+ * of that rule. The removed rules and rule set members are logged to
+ * gp2-compile.log. */
+void pruneProgram(List *declarations);
+
 /* Each GP 2 control construct is translated into a fragment of C code. 
  * I give the "broad strokes" translation here, excluding the more fiddly
  * details such as the management of graph backtracking. The runtime code
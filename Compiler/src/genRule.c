@@ -16,23 +16,149 @@
 #include "genRule.h"
 
 static void generateMatchingCode(Rule *rule, bool predicate);
-static void emitDegreeCheck(RuleNode *left_node, int indent);
+static void emitDegreeCheck(RuleNode *left_node, bool columns, int indent);
+static int emitClassTableLoops(RuleLabel label, bool node);
+static void emitClassTableLoopsEnd(int indent);
 static void emitRootNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op);
 static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op);
+static void emitFilteredNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op);
 static void emitNodeFromEdgeMatcher(Rule *rule, RuleNode *left_node, char type, SearchOp *next_op);
-static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int indent);
 static void emitEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op);
 static void emitLoopEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op);
-static void emitEdgeFromNodeMatcher(Rule *rule, RuleEdge *left_edge, bool source,
-                                    bool initialise, bool exit, SearchOp *next_op);
-static void emitEdgeMatchResultCode(int index, SearchOp *next_op, int indent);
+static void emitEdgeFromNodeMatcher(Rule *rule, RuleEdge *left_edge, bool ends_matched,
+                                    bool source, SearchOp *next_op);
+static void emitMatchResultCode(Rule *rule, bool node, int index, SearchOp *next_op,
+                                int indent);
 static void emitNextMatcherCall(SearchOp *next_operation);
+static void emitOperation(Rule *rule, SearchOp *operation);
+static int emitInlineOperation(Rule *rule, SearchOp *operation, int indent);
+static void emitBacktrackLabel(int label, int indent);
+static void emitMatcherStart(char item, int index, bool from_edge);
+static void emitMatcherEnd(void);
+static void emitMatchedTest(string item, bool node);
+static void emitMatchedFlagUpdate(string item, bool node, bool matched, int indent);
+static void emitParallelMatcher(void);
+static void emitBatchStore(void);
+static void emitBatchApplication(string rule_name);
+static string matchFoundCode(void);
+static void emitRuleProfile(string rule_name, Searchplan *searchplan);
+static void emitCandidateCount(int indent);
+static void emitProfiledFunctions(Rule *rule, bool predicate);
+static void emitApplicationCount(string rule_name);
+static void emitUnityNames(Rule *rule, bool define);
+static void emitScanMatcher(Rule *rule);
 
 FILE *header = NULL;
 FILE *file = NULL;
 Searchplan *searchplan = NULL;
 
+/* Hosts with fewer candidates for the first searchplan operation than this are
+ * searched by the calling thread alone. */
+#define PARALLEL_MATCH_THRESHOLD 1024
+
+/* Set for the rule being generated if its matcher is run by several threads.
+ * partition_candidates is set while the first operation of its searchplan is
+ * generated, whose candidates are divided between the threads. */
+static bool parallel_rule = false;
+static bool partition_candidates = false;
+
+/* Set for the rule being generated if it is applied to sets of disjoint matches
+ * by a loop (see markBatchLoops in genProgram.h). collect_matches is set while
+ * the first operation of its searchplan is generated, which records each
+ * complete match and continues with its next candidate during a sweep. */
+static bool batch_rule = false;
+static bool collect_matches = false;
+
+/* Set for the rule being generated if it is a member of a rule set matched by
+ * one scan of the host nodes (see markRuleSetScans in genProgram.h), and
+ * cleared if its searchplan cannot start at a node given by the scan. */
+static bool scan_rule = false;
+
+/* With rule profiling, the position in the searchplan of the operation being
+ * generated, whose candidate counter the generated matching function
+ * increments. */
+static int current_operation = 0;
+
+/* With rule profiling, the matching and application functions of a rule are
+ * printed as static functions whose names end in Body. emitProfiledFunctions
+ * prints the functions of the public names, which update the rule's profile
+ * around calls to them. */
+#define FUNCTION_PREFIX (rule_profiling ? "static " : "")
+#define FUNCTION_SUFFIX (rule_profiling ? "Body" : "")
+
+/* Set for the rule being generated if its searchplan is printed as a single
+ * matching function by the -f flag: the function of the first operation. In
+ * place of the call to the function of the next operation, each operation
+ * prints the code of the next operation inline, in the block where it has
+ * matched its item, so that the searchplan becomes one nest of loops whose
+ * host items and label copies are locals of the same function.
+ * inline_operation is set while an operation is printed inline. A failing
+ * inline operation does not return false, but jumps to the backtracking code
+ * of the enclosing operation with fail_statement. fail_statement_used records
+ * whether the jump was printed, and so whether its label is needed. */
+static bool fused_rule = false;
+static bool inline_operation = false;
+static char fail_statement[32] = "return false;";
+static bool fail_statement_used = false;
+static int backtrack_labels = 0;
+
+/* Returns the statement printed where a matching function returns false. */
+static string failCode(void)
+{
+   fail_statement_used = true;
+   return fail_statement;
+}
+
+/* Returns true if the loop R! can apply R to every match of a set of pairwise
+ * disjoint matches before matching again. Applying R at one match deletes and
+ * relabels only the items of that match and adds edges only between its own
+ * nodes and new nodes, so it changes neither the labels nor the incident edges
+ * of the items of a disjoint match. Every other match of the set therefore
+ * remains a match, with the same condition results, after each application, and
+ * the batch is one of the sequential executions of the loop. The check refuses
+ * rules without a left-hand side or without effect on the host graph, whose
+ * loops do not terminate. The refusals are written to the compile log. */
+static bool batchable(Rule *rule, bool predicate)
+{
+   string reason = NULL;
+   if(rule->lhs == NULL) reason = "it has an empty left-hand side";
+   else if(predicate) reason = "it does not change the host graph";
+   if(reason == NULL) return true;
+   print_to_log("Batch application refused for rule %s: %s.\n", rule->name, reason);
+   return false;
+}
+
+/* With the -m flag, the open rule modules and the number of rules generated,
+ * which selects the module of the next rule. */
+static FILE **module_files = NULL;
+static int generated_rules = 0;
+
+static void generateRuleDeclarations(List *declarations, string output_dir);
+
 void generateRules(List *declarations, string output_dir)
+{
+   if(rule_modules > 0)
+   {
+      module_files = calloc(rule_modules, sizeof(FILE *));
+      if(module_files == NULL)
+      {
+         print_to_log("Error (generateRules): malloc failure.\n");
+         exit(1);
+      }
+   }
+   generated_rules = 0;
+   generateRuleDeclarations(declarations, output_dir);
+   if(rule_modules > 0)
+   {
+      int module;
+      for(module = 0; module < rule_modules; module++)
+         if(module_files[module] != NULL) fclose(module_files[module]);
+      free(module_files);
+      module_files = NULL;
+   }
+}
+
+static void generateRuleDeclarations(List *declarations, string output_dir)
 {
    while(declarations != NULL)
    {
@@ -44,30 +170,101 @@ void generateRules(List *declarations, string output_dir)
 
          case PROCEDURE_DECLARATION:
               if(decl->procedure->local_decls != NULL)
-                 generateRules(decl->procedure->local_decls, output_dir);
+                 generateRuleDeclarations(decl->procedure->local_decls, output_dir);
               break;
 
          case RULE_DECLARATION:
          {
+              if(!decl->rule->reachable) break;
+              startPhase(TRANSFORM_PHASE);
               Rule *rule = transformRule(decl->rule);
+              endPhase(TRANSFORM_PHASE);
               /* Annotate the AST's rule declaration node with information about
                * the rule. This is used when generating code to execute the GP 2
                * program. */
               decl->rule->empty_lhs = rule->lhs == NULL;
               decl->rule->is_predicate = isPredicate(rule);
+              if(decl->rule->batch_apply) 
+                 decl->rule->batch_apply = batchable(rule, decl->rule->is_predicate);
+              batch_rule = decl->rule->batch_apply;
+              scan_rule = decl->rule->scan_member;
+              startPhase(RULE_PHASE);
+              decl->rule->label_constants = collectLabelConstants(rule);
               generateRuleCode(rule, decl->rule->is_predicate, output_dir);
+              freeLabelConstants();
+              endPhase(RULE_PHASE);
+              decl->rule->scan_member = scan_rule;
+              batch_rule = false;
+              scan_rule = false;
               freeRule(rule);
               break;
          }
          default: 
-              print_to_log("Error (generateRules): Unexpected declaration type "
-                           "%d at AST node %d\n", decl->type, decl->id);
+              print_to_log("Error (generateRuleDeclarations): Unexpected "
+                           "declaration type %d at AST node %d\n", decl->type, decl->id);
               break;
       }
       declarations = declarations->next;
    }
 }
 
+/* Returns true if the rule can be matched from a host node given by the scan
+ * of a rule set: its searchplan starts by matching a node in isolation. Root
+ * nodes are found through the host graph's root node arrays, whose few
+ * candidates are cheaper to search than the scan's nodes. The refusals are
+ * written to the compile log. */
+static bool scannable(Rule *rule)
+{
+   string reason = NULL;
+   if(rule->lhs == NULL) reason = "it has an empty left-hand side";
+   else if(searchplan->first->type == 'r') reason = "its searchplan starts at a root node";
+   else if(searchplan->first->type != 'n') reason = "its searchplan starts at an edge";
+   if(reason == NULL) return true;
+   print_to_log("Rule set scan refused for rule %s: %s.\n", rule->name, reason);
+   return false;
+}
+
+/* Returns true if the rule's matcher can be run by several threads with the
+ * -j flag. Label matching with list variables and conditions that build host
+ * lists update the runtime's shared list store, and root node lists are too
+ * short to be worth dividing, so such rules are matched sequentially. */
+static bool parallelisable(Rule *rule)
+{
+   if(match_threads <= 1 || rule->lhs == NULL) return false;
+   string reason = NULL;
+   /* Collecting disjoint matches relies on the matched flags. */
+   if(batch_rule) reason = "it is applied to sets of disjoint matches";
+   else if(rule->is_rooted) reason = "it has root nodes";
+   else if(rule->condition != NULL && !conditionIsThreadSafe(rule->condition))
+      reason = "its condition builds host lists";
+   else
+   {
+      int index;
+      for(index = 0; index < rule->variables; index++)
+         if(rule->variable_list[index].type == LIST_VAR) 
+            reason = "it has list variables";
+   }
+   if(reason == NULL) return true;
+   print_to_log("Rule %s is matched sequentially: %s.\n", rule->name, reason);
+   return false;
+}
+
+/* Returns the module of the next rule with the -m flag, opened at its first rule. */
+static FILE *nextRuleModule(string output_dir)
+{
+   int module = generated_rules++ % rule_modules;
+   if(module_files[module] != NULL) return module_files[module];
+   char file_name[strlen(output_dir) + 32];
+   sprintf(file_name, "%s/rules_%d.c", output_dir, module);
+   module_files[module] = fopen(file_name, "w");
+   if(module_files[module] == NULL)
+   {
+      perror(file_name);
+      exit(1);
+   }
+   return module_files[module];
+}
+
 /* Create a C module to match and apply the rule. */
 void generateRuleCode(Rule *rule, bool predicate, string output_dir)
 {
@@ -86,37 +283,45 @@ void generateRuleCode(Rule *rule, bool predicate, string output_dir)
       exit(1);
    }  
 
-   char file_name[length];
-   strcpy(file_name, output_dir);
-   strcat(file_name, "/");
-   strcat(file_name, rule->name);
-   strcat(file_name, ".c");
+   if(rule_modules > 0) file = nextRuleModule(output_dir);
+   else
+   {
+      char file_name[length];
+      strcpy(file_name, output_dir);
+      strcat(file_name, "/");
+      strcat(file_name, rule->name);
+      strcat(file_name, ".c");
 
-   file = fopen(file_name, "w");
-   if(file == NULL) { 
-      perror(file_name);
-      exit(1);
+      file = fopen(file_name, "w");
+      if(file == NULL) { 
+         perror(file_name);
+         exit(1);
+      }
    }
 
    fprintf(header, "#include \"graph.h\"\n"
                    "#include \"label.h\"\n"
                    "#include \"graphStacks.h\"\n"
-                   "#include \"parser.h\"\n"
+                   "#include \"hostLoader.h\"\n"
                    "#include \"morphism.h\"\n\n");
+   fprintf(header, "#include \"debug.h\"\n\n");
    PTF("#include \"%s.h\"\n\n", rule->name);
-
-   if(rule->condition != NULL)
+   /* The shared library runs on its callers' threads and has no live
+    * statistics, so its rules are not counted. */
+   if(!shared_library)
    {
-      /* The condition is iterated over three times.
-       * The first iteration declares and initialises the runtime global boolean
-       * varables, one for each predicate in the condition.
-       * The second iteration writes the function to evaluate the condition.
-       * The third iteration writes the functions to evaluate the predicates. */
-      generateConditionVariables(rule->condition);
-      PTF("\n");
-      generateConditionEvaluator(rule->condition, false);
-      generatePredicateEvaluators(rule, rule->condition);
+      fprintf(header, "extern RuleCounter counter_%s;\n\n", rule->name);
+      PTF("RuleCounter counter_%s = {\"%s\", 0};\n\n", rule->name, rule->name);
+   }
+   if(match_budgets && rule->lhs != NULL)
+   {
+      fprintf(header, "extern MatchBudget budget_%s;\n\n", rule->name);
+      PTF("MatchBudget budget_%s = {\"%s\", 0, 0, 0};\n\n", rule->name, rule->name);
    }
+   parallel_rule = parallelisable(rule);
+   if(parallel_rule) PTF("#include <pthread.h>\n\n");
+   if(unity_build || rule_modules > 0) emitUnityNames(rule, true);
+
    if(rule->lhs != NULL) 
    {
       generateMatchingCode(rule, predicate);
@@ -124,28 +329,75 @@ void generateRuleCode(Rule *rule, bool predicate, string output_dir)
       {
          if(rule->rhs == NULL) generateRemoveLHSCode(rule->name);
          else generateApplicationCode(rule);
+         if(batch_rule) emitBatchApplication(rule->name);
       }
    }
    else
    {
+      if(scan_rule) scan_rule = scannable(rule);
+      if(rule_profiling) emitRuleProfile(rule->name, NULL);
       if(rule->rhs != NULL) generateAddRHSCode(rule);
    }
+   if(rule_profiling) emitProfiledFunctions(rule, predicate);
+   if(unity_build || rule_modules > 0) emitUnityNames(rule, false);
    fclose(header);
-   fclose(file);
+   if(rule_modules == 0) fclose(file);
    return;
 }
 
+/* Records the searchplan in a comment at the top of the generated matching
+ * code. Operations are printed as their type character followed by the index
+ * of the LHS item. */
+/* Returns true if the LHS node is matched by an operation of the searchplan
+ * preceding the passed operation. */
+static bool matchedBefore(SearchOp *operation, int node_index)
+{
+   SearchOp *iterator = searchplan->first;
+   for(; iterator != operation; iterator = iterator->next)
+      if(iterator->is_node && iterator->index == node_index) return true;
+   return false;
+}
+
+static void emitSearchplanComment(Searchplan *searchplan)
+{
+   PTF("/* Searchplan:");
+   SearchOp *operation = searchplan->first;
+   for(; operation != NULL; operation = operation->next)
+      PTF(" %c%d", operation->type, operation->index);
+   if(searchplan->cost >= 0) 
+      PTF("\n * Chosen by the cost model. Estimated cost: %.2f", searchplan->cost);
+   PTF(" */\n");
+}
+
 static void generateMatchingCode(Rule *rule, bool predicate)
 {
-   searchplan = generateSearchplan(rule->lhs); 
+   if(costed_searchplans) searchplan = generateCostedSearchplan(rule->lhs);
+   else searchplan = generateSearchplan(rule->lhs); 
    if(searchplan->first == NULL)
    {
       print_to_log("Error: empty searchplan. Aborting.\n");
       freeSearchplan(searchplan);
       return;
    }
+   if(generateLabelConstants(rule->name))
+      fprintf(header, "void initialise%sLabels(void);\n", rule->name);
+   emitSearchplanComment(searchplan);
+   if(rule->condition != NULL)
+   {
+      /* Each predicate is evaluated at the searchplan operation that matches
+       * the last of its nodes and variables. The declarations of its runtime
+       * variables precede the functions that evaluate the predicates. */
+      prepareCondition(rule, searchplan);
+      generateConditionVariables(rule->condition);
+      PTF("\n");
+      generatePredicateEvaluators(rule, rule->condition);
+   }
+   if(rule_profiling) emitRuleProfile(rule->name, searchplan);
+   fused_rule = fused_matching;
+   backtrack_labels = 0;
    SearchOp *operation = searchplan->first;
-   /* Iterator over the searchplan to print the prototypes of the matching functions. */
+   /* Iterator over the searchplan to print the prototypes of the matching functions. 
+    * A fused matcher has only the function of the first operation. */
    while(operation != NULL)
    {
       char type = operation->type;
@@ -175,20 +427,28 @@ static void generateMatchingCode(Rule *rule, bool predicate)
                            "operation type %c.\n", operation->type);
               break;
       }
-      operation = operation->next;
+      operation = fused_rule ? NULL : operation->next;
    }
+   /* The fused matcher reads the host graph pointer into a local once. */
+   if(fused_rule) PTF("static inline Graph *hostGraph(void) { return host; }\n");
+   if(parallel_rule) emitParallelMatcher();
+   if(batch_rule) emitBatchStore();
    /* Generate the main matching function which sets up the runtime matching 
     * environment and calls the first matching function. */
    fprintf(header, "bool match%s(Morphism *morphism);\n\n", rule->name);
-   PTF("\nbool match%s(Morphism *morphism)\n", rule->name);
+   PTF("\n%sbool match%s%s(Morphism *morphism)\n", FUNCTION_PREFIX, rule->name, FUNCTION_SUFFIX);
    PTF("{\n");
    PTFI("if(%d > host->number_of_nodes || %d > host->number_of_edges) return false;\n",
         3, rule->lhs->node_index, rule->lhs->edge_index);
+   if(match_budgets) PTFI("startMatchBudget(&budget_%s);\n", 3, rule->name);
    char item = searchplan->first->is_node ? 'n' : 'e';
+   char first_match[32];
+   if(parallel_rule) strcpy(first_match, "matchParallel");
+   else sprintf(first_match, "match_%c%d", item, searchplan->first->index);
    
    if(predicate)
    {
-      PTFI("bool match = match_%c%d(morphism);\n", 3, item, searchplan->first->index);
+      PTFI("bool match = %s(morphism);\n", 3, first_match);
       /* Reset the matched flags in the host graph. This is normally done after
        * rule application, but predicate rules are not applied. */
       PTFI("initialiseMorphism(morphism, host);\n", 3);
@@ -196,7 +456,7 @@ static void generateMatchingCode(Rule *rule, bool predicate)
    }
    else 
    {
-      PTFI("if(match_%c%d(morphism)) return true;\n", 3, item, searchplan->first->index);
+      PTFI("if(%s(morphism)) return true;\n", 3, first_match);
       PTFI("else\n", 3);
       PTFI("{\n", 3);
       PTFI("initialiseMorphism(morphism, host);\n", 6);
@@ -207,67 +467,311 @@ static void generateMatchingCode(Rule *rule, bool predicate)
 
    /* Iterator over the searchplan to print the definitions of the matching functions. */
    operation = searchplan->first;
-   RuleNode *node = NULL;
-   RuleEdge *edge = NULL;
+   current_operation = 0;
    while(operation != NULL)
    {
-      switch(operation->type)
-      {        
-         case 'r': 
-              node = getRuleNode(rule->lhs, operation->index);
-              emitRootNodeMatcher(rule, node, operation->next);
-              break;
+      partition_candidates = parallel_rule && operation == searchplan->first;
+      collect_matches = batch_rule && operation == searchplan->first;
+      emitOperation(rule, operation);
+      operation = fused_rule ? NULL : operation->next;
+      current_operation++;
+   }
+   partition_candidates = false;
+   collect_matches = false;
+   if(scan_rule) scan_rule = scannable(rule);
+   if(scan_rule) emitScanMatcher(rule);
+   fused_rule = false;
+   freeSearchplan(searchplan);
+}
 
-         case 'n': 
-              node = getRuleNode(rule->lhs, operation->index);
-              emitNodeMatcher(rule, node, operation->next);
-              break;
+/* Prints the matching code of the searchplan operation. */
+static void emitOperation(Rule *rule, SearchOp *operation)
+{
+   RuleNode *node = NULL;
+   RuleEdge *edge = NULL;
+   bool ends_matched = false;
+   switch(operation->type)
+   {        
+      case 'r': 
+           node = getRuleNode(rule->lhs, operation->index);
+           emitRootNodeMatcher(rule, node, operation->next);
+           break;
 
-         case 'i': 
-         case 'o': 
-         case 'b':
-              node = getRuleNode(rule->lhs, operation->index);
-              emitNodeFromEdgeMatcher(rule, node, operation->type, operation->next);
-              break;
+      case 'n': 
+           node = getRuleNode(rule->lhs, operation->index);
+           emitNodeMatcher(rule, node, operation->next);
+           break;
 
-         case 'e': 
-              edge = getRuleEdge(rule->lhs, operation->index);
-              emitEdgeMatcher(rule, edge, operation->next);
-              break;
+      case 'i': 
+      case 'o': 
+      case 'b':
+           node = getRuleNode(rule->lhs, operation->index);
+           emitNodeFromEdgeMatcher(rule, node, operation->type, operation->next);
+           break;
 
-         case 'l':
-              edge = getRuleEdge(rule->lhs, operation->index);
-              emitLoopEdgeMatcher(rule, edge, operation->next);
-              break;
+      case 'e': 
+           edge = getRuleEdge(rule->lhs, operation->index);
+           emitEdgeMatcher(rule, edge, operation->next);
+           break;
 
-         case 's': 
-              edge = getRuleEdge(rule->lhs, operation->index);
-              if(edge->bidirectional) 
-              {
-                 emitEdgeFromNodeMatcher(rule, edge, true, true, false, operation->next);
-                 emitEdgeFromNodeMatcher(rule, edge, false, false, true, operation->next);
-              }
-              else emitEdgeFromNodeMatcher(rule, edge, true, true, true, operation->next);
-              break;
+      case 'l':
+           edge = getRuleEdge(rule->lhs, operation->index);
+           emitLoopEdgeMatcher(rule, edge, operation->next);
+           break;
 
-         case 't':
-              edge = getRuleEdge(rule->lhs, operation->index);
-              if(edge->bidirectional) 
-              {
-                 emitEdgeFromNodeMatcher(rule, edge, false, true, false, operation->next);
-                 emitEdgeFromNodeMatcher(rule, edge, true, false, true, operation->next);
-              }
-              else emitEdgeFromNodeMatcher(rule, edge, false, true, true, operation->next);
-              break;
-         
-         default:
-              print_to_log("Error (generateMatchingCode): Unexpected "
-                           "operation type %c.\n", operation->type);
-              break;
-      }
-      operation = operation->next;
+      case 's': 
+           edge = getRuleEdge(rule->lhs, operation->index);
+           ends_matched = matchedBefore(operation, edge->target->index);
+           emitEdgeFromNodeMatcher(rule, edge, ends_matched, true, operation->next);
+           break;
+
+      case 't':
+           edge = getRuleEdge(rule->lhs, operation->index);
+           ends_matched = matchedBefore(operation, edge->source->index);
+           emitEdgeFromNodeMatcher(rule, edge, ends_matched, false, operation->next);
+           break;
+      
+      default:
+           print_to_log("Error (emitOperation): Unexpected operation type %c.\n",
+                        operation->type);
+           break;
    }
-   freeSearchplan(searchplan);
+}
+
+/* Prints the code of the searchplan operation inline at indent, in the block of
+ * the enclosing operation where that operation has matched its item. The code
+ * is printed to a buffer at the indent of a function body and copied to the
+ * file at the passed indent. Returns the number of the backtracking label to
+ * which the code jumps when the operation fails, or -1 if the code never jumps
+ * and instead leaves its block. */
+static int emitInlineOperation(Rule *rule, SearchOp *operation, int indent)
+{
+   FILE *enclosing_file = file;
+   char enclosing_fail_statement[32];
+   strcpy(enclosing_fail_statement, fail_statement);
+   bool enclosing_fail_used = fail_statement_used;
+   bool enclosing_inline = inline_operation;
+   bool enclosing_partition = partition_candidates;
+   bool enclosing_collect = collect_matches;
+
+   int label = backtrack_labels++;
+   sprintf(fail_statement, "goto backtrack%d;", label);
+   fail_statement_used = false;
+   inline_operation = true;
+   partition_candidates = false;
+   collect_matches = false;
+   current_operation++;
+
+   char *code = NULL;
+   size_t size = 0;
+   file = open_memstream(&code, &size);
+   if(file == NULL)
+   {
+      print_to_log("Error (emitInlineOperation): malloc failure.\n");
+      exit(1);
+   }
+   emitOperation(rule, operation);
+   fclose(file);
+   file = enclosing_file;
+
+   char *line = code;
+   while(*line != '\0')
+   {
+      char *end = strchr(line, '\n');
+      if(end != NULL) *end = '\0';
+      if(*line == '\0') PTF("\n");
+      else PTF("%*s%s\n", indent - 3, "", line);
+      if(end == NULL) break;
+      line = end + 1;
+   }
+   free(code);
+
+   bool jumps = fail_statement_used;
+   strcpy(fail_statement, enclosing_fail_statement);
+   fail_statement_used = enclosing_fail_used;
+   inline_operation = enclosing_inline;
+   partition_candidates = enclosing_partition;
+   collect_matches = enclosing_collect;
+   current_operation--;
+   return jumps ? label : -1;
+}
+
+static void emitBacktrackLabel(int label, int indent)
+{
+   if(label >= 0) PTFI("backtrack%d:\n", indent, label);
+}
+
+/* Prints the header of the matching function of a searchplan operation. An
+ * operation printed inline has no function of its own. */
+static void emitMatcherStart(char item, int index, bool from_edge)
+{
+   if(inline_operation) return;
+   if(from_edge) PTF("static bool match_%c%d(Morphism *morphism, Edge *host_edge)\n", item, index);
+   else PTF("static bool match_%c%d(Morphism *morphism)\n", item, index);
+   PTF("{\n");
+   if(fused_rule) PTFI("Graph *const host = hostGraph();\n", 3);
+}
+
+/* Prints the end of the matching function of a searchplan operation. An inline
+ * operation that has tried all its candidates leaves its block instead. */
+static void emitMatcherEnd(void)
+{
+   if(inline_operation) return;
+   PTFI("return false;\n", 3);
+   PTF("}\n\n");
+}
+
+/* A sweep for disjoint matches runs the ordinary matching functions with the
+ * flag sweeping set. When a complete match is found, the first matching
+ * function passes the morphism to recordMatch, which copies it to the batch and
+ * clears it without resetting the matched flags of its host items. The items
+ * of recorded matches are thereby excluded from the rest of the sweep. */
+static void emitBatchStore(void)
+{
+   PTF("\nstatic __thread bool sweeping = false;\n");
+   PTF("static __thread Morphism **batch = NULL;\n");
+   PTF("static __thread int batch_size = 0, batch_capacity = 0;\n\n");
+   PTF("static bool recordMatch(Morphism *morphism)\n");
+   PTF("{\n");
+   PTFI("if(!sweeping) return false;\n", 3);
+   PTFI("if(batch_size == batch_capacity)\n", 3);
+   PTFI("{\n", 3);
+   PTFI("int old_capacity = batch_capacity;\n", 6);
+   PTFI("batch_capacity = batch_capacity == 0 ? 16 : 2 * batch_capacity;\n", 6);
+   PTFI("batch = realloc(batch, batch_capacity * sizeof(Morphism *));\n", 6);
+   PTFI("if(batch == NULL)\n", 6);
+   PTFI("{\n", 6);
+   PTFI("print_to_log(\"Error (recordMatch): malloc failure.\\n\");\n", 9);
+   PTFI("exit(1);\n", 9);
+   PTFI("}\n", 6);
+   PTFI("int index;\n", 6);
+   PTFI("for(index = old_capacity; index < batch_capacity; index++) batch[index] = NULL;\n", 6);
+   PTFI("}\n", 3);
+   PTFI("if(batch[batch_size] == NULL)\n", 3);
+   PTFI("batch[batch_size] = makeMorphism(morphism->nodes, morphism->edges,\n", 6);
+   PTFI("                                 morphism->variables);\n", 6);
+   PTFI("copyMorphism(batch[batch_size++], morphism);\n", 3);
+   PTFI("initialiseMorphism(morphism, NULL);\n", 3);
+   PTFI("return true;\n", 3);
+   PTF("}\n");
+}
+
+/* The printed function sweeps the host graph once for a set of disjoint
+ * matches, applies the rule to each of them and returns their number. */
+static void emitBatchApplication(string rule_name)
+{
+   fprintf(header, "int applyAll%s(Morphism *morphism, bool record_changes);\n", rule_name);
+   PTF("int applyAll%s(Morphism *morphism, bool record_changes)\n", rule_name);
+   PTF("{\n");
+   PTFI("sweeping = true;\n", 3);
+   PTFI("match%s(morphism);\n", 3, rule_name);
+   PTFI("sweeping = false;\n", 3);
+   if(rule_profiling) PTFI("profile_%s.matches += batch_size;\n", 3, rule_name);
+   PTFI("int index;\n", 3);
+   PTFI("for(index = 0; index < batch_size; index++)\n", 3);
+   PTFI("apply%s(batch[index], record_changes);\n", 6, rule_name);
+   PTFI("int matches = batch_size;\n", 3);
+   PTFI("batch_size = 0;\n", 3);
+   PTFI("return matches;\n", 3);
+   PTF("}\n\n");
+}
+
+/* The statement printed when all items are matched. In the first matching
+ * function of a batched rule, a match found by a sweep is recorded and the
+ * search continues with the next candidate. */
+static string matchFoundCode(void)
+{
+   /* The operations of a fused matcher are nested in the loop of the first
+    * operation, which continues at the label at the end of its loop body. */
+   if(batch_rule && fused_rule)
+      return "{ if(recordMatch(morphism)) goto next_candidate; return true; }";
+   if(collect_matches) return "{ if(recordMatch(morphism)) continue; return true; }";
+   return "return true;";
+}
+
+/* The parallel matcher runs the first searchplan operation in match_threads
+ * threads. Thread k examines the candidates at positions k, k + threads, ... of
+ * each label class table (or node column block), matching into its own
+ * morphism. Injectivity is tested against that morphism instead of the host
+ * graph's matched flags. The first thread to succeed stores its slice in the
+ * winner of the search, to which match_winner points; the other threads see it
+ * at their next candidate and give up. The winning morphism is copied into the
+ * rule's morphism.
+ *
+ * The runtime state is thread-local, so each search belongs to the thread that
+ * starts it. Its task for a slice passes that thread's host graph, log file and
+ * label constants to the thread searching the slice. */
+static void emitParallelMatcher(void)
+{
+   char item = searchplan->first->is_node ? 'n' : 'e';
+   int first = searchplan->first->index;
+   int constants = countLabelConstants();
+   PTF("\nstatic __thread int match_slice = 0, match_slices = 1;\n");
+   PTF("static __thread int *match_winner = NULL;\n");
+   PTF("static __thread Morphism *slice_morphisms[%d];\n\n", match_threads);
+
+   PTF("typedef struct SliceTask {\n");
+   PTFI("int slice, *winner;\n", 3);
+   PTFI("Morphism *morphism;\n", 3);
+   PTFI("Graph *host;\n", 3);
+   PTFI("FILE *log_file;\n", 3);
+   if(constants > 0) PTFI("void *label_constants[%d];\n", 3, constants);
+   PTF("} SliceTask;\n\n");
+
+   PTF("static void *matchSlice(void *argument)\n");
+   PTF("{\n");
+   PTFI("SliceTask *task = argument;\n", 3);
+   PTFI("match_slice = task->slice;\n", 3);
+   PTFI("match_slices = %d;\n", 3, match_threads);
+   PTFI("match_winner = task->winner;\n", 3);
+   PTFI("host = task->host;\n", 3);
+   PTFI("log_file = task->log_file;\n", 3);
+   generateLabelConstantCopies("task->label_constants", false, 3);
+   PTFI("if(match_%c%d(task->morphism))\n", 3, item, first);
+   PTFI("{\n", 3);
+   PTFI("int no_winner = -1;\n", 6);
+   PTFI("if(__atomic_compare_exchange_n(match_winner, &no_winner, match_slice, false,\n", 6);
+   PTFI("                               __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return NULL;\n", 6);
+   PTFI("}\n", 3);
+   PTFI("initialiseMorphism(task->morphism, NULL);\n", 3);
+   PTFI("return NULL;\n", 3);
+   PTF("}\n\n");
+
+   PTF("static bool matchParallel(Morphism *morphism)\n");
+   PTF("{\n");
+   PTFI("int winner = -1;\n", 3);
+   PTFI("match_winner = &winner;\n", 3);
+   PTFI("if(host->number_of_%s < %d) return match_%c%d(morphism);\n", 3,
+        item == 'n' ? "nodes" : "edges", PARALLEL_MATCH_THRESHOLD, item, first);
+   PTFI("pthread_t threads[%d];\n", 3, match_threads);
+   PTFI("SliceTask tasks[%d];\n", 3, match_threads);
+   PTFI("bool started[%d];\n", 3, match_threads);
+   PTFI("int slice;\n", 3);
+   PTFI("for(slice = 0; slice < %d; slice++)\n", 3, match_threads);
+   PTFI("{\n", 3);
+   PTFI("if(slice_morphisms[slice] == NULL)\n", 6);
+   PTFI("slice_morphisms[slice] = makeMorphism(morphism->nodes, morphism->edges,\n", 9);
+   PTFI("                                      morphism->variables);\n", 9);
+   PTFI("SliceTask *task = &tasks[slice];\n", 6);
+   PTFI("task->slice = slice;\n", 6);
+   PTFI("task->winner = &winner;\n", 6);
+   PTFI("task->morphism = slice_morphisms[slice];\n", 6);
+   PTFI("task->host = host;\n", 6);
+   PTFI("task->log_file = log_file;\n", 6);
+   generateLabelConstantCopies("task->label_constants", true, 6);
+   PTFI("started[slice] = pthread_create(&threads[slice], NULL, matchSlice, task) == 0;\n", 6);
+   PTFI("/* Search the slice in this thread if no thread could be started. */\n", 6);
+   PTFI("if(!started[slice]) matchSlice(task);\n", 6);
+   PTFI("}\n", 3);
+   PTFI("for(slice = 0; slice < %d; slice++)\n", 3, match_threads);
+   PTFI("if(started[slice]) pthread_join(threads[slice], NULL);\n", 6);
+   PTFI("match_slice = 0;\n", 3);
+   PTFI("match_slices = 1;\n", 3);
+   PTFI("if(winner < 0) return false;\n", 3);
+   PTFI("copyMorphism(morphism, slice_morphisms[winner]);\n", 3);
+   PTFI("initialiseMorphism(slice_morphisms[winner], NULL);\n", 3);
+   PTFI("return true;\n", 3);
+   PTF("}\n");
 }
 
 
@@ -282,10 +786,15 @@ static void generateMatchingCode(Rule *rule, bool predicate)
  * (3) The number of edges incident to the host node is not equal to the 
  *     number of edges incident to the rule node. Indeed, if it is less,
  *     then standard matching is violated (above). If it is greater,
- *     then the dangling condition is violated. */
+ *     then the dangling condition is violated. 
+ *
+ * If columns is true, the degrees are read from the host graph's node columns
+ * at host_index instead of from host_node. */
 
-static void emitDegreeCheck(RuleNode *left_node, int indent)
+static void emitDegreeCheck(RuleNode *left_node, bool columns, int indent)
 {
+   string indegree = columns ? "columns->indegrees[host_index]" : "host_node->indegree";
+   string outdegree = columns ? "columns->outdegrees[host_index]" : "host_node->outdegree";
    /* For condition (3) above, the number of edges incident to the host node
     * is given by the sum of the outdegree and the indegree. The edges
     * incident to the rule node is the sum of the node's outdegree, indegree
@@ -295,18 +804,18 @@ static void emitDegreeCheck(RuleNode *left_node, int indent)
    {
       /* Dangling node degree check. If the if condition evaluates to true,
        * then the node is not a valid match. */
-      PTFI("if(host_node->indegree < %d || host_node->outdegree < %d ||\n",
-           indent, left_node->indegree, left_node->outdegree);
-      PTFI("   ((host_node->outdegree + host_node->indegree - %d - %d - %d) != 0)) ", 
-           indent, left_node->outdegree, left_node->indegree, left_node->bidegree);
+      PTFI("if(%s < %d || %s < %d ||\n", indent, indegree, left_node->indegree,
+           outdegree, left_node->outdegree);
+      PTFI("   ((%s + %s - %d - %d - %d) != 0)) ", indent, outdegree, indegree,
+           left_node->outdegree, left_node->indegree, left_node->bidegree);
    }
    else
    {
       /* Standard node degree check. */
-      PTFI("if(host_node->indegree < %d || host_node->outdegree < %d ||\n",
-           indent, left_node->indegree, left_node->outdegree);
-      PTFI("   ((host_node->outdegree + host_node->indegree - %d - %d - %d) < 0)) ", 
-           indent, left_node->outdegree, left_node->indegree, left_node->bidegree);
+      PTFI("if(%s < %d || %s < %d ||\n", indent, indegree, left_node->indegree,
+           outdegree, left_node->outdegree);
+      PTFI("   ((%s + %s - %d - %d - %d) < 0)) ", indent, outdegree, indegree,
+           left_node->outdegree, left_node->indegree, left_node->bidegree);
    }
 }
 
@@ -330,33 +839,176 @@ static void emitDegreeCheck(RuleNode *left_node, int indent)
  *
  * If a valid host item is found, the generated code pushes its index to the
  * appropriate morphism stack and calls the function for the following 
- * searchplan operation (see emitNextMatcherCall). If there are no operations 
- * left, code is generated to return true. */
+ * searchplan operation (see emitNextMatcherCall), or, in a fused matcher, runs
+ * the code of that operation printed inline (see emitInlineOperation). If there
+ * are no operations left, code is generated to return true. */
 static void emitRootNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
 {
-   PTF("static bool match_n%d(Morphism *morphism)\n", left_node->index);
-   PTF("{\n");
-   PTFI("RootNodes *nodes;\n", 3);   
-   PTFI("for(nodes = getRootNodeList(host); nodes != NULL; nodes = nodes->next)\n", 3);
+   /* The root node arrays of the host graph hold only the live root nodes of
+    * each mark, so the candidates need no alive, root or mark test. */
+   int first_mark = left_node->label.mark, last_mark = left_node->label.mark;
+   if(left_node->label.mark == ANY) 
+   {
+      first_mark = RED;
+      last_mark = DASHED;
+   }
+   emitMatcherStart('n', left_node->index, false);
+   if(node_columns) PTFI("NodeColumns *columns = host->node_columns;\n", 3);
+   PTFI("int mark, position;\n", 3);
+   PTFI("for(mark = %d; mark <= %d; mark++)\n", 3, first_mark, last_mark);
    PTFI("{\n", 3);
-   PTFI("Node *host_node = getNode(host, nodes->index);\n", 6);
-   PTFI("if(host_node == NULL) continue;\n", 6);
-   PTFI("if(host_node->matched) continue;\n", 6);
-   if(left_node->label.mark == ANY)
-      PTFI("if(host_node->label.mark == 0) continue;\n", 6);
-   else PTFI("if(host_node->label.mark != %d) continue;\n", 6, left_node->label.mark);
-   emitDegreeCheck(left_node, 6);  
-   PTF("continue;\n\n");
+   PTFI("IntArray *roots = getRootNodes(host, mark);\n", 6);
+   PTFI("for(position = 0; position < roots->size; position++)\n", 6);
+   PTFI("{\n", 6);
+   emitCandidateCount(9);
+   if(node_columns)
+   {
+      /* The candidate is filtered with the column arrays before its Node
+       * structure is read. */
+      PTFI("int host_index = roots->items[position];\n", 9);
+      if(parallel_rule) PTFI("if(nodeInMorphism(morphism, host_index)) continue;\n", 9);
+      else PTFI("if(nodeColumnBit(columns->matched, host_index)) continue;\n", 9);
+      emitDegreeCheck(left_node, true, 9);  
+      PTF("continue;\n");
+      PTFI("Node *host_node = getNode(host, host_index);\n\n", 9);
+   }
+   else
+   {
+      PTFI("Node *host_node = getNode(host, roots->items[position]);\n", 9);
+      PTFI("if(", 9);
+      emitMatchedTest("host_node", true);
+      PTF(") continue;\n");
+      emitDegreeCheck(left_node, false, 9);  
+      PTF("continue;\n\n");
+   }
 
-   PTFI("HostLabel label = host_node->label;\n", 6);
-   PTFI("bool match = false;\n", 6);
+   if(rule->condition != NULL)
+      generatePredicateFilters(rule->condition, left_node, "continue;", 9);
+   PTFI("HostLabel label = host_node->label;\n", 9);
+   PTFI("bool match = false;\n", 9);
    if(hasListVariable(left_node->label))
-      generateVariableListMatchingCode(rule, left_node->label, 6);
-   else generateFixedListMatchingCode(rule, left_node->label, 6);
-   emitNodeMatchResultCode(left_node, next_op, 6);
+      generateVariableListMatchingCode(rule, left_node->label, 9);
+   else generateFixedListMatchingCode(rule, left_node->label, 9);
+   emitMatchResultCode(rule, true, left_node->index, next_op, 9);
+   PTFI("}\n", 6);
    PTFI("}\n", 3);
-   PTFI("return false;\n", 3);
-   PTF("}\n\n");
+   emitMatcherEnd();
+}
+
+/* Host labels are partitioned into the label classes defined in lib/label.h.
+ * The names are printed in the generated code, and their positions in this
+ * array are the values of the runtime enumerated type. */
+static string label_class_names[] = {"EMPTY_L", "INTEGER_L", "STRING_L", "LIST2_L",
+                                     "LIST3_L", "LIST4_L", "LONG_LIST_L"};
+
+/* Prints the loop headers that iterate over the label class tables of the
+ * host graph compatible with the mark and label of the rule item. The body of
+ * the innermost loop binds host_node or host_edge at the returned indent and
+ * must be closed by emitClassTableLoopsEnd. With node columns, the loops over
+ * node tables bind the node index host_index instead, and the caller binds
+ * host_node after filtering the candidate.
+ *
+ * With resumed matching, the generated function remembers the table and the
+ * position of the last candidate it examined. The next search starts there,
+ * runs to the end of the tables, wraps around and stops where it started, so
+ * every candidate is still examined once. A loop that applies a rule at many
+ * places in turn then finds each match near the previous one instead of
+ * rescanning the candidates rejected before it.
+ *
+ * With sampled matching, the search starts instead at a candidate drawn at
+ * random from all the candidates of the tables, and wraps around in the same
+ * way. The match found is the first one at or after the random candidate, at
+ * the cost of one pass over the table sizes before the search. */
+static int emitClassTableLoops(RuleLabel label, bool node)
+{
+   int first_mark = label.mark, last_mark = label.mark;
+   /* The any mark matches every host mark except the null mark. */
+   if(label.mark == ANY) 
+   {
+      first_mark = RED;
+      last_mark = DASHED;
+   }
+   int first_class, last_class;
+   getLabelClassRange(label, &first_class, &last_class);
+
+   string table_function = node ? "getNodeClassTable" : "getEdgeClassTable";
+   int indent;
+
+   if(node && node_columns) PTFI("NodeColumns *columns = host->node_columns;\n", 3);
+   if((resume_matching || sampled_matching) && !parallel_rule)
+   {
+      int classes = last_class - first_class + 1;
+      int tables = (last_mark - first_mark + 1) * classes;
+      if(sampled_matching)
+      {
+         PTFI("int start_table, start_position = 0, candidates = 0;\n", 3);
+         PTFI("for(start_table = 0; start_table < %d; start_table++)\n", 3, tables);
+         PTFI("candidates += %s(host, %d + start_table / %d, %s + start_table %% %d)->size;\n",
+              6, table_function, first_mark, classes, label_class_names[first_class], classes);
+         PTFI("if(candidates > 0) start_position = sampleCandidate(candidates);\n", 3);
+         PTFI("for(start_table = 0; start_table < %d; start_table++)\n", 3, tables - 1);
+         PTFI("{\n", 3);
+         PTFI("int size = %s(host, %d + start_table / %d, %s + start_table %% %d)->size;\n",
+              6, table_function, first_mark, classes, label_class_names[first_class], classes);
+         PTFI("if(start_position < size) break;\n", 6);
+         PTFI("start_position -= size;\n", 6);
+         PTFI("}\n", 3);
+      }
+      else
+      {
+         PTFI("static __thread int resume_table = 0, resume_position = 0;\n", 3);
+         PTFI("int start_table = resume_table, start_position = resume_position;\n", 3);
+      }
+      PTFI("int mark, label_class, position, step;\n", 3);
+      PTFI("for(step = 0; step <= %d; step++)\n", 3, tables);
+      PTFI("{\n", 3);
+      PTFI("int table = (start_table + step) %% %d;\n", 6, tables);
+      PTFI("mark = %d + table / %d;\n", 6, first_mark, classes);
+      PTFI("label_class = %s + table %% %d;\n", 6, label_class_names[first_class], classes);
+      PTFI("IntArray *class_table = %s(host, mark, label_class);\n", 6, table_function);
+      PTFI("int first_position = step == 0 ? start_position : 0;\n", 6);
+      PTFI("int last_position = step == %d ? start_position : class_table->size;\n", 
+           6, tables);
+      PTFI("if(last_position > class_table->size) last_position = class_table->size;\n", 6);
+      PTFI("for(position = first_position; position < last_position; position++)\n", 6);
+      PTFI("{\n", 6);
+      if(!sampled_matching)
+      {
+         PTFI("resume_table = table;\n", 9);
+         PTFI("resume_position = position;\n", 9);
+      }
+      indent = 9;
+   }
+   else
+   {
+      PTFI("int mark, label_class, position;\n", 3);
+      PTFI("for(mark = %d; mark <= %d; mark++)\n", 3, first_mark, last_mark);
+      PTFI("{\n", 3);
+      PTFI("for(label_class = %s; label_class <= %s; label_class++)\n", 6,
+           label_class_names[first_class], label_class_names[last_class]);
+      PTFI("{\n", 6);
+      PTFI("IntArray *class_table = %s(host, mark, label_class);\n", 9, table_function);
+      if(partition_candidates)
+         PTFI("for(position = match_slice; position < class_table->size; "
+              "position += match_slices)\n", 9);
+      else PTFI("for(position = 0; position < class_table->size; position++)\n", 9);
+      PTFI("{\n", 9);
+      indent = 12;
+   }
+   if(partition_candidates)
+      PTFI("if(__atomic_load_n(match_winner, __ATOMIC_RELAXED) >= 0) return false;\n",
+           indent);
+   emitCandidateCount(indent);
+   if(!node) PTFI("Edge *host_edge = getEdge(host, class_table->items[position]);\n", indent);
+   else if(node_columns) PTFI("int host_index = class_table->items[position];\n", indent);
+   else PTFI("Node *host_node = getNode(host, class_table->items[position]);\n", indent);
+   return indent;
+}
+
+/* Closes the loops opened by emitClassTableLoops, whose body is at indent. */
+static void emitClassTableLoopsEnd(int indent)
+{
+   for(indent = indent - 3; indent >= 3; indent -= 3) PTFI("}\n", indent);
 }
 
 /* The rule node is matched "in isolation", in that it is not the source or
@@ -364,29 +1016,105 @@ static void emitRootNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_
  * graph nodes are obtained from the appropriate label class tables. */
 static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
 {
-   PTF("static bool match_n%d(Morphism *morphism)\n", left_node->index);
-   PTF("{\n");
-   PTFI("int host_index;\n", 3);
-   PTFI("for(host_index = 0; host_index < host->nodes.size; host_index++)\n", 3);
-   PTFI("{\n", 3);
-   PTFI("Node *host_node = getNode(host, host_index);\n", 6);
-   PTFI("if(host_node == NULL || host_node->index == -1) continue;\n", 6);
-   PTFI("if(host_node->matched) continue;\n", 6);
-   if(left_node->label.mark == ANY)
-      PTFI("if(host_node->label.mark == 0) continue;\n", 6);
-   else PTFI("if(host_node->label.mark != %d) continue;\n", 6, left_node->label.mark);
-   emitDegreeCheck(left_node, 6);  
-   PTF("continue;\n\n");
+   int first_class, last_class;
+   getLabelClassRange(left_node->label, &first_class, &last_class);
+   /* The label class tables do not narrow the search for a label that can
+    * match a host label of any class. Such nodes are instead searched for by
+    * filtering the whole node array on the node columns. */
+   if(node_columns && first_class == 0 && last_class == 6)
+   {
+      emitFilteredNodeMatcher(rule, left_node, next_op);
+      return;
+   }
+   emitMatcherStart('n', left_node->index, false);
+   int indent = emitClassTableLoops(left_node->label, true);
+   if(node_columns)
+   {
+      if(parallel_rule) PTFI("if(nodeInMorphism(morphism, host_index)) continue;\n", indent);
+      else PTFI("if(nodeColumnBit(columns->matched, host_index)) continue;\n", indent);
+      emitDegreeCheck(left_node, true, indent);  
+      PTF("continue;\n");
+      PTFI("Node *host_node = getNode(host, host_index);\n\n", indent);
+   }
+   else
+   {
+      PTFI("if(", indent);
+      emitMatchedTest("host_node", true);
+      PTF(") continue;\n");
+      emitDegreeCheck(left_node, false, indent);  
+      PTF("continue;\n\n");
+   }
 
-   PTFI("HostLabel label = host_node->label;\n", 6);
-   PTFI("bool match = false;\n", 6);
+   if(rule->condition != NULL)
+      generatePredicateFilters(rule->condition, left_node, "continue;", indent);
+   PTFI("HostLabel label = host_node->label;\n", indent);
+   PTFI("bool match = false;\n", indent);
    if(hasListVariable(left_node->label))
-      generateVariableListMatchingCode(rule, left_node->label, 6);
-   else generateFixedListMatchingCode(rule, left_node->label, 6);
-   emitNodeMatchResultCode(left_node, next_op, 6);
+      generateVariableListMatchingCode(rule, left_node->label, indent);
+   else generateFixedListMatchingCode(rule, left_node->label, indent);
+   emitMatchResultCode(rule, true, left_node->index, next_op, indent);
+   emitClassTableLoopsEnd(indent);
+   emitMatcherEnd();
+}
+
+/* The candidates are the nodes selected by filterNodeColumns, which tests the
+ * mark, degree and matched flag of 64 nodes at a time. Label matching runs on
+ * the set bits of each block's bitmask. */
+static void emitFilteredNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
+{
+   emitMatcherStart('n', left_node->index, false);
+   PTFI("NodeFilter filter = {%d, %d, %d, %d, %s};\n", 3,
+        left_node->label.mark == ANY ? -1 : (int)left_node->label.mark,
+        left_node->indegree, left_node->outdegree,
+        left_node->outdegree + left_node->indegree + left_node->bidegree,
+        left_node->interface == NULL ? "true" : "false");
+   PTFI("int block, blocks = (host->nodes.size + 63) / 64;\n", 3);
+   if(partition_candidates)
+   {
+      PTFI("for(block = match_slice; block < blocks; block += match_slices)\n", 3);
+      PTFI("{\n", 3);
+      PTFI("if(__atomic_load_n(match_winner, __ATOMIC_RELAXED) >= 0) return false;\n", 6);
+   }
+   else if(sampled_matching && !parallel_rule)
+   {
+      /* Sampled matching starts at a random node and wraps around, ending with
+       * the nodes of the first block that precede the start. */
+      PTFI("int step, start = blocks > 0 ? sampleCandidate(64 * blocks) : 0;\n", 3);
+      PTFI("uint64_t start_bits = ~(uint64_t)0 << (start & 63);\n", 3);
+      PTFI("for(step = 0; blocks > 0 && step <= blocks; step++)\n", 3);
+      PTFI("{\n", 3);
+      PTFI("block = start / 64 + step < blocks ? start / 64 + step : "
+           "start / 64 + step - blocks;\n", 6);
+   }
+   else
+   {
+      PTFI("for(block = 0; block < blocks; block++)\n", 3);
+      PTFI("{\n", 3);
+   }
+   PTFI("uint64_t candidates = filterNodeColumns(host, block, &filter);\n", 6);
+   if(sampled_matching && !parallel_rule)
+   {
+      PTFI("if(step == 0) candidates &= start_bits;\n", 6);
+      PTFI("else if(step == blocks) candidates &= ~start_bits;\n", 6);
+   }
+   PTFI("while(candidates != 0)\n", 6);
+   PTFI("{\n", 6);
+   PTFI("int host_index = 64 * block + __builtin_ctzll(candidates);\n", 9);
+   PTFI("candidates &= candidates - 1;\n", 9);
+   emitCandidateCount(9);
+   if(parallel_rule) PTFI("if(nodeInMorphism(morphism, host_index)) continue;\n", 9);
+   PTFI("Node *host_node = getNode(host, host_index);\n\n", 9);
+   if(rule->condition != NULL)
+      generatePredicateFilters(rule->condition, left_node, "continue;", 9);
+   PTFI("HostLabel label = host_node->label;\n", 9);
+   PTFI("bool match = false;\n", 9);
+   if(hasListVariable(left_node->label))
+      generateVariableListMatchingCode(rule, left_node->label, 9);
+   else generateFixedListMatchingCode(rule, left_node->label, 9);
+   emitMatchResultCode(rule, true, left_node->index, next_op, 9);
+   PTFI("}\n", 6);
    PTFI("}\n", 3);
-   PTFI("return false;\n", 3);
-   PTF("}\n\n");
+   emitMatcherEnd();
 }
 
 /* Matching a node from a matched incident edge always follow an edge match in
@@ -394,46 +1122,38 @@ static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
  * the previous searchplan function as one of its arguments. It gets the
  * appropriate host node (source or target of the host edge) and checks if this
  * node is compatible with the rule node. 
- * The type argument is either 'i', 'o', or 'b'. */
+ * The type argument is either 'i', 'o', or 'b'. A bidirectional edge is matched
+ * from the image of its other node, which is one of the incident nodes of the
+ * host edge and is matched, so the candidate is the incident node that is not
+ * matched. It is the only candidate: the checks are made once. */
 static void emitNodeFromEdgeMatcher(Rule *rule, RuleNode *left_node, char type,
                                     SearchOp *next_op)
 {
-   PTF("static bool match_n%d(Morphism *morphism, Edge *host_edge)\n",
-       left_node->index);
-   PTF("{\n");
+   emitMatcherStart('n', left_node->index, true);
+   emitCandidateCount(3);
    if(type == 'i' || type == 'b') 
-        PTFI("Node *host_node = getTarget(host, host_edge);\n\n", 3);
-   else PTFI("Node *host_node = getSource(host, host_edge);\n\n", 3);
+        PTFI("Node *host_node = getTarget(host, host_edge);\n", 3);
+   else PTFI("Node *host_node = getSource(host, host_edge);\n", 3);
+   if(type == 'b')
+   {
+      PTFI("if(", 3);
+      emitMatchedTest("host_node", true);
+      PTF(") host_node = getSource(host, host_edge);\n");
+   }
+   PTF("\n");
 
-   string fail_code = (type == 'b') ? "candidate_node = false;" : "return false;";
-   if(type == 'b') PTFI("bool candidate_node = true;\n", 3);
-   PTFI("if(host_node->matched) %s\n", 3, fail_code);
+   string fail_code = failCode();
+   PTFI("if(", 3);
+   emitMatchedTest("host_node", true);
+   PTF(") %s\n", fail_code);
    if(left_node->root) PTFI("if(!(host_node->root)) %s\n", 3, fail_code);
    if(left_node->label.mark == ANY)
       PTFI("if(host_node->label.mark == 0) %s\n", 3, fail_code);
    else PTFI("if(host_node->label.mark != %d) %s\n", 3, left_node->label.mark, fail_code);
-   emitDegreeCheck(left_node, 6);  
-   PTF("%s;\n\n", fail_code);
-
-   /* If the above check fails and the edge is bidirectional, check the other 
-    * node incident to the host edge. Otherwise return false. */
-   if(type == 'b')
-   {
-      PTFI("if(!candidate_node)\n", 3);
-      PTFI("{\n", 3); 
-      PTFI("/* Matching from bidirectional edge: check the second incident node. */\n", 6);
-      if(type == 'i' || type == 'b') 
-           PTFI("host_node = getSource(host, host_edge);\n", 6);
-      else PTFI("host_node = getTarget(host, host_edge);\n", 6);
-      PTFI("if(host_node->matched) return false;\n", 6);
-      if(left_node->root) PTFI("if(!(host_node->root)) return false;\n", 6);
-      if(left_node->label.mark == ANY)
-	 PTFI("if(host_node->label.mark == 0) return false;\n", 6);
-      else PTFI("if(host_node->label.mark != %d) return false;\n", 6, left_node->label.mark);
-      emitDegreeCheck(left_node, 6);  
-      PTF("return false;\n\n");
-      PTFI("}\n", 3);
-   }
+   emitDegreeCheck(left_node, false, 6);  
+   PTF("%s\n\n", fail_code);
+   if(rule->condition != NULL)
+      generatePredicateFilters(rule->condition, left_node, fail_code, 3);
 
    PTFI("HostLabel label = host_node->label;\n", 3);
    PTFI("bool match = false;\n", 3);
@@ -441,84 +1161,131 @@ static void emitNodeFromEdgeMatcher(Rule *rule, RuleNode *left_node, char type,
       generateVariableListMatchingCode(rule, left_node->label, 3);
    else generateFixedListMatchingCode(rule, left_node->label, 3);
 
-   emitNodeMatchResultCode(left_node, next_op, 3);
+   emitMatchResultCode(rule, true, left_node->index, next_op, 3);
+   emitMatcherEnd();
+}
+
+/* Prints the function called by the scan of a rule set, which matches the rule
+ * with the node of the first searchplan operation mapped to host_node. The
+ * candidate is tested as by the operation's matcher, which finds it in a label
+ * class table, so its mark is tested here. The matched items are left in the
+ * morphism, which the caller resets after a failed scan or a predicate's match.
+ * With match budgets, each call is a search with a budget of its own. */
+static void emitScanMatcher(Rule *rule)
+{
+   SearchOp *first = searchplan->first;
+   RuleNode *left_node = getRuleNode(rule->lhs, first->index);
+   /* A match found from the scan is never recorded for a batch. */
+   bool enclosing_batch = batch_rule;
+   batch_rule = false;
+   current_operation = 0;
+
+   fprintf(header, "bool match%sAt(Morphism *morphism, Node *host_node);\n\n", rule->name);
+   PTF("bool match%sAt(Morphism *morphism, Node *host_node)\n", rule->name);
+   PTF("{\n");
+   if(fused_rule) PTFI("Graph *const host = hostGraph();\n", 3);
+   if(match_budgets) PTFI("startMatchBudget(&budget_%s);\n", 3, rule->name);
+   emitCandidateCount(3);
+   PTFI("if(", 3);
+   emitMatchedTest("host_node", true);
+   PTF(") return false;\n");
+   if(left_node->label.mark == ANY) PTFI("if(host_node->label.mark == 0) return false;\n", 3);
+   else PTFI("if(host_node->label.mark != %d) return false;\n", 3, left_node->label.mark);
+   emitDegreeCheck(left_node, false, 3);  
+   PTF("return false;\n\n");
+   if(rule->condition != NULL)
+      generatePredicateFilters(rule->condition, left_node, "return false;", 3);
+   PTFI("HostLabel label = host_node->label;\n", 3);
+   PTFI("bool match = false;\n", 3);
+   if(hasListVariable(left_node->label))
+      generateVariableListMatchingCode(rule, left_node->label, 3);
+   else generateFixedListMatchingCode(rule, left_node->label, 3);
+   emitMatchResultCode(rule, true, left_node->index, first->next, 3);
    PTFI("return false;\n", 3);
    PTF("}\n\n");
+   batch_rule = enclosing_batch;
 }
 
-/* Generates code to test the result of label matching a node. If the label
- * matching succeeds, any predicates in which the node participates are evaluated
- * and the condition checked. If everything succeeds, the morphism and matched_nodes
- * array are updated, and matching continues. If not, any runtime boolean variables
- * modified by predicate evaluation are reset, and any assignments made during label
- * matching are undone. */
-static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int indent)
+/* Generates code to test the result of label matching a node or an edge. If
+ * the label matching succeeds, the morphism and the matched flag are updated,
+ * the predicates of the rule's condition whose nodes and variables are now all
+ * matched are marked for evaluation, and the condition is tested if they can
+ * make it false (see prepareCondition in genCondition.h). If the condition 
+ * holds, matching continues. If anything fails, the updates are undone,
+ * including any assignments made during label matching. */
+static void emitMatchResultCode(Rule *rule, bool node, int index, SearchOp *next_op,
+                                int indent)
 {
+   string item = node ? "host_node" : "host_edge";
    PTFI("if(match)\n", indent);
    PTFI("{\n", indent);
-   PTFI("addNodeMap(morphism, %d, host_node->index, new_assignments);\n",
-        indent + 3, node->index);
-   PTFI("host_node->matched = true;\n", indent + 3);
-   if(node->predicates != NULL)
+   PTFI("add%sMap(morphism, %d, %s->index, new_assignments);\n", indent + 3,
+        node ? "Node" : "Edge", index, item);
+   emitMatchedFlagUpdate(item, node, true, indent + 3);
+   bool tested = false;
+   if(rule->condition != NULL)
    {
-      PTFI("/* Update global booleans representing the node's predicates. */\n", indent + 3);
-      int index;
-      for(index = 0; index < node->predicate_count; index++)
-         PTFI("evaluatePredicate%d(morphism);\n", indent + 3, 
-              node->predicates[index]->bool_id);
-      if(next_op != NULL) PTFI("bool next_match_result = false;\n", indent + 3);
-      PTFI("if(evaluateCondition())", indent + 3);
-      if(next_op == NULL)
-      { 
-         PTF("\n");
+      generatePredicateResets(rule->condition, current_operation, indent + 3);
+      tested = conditionTested(rule->condition, current_operation);
+   }
+   if(next_op == NULL)
+   {
+      if(tested)
+      {
+         PTFI("if(", indent + 3);
+         generateConditionExpression(rule->condition, current_operation);
+         PTF(")\n");
          PTFI("{\n", indent + 3);
          PTFI("/* All items matched! */\n", indent + 6);
-         PTFI("return true;\n", indent + 6);
+         PTFI("%s\n", indent + 6, matchFoundCode());
          PTFI("}\n", indent + 3);
+         PTFI("remove%sMap(morphism, %d);\n", indent + 3, node ? "Node" : "Edge", index);
+         emitMatchedFlagUpdate(item, node, false, indent + 3);
       }
       else
       {
-         PTF(" next_match_result = ");
-         emitNextMatcherCall(next_op);
-         PTF(";\n");
-         PTFI("if(next_match_result) return true;\n", indent + 3);           
+         PTFI("/* All items matched! */\n", indent + 3);
+         PTFI("%s\n", indent + 3, matchFoundCode());
       }
-      PTFI("else\n", indent + 3);
-      PTFI("{\n", indent + 3);  
-      PTFI("/* Reset the boolean variables in the predicates of this node. */\n", 
-            indent + 6);
-      for(index = 0; index < node->predicate_count; index++)
-      { 
-         Predicate *predicate = node->predicates[index];
-         if(predicate->negated) PTFI("b%d = false;\n", indent + 6, predicate->bool_id);
-         else PTFI("b%d = true;\n", indent + 6, predicate->bool_id);
+   }
+   else if(fused_rule)
+   {
+      /* The next operation is printed in the block of the condition. */
+      if(tested)
+      {
+         PTFI("if(", indent + 3);
+         generateConditionExpression(rule->condition, current_operation);
+         PTF(")\n");
       }
-      PTFI("removeNodeMap(morphism, %d);\n", indent + 6, node->index);
-      PTFI("host_node->matched = false;\n", indent + 6);  
+      PTFI("{\n", indent + 3);
+      int label = emitInlineOperation(rule, next_op, indent + 6);
       PTFI("}\n", indent + 3);
+      emitBacktrackLabel(label, indent + 3);
+      PTFI("remove%sMap(morphism, %d);\n", indent + 3, node ? "Node" : "Edge", index);
+      emitMatchedFlagUpdate(item, node, false, indent + 3);
    }
    else
    {
-      if(next_op == NULL)
-      {
-         PTFI("/* All items matched! */\n", indent + 3);
-         PTFI("return true;\n", indent + 3);
-      }
-      else
+      PTFI("if(", indent + 3);
+      if(tested)
       {
-         PTFI("if(", indent + 3);
-         emitNextMatcherCall(next_op); 
-         PTF(") return true;\n");            
-         PTFI("else\n", indent + 3);
-         PTFI("{\n", indent + 3);  
-         PTFI("removeNodeMap(morphism, %d);\n", indent + 6, node->index);
-         PTFI("host_node->matched = false;\n", indent + 6);  
-         PTFI("}\n", indent + 3);
+         generateConditionExpression(rule->condition, current_operation);
+         PTF(" && ");
       }
+      emitNextMatcherCall(next_op); 
+      PTF(") %s\n", matchFoundCode());
+      PTFI("else\n", indent + 3);
+      PTFI("{\n", indent + 3);  
+      PTFI("remove%sMap(morphism, %d);\n", indent + 6, node ? "Node" : "Edge", index);
+      emitMatchedFlagUpdate(item, node, false, indent + 6);
+      PTFI("}\n", indent + 3);
    }
    PTFI("}\n", indent);
    /* The else branch of the "if(match)" printed at the top of this function. */
    PTFI("else removeAssignments(morphism, new_assignments);\n", indent);
+   /* The end of the first operation's loop body in a fused batched matcher, to which
+    * matchFoundCode jumps after recording a match. */
+   if(collect_matches && fused_rule) PTFI("next_candidate: ;\n", indent);
 }
 
 /* The rule edge is matched "in isolation", in that it is not incident to a
@@ -526,44 +1293,51 @@ static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int inden
  * are obtained from the appropriate label class tables. */
 static void emitEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op)
 {
-   PTF("static bool match_e%d(Morphism *morphism)\n", left_edge->index);
-   PTF("{\n");
-   PTFI("int host_index;\n", 3);
-   PTFI("for(host_index = 0; host_index < host->edges.size; host_index++)\n", 3);
-   PTFI("{\n", 3);
-   PTFI("Edge *host_edge = getEdge(host, host_index);\n", 6);
-   PTFI("if(host_edge == NULL || host_edge->index == -1) continue;\n", 6);
-   PTFI("if(host_edge->matched) continue;\n", 6);
-   if(left_edge->label.mark == ANY) 
-      PTFI("if(host_edge->label.mark == 0) continue;\n\n", 6);
-   else PTFI("if(host_edge->label.mark != %d) continue;\n\n", 6, left_edge->label.mark);
-   PTFI("HostLabel label = host_edge->label;\n", 6);
-   PTFI("bool match = false;\n", 6);
+   emitMatcherStart('e', left_edge->index, false);
+   int indent = emitClassTableLoops(left_edge->label, false);
+   PTFI("if(", indent);
+   emitMatchedTest("host_edge", false);
+   PTF(") continue;\n\n");
+   PTFI("HostLabel label = host_edge->label;\n", indent);
+   PTFI("bool match = false;\n", indent);
    if(hasListVariable(left_edge->label))
-      generateVariableListMatchingCode(rule, left_edge->label, 6);
-   else generateFixedListMatchingCode(rule, left_edge->label, 6);
-   emitEdgeMatchResultCode(left_edge->index, next_op, 6);
-   PTFI("}\n", 3);
-   PTFI("return false;\n", 3);
-   PTF("}\n\n");
+      generateVariableListMatchingCode(rule, left_edge->label, indent);
+   else generateFixedListMatchingCode(rule, left_edge->label, indent);
+   emitMatchResultCode(rule, false, left_edge->index, next_op, indent);
+   emitClassTableLoopsEnd(indent);
+   emitMatcherEnd();
 }
 
 static void emitLoopEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op)
 {
-   PTF("static bool match_e%d(Morphism *morphism)\n", left_edge->index);
-   PTF("{\n");
+   emitMatcherStart('e', left_edge->index, false);
    PTFI("/* Matching a loop. */\n", 3);
    PTFI("int node_index = lookupNode(morphism, %d);\n", 3, left_edge->source->index);
-   PTFI("if(node_index < 0) return false;\n", 3);
-   PTFI("Node *host_node = getNode(host, node_index);\n\n", 3);
-
+   PTFI("if(node_index < 0) %s\n", 3, failCode());
    PTFI("int counter;\n", 3);
-   PTFI("for(counter = 0; counter < host_node->out_edges.size + 2; counter++)\n", 3);
-   PTFI("{\n", 3);
-   PTFI("Edge *host_edge = getNthOutEdge(host, host_node, counter);\n", 6);
-   PTFI("if(host_edge == NULL) continue;\n", 6);
-   PTFI("if(host_edge->matched) continue;\n", 6);
-   PTFI("if(host_edge->source != host_edge->target) continue;\n", 6);
+   if(adjacency_index)
+   {
+      PTFI("IntArray *loops = getEdgesBetween(host, node_index, node_index);\n", 3);
+      PTFI("for(counter = 0; loops != NULL && counter < loops->size; counter++)\n", 3);
+      PTFI("{\n", 3);
+      emitCandidateCount(6);
+      PTFI("Edge *host_edge = getEdge(host, loops->items[counter]);\n", 6);
+      PTFI("if(", 6);
+      emitMatchedTest("host_edge", false);
+      PTF(") continue;\n");
+   }
+   else
+   {
+      PTFI("Node *host_node = getNode(host, node_index);\n", 3);
+      PTFI("Edge *host_edge;\n\n", 3);
+      PTFI("forEachOutEdge(host, host_node, host_edge, counter)\n", 3);
+      PTFI("{\n", 3);
+      emitCandidateCount(6);
+      PTFI("if(", 6);
+      emitMatchedTest("host_edge", false);
+      PTF(") continue;\n");
+      PTFI("if(host_edge->source != host_edge->target) continue;\n", 6);
+   }
    if(left_edge->label.mark == ANY)
       PTFI("if(host_edge->label.mark == 0) continue;\n\n", 6);
    else PTFI("if(host_edge->label.mark != %d) continue;\n\n", 6, left_edge->label.mark);
@@ -572,9 +1346,9 @@ static void emitLoopEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_
    if(hasListVariable(left_edge->label))
       generateVariableListMatchingCode(rule, left_edge->label, 6);
    else generateFixedListMatchingCode(rule, left_edge->label, 6);
-   emitEdgeMatchResultCode(left_edge->index, next_op, 6);
+   emitMatchResultCode(rule, false, left_edge->index, next_op, 6);
    PTFI("}\n", 3);
-   PTFI("return false;\n}\n\n", 3);
+   emitMatcherEnd();
 }
 
 /* The following function matches a rule edge from one of its matched incident
@@ -584,71 +1358,120 @@ static void emitLoopEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_
  * of the LHS-edge to find the host node to which it has been matched. The candidate
  * host edges come from the edges lists of that node. 
  *
- * Called for various searchplan operations: matching an edge from its source,
- * matching an edge from its target, and matching bidirectional edges. In 
- * particular, the bidirectional edge code is generated by two calls to this
- * function. The skeleton of the generated code is largely the same for these 
- * operations, but different parts of the code printed by this function are required
- * for different operations. This is controlled by the three boolean flags:
+ * Called for two searchplan operations: matching an edge from its source and
+ * matching an edge from its target, as controlled by the source flag. The
+ * candidates of a directed edge are the outgoing (incoming) edges of the start
+ * node. The candidates of a bidirectional edge are all its incident edges, which
+ * are examined in a single loop with the other incident node of each host edge
+ * as the end node, so that the code of the rest of the searchplan is printed once.
  *
- * source - When set, the generated code searches from the match of the source of 
- *          the rule edge. Otherwise, it searches from the match of the target.
- * initialise - When set, this prints the header of the generated matching function.
- *              This is set in all cases except for the second call in the generation
- *              of bidirectional edge matching code.
- * exit - When set, this prints the return statement of the generated matching function.
- *        This is set in all cases except for the first call in the generation of
- *        bidirectional edge matching code. */
-static void emitEdgeFromNodeMatcher(Rule *rule, RuleEdge *left_edge, bool source,
-                                    bool initialise, bool exit, SearchOp *next_op)
+ * If both incident nodes of the rule edge are matched by earlier searchplan
+ * operations and the compiler's -a flag is set, the candidate host edges are
+ * instead obtained from the host graph's adjacency index (ends_matched). */
+static void emitEdgeFromNodeMatcher(Rule *rule, RuleEdge *left_edge, bool ends_matched,
+                                    bool source, SearchOp *next_op)
 {
    int start_index = source ? left_edge->source->index : left_edge->target->index;
    int end_index = source ? left_edge->target->index : left_edge->source->index;
    string end_node_type = source ? "target" : "source";
+   bool bidirectional = left_edge->bidirectional;
+   /* The host node index to which the end node is matched. */
+   char host_end[32];
+   if(bidirectional) strcpy(host_end, "host_end");
+   else sprintf(host_end, "host_edge->%s", end_node_type);
 
-   if(initialise)
+   emitMatcherStart('e', left_edge->index, false);
+   if(adjacency_index && ends_matched)
    {
-      PTF("static bool match_e%d(Morphism *morphism)\n", left_edge->index);
-      PTF("{\n");
-      PTFI("/* Start node is the already-matched node from which the candidate\n", 3);
-      PTFI("   edges are drawn. End node may or may not have been matched already. */\n", 3);
+      PTFI("/* Both incident nodes are matched. The candidate edges are the host\n", 3);
+      PTFI("   edges between their images. */\n", 3);
       PTFI("int start_index = lookupNode(morphism, %d);\n", 3, start_index);
       PTFI("int end_index = lookupNode(morphism, %d);\n", 3, end_index);
-      PTFI("if(start_index < 0) return false;\n", 3);
-      PTFI("Node *host_node = getNode(host, start_index);\n\n", 3);
+      PTFI("if(start_index < 0 || end_index < 0) %s\n", 3, failCode());
       PTFI("int counter;\n", 3);
-   }
-   if(source)
-   {
-      PTFI("for(counter = 0; counter < host_node->out_edges.size + 2; counter++)\n", 3);
-      PTFI("{\n", 3);
-      PTFI("Edge *host_edge = getNthOutEdge(host, host_node, counter);\n", 6);
-   }
-   else
-   {
-      PTFI("for(counter = 0; counter < host_node->in_edges.size + 2; counter++)\n", 3);
-      PTFI("{\n", 3);
-      PTFI("Edge *host_edge = getNthInEdge(host, host_node, counter);\n", 6);
+      if(bidirectional)
+      {
+         /* One loop over the edges in both directions, from the start node first. */
+         PTFI("IntArray *forward_edges = getEdgesBetween(host, start_index, end_index);\n", 3);
+         PTFI("IntArray *backward_edges = getEdgesBetween(host, end_index, start_index);\n", 3);
+         PTFI("int forward_size = forward_edges == NULL ? 0 : forward_edges->size;\n", 3);
+         PTFI("int size = forward_size + (backward_edges == NULL ? 0 : backward_edges->size);\n", 3);
+         PTFI("for(counter = 0; counter < size; counter++)\n", 3);
+         PTFI("{\n", 3);
+         emitCandidateCount(6);
+         PTFI("Edge *host_edge = getEdge(host, counter < forward_size ?\n", 6);
+         PTFI("                  forward_edges->items[counter] :\n", 6);
+         PTFI("                  backward_edges->items[counter - forward_size]);\n", 6);
+      }
+      else
+      {
+         if(source) 
+              PTFI("IntArray *parallel_edges = getEdgesBetween(host, start_index, end_index);\n", 3);
+         else PTFI("IntArray *parallel_edges = getEdgesBetween(host, end_index, start_index);\n", 3);
+         PTFI("for(counter = 0; parallel_edges != NULL && counter < parallel_edges->size;"
+              " counter++)\n", 3);
+         PTFI("{\n", 3);
+         emitCandidateCount(6);
+         PTFI("Edge *host_edge = getEdge(host, parallel_edges->items[counter]);\n", 6);
+      }
+      PTFI("if(", 6);
+      emitMatchedTest("host_edge", false);
+      PTF(") continue;\n");
+      if(left_edge->label.mark == ANY)
+         PTFI("if(host_edge->label.mark == 0) continue;\n\n", 6);
+      else PTFI("if(host_edge->label.mark != %d) continue;\n\n", 6, left_edge->label.mark);
+      PTFI("HostLabel label = host_edge->label;\n", 6);
+      PTFI("bool match = false;\n", 6);
+      if(hasListVariable(left_edge->label))
+         generateVariableListMatchingCode(rule, left_edge->label, 6);
+      else generateFixedListMatchingCode(rule, left_edge->label, 6);
+      emitMatchResultCode(rule, false, left_edge->index, next_op, 6);
+      PTFI("}\n", 3);
+      emitMatcherEnd();
+      return;
    }
 
-   PTFI("if(host_edge == NULL) continue;\n", 6);
-   PTFI("if(host_edge->matched) continue;\n", 6);
+   PTFI("/* Start node is the already-matched node from which the candidate\n", 3);
+   PTFI("   edges are drawn. End node may or may not have been matched already. */\n", 3);
+   PTFI("int start_index = lookupNode(morphism, %d);\n", 3, start_index);
+   PTFI("int end_index = lookupNode(morphism, %d);\n", 3, end_index);
+   PTFI("if(start_index < 0) %s\n", 3, failCode());
+   PTFI("Node *host_node = getNode(host, start_index);\n\n", 3);
+   PTFI("Edge *host_edge;\n", 3);
+   PTFI("int counter;\n", 3);
+   if(bidirectional) PTFI("forEachIncidentEdge(host, host_node, host_edge, counter)\n", 3);
+   else if(source) PTFI("forEachOutEdge(host, host_node, host_edge, counter)\n", 3);
+   else PTFI("forEachInEdge(host, host_node, host_edge, counter)\n", 3);
+   PTFI("{\n", 3);
+   emitCandidateCount(6);
+   PTFI("if(", 6);
+   emitMatchedTest("host_edge", false);
+   PTF(") continue;\n");
    PTFI("if(host_edge->source == host_edge->target) continue;\n", 6);
    if(left_edge->label.mark == ANY)
       PTFI("if(host_edge->label.mark == 0) continue;\n\n", 6);
    else PTFI("if(host_edge->label.mark != %d) continue;\n\n", 6, left_edge->label.mark);
 
+   if(bidirectional)
+   {
+      PTFI("/* The end node is matched to the other incident node of the host edge. */\n", 6);
+      PTFI("int host_end = host_edge->source == start_index ?\n", 6);
+      PTFI("               host_edge->target : host_edge->source;\n", 6);
+      end_node_type = "other incident node";
+   }
    PTFI("/* If the end node has been matched, check that the %s of the\n", 6, end_node_type);
    PTFI(" * host edge is the image of the end node. */\n", 6);
    PTFI("if(end_index >= 0)\n", 6);
    PTFI("{\n", 6);
-   PTFI("if(host_edge->%s != end_index) continue;\n", 9, end_node_type);
+   PTFI("if(%s != end_index) continue;\n", 9, host_end);
    PTFI("}\n", 6);
    PTFI("/* Otherwise, the %s of the host edge should be unmatched. */\n", 6, end_node_type);
    PTFI("else\n", 6);
    PTFI("{\n", 6);
-   PTFI("Node *end_node = getNode(host, host_edge->%s);\n", 9, end_node_type);
-   PTFI("if(end_node->matched) continue;\n", 9);
+   PTFI("Node *end_node = getNode(host, %s);\n", 9, host_end);
+   PTFI("if(", 9);
+   emitMatchedTest("end_node", true);
+   PTF(") continue;\n");
    PTFI("}\n\n", 6);
 
    PTFI("HostLabel label = host_edge->label;\n", 6);
@@ -656,41 +1479,14 @@ static void emitEdgeFromNodeMatcher(Rule *rule, RuleEdge *left_edge, bool source
    if(hasListVariable(left_edge->label))
       generateVariableListMatchingCode(rule, left_edge->label, 6);
    else generateFixedListMatchingCode(rule, left_edge->label, 6);
-   emitEdgeMatchResultCode(left_edge->index, next_op, 6);
+   emitMatchResultCode(rule, false, left_edge->index, next_op, 6);
    PTFI("}\n", 3);
-
-   if(exit) PTFI("return false;\n}\n\n", 3);
+   emitMatcherEnd();
 }
 
 /* Generates code to test the result of label matching a edge. If the label matching
  * succeeds, the morphism and matched_edges array are updated, and matching
  * continues. If not,  any assignments made during label matching are undone. */
-static void emitEdgeMatchResultCode(int index, SearchOp *next_op, int indent)
-{
-   PTFI("if(match)\n", indent);
-   PTFI("{\n", indent);
-   PTFI("addEdgeMap(morphism, %d, host_edge->index, new_assignments);\n", indent + 3, index);
-   PTFI("host_edge->matched = true;\n", indent + 3);
-   if(next_op == NULL)
-   {
-      PTFI("/* All items matched! */\n", indent);
-      PTFI("return true;\n", indent);
-   }
-   else
-   {
-      PTFI("if(", indent + 3);
-      emitNextMatcherCall(next_op); 
-      PTF(") return true;\n");           
-      PTFI("else\n", indent + 3);
-      PTFI("{\n", indent + 3);                              
-      PTFI("removeEdgeMap(morphism, %d);\n", indent + 6, index);
-      PTFI("host_edge->matched = false;\n", indent + 6); 
-      PTFI("}\n", indent + 3);
-   } 
-   PTFI("}\n", indent);
-   PTFI("else removeAssignments(morphism, new_assignments);\n", indent);
-}
-
 static void emitNextMatcherCall(SearchOp *next_operation)
 {
    switch(next_operation->type)
@@ -720,11 +1516,38 @@ static void emitNextMatcherCall(SearchOp *next_operation)
    }
 }
 
+/* Prints the test that the host item has already been matched. Parallel
+ * matchers test their own morphism instead of the shared matched flag. Few
+ * host items are matched at a time, so fused matchers mark the test as
+ * unlikely to hold. */
+static void emitMatchedTest(string item, bool node)
+{
+   if(fused_rule) PTF("__builtin_expect(");
+   if(parallel_rule) 
+      PTF("%sInMorphism(morphism, %s->index)", node ? "node" : "edge", item);
+   else PTF("%sMatched(host, %s)", node ? "node" : "edge", item);
+   if(fused_rule) PTF(", 0)");
+}
+
+/* Prints the statement that sets or resets the matched flag of the host item,
+ * its stamp with the host graph's match epoch. Parallel matchers do not write
+ * the flags. */
+static void emitMatchedFlagUpdate(string item, bool node, bool matched, int indent)
+{
+   if(parallel_rule) return;
+   if(node && node_columns)
+      PTFI("%sMatchedNodeFlag(host, %s->index);\n", indent, matched ? "set" : "reset", item);
+   else if(matched) PTFI("%s->matched_epoch = host->match_epoch;\n", indent, item);
+   else PTFI("%s->matched_epoch = 0;\n", indent, item);
+}
+
 void generateRemoveLHSCode(string rule_name)
 {
    fprintf(header, "void apply%s(Morphism *morphism, bool record_changes);\n", rule_name);
-   PTF("void apply%s(Morphism *morphism, bool record_changes)\n", rule_name);
+   PTF("%svoid apply%s%s(Morphism *morphism, bool record_changes)\n", FUNCTION_PREFIX,
+       rule_name, FUNCTION_SUFFIX);
    PTF("{\n");
+   emitApplicationCount(rule_name);
 
    PTFI("int count;\n", 3);
    PTFI("for(count = 0; count < morphism->edges; count++)\n", 3);
@@ -757,8 +1580,10 @@ void generateRemoveLHSCode(string rule_name)
 void generateAddRHSCode(Rule *rule)
 {
    fprintf(header, "void apply%s(bool record_changes);\n", rule->name);
-   PTF("void apply%s(bool record_changes)\n", rule->name);
+   PTF("%svoid apply%s%s(bool record_changes)\n", FUNCTION_PREFIX, rule->name,
+       FUNCTION_SUFFIX);
    PTF("{\n");
+   emitApplicationCount(rule->name);
    PTFI("int index;\n", 3);
    PTFI("HostLabel label;\n\n", 3);
    /* Generate code to retrieve the values assigned to the variables in the
@@ -832,8 +1657,10 @@ void generateAddRHSCode(Rule *rule)
 void generateApplicationCode(Rule *rule)
 {
    fprintf(header, "void apply%s(Morphism *morphism, bool record_changes);\n", rule->name);
-   PTF("void apply%s(Morphism *morphism, bool record_changes)\n", rule->name);
+   PTF("%svoid apply%s%s(Morphism *morphism, bool record_changes)\n", FUNCTION_PREFIX,
+       rule->name, FUNCTION_SUFFIX);
    PTF("{\n");
+   emitApplicationCount(rule->name);
    /* Generate code to retrieve the values assigned to the variables in the
     * matching phase. */
    int index;
@@ -1126,3 +1953,131 @@ void generateApplicationCode(Rule *rule)
    PTFI("initialiseMorphism(morphism, host);\n}\n\n", 3);
 }
 
+/* Prints the definition of the rule's profile, which the runtime's main
+ * function lists, and the candidate counters of its searchplan operations. */
+static void emitRuleProfile(string rule_name, Searchplan *searchplan)
+{
+   int operations = 0;
+   fprintf(header, "extern RuleProfile profile_%s;\n\n", rule_name);
+   if(searchplan != NULL)
+   {
+      SearchOp *operation = searchplan->first;
+      for(; operation != NULL; operation = operation->next) operations++;
+      PTF("static unsigned long profile_candidates[%d];\n", operations);
+   }
+   PTF("RuleProfile profile_%s = {\"%s\", \"", rule_name, rule_name);
+   if(searchplan != NULL)
+   {
+      SearchOp *operation = searchplan->first;
+      for(; operation != NULL; operation = operation->next)
+         PTF("%s%c%d", operation == searchplan->first ? "" : " ", operation->type,
+             operation->index);
+   }
+   PTF("\", %d, %s, 0, 0, 0, 0, 0, 0};\n\n", operations,
+       searchplan == NULL ? "NULL" : "profile_candidates");
+}
+
+/* Prints the statements at the start of a rule's application function that
+ * count the application and write the live statistics if they are requested
+ * (see pollRuntimeStats in debug.h). Nothing is counted in the shared
+ * library, whose rules may be applied on several threads at once. */
+static void emitApplicationCount(string rule_name)
+{
+   if(shared_library) return;
+   PTFI("counter_%s.applications++;\n", 3, rule_name);
+   PTFI("pollRuntimeStats();\n", 3);
+}
+
+/* With rule profiling, prints the statement that counts a candidate of the
+ * current searchplan operation. The threads of a parallel matcher share the
+ * counters. With match budgets, the candidate is also a step of the search,
+ * which fails if the step exceeds the budget of the rule (see match_steps in
+ * morphism.h). The threads of a parallel matcher are not budgeted. */
+static void emitCandidateCount(int indent)
+{
+   if(match_budgets && !parallel_rule)
+      PTFI("if(--match_steps < 0 && matchBudgetExceeded()) %s\n", indent, failCode());
+   if(!rule_profiling) return;
+   if(parallel_rule)
+      PTFI("__atomic_fetch_add(&profile_candidates[%d], 1, __ATOMIC_RELAXED);\n", indent,
+           current_operation);
+   else PTFI("profile_candidates[%d]++;\n", indent, current_operation);
+}
+
+/* Prints the public matching and application functions of a profiled rule.
+ * They time the calls to the functions printed under the names ending in Body
+ * and count the calls, the matches found and the graph changes pushed. */
+static void emitProfiledFunctions(Rule *rule, bool predicate)
+{
+   if(rule->lhs != NULL)
+   {
+      PTF("bool match%s(Morphism *morphism)\n", rule->name);
+      PTF("{\n");
+      PTFI("uint64_t start = profileClock();\n", 3);
+      PTFI("bool match = match%sBody(morphism);\n", 3, rule->name);
+      PTFI("profile_%s.match_time += profileClock() - start;\n", 3, rule->name);
+      PTFI("profile_%s.match_calls++;\n", 3, rule->name);
+      PTFI("if(match) profile_%s.matches++;\n", 3, rule->name);
+      PTFI("return match;\n", 3);
+      PTF("}\n\n");
+   }
+   if(predicate || (rule->lhs == NULL && rule->rhs == NULL)) return;
+   if(rule->lhs == NULL) PTF("void apply%s(bool record_changes)\n", rule->name);
+   else PTF("void apply%s(Morphism *morphism, bool record_changes)\n", rule->name);
+   PTF("{\n");
+   PTFI("int changes = graph_change_count;\n", 3);
+   PTFI("uint64_t start = profileClock();\n", 3);
+   if(rule->lhs == NULL) PTFI("apply%sBody(record_changes);\n", 3, rule->name);
+   else PTFI("apply%sBody(morphism, record_changes);\n", 3, rule->name);
+   PTFI("profile_%s.apply_time += profileClock() - start;\n", 3, rule->name);
+   PTFI("profile_%s.applications++;\n", 3, rule->name);
+   PTFI("profile_%s.changes += graph_change_count - changes;\n", 3, rule->name);
+   PTF("}\n\n");
+}
+
+/* The names of the static functions and variables that any rule module may
+ * define, besides its matching functions and label constants. */
+static const string unity_names[] = {
+   "hostGraph", "profile_candidates", "sweeping", "batch",
+   "batch_size", "batch_capacity", "recordMatch", "match_slice", "match_slices",
+   "match_winner", "slice_morphisms", "SliceTask", "matchSlice", "matchParallel" };
+
+/* The unity build compiles the runtime library and all generated modules as one
+ * translation unit, in which the static names of different rule modules would
+ * clash, as they would in the shared rule modules of the -m flag. The code of
+ * each rule therefore defines macros at its top that prefix its static names
+ * with the rule name, and undefines them at its end. */
+static void emitUnityNames(Rule *rule, bool define)
+{
+   int names = sizeof(unity_names) / sizeof(unity_names[0]), index;
+   if(define) PTF("/* Names of this module's statics in the unity build. */\n");
+   else PTF("\n");
+   for(index = 0; index < names; index++)
+   {
+      if(define) PTF("#define %s %s_%s\n", unity_names[index], rule->name, unity_names[index]);
+      else PTF("#undef %s\n", unity_names[index]);
+   }
+   int items = rule->lhs == NULL ? 0 : rule->lhs->node_index;
+   for(index = 0; index < items; index++)
+   {
+      if(define) PTF("#define match_n%d %s_match_n%d\n", index, rule->name, index);
+      else PTF("#undef match_n%d\n", index);
+   }
+   items = rule->lhs == NULL ? 0 : rule->lhs->edge_index;
+   for(index = 0; index < items; index++)
+   {
+      if(define) PTF("#define match_e%d %s_match_e%d\n", index, rule->name, index);
+      else PTF("#undef match_e%d\n", index);
+   }
+   items = countLabelConstants();
+   for(index = 0; index < items; index++)
+   {
+      if(define) 
+      {
+         PTF("#define label_list%d %s_label_list%d\n", index, rule->name, index);
+         PTF("#define label_string%d %s_label_string%d\n", index, rule->name, index);
+      }
+      else PTF("#undef label_list%d\n#undef label_string%d\n", index, index);
+   }
+   if(define) PTF("\n");
+}
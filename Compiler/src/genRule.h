@@ -31,6 +31,7 @@
 
 #include "ast.h"
 #include "common.h"
+#include "error.h"
 #include "genCondition.h"
 #include "genLabel.h"
 #include "rule.h"
@@ -57,14 +58,23 @@
  * function f_1 returns false, then match_R returns false, signalling that the 
  * rule matching failed. If the last matching function f_n finds a match, then
  * it returns true. This propagates back through all the matching functions to 
- * match_R, which returns true, signalling that the rule match is a success. */
+ * match_R, which returns true, signalling that the rule match is a success.
+ *
+ * With the -f flag, f_1 is the only matching function. The code of op_i+1 is
+ * printed inside f_1 where the code of op_i has found a match, and a failing
+ * op_i+1 jumps with goto to the code that undoes the match of op_i. */
  
 /* Takes the root of the AST of a GP 2 program and generates C modules for
- * each rule in the program. */
+ * each rule in the program. With the -m flag, the code of the rules is written
+ * to the given number of modules rules_0.c, rules_1.c, ..., the rules being
+ * dealt to the modules in turn, so that a program with many rules is compiled
+ * with few invocations of the C compiler. The statics of each rule are renamed
+ * as in the unity build. */
 void generateRules(List *declarations, string output_dir);
 
 /* Create a C module to match and apply the rule. The generated files are
- * called <rule_name>.h and <rule_name>.c.*/
+ * called <rule_name>.h and <rule_name>.c, or the code is appended to the
+ * module of the rule with -m. */
 void generateRuleCode(Rule *rule, bool predicate, string output_dir);
 
 /* The three functions below write the function apply_<rule_name> that makes the 
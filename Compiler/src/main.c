@@ -35,6 +35,7 @@
 #include "genRule.h"
 #include "parser.h"
 #include "pretty.h"
+#include "searchplan.h"
 #include "seman.h" 
 
 #include <sys/stat.h>
@@ -81,9 +82,12 @@ static bool validateProgram(string program_file)
     * exist in the program. Some syntax errors are cleanly handled by the parser,
     * resulting in a valid AST. Hence, if syntax errors are encountered, semantic
     * analysis can still be performed. */
+   startPhase(PARSE_PHASE);
    bool valid_program = (yyparse() == 0);
+   endPhase(PARSE_PHASE);
    if(!valid_program) return false;
    gp_program = reverse(gp_program);
+   startPhase(ANALYSIS_PHASE);
    #ifdef DEBUG_PROGRAM
       /* analyseProgram prints the symbol table before exiting. */
       bool semantic_error = analyseProgram(gp_program, true, program_file);
@@ -91,6 +95,7 @@ static bool validateProgram(string program_file)
    #else
       bool semantic_error = analyseProgram(gp_program, false, NULL);
    #endif
+   endPhase(ANALYSIS_PHASE);
    return (!syntax_error && !semantic_error);
 }
 
@@ -124,6 +129,36 @@ static bool validateHostGraph(string host_file)
 /* Controls the CFLAGS in the generated makefile. */
 bool debug_flags = false;
 
+/* Set by the -B flag to select the build profiles of the generated makefile.
+ * unity_build is also read by genRule. */
+bool unity_build = false;
+bool lto_build = false;
+bool native_build = false;
+bool pgo_build = false;
+/* Set by the --shared flag to build the program as the shared library gp2run.so
+ * with the C interface of gp2.h instead of the executable gp2run. */
+bool shared_library = false;
+
+/* Reads the comma-separated list of build profiles passed with -B. Returns false
+ * if a profile is not known. */
+static bool readBuildProfiles(string profiles)
+{
+   string profile = strtok(profiles, ",");
+   for(; profile != NULL; profile = strtok(NULL, ","))
+   {
+      if(strcmp(profile, "unity") == 0) unity_build = true;
+      else if(strcmp(profile, "lto") == 0) lto_build = true;
+      else if(strcmp(profile, "native") == 0) native_build = true;
+      else if(strcmp(profile, "pgo") == 0) pgo_build = true;
+      else
+      {
+         print_to_console("Error: unknown build profile \"%s\".\n", profile);
+         return false;
+      }
+   }
+   return true;
+}
+
 void printMakeFile(string output_dir, string install_dir)
 {
    int length = strlen(output_dir) + 9;
@@ -138,18 +173,75 @@ void printMakeFile(string output_dir, string install_dir)
       exit(1);
    }
    
+   /* The unity and LTO builds compile the installed sources of the runtime
+    * library with the program instead of linking libgp2.a, as does the shared
+    * library build, whose objects must be position-independent. */
+   bool runtime_sources = unity_build || lto_build || shared_library;
+   string binary = shared_library ? "gp2run.so" : "gp2run";
    if(install_dir != NULL) 
    { 
       fprintf(makefile, "INCDIR=%s/include\n", install_dir);
       fprintf(makefile, "LIBDIR=%s/lib\n", install_dir);
+      if(runtime_sources) fprintf(makefile, "LIBSRCDIR=%s/share/gp2/lib\n", install_dir);
+   }
+   else if(runtime_sources) fprintf(makefile, "LIBSRCDIR=/usr/local/share/gp2/lib\n");
+   if(unity_build)
+   {
+      fprintf(makefile, "SOURCES := $(filter-out gp2run_unity.c, $(wildcard *.c))\n");
+      fprintf(makefile, "OBJECTS := $(patsubst %%.c, %%.o, $(SOURCES))\n");
    }
-   fprintf(makefile, "OBJECTS := $(patsubst %%.c, %%.o, $(wildcard *.c))\n");  
+   else fprintf(makefile, "OBJECTS := $(patsubst %%.c, %%.o, $(wildcard *.c))\n");  
+   if(runtime_sources && !unity_build)
+      fprintf(makefile, "RUNTIME_OBJECTS := $(patsubst $(LIBSRCDIR)/%%.c, gp2_%%.o, "
+                        "$(wildcard $(LIBSRCDIR)/*.c))\n");
    fprintf(makefile, "CC=gcc\n\n");
 
-   if(debug_flags) fprintf(makefile, "CFLAGS = -g -L$(LIB) -Wall -Wextra -lgp2\n\n");
+   if(debug_flags) fprintf(makefile, "CFLAGS = -g -L$(LIB) -Wall -Wextra");
    else fprintf(makefile, "CFLAGS = -I$(INCDIR) -L$(LIBDIR) -fomit-frame-pointer "
-                          "-O2 -Wall -Wextra -lgp2\n\n");
-   fprintf(makefile, "default:\t$(OBJECTS)\n\t\t$(CC) $(OBJECTS) $(CFLAGS) -o gp2run\n\n");
+                          "-O2 -Wall -Wextra");
+   if(!runtime_sources) fprintf(makefile, " -lgp2");
+   if(lto_build) fprintf(makefile, " -flto");
+   if(native_build) fprintf(makefile, " -march=native");
+   /* The shared library binds its own symbols, so that its copy of the runtime
+    * is separate from that of any other program loaded into the process. */
+   if(shared_library) fprintf(makefile, " -fPIC -shared -Wl,-Bsymbolic");
+   /* The runtime loads large host graphs, and parallel matchers search, on
+    * POSIX threads. */
+   fprintf(makefile, " -pthread");
+   if(pgo_build) fprintf(makefile, " $(PGO_FLAGS)");
+   fprintf(makefile, "\n\n");
+
+   /* The PGO build makes gp2run twice: instrumented, to run it once on the
+    * training host graph, and then optimised with the profile of that run. */
+   string target = pgo_build ? "gp2run" : "default";
+   if(pgo_build)
+   {
+      fprintf(makefile, "default:\n");
+      fprintf(makefile, "ifndef TRAIN\n\t\t$(error The PGO build needs a training "
+                        "host graph: make TRAIN=<host_file>)\nendif\n");
+      fprintf(makefile, "\t\trm -f gp2run $(OBJECTS) $(RUNTIME_OBJECTS) *.gcda\n");
+      fprintf(makefile, "\t\t$(MAKE) gp2run PGO_FLAGS=-fprofile-generate\n");
+      fprintf(makefile, "\t\t./gp2run -o gp2.training.output $(TRAIN) > /dev/null\n");
+      fprintf(makefile, "\t\trm -f gp2run $(OBJECTS) $(RUNTIME_OBJECTS) "
+                        "gp2.training.output\n");
+      fprintf(makefile, "\t\t$(MAKE) gp2run PGO_FLAGS=\"-fprofile-use "
+                        "-fprofile-correction\"\n\n");
+   }
+   if(unity_build)
+   {
+      fprintf(makefile, "%s:\tgp2run_unity.c\n\t\t$(CC) gp2run_unity.c $(CFLAGS) "
+                        "-o %s\n\n", target, binary);
+      fprintf(makefile, "gp2run_unity.c:\t$(SOURCES)\n\t\tprintf '#include \"%%s\"\\n' "
+                        "$(wildcard $(LIBSRCDIR)/*.c) $(SOURCES) > $@\n\n");
+   }
+   else if(runtime_sources)
+   {
+      fprintf(makefile, "%s:\t$(OBJECTS) $(RUNTIME_OBJECTS)\n\t\t$(CC) $(OBJECTS) "
+                        "$(RUNTIME_OBJECTS) $(CFLAGS) -o %s\n\n", target, binary);
+      fprintf(makefile, "gp2_%%.o:\t$(LIBSRCDIR)/%%.c\n\t\t$(CC) -c $(CFLAGS) -o $@ $<\n\n");
+   }
+   else fprintf(makefile, "%s:\t$(OBJECTS)\n\t\t$(CC) $(OBJECTS) $(CFLAGS) -o gp2run\n\n",
+                target);
    fprintf(makefile, "%%.o:\t\t%%.c\n\t\t$(CC) -c $(CFLAGS) -o $@ $<\n\n");
    fprintf(makefile, "clean:\t\n\t\trm *\n");
    fclose(makefile);
@@ -157,27 +249,91 @@ void printMakeFile(string output_dir, string install_dir)
 
    
 bool graph_copying = false;
+/* Set by the -s and -S flags to select cost-based searchplan generation. */
+bool costed_searchplans = false;
+/* Set by the -a flag to maintain an adjacency index in the host graph. */
+bool adjacency_index = false;
+/* Set by the -n flag to filter candidate nodes with the host graph's node columns. */
+bool node_columns = false;
+/* Set by the -i flag to resume each rule's search from its previous match. */
+bool resume_matching = false;
+/* Set by the -j flag to the number of threads searching for a rule match. */
+int match_threads = 1;
+/* Set by the -b flag to apply single-rule loops to sets of disjoint matches. */
+bool batch_loops = false;
+/* Set by the -P flag to generate a runtime that profiles each rule. */
+bool rule_profiling = false;
+/* Set by the -f flag to print each rule's searchplan as one matching function. */
+bool fused_matching = false;
+/* Set by the -F flag to match rule sets with one scan of the host nodes. */
+bool rule_set_scans = false;
+/* Set by the -R flag to start the search for a rule's first item at a random
+ * candidate. */
+bool sampled_matching = false;
+/* Set by the -L flag to bound each search for a match by the budgets given to
+ * gp2run. */
+bool match_budgets = false;
+/* Set by the -m flag to the number of modules the rules are generated into.
+ * 0 generates one module per rule. */
+int rule_modules = 0;
 
 int main(int argc, char **argv)
 {
    string const usage = "Usage:\n"
-                        "gp2 [-c] [-d] [-l <rootdir>] [-o <outdir>] <program_file>\n"
+                        "gp2 [-a] [-b] [-c] [-d] [-f] [-F] [-i] [-L] [-n] [-P] [-R] [-j <threads>]\n"
+                        "    [-m <modules>] [-s | -S <stats_file>] [-B <profiles>] [--shared]\n"
+                        "    [-l <rootdir>] [-o <outdir>] <program_file>\n"
                         "gp2 -p <program_file>\n"
                         "gp2 -r <rule_file>\n"
                         "gp2 -h <host_file>\n\n"
                         "Flags:\n"
+                        "-a - Match edges between matched nodes with an adjacency index.\n"
+                        "-B - Build gp2run with the comma-separated build profiles:\n"
+                        "     unity  - Compile the program and the runtime library sources\n"
+                        "              as one translation unit.\n"
+                        "     lto    - Compile and link with link-time optimisation.\n"
+                        "     native - Compile for the instruction set of the build machine.\n"
+                        "     pgo    - Build with profile-guided optimisation, trained by\n"
+                        "              one run on the host graph given to make by\n"
+                        "              TRAIN=<host_file>.\n"
+                        "-b - Apply the rule of each loop R! to all matches of a set of\n"
+                        "     pairwise disjoint matches before matching again.\n"
                         "-c - Enable graph copying.\n"
                         "-d - Compile program with GCC debugging flags.\n"
+                        "-f - Generate one matching function of nested loops per rule\n"
+                        "     instead of one function per searchplan operation.\n"
+                        "-F - Match each rule set with one scan of the host nodes, trying\n"
+                        "     the rules in the declared order at each node.\n"
+                        "-i - Resume the search for a rule's first item from the\n"
+                        "     position of its previous match.\n"
+                        "-j - Search for matches of rules with <threads> threads.\n"
+                        "-L - Fail a search for a match of a rule that exceeds its budget\n"
+                        "     of steps (gp2run -L) or milliseconds (gp2run -W). Not with\n"
+                        "     --shared.\n"
+                        "-m - Generate the code of the rules into <modules> C modules\n"
+                        "     instead of one module per rule.\n"
+                        "-n - Filter candidate nodes with column arrays of node marks,\n"
+                        "     degrees and matched flags.\n"
+                        "-P - Count the match attempts, candidates, changes and time of\n"
+                        "     each rule, written to gp2.profile.json when gp2run exits.\n"
+                        "-R - Start the search for a rule's first item at a random\n"
+                        "     candidate, so that the match is chosen at random instead\n"
+                        "     of by its position in the host graph.\n"
+                        "-s - Generate searchplans with the cost model.\n"
+                        "-S - Generate searchplans with the cost model, using the host\n"
+                        "     graph statistics in <stats_file> (written by gp2run -s).\n"
                         "-p - Validate a GP 2 program.\n"
                         "-r - Validate a GP 2 rule.\n"
                         "-h - Validate a GP 2 host graph.\n"
+                        "--shared - Build the program as the shared library gp2run.so\n"
+                        "     with the C interface of gp2.h instead of gp2run.\n"
                         "-l - Specify root directory of installed files.\n"
                         "-o - Specify directory for generated code and program output.\n";
 
    /* If true, only parsing and semantic analysis executed on the GP2 source files. */
    bool validate = false;
    string program_file = NULL, host_file = NULL, rule_file = NULL, 
-          install_dir = NULL, output_dir = NULL;
+          install_dir = NULL, output_dir = NULL, stats_file = NULL;
 
    if(argc < 2)
    {
@@ -226,6 +382,24 @@ int main(int argc, char **argv)
          if(parameter[0] != '-') break;
          switch(parameter[1])
          {
+            case 'a':
+                 adjacency_index = true;
+                 break;
+
+            case 'b':
+                 batch_loops = true;
+                 break;
+
+            case 'B':
+                 argv_index++;
+                 if(argv_index == argc)
+                 {
+                    print_to_console("%s", usage);
+                    return 0; 
+                 }
+                 if(!readBuildProfiles(argv[argv_index])) return 0;
+                 break;
+
             case 'c':
                  graph_copying = true;
                  break;
@@ -233,6 +407,69 @@ int main(int argc, char **argv)
             case 'd':
                  debug_flags = true;
                  break;
+
+            case 'f':
+                 fused_matching = true;
+                 break;
+
+            case 'F':
+                 rule_set_scans = true;
+                 break;
+
+            case 'i':
+                 resume_matching = true;
+                 break;
+
+            case 'j':
+                 argv_index++;
+                 if(argv_index == argc || atoi(argv[argv_index]) < 1)
+                 {
+                    print_to_console("%s", usage);
+                    return 0; 
+                 }
+                 match_threads = atoi(argv[argv_index]);
+                 break;
+
+            case 'm':
+                 argv_index++;
+                 if(argv_index == argc || atoi(argv[argv_index]) < 1)
+                 {
+                    print_to_console("%s", usage);
+                    return 0; 
+                 }
+                 rule_modules = atoi(argv[argv_index]);
+                 break;
+
+            case 'L':
+                 match_budgets = true;
+                 break;
+
+            case 'n':
+                 node_columns = true;
+                 break;
+
+            case 'P':
+                 rule_profiling = true;
+                 break;
+
+            case 'R':
+                 sampled_matching = true;
+                 break;
+
+            case 's':
+                 costed_searchplans = true;
+                 break;
+
+            case 'S':
+                 argv_index++;
+                 if(argv_index == argc)
+                 {
+                    print_to_console("%s", usage);
+                    return 0; 
+                 }
+                 costed_searchplans = true;
+                 stats_file = argv[argv_index];
+                 break;
             
             case 'l':
                  argv_index++;
@@ -254,11 +491,33 @@ int main(int argc, char **argv)
                  output_dir = argv[argv_index];
                  break;
 
+            case '-':
+                 if(strcmp(parameter, "--shared") == 0)
+                 {
+                    shared_library = true;
+                    break;
+                 }
+                 print_to_console("Error: invalid option \"%s\".\n", parameter);
+                 return 0;
+
             default:
                  print_to_console("Error: invalid option \"%s\".\n", parameter);
                  return 0;
          }
       }
+      /* The training run of the PGO build needs an executable. */
+      if(shared_library && pgo_build)
+      {
+         print_to_console("Error: the pgo build profile cannot build a shared library.\n");
+         return 0;
+      }
+      /* Budgets are set by the flags of gp2run and counted in process-wide
+       * variables, so the shared library has no use for them. */
+      if(shared_library && match_budgets)
+      {
+         print_to_console("Error: match budgets (-L) cannot be used with --shared.\n");
+         return 0;
+      }
       /* The remaining parameter is the program file. */
       if(argc - argv_index != 1)
       {
@@ -321,12 +580,29 @@ int main(int argc, char **argv)
          closeLogFile();
          return 0;
       }
+      else if(stats_file != NULL && !readHostStatistics(stats_file))
+      {
+         print_to_console("Error reading host graph statistics %s. Build aborted.\n",
+                          stats_file);   
+         if(yyin != NULL) fclose(yyin);
+         if(gp_program) freeAST(gp_program); 
+         closeLogFile();
+         return 0;
+      }
       else
       {
          print_to_console("Generating program code...\n");
+         startPhase(PROGRAM_PHASE);
+         pruneProgram(gp_program);
+         if(batch_loops) markBatchLoops(gp_program);
+         if(rule_set_scans) markRuleSetScans(gp_program);
+         endPhase(PROGRAM_PHASE);
          generateRules(gp_program, output_dir);
+         startPhase(MAIN_PHASE);
          generateRuntimeMain(gp_program, output_dir);
          printMakeFile(output_dir, install_dir);
+         endPhase(MAIN_PHASE);
+         logCompileTimes();
       }
    }
    if(yyin != NULL) fclose(yyin);
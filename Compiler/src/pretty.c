@@ -50,7 +50,7 @@ void printSymbolList(gpointer key, gpointer value, gpointer user_data)
 	if(symbol->rule_name == NULL)
         {
 	   print_to_symtab_file("Name: %s\nType: %d\nScope: %s\n",
-	                       (string)key, symbol->type, symbol->scope);
+	                       symbolKeyName(key), symbol->type, symbol->scope);
 	   if(symbol->is_var) print_to_symtab_file("Variable\n");
 	   if(symbol->in_lhs) print_to_symtab_file("In LHS\n");
            if(symbol->wildcard) print_to_symtab_file("Wildcard\n");
@@ -60,7 +60,7 @@ void printSymbolList(gpointer key, gpointer value, gpointer user_data)
 	else 
         {	
            print_to_symtab_file("Name: %s\nType: %d\nScope: %s\nContaining "
-                                "Rule: %s\n", (string)key, symbol->type, 
+                                "Rule: %s\n", symbolKeyName(key), symbol->type, 
                                 symbol->scope, symbol->rule_name);
        	   if(symbol->is_var) print_to_symtab_file("Variable\n");
 	   if(symbol->in_lhs) print_to_symtab_file("In LHS\n");
@@ -159,6 +159,8 @@ Predicate *makeTypeCheck(int bool_id, bool negated, ConditionType type, int vari
    }
    predicate->bool_id = bool_id;
    predicate->negated = negated;
+   predicate->stage = 0;
+   predicate->hoisted = false;
    predicate->type = type;
    predicate->variable_id = variable_id;
    return predicate;
@@ -174,6 +176,8 @@ Predicate *makeEdgePred(int bool_id, bool negated, int source, int target, RuleL
    }
    predicate->bool_id = bool_id;
    predicate->negated = negated;
+   predicate->stage = 0;
+   predicate->hoisted = false;
    predicate->type = EDGE_PRED;
    predicate->edge_pred.source = source;
    predicate->edge_pred.target = target;
@@ -192,6 +196,8 @@ Predicate *makeListComp(int bool_id, bool negated, ConditionType type,
    }
    predicate->bool_id = bool_id;
    predicate->negated = negated;
+   predicate->stage = 0;
+   predicate->hoisted = false;
    predicate->type = type;
    predicate->list_comp.left_label = left_label;
    predicate->list_comp.right_label = right_label;
@@ -209,6 +215,8 @@ Predicate *makeAtomComp(int bool_id, bool negated, ConditionType type,
    }
    predicate->bool_id = bool_id;
    predicate->negated = negated;
+   predicate->stage = 0;
+   predicate->hoisted = false;
    predicate->type = type;
    predicate->atom_comp.left_atom = left_atom;
    predicate->atom_comp.right_atom = right_atom;
@@ -310,6 +318,42 @@ bool isPredicate(Rule *rule)
    return true;
 }
 
+static bool equalRuleLabels(RuleLabel first, RuleLabel second)
+{
+   return first.mark == second.mark && equalRuleLists(first, second);
+}
+
+bool subsumesRule(Rule *first, Rule *second)
+{
+   if(first->condition != NULL) return false;
+   if(first->lhs == NULL) return true;
+   if(second->lhs == NULL) return false;
+   if(first->lhs->node_index != second->lhs->node_index ||
+      first->lhs->edge_index != second->lhs->edge_index) return false;
+   if(first->variables != second->variables) return false;
+   int index;
+   for(index = 0; index < first->variables; index++)
+      if(first->variable_list[index].type != second->variable_list[index].type) return false;
+   for(index = 0; index < first->lhs->node_index; index++)
+   {
+      RuleNode *first_node = getRuleNode(first->lhs, index);
+      RuleNode *second_node = getRuleNode(second->lhs, index);
+      if(first_node->root != second_node->root) return false;
+      if(!equalRuleLabels(first_node->label, second_node->label)) return false;
+      if(first_node->interface == NULL && second_node->interface != NULL) return false;
+   }
+   for(index = 0; index < first->lhs->edge_index; index++)
+   {
+      RuleEdge *first_edge = getRuleEdge(first->lhs, index);
+      RuleEdge *second_edge = getRuleEdge(second->lhs, index);
+      if(first_edge->bidirectional != second_edge->bidirectional) return false;
+      if(first_edge->source->index != second_edge->source->index ||
+         first_edge->target->index != second_edge->target->index) return false;
+      if(!equalRuleLabels(first_edge->label, second_edge->label)) return false;
+   }
+   return true;
+}
+
 Variable *getVariable(Rule *rule, string name)
 {
    int index;
@@ -440,6 +484,58 @@ bool hasListVariable(RuleLabel label)
    return false;
 }
 
+/* Returns the label class of a fixed list of the given length. The class of
+ * lists of length 1 depends on the type of the atom and is handled by the caller. */
+static int getLengthClass(int length)
+{
+   if(length == 0) return 0;
+   else if(length <= 4) return length + 1;
+   else return 6;
+}
+
+/* The host labels that can match a rule label lie in a contiguous range of
+ * label classes. If the rule label contains a list variable, a host label
+ * matches only if it contains at least as many atoms as the rest of the
+ * rule list. Otherwise the host list must have exactly the same length as the
+ * rule list and, for lists of length 1, an atom of a compatible type. */
+void getLabelClassRange(RuleLabel label, int *first, int *last)
+{
+   if(hasListVariable(label))
+   {
+      *first = label.length == 2 ? 1 : getLengthClass(label.length - 1);
+      *last = 6;
+      return;
+   }
+   if(label.length != 1)
+   {
+      *first = *last = getLengthClass(label.length);
+      return;
+   }
+   RuleAtom *atom = label.list->first->atom;
+   if(atom->type == STRING_CONSTANT || atom->type == CONCAT) *first = *last = 2;
+   else if(atom->type == VARIABLE)
+   {
+      switch(atom->variable.type)
+      {
+         case INTEGER_VAR:
+              *first = *last = 1;
+              break;
+
+         case CHARACTER_VAR:
+         case STRING_VAR:
+              *first = *last = 2;
+              break;
+
+         default:
+              *first = 1;
+              *last = 2;
+              break;
+      }
+   }
+   /* All other atoms are integer expressions. */
+   else *first = *last = 1;
+}
+
 static void printOperation(RuleAtom *left_exp, RuleAtom *right_exp, 
                            string const operation, bool nested, FILE *file);
 
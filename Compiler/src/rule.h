@@ -181,6 +181,12 @@ typedef struct Condition {
 typedef struct Predicate {
    int bool_id;
    bool negated;
+   /* Set by prepareCondition in genCondition.h. stage is the position in the
+    * searchplan of the operation after which all of the predicate's nodes and
+    * variables are matched. A hoisted predicate is tested on the candidates of
+    * its only node instead of in the condition. */
+   int stage;
+   bool hoisted;
    ConditionType type;
    union {
       int variable_id; /* Subtype predicates. */
@@ -244,6 +250,14 @@ void addVariablePredicate(Variable *variable, Predicate *predicate, int size);
  * deletes nor relabels any items. */
 bool isPredicate(Rule *rule);
 
+/* Returns true if first matches wherever second matches: first has no condition,
+ * and either first's LHS is empty or both LHSs are the same graph with their
+ * items in the same order, the same labels over variables of the same types,
+ * and every node that first deletes deleted by second too, so that first's
+ * dangling condition holds wherever second's does. A rule set tries its rules
+ * in order, so a rule after one that subsumes it is never applied. */
+bool subsumesRule(Rule *first, Rule *second);
+
 Variable *getVariable(Rule *rule, string name);
 int getVariableId(Rule *rule, string name);
 RuleNode *getRuleNode(RuleGraph *graph, int index);
@@ -257,6 +271,11 @@ RuleList *appendRuleAtom(RuleList *list, RuleAtom *atom);
 bool equalRuleLists(RuleLabel left_label, RuleLabel right_label);
 /* Used to determine the appropriate function call to generate label matching code. */
 bool hasListVariable(RuleLabel label);
+/* Host labels are partitioned into label classes by the runtime library (see
+ * LabelClass in lib/label.h). Computes the range [first, last] of the values
+ * of the runtime enumerated type that contains the classes of all host labels
+ * that can match the rule label. */
+void getLabelClassRange(RuleLabel label, int *first, int *last);
 
 void printRule(Rule *rule, FILE *file);
 void freeRule(Rule *rule);
@@ -30,6 +30,7 @@ static Searchplan *makeSearchplan(void)
    }   
    plan->first = NULL;
    plan->last = NULL;
+   plan->cost = -1;
    return plan;
 }
 
@@ -158,6 +159,360 @@ static void traverseEdge(Searchplan *searchplan, RuleEdge *edge, char type,
    }
 }
 
+/* The number of marks and label classes in host graphs. See lib/graph.h. */
+#define HOST_MARKS 6
+#define HOST_CLASSES 7
+
+/* Estimates used in the absence of a statistics file. The default fractions
+ * are the proportion of host items expected to carry a given kind of mark and
+ * to have a label in a single label class. */
+#define DEFAULT_NODES 1000.0
+#define DEFAULT_EDGES 2000.0
+#define DEFAULT_ROOTS 1.0
+#define UNMARKED_FRACTION 0.6
+#define MARKED_FRACTION 0.1
+#define ANY_MARK_FRACTION 0.4
+#define CLASS_FRACTION 0.5
+/* The proportion of host items matching a constant atom in a rule label. */
+#define CONSTANT_ATOM_FRACTION 0.2
+
+typedef struct HostStatistics {
+   bool available;
+   double nodes, edges, roots;
+   double node_counts[HOST_MARKS][HOST_CLASSES];
+   double edge_counts[HOST_MARKS][HOST_CLASSES];
+} HostStatistics;
+
+static HostStatistics host_statistics = {false, 0, 0, 0, {{0}}, {{0}}};
+
+bool readHostStatistics(string stats_file)
+{
+   FILE *stats = fopen(stats_file, "r");
+   if(stats == NULL)
+   {
+      perror(stats_file);
+      return false;
+   }
+   char line[256];
+   while(fgets(line, sizeof(line), stats) != NULL)
+   {
+      char item[16];
+      int mark, label_class;
+      double count;
+      if(line[0] == '#') continue;
+      if(sscanf(line, "%15s %d %d %lf", item, &mark, &label_class, &count) == 4)
+      {
+         if(mark < 0 || mark >= HOST_MARKS || label_class < 0 || 
+            label_class >= HOST_CLASSES) continue;
+         if(strcmp(item, "node") == 0) 
+            host_statistics.node_counts[mark][label_class] = count;
+         else if(strcmp(item, "edge") == 0)
+            host_statistics.edge_counts[mark][label_class] = count;
+      }
+      else if(sscanf(line, "%15s %lf", item, &count) == 2)
+      {
+         if(strcmp(item, "nodes") == 0) host_statistics.nodes = count;
+         else if(strcmp(item, "edges") == 0) host_statistics.edges = count;
+         else if(strcmp(item, "roots") == 0) host_statistics.roots = count;
+      }
+   }
+   fclose(stats);
+   host_statistics.available = true;
+   return true;
+}
+
+static double hostNodes(void)
+{
+   if(!host_statistics.available) return DEFAULT_NODES;
+   return host_statistics.nodes > 1 ? host_statistics.nodes : 1;
+}
+
+static double hostEdges(void)
+{
+   return host_statistics.available ? host_statistics.edges : DEFAULT_EDGES;
+}
+
+static double hostRoots(void)
+{
+   return host_statistics.available ? host_statistics.roots : DEFAULT_ROOTS;
+}
+
+/* The expected fraction of host nodes (edges) in the label class tables that
+ * are scanned for items matching the rule label. */
+static double classFraction(RuleLabel label, bool node)
+{
+   int first_class, last_class, mark, label_class;
+   getLabelClassRange(label, &first_class, &last_class);
+   if(host_statistics.available)
+   {
+      double total = node ? host_statistics.nodes : host_statistics.edges;
+      if(total <= 0) return 1;
+      double count = 0;
+      for(mark = 0; mark < HOST_MARKS; mark++)
+      {
+         if(label.mark == ANY && mark == NONE) continue;
+         if(label.mark != ANY && mark != (int)label.mark) continue;
+         for(label_class = first_class; label_class <= last_class; label_class++)
+            count += node ? host_statistics.node_counts[mark][label_class]
+                          : host_statistics.edge_counts[mark][label_class];
+      }
+      return count / total;
+   }
+   double fraction;
+   if(label.mark == NONE) fraction = UNMARKED_FRACTION;
+   else if(label.mark == ANY) fraction = ANY_MARK_FRACTION;
+   else fraction = MARKED_FRACTION;
+   if(first_class != 0 || last_class != HOST_CLASSES - 1) fraction *= CLASS_FRACTION;
+   return fraction;
+}
+
+/* The fraction of the scanned items that pass the checks of the constant
+ * atoms in the rule label. */
+static double constantFraction(RuleLabel label)
+{
+   double fraction = 1;
+   if(label.list == NULL) return fraction;
+   RuleListItem *item = label.list->first;
+   for(; item != NULL; item = item->next)
+   {
+      if(item->atom->type == INTEGER_CONSTANT || item->atom->type == STRING_CONSTANT)
+         fraction *= CONSTANT_ATOM_FRACTION;
+   }
+   return fraction;
+}
+
+/* The fraction of the scanned host nodes that pass the degree check. Host nodes
+ * whose degree is at most the average degree are assumed to pass. Nodes deleted
+ * by the rule must match the degree exactly. */
+static double degreeFraction(RuleNode *node)
+{
+   double degree = node->indegree + node->outdegree + node->bidegree;
+   double average = 2 * hostEdges() / hostNodes();
+   double fraction = (degree > average) ? average / degree : 1;
+   if(node->interface == NULL) fraction *= 0.5;
+   return fraction;
+}
+
+/* Computes the number of host items scanned by the searchplan operation and
+ * the number of those expected to be matched, given the LHS nodes matched
+ * by the preceding operations. */
+static void estimateOperation(RuleGraph *lhs, char type, int index, bool *bound_nodes,
+                              double *scanned, double *matched)
+{
+   double average_degree = hostEdges() / hostNodes();
+   RuleNode *node = NULL;
+   RuleEdge *edge = NULL;
+   if(type == 'e' || type == 's' || type == 't' || type == 'l') 
+      edge = getRuleEdge(lhs, index);
+   else node = getRuleNode(lhs, index);
+
+   switch(type)
+   {
+      case 'r':
+           *scanned = hostRoots();
+           *matched = *scanned * classFraction(node->label, true) *
+                      constantFraction(node->label) * degreeFraction(node);
+           break;
+
+      case 'n':
+           *scanned = hostNodes() * classFraction(node->label, true);
+           *matched = *scanned * constantFraction(node->label) * degreeFraction(node);
+           break;
+
+      case 'i':
+      case 'o':
+      case 'b':
+           *scanned = type == 'b' ? 2 : 1;
+           *matched = classFraction(node->label, true) * 
+                      constantFraction(node->label) * degreeFraction(node);
+           break;
+
+      case 'e':
+           *scanned = hostEdges() * classFraction(edge->label, false);
+           *matched = *scanned * constantFraction(edge->label);
+           break;
+
+      case 's':
+      case 't':
+      case 'l':
+      {
+           *scanned = edge->bidirectional ? 2 * average_degree : average_degree;
+           *matched = *scanned * classFraction(edge->label, false) *
+                      constantFraction(edge->label);
+           /* If the other end of the edge is already matched, only host edges
+            * incident to the image of that node match. */
+           RuleNode *end = type == 's' ? edge->target : edge->source;
+           if(type == 'l' || bound_nodes[end->index]) *matched /= hostNodes();
+           break;
+      }
+      default:
+           print_to_log("Error (estimateOperation): Unexpected operation type %c.\n",
+                        type);
+           *scanned = *matched = 1;
+           break;
+   }
+}
+
+static double searchplanCost(RuleGraph *lhs, Searchplan *plan)
+{
+   bool bound_nodes[lhs->node_index]; 
+   int index;
+   for(index = 0; index < lhs->node_index; index++) bound_nodes[index] = false;
+   double cost = 0, partial_matches = 1, scanned, matched;
+   SearchOp *operation;
+   for(operation = plan->first; operation != NULL; operation = operation->next)
+   {
+      estimateOperation(lhs, operation->type, operation->index, bound_nodes,
+                        &scanned, &matched);
+      cost += partial_matches * scanned;
+      partial_matches *= matched;
+      if(operation->is_node) bound_nodes[operation->index] = true;
+   }
+   return cost;
+}
+
+/* Appends the operations to match an LHS node or edge from scratch. An edge
+ * is followed by the operations to match its target and source from the host
+ * edge. */
+static void appendStartOperation(Searchplan *plan, RuleGraph *lhs, char type, int index,
+                                 bool *bound_nodes, bool *bound_edges)
+{
+   if(type == 'e')
+   {
+      RuleEdge *edge = getRuleEdge(lhs, index);
+      appendSearchOp(plan, 'e', index);
+      appendSearchOp(plan, 'i', edge->target->index);
+      appendSearchOp(plan, 'o', edge->source->index);
+      bound_edges[index] = true;
+      bound_nodes[edge->target->index] = true;
+      bound_nodes[edge->source->index] = true;
+   }
+   else
+   {
+      appendSearchOp(plan, type, index);
+      bound_nodes[index] = true;
+   }
+}
+
+static Searchplan *greedySearchplan(RuleGraph *lhs, char first_type, int first_index)
+{
+   Searchplan *plan = makeSearchplan();
+   bool bound_nodes[lhs->node_index]; 
+   bool bound_edges[lhs->edge_index];  
+   int index, unbound;
+   for(index = 0; index < lhs->node_index; index++) bound_nodes[index] = false;
+   for(index = 0; index < lhs->edge_index; index++) bound_edges[index] = false;
+   appendStartOperation(plan, lhs, first_type, first_index, bound_nodes, bound_edges);
+
+   while(true)
+   {
+      unbound = 0;
+      for(index = 0; index < lhs->node_index; index++) if(!bound_nodes[index]) unbound++;
+      for(index = 0; index < lhs->edge_index; index++) if(!bound_edges[index]) unbound++;
+      if(unbound == 0) break;
+
+      /* Choose the unmatched edge incident to a matched node with the fewest
+       * expected matches, including the matches of its other end. */
+      int best_edge = -1;
+      char best_type = 0;
+      double best_matched = 0, scanned, matched;
+      for(index = 0; index < lhs->edge_index; index++)
+      {
+         if(bound_edges[index]) continue;
+         RuleEdge *edge = getRuleEdge(lhs, index);
+         bool source_bound = bound_nodes[edge->source->index];
+         bool target_bound = bound_nodes[edge->target->index];
+         if(!source_bound && !target_bound) continue;
+         char type;
+         RuleNode *end;
+         if(edge->source == edge->target) type = 'l';
+         else type = source_bound ? 's' : 't';
+         end = type == 't' ? edge->source : edge->target;
+         estimateOperation(lhs, type, index, bound_nodes, &scanned, &matched);
+         if(type != 'l' && !bound_nodes[end->index])
+         {
+            double node_matched;
+            char node_type = type == 's' ? 'i' : 'o';
+            estimateOperation(lhs, node_type, end->index, bound_nodes, &scanned,
+                              &node_matched);
+            matched *= node_matched;
+         }
+         if(best_edge < 0 || matched < best_matched)
+         {
+            best_edge = index;
+            best_type = type;
+            best_matched = matched;
+         }
+      }
+      if(best_edge >= 0)
+      {
+         RuleEdge *edge = getRuleEdge(lhs, best_edge);
+         appendSearchOp(plan, best_type, best_edge);
+         bound_edges[best_edge] = true;
+         if(best_type == 'l') continue;
+         RuleNode *end = best_type == 's' ? edge->target : edge->source;
+         if(!bound_nodes[end->index])
+         {
+            if(edge->bidirectional) appendSearchOp(plan, 'b', end->index);
+            else appendSearchOp(plan, best_type == 's' ? 'i' : 'o', end->index);
+            bound_nodes[end->index] = true;
+         }
+         continue;
+      }
+      /* No unmatched edge is incident to a matched node: start a new connected
+       * component from the unmatched node that scans the fewest host nodes. */
+      int best_node = -1;
+      char best_node_type = 'n';
+      double best_scanned = 0;
+      for(index = 0; index < lhs->node_index; index++)
+      {
+         if(bound_nodes[index]) continue;
+         RuleNode *node = getRuleNode(lhs, index);
+         char type = node->root ? 'r' : 'n';
+         estimateOperation(lhs, type, index, bound_nodes, &scanned, &matched);
+         if(best_node < 0 || scanned < best_scanned)
+         {
+            best_node = index;
+            best_node_type = type;
+            best_scanned = scanned;
+         }
+      }
+      assert(best_node >= 0);
+      appendStartOperation(plan, lhs, best_node_type, best_node, bound_nodes, bound_edges);
+   }
+   plan->cost = searchplanCost(lhs, plan);
+   return plan;
+}
+
+Searchplan *generateCostedSearchplan(RuleGraph *lhs)
+{
+   Searchplan *best = generateSearchplan(lhs);
+   best->cost = searchplanCost(lhs, best);
+   int index;
+   for(index = 0; index < lhs->node_index + lhs->edge_index; index++)
+   {
+      Searchplan *plan = NULL;
+      if(index < lhs->node_index)
+      {
+         RuleNode *node = getRuleNode(lhs, index);
+         plan = greedySearchplan(lhs, node->root ? 'r' : 'n', index);
+      }
+      else
+      {
+         RuleEdge *edge = getRuleEdge(lhs, index - lhs->node_index);
+         if(edge->source == edge->target || edge->bidirectional) continue;
+         plan = greedySearchplan(lhs, 'e', edge->index);
+      }
+      if(plan->cost < best->cost)
+      {
+         freeSearchplan(best);
+         best = plan;
+      }
+      else freeSearchplan(plan);
+   }
+   return best;
+}
+
 void printSearchplan(Searchplan *plan)
 { 
    if(plan->first == NULL) printf("Empty searchplan.\n");
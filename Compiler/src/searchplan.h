@@ -56,10 +56,13 @@ typedef struct SearchOp {
 } SearchOp;
 
 /* Operations are appended to the searchplan, so a pointer to the last
- * searchplan operation is maintained for efficiency. */
+ * searchplan operation is maintained for efficiency. The cost is the estimate
+ * computed by the cost model below, or -1 if the searchplan was generated
+ * without it. */
 typedef struct Searchplan {
    SearchOp *first;
    SearchOp *last;
+   double cost;
 } Searchplan;
 
 /* generateSearchplan traverses a graph in order to create a searchplan
@@ -80,6 +83,30 @@ typedef struct Searchplan {
 
 Searchplan *generateSearchplan(RuleGraph *lhs);
 
+/* Cost-based searchplan generation, enabled by the compiler's -s and -S flags.
+ * The cost of a searchplan is an estimate of the number of host items examined
+ * by the generated matching code. Each operation is assigned the number of
+ * host items it scans and the expected number of those that survive the mark,
+ * label class, constant atom and degree checks. The cost of the searchplan is
+ * the sum over all operations of the product of the survivors of the previous
+ * operations and the number of items scanned by the operation.
+ *
+ * The estimates are drawn from a host graph statistics file if one has been
+ * read with readHostStatistics, and from built-in defaults otherwise.
+ *
+ * generateCostedSearchplan builds one plan for each possible first operation:
+ * each LHS node and each non-loop, non-bidirectional LHS edge. The rest of the
+ * plan is built greedily, at each step choosing the edge incident to a matched
+ * node that is expected to leave the fewest partial matches. The cheapest of
+ * these plans and the depth-first plan of generateSearchplan is returned. */
+Searchplan *generateCostedSearchplan(RuleGraph *lhs);
+
+/* Reads a statistics file written by a GP 2 runtime executable invoked with 
+ * the -s flag. The file contains the number of nodes, edges and root nodes of
+ * the host graph, followed by the number of nodes and edges in each label class
+ * table of the host graph. Returns false if the file cannot be read. */
+bool readHostStatistics(string stats_file);
+
 void printSearchplan(Searchplan *searchplan);
 void freeSearchplan(Searchplan *searchplan);
 #endif /* INC_SEARCHPLAN_H */
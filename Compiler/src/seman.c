@@ -87,16 +87,16 @@ bool declarationScan(List *ast, string scope)
               ast->declaration->rule->name = rule_name;
               free(old_rule_name);
  
-              symbol_list = g_hash_table_lookup(symbol_table, rule_name);      
+              symbol_list = lookupSymbols(symbol_table, scope, NULL, rule_name);      
 	      SymbolList *iterator = symbol_list;
               bool add_rule = true;	      
 
               /* Report an error if two rules with the same name are declared
                * in the same scope. iterator points to the start of the symbol
-               * list whose key is rule_name. */
+               * list of rule_name in the scope. */
               while(iterator != NULL)   
               {
-                 if(iterator->type == RULE_S && !strcmp(iterator->scope, scope))
+                 if(iterator->type == RULE_S)
 		 {
                     if(!strcmp(scope, "Main")) 
                          print_error("Error: Rule %s declared twice in " 
@@ -114,11 +114,7 @@ bool declarationScan(List *ast, string scope)
               {
 	         symbol_list = addSymbol(symbol_list, RULE_S, scope, NULL, false,
                                          false, false, false); 
-                 /* If rule_name is not copied here, it would be freed twice: 
-                  * once when the rule is freed, and again when the hash table
-                  * keys are freed. */
-                 string rule_name_copy = strdup(rule_name);
-                 g_hash_table_replace(symbol_table, rule_name_copy, symbol_list);  
+                 enterSymbols(symbol_table, scope, NULL, rule_name, symbol_list);  
 	      }
               break;
          }
@@ -510,8 +506,8 @@ int enterVariables(SymbolType type, List *variables, string scope, string rule_n
    while(variables != NULL) 
    {
       variable_count++;
-      string variable_name = strdup(variables->variable_name);	   
-      SymbolList *symbol_list = g_hash_table_lookup(symbol_table, variable_name);
+      string variable_name = variables->variable_name;	   
+      SymbolList *symbol_list = lookupSymbols(symbol_table, scope, rule_name, variable_name);
       SymbolList *iterator = symbol_list;
 
       bool add_variable = true;
@@ -519,7 +515,7 @@ int enterVariables(SymbolType type, List *variables, string scope, string rule_n
       {
 	 /* Print an error if there already exists a variable in the same rule
 	  * and scope with the same name. */
-         if(iterator->is_var && symbolInScope(iterator, scope, rule_name))
+         if(iterator->is_var)
 	 {	 
 	    print_error("Warning (%s): Variable %s declared twice.\n", 
                         rule_name, variable_name);
@@ -532,11 +528,8 @@ int enterVariables(SymbolType type, List *variables, string scope, string rule_n
       {
          symbol_list = addSymbol(symbol_list, type, scope, rule_name, true,
                                  false, false, false);
-         g_hash_table_replace(symbol_table, variable_name, symbol_list);
+         enterSymbols(symbol_table, scope, rule_name, variable_name, symbol_list);
      }
-     /* The malloc'd string variable_name is not used as a key to the symbol
-      * table in the else case. It needs to be freed before the loop breaks. */
-     else free(variable_name);
      /* Move to the next variable in the declaration list. */
      variables = variables->next;
    }
@@ -571,11 +564,8 @@ void graphScan(GPRule *rule, List *interface, string scope, string rule_name, ch
    while(node_list)  
    {
       if(side == 'l') rule->left_nodes++;
-      /* node_id is used as a key, so it is duplicated as node_id will be freed
-       * by g_hash_table_insert. I do not want to also free the node->name in
-       * the AST. */
-      string node_id = strdup(node_list->node->name);
-      symbol_list = g_hash_table_lookup(symbol_table, node_id);
+      string node_id = node_list->node->name;
+      symbol_list = lookupSymbols(symbol_table, scope, rule_name, node_id);
       SymbolList *symbol = symbol_list;
 
       bool add_node = true;
@@ -583,7 +573,7 @@ void graphScan(GPRule *rule, List *interface, string scope, string rule_name, ch
       {
 	 /* Print an error if there already exists a node in the same graph, 
 	  * rule and scope with the same name. */
-         if(symbol->type == node_type && symbolInScope(symbol, scope, rule_name))
+         if(symbol->type == node_type)
 	 {
 	     print_to_log("Warning (%s): Node ID %s not unique in the "
                           "%s.\n", rule_name, node_id, graph_type);  
@@ -603,7 +593,7 @@ void graphScan(GPRule *rule, List *interface, string scope, string rule_name, ch
       { 
          symbol_list = addSymbol(symbol_list, node_type, scope, rule_name,
                                  false, false, wildcard, false);
-         g_hash_table_replace(symbol_table, node_id, symbol_list);         
+         enterSymbols(symbol_table, scope, rule_name, node_id, symbol_list);         
       }      
       /* Check that RHS wildcard nodes exist in the interface and that they
        * have a corresponding LHS wildcard. */
@@ -626,32 +616,18 @@ void graphScan(GPRule *rule, List *interface, string scope, string rule_name, ch
                         "interface.\n", rule_name, node_id, graph_type);
             abort_compilation = true;  
          }
-         else
+         /* The first symbol of the list is the node of the same rule. If
+          * that node is in the LHS and is not a wildcard then report an error. */
+         else if(symbol_list != NULL && symbol_list->type == LEFT_NODE_S &&
+                 !(symbol_list->wildcard))
          {
-            symbol = symbol_list;
-            while(symbol != NULL) 
-            {
-               /* Find a node in the same rule. If that node is in the LHS
-                * and is not a wildcard then report an error. */
-               if(symbolInScope(symbol, scope, rule_name))	
-               {
-                  if(symbol->type == LEFT_NODE_S && !(symbol->wildcard)) 
-                  {
-                     print_to_log("Error (%s): RHS wildcard node %s has no "
-                                  "matching LHS wildcard.", rule_name, node_id);  
-                     abort_compilation = true; 
-                  }
-                  /* Regardless of the outcome of the inner if statement, exit
-                   * the loop as the single appropriate node has been located. */
-                  break;
-               }
-               symbol = symbol->next;
-            }
+            print_to_log("Error (%s): RHS wildcard node %s has no "
+                         "matching LHS wildcard.", rule_name, node_id);  
+            abort_compilation = true; 
          }
       }
       gpListScan(&(node_list->node->label->gp_list), interface, scope, rule_name, side);
       node_list = node_list->next;   
-      if(!add_node && node_id) free(node_id);  
    }   
 
    /* Reverse the edge list */
@@ -661,20 +637,17 @@ void graphScan(GPRule *rule, List *interface, string scope, string rule_name, ch
    while(edge_list)
    {
       if(side == 'l') rule->left_edges++;
-      /* edge_id is used as a key, so it is duplicated as edge_id will be freed
-       * by g_hash_table_insert. I do not also want to free the edge->name in
-       * the AST. */
-      string edge_id = strdup(edge_list->edge->name);
+      string edge_id = edge_list->edge->name;
       string source_id = edge_list->edge->source;
       string target_id = edge_list->edge->target;
 
-      symbol_list = g_hash_table_lookup(symbol_table, edge_id);
+      symbol_list = lookupSymbols(symbol_table, scope, rule_name, edge_id);
       SymbolList *symbol = symbol_list;
       while(symbol != NULL) 
       {
 	 /* Print an error if there already exists an edge in the same graph,
 	  * rule and scope with the same name. */
-         if(symbol->type == edge_type && symbolInScope(symbol, scope, rule_name))
+         if(symbol->type == edge_type)
          {
 	     print_to_log("Warning (%s): Edge ID %s not unique in the %s "
                           "graph.\n", rule_name, edge_id, graph_type);
@@ -689,33 +662,20 @@ void graphScan(GPRule *rule, List *interface, string scope, string rule_name, ch
       {
          symbol_list = addSymbol(symbol_list, edge_type, scope, rule_name, 
                                  false, false, wildcard, bidirectional);
-         g_hash_table_replace(symbol_table, edge_id, symbol_list);
+         enterSymbols(symbol_table, scope, rule_name, edge_id, symbol_list);
       }
       /* Check that RHS wildcard edges exist in the interface and that they
        * have a corresponding LHS wildcard.
        * TODO: No interface checking yet. This would allow multiple RHS wildcard
        * edges and fewer LHS wildcard edges. I think. */
-      if(wildcard && side == 'r')
+      /* The first symbol of the list is the edge of the same rule. If that
+       * edge is in the LHS and is not a wildcard then report an error. */
+      if(wildcard && side == 'r' && symbol_list != NULL &&
+         symbol_list->type == LEFT_EDGE_S && !(symbol_list->wildcard))
       {
-         symbol = symbol_list;
-         while(symbol) 
-         {
-            /* Find an edge in the same rule. If that edge is in the LHS
-             * and is not a wildcard then report an error. */
-            if(symbolInScope(symbol, scope, rule_name))	
-            {
-               if(symbol->type == LEFT_EDGE_S && !(symbol->wildcard)) 
-               {
-                  print_to_log("Error (%s): RHS wildcard edge %s has no "
-                               "matching LHS wildcard.", rule_name, edge_id);  
-                  abort_compilation = true; 
-               }
-               /* Regardless of the outcome of the inner if statement, exit
-                  * the loop as the single appropriate node has been located. */
-               break;
-            }
-            symbol = symbol->next;
-         }
+         print_to_log("Error (%s): RHS wildcard edge %s has no "
+                      "matching LHS wildcard.", rule_name, edge_id);  
+         abort_compilation = true; 
       }
       /* Two semantic checks are made for bidirectional edges (BEs):
        * (1) A BE in the RHS must have a corresponding BE in the LHS.
@@ -776,7 +736,9 @@ void graphScan(GPRule *rule, List *interface, string scope, string rule_name, ch
                                             side, source_id, target_id);
       }
       /* Verify source node exists in the graph. */
-      symbol_list = g_hash_table_lookup(symbol_table, source_id);
+      symbol_list = lookupSymbols(symbol_table, scope, rule_name, source_id);
+      while(symbol_list != NULL && symbol_list->type != node_type)
+         symbol_list = symbol_list->next;
       if(symbol_list == NULL) 
       {
 	 print_to_log("Error (%s): Source node %s of edge %s does not "
@@ -784,64 +746,20 @@ void graphScan(GPRule *rule, List *interface, string scope, string rule_name, ch
                       graph_type);     
          abort_compilation = true; 
       }
-      else
-      {
-         /* The while loop condition is true if the current symbol is not
-          * the node in the same rule and graph as the current edge.
-          * Hence the loop breaks if the appropriate node is found.
-          * At each pass a check is made to see if the end of the list
-          * has been reached. If not, check the next symbol in the symbol
-          * list. Otherwise, print an error and break. */
-         while(symbol_list->type != node_type    ||
-               strcmp(symbol_list->scope, scope)  ||
-               strcmp(symbol_list->rule_name, rule_name))
-         {   
-            if(symbol_list->next == NULL) 
-            {
-               print_to_log("Error (%s): Source node %s of edge %s does "
-                            "not exist in %s graph.\n", 
-                            rule_name, source_id, edge_id, graph_type);     
-               abort_compilation = true; 
-               break;
-            }
-            else symbol_list = symbol_list->next;             
-         } 
-      }
+
       /* Verify target node exists in the graph. */
-      symbol_list = g_hash_table_lookup(symbol_table, target_id);    
-       if(symbol_list == NULL) 
+      symbol_list = lookupSymbols(symbol_table, scope, rule_name, target_id);
+      while(symbol_list != NULL && symbol_list->type != node_type)
+         symbol_list = symbol_list->next;
+      if(symbol_list == NULL) 
       {
 	 print_to_log("Error (%s): Target node %s of edge %s does not "
-                      "exist in %s graph.\n", 
-                      rule_name, target_id, edge_id, graph_type);     
+                      "exist in %s graph.\n", rule_name, target_id, edge_id, 
+                      graph_type);     
          abort_compilation = true; 
-      } 
-      else 
-      {
-         /* The while loop condition is true if the current symbol is not
-          * the node in the same rule and graph as the current edge.
-          * Hence the loop breaks if the appropriate node is found.
-          * At each pass a check is made to see if the end of the list
-          * has been reached. If not, check the next symbol in the symbol
-          * list. Otherwise, print an error and break. */               
-         while(symbol_list->type != node_type    ||
-               strcmp(symbol_list->scope, scope) ||
-               strcmp(symbol_list->rule_name, rule_name))
-         {
-            if(symbol_list->next == NULL) 
-            {
-               print_to_log("Error (%s): Target node %s of edge %s does "
-                            "not exist in %s graph.\n", 
-                            rule_name, target_id, edge_id, graph_type);   
-               abort_compilation = true; 
-               break;
-            }
-            else symbol_list = symbol_list->next;             
-         }
-      }	 
+      }
       gpListScan(&(edge_list->edge->label->gp_list), interface, scope, rule_name, side);
       edge_list = edge_list->next;
-      if(!add_edge && edge_id) free(edge_id);
    }
 }
 
@@ -859,14 +777,12 @@ void interfaceScan(List *interface, string scope, string rule_name)
        * checking for duplicate nodes easier. */
       interface_ids = g_slist_insert_sorted(interface_ids, interface->node_id,
                                             (GCompareFunc)strcmp);
-      SymbolList *node_symbol = g_hash_table_lookup(symbol_table, interface->node_id);     
+      SymbolList *node_symbol = lookupSymbols(symbol_table, scope, rule_name,
+                                              interface->node_id);     
       while(node_symbol) 
       {
-         if(symbolInScope(node_symbol, scope, rule_name))
-         {
-            if(node_symbol->type == LEFT_NODE_S) in_lhs = true;
-            if(node_symbol->type == RIGHT_NODE_S) in_rhs = true;
-         }
+         if(node_symbol->type == LEFT_NODE_S) in_lhs = true;
+         if(node_symbol->type == RIGHT_NODE_S) in_rhs = true;
          /* If both the LHS node and RHS node have been found, no need to look
           * further down the symbol list. */         
          if(in_lhs && in_rhs) break;
@@ -911,12 +827,13 @@ int conditionScan(GPCondition *condition, List *interface, string scope,
       {
            predicate_count++;
            bool in_rule = false; 
-           SymbolList *var_list = g_hash_table_lookup(symbol_table, condition->var);
-	   /* Go through the list of symbols with the name in question
-            * to check if any variables exist in this rule. */
+           SymbolList *var_list = lookupSymbols(symbol_table, scope, rule_name,
+                                                condition->var);
+	   /* Go through the symbols of the rule with the name in question
+            * to check if any of them is a variable. */
            while(var_list != NULL) 
            {
-              if(var_list->is_var && symbolInScope(var_list, scope, rule_name))
+              if(var_list->is_var)
               {
                   in_rule = true;
                   break;
@@ -1172,16 +1089,16 @@ void atomScan(GPAtom *atom, List *interface, string scope, string rule_name,
 void variableScan(GPAtom *atom, string scope, string rule_name, 
                   char location, bool int_exp, bool string_exp, bool length)
 {
-   /* var_list is pointed to the symbol_list of symbols with the same
-    * identifier as the variable. */
-   SymbolList *var_list = g_hash_table_lookup(symbol_table, atom->variable.name);      
+   /* var_list is pointed to the symbol_list of symbols of the rule with the
+    * same identifier as the variable. */
+   SymbolList *var_list = lookupSymbols(symbol_table, scope, rule_name,
+                                        atom->variable.name);      
    bool in_rule = false;
    while(var_list)
    {
-      /* Locate the variable with the appropriate scope and rule name. If it 
-       * exists, there is only one, as duplicates are not entered into the 
-       * symbol table. */
-      if(var_list->is_var && symbolInScope(var_list, scope, rule_name)) in_rule = true;
+      /* Locate the variable among the symbols. If it exists, there is only
+       * one, as duplicates are not entered into the symbol table. */
+      if(var_list->is_var) in_rule = true;
       else 
       {
          var_list = var_list->next;
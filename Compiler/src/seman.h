@@ -38,40 +38,37 @@
 #include <string.h> 
 
 /* GLib's hashtable data structure is used to implement GP2's symbol table.
- * GP2 identifiers are the keys. The values are lists of struct Symbols,
- * defined in the symbol module. 
+ * The keys are the triples (scope, rule, identifier), and the values are lists
+ * of struct Symbols, defined in the symbol module. Every check of a symbol
+ * therefore looks up the few symbols of its own rule instead of scanning the
+ * symbols of that identifier in every rule of the program.
  *
- * The following glib function calls are used extensively in the source file. 
+ * The following functions of the symbol module are used extensively in the
+ * source file. 
  *
- * ===============================================
- * GSList *list = g_hash_table_lookup(table, key);
- * ===============================================
+ * ======================================================================
+ * SymbolList *list = lookupSymbols(table, scope, rule_name, identifier);
+ * ======================================================================
  *
- * Creates a pointer to a GSList by calling g_hash_table_lookup. This function 
- * looks up a name in the symbol table and returns a pointer to the identifier
- * list if the name is already present, otherwise it returns NULL. 
- * Note that g_hash_table_lookup returns a void pointer.
+ * Returns the list of symbols with the identifier in the rule and scope, or
+ * NULL if there are none.
  *
- * =====================================
- * list = g_slist_prepend(list, symbol);     
- * =====================================    
+ * ===============================================================
+ * list = addSymbol(list, type, scope, rule_name, <symbol flags>);
+ * ===============================================================
  *
- * Adds the symbol given by the second argument to the start of the GSList
- * list. If list is NULL then a new list is created with the single element
- * symbol.
+ * Adds a new symbol to the start of the list.
  *
- * =======================================
- * g_hash_table_replace(table, key, list); 
- * =======================================
+ * ==============================================================
+ * enterSymbols(table, scope, rule_name, identifier, list); 
+ * ==============================================================
  *
- * Inserts the GSList list to the symbol table. If the key already exists 
- * then the old value for that key is freed with <value_destroy_func> and 
- * replaced with the new value. This means that only one symbol list will 
- * exist for a particular key.
+ * Inserts the list into the symbol table, replacing the previous list of the
+ * key.
  *
  * These three function calls are made in succession to ensure that the
- * symbol list for a particular identifier name always contains all the 
- * objects with that name.
+ * symbol list for a particular key always contains all the symbols with that
+ * identifier in the rule.
  */
 extern GHashTable *symbol_table; 
 
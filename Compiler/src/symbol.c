@@ -34,9 +34,43 @@ SymbolList *addSymbol(SymbolList *list, SymbolType type, string scope, string ru
    return symbol;
 }
 
-bool symbolInScope(SymbolList *symbol, string scope, string rule_name)
+/* A key is the scope, the rule name and the name, separated by a character
+ * that GP 2 identifiers do not contain. */
+#define KEY_SEPARATOR ':'
+
+static int symbolKeyLength(string scope, string rule_name, string name)
+{
+   return strlen(scope) + (rule_name == NULL ? 0 : strlen(rule_name)) + strlen(name) + 3;
+}
+
+static void writeSymbolKey(char *key, string scope, string rule_name, string name)
+{
+   sprintf(key, "%s%c%s%c%s", scope, KEY_SEPARATOR, rule_name == NULL ? "" : rule_name,
+           KEY_SEPARATOR, name);
+}
+
+SymbolList *lookupSymbols(GHashTable *table, string scope, string rule_name, string name)
+{
+   char key[symbolKeyLength(scope, rule_name, name)];
+   writeSymbolKey(key, scope, rule_name, name);
+   return g_hash_table_lookup(table, key);
+}
+
+void enterSymbols(GHashTable *table, string scope, string rule_name, string name,
+                  SymbolList *list)
+{
+   string key = malloc(symbolKeyLength(scope, rule_name, name));
+   if(key == NULL) {
+      print_to_log("Error (enterSymbols): malloc failure.\n");
+      exit(1);
+   }
+   writeSymbolKey(key, scope, rule_name, name);
+   g_hash_table_replace(table, key, list);
+}
+
+string symbolKeyName(string key)
 {
-   return !strcmp(symbol->scope, scope) && !strcmp(symbol->rule_name, rule_name);
+   return strrchr(key, KEY_SEPARATOR) + 1;
 }
 
 void freeSymbolList(gpointer key, gpointer value, gpointer user_data) 
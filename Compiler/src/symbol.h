@@ -35,7 +35,9 @@
 #include <string.h> 
 
 /* GP2 symbols are stored in struct Symbol. These are values of the symbol
- * table. The hash key of each symbol is its name in the GP2 program text.
+ * table. The hash key of each symbol is the triple of its scope, its rule and
+ * its name in the GP2 program text, so that a lookup finds only the symbols of
+ * one rule: at most one variable and one node or edge of each graph.
  *
  * GP2's symbols are:
  * - Procedures
@@ -89,9 +91,16 @@ typedef struct SymbolList {
 
 SymbolList *addSymbol(SymbolList *list, SymbolType type, string scope, string rule,
                       bool is_var, bool in_lhs, bool wildcard, bool bidirectional);
-bool symbolInScope(SymbolList *symbol, string scope, string rule_name);
 void freeSymbolList(gpointer key, gpointer value, gpointer user_data); 
 
+/* Return and replace the list of symbols with the given scope, rule and name.
+ * The rule name of procedures and rules is NULL. */
+SymbolList *lookupSymbols(GHashTable *table, string scope, string rule_name, string name);
+void enterSymbols(GHashTable *table, string scope, string rule_name, string name,
+                  SymbolList *list);
+/* Returns the name part of a symbol table key. */
+string symbolKeyName(string key);
+
 /* BiEdge is used to store the necessary information for semantic checking of
  * bidirectional edges. We need to check for parallel bidirectional edges,
  * which requires the scope, the type of the graph (LHS or RHS) and the
@@ -23,6 +23,20 @@ else
    exit 1
 fi
   
+clean-tmp
+./gp2 stripprog
+
+# The runtime library is compiled from its sources, as lib is built after src.
+if gcc -I../lib /tmp/gp2/*.c ../lib/*.c -pthread -lm -o /tmp/gp2/gp2run &&
+   /tmp/gp2/gp2run -o /tmp/gp2/gp2.output strip-host > /dev/null &&
+   grep -q '(0, "z") (1, "bz" : "a")' /tmp/gp2/gp2.output; then
+   echo "PASS: Strip program matched after a rejected empty string."
+else
+   echo "FAIL: Strip program did not match after a rejected empty string."
+   clean-tmp
+   exit 1
+fi
+
 echo "All tests passed!"
 clean-tmp
 exit 0